@@ -63,6 +63,43 @@ ssize_t BackTrace::ToString(void * const* callstack, int frames, char *buf,
 #endif
 }
 
+void BackTrace::ToSymbols(void * const* callstack, int frames,
+                          std::vector<std::string> *symbols) {
+#ifdef DARWIN
+    return;
+#else
+    char **strs = backtrace_symbols(callstack, frames);
+    if (strs == NULL)
+        return;
+
+    for (int i = 0; i < frames; ++i) {
+        // Symbols look like "module(function+offset) [address]".
+        std::string symbol(strs[i]);
+        size_t start = symbol.find('(');
+        size_t end = symbol.find_first_of("+)", start);
+        if (start == std::string::npos || end == std::string::npos ||
+            end == start + 1) {
+            char address[32];
+            snprintf(address, sizeof(address), "%p", callstack[i]);
+            symbols->push_back(address);
+            continue;
+        }
+
+        std::string name(symbol, start + 1, end - start - 1);
+        int status;
+        char *demangledName =
+            abi::__cxa_demangle(name.c_str(), NULL, NULL, &status);
+        if (status == 0) {
+            symbols->push_back(demangledName);
+            free(demangledName);
+        } else {
+            symbols->push_back(name);
+        }
+    }
+    free(strs);
+#endif
+}
+
 int BackTrace::Get(void * const* &callstack) {
     callstack = (void * const *) calloc(1024, sizeof(void *));
     return backtrace((void **) callstack, 1024);
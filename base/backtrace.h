@@ -6,6 +6,7 @@
 #define BASE_BACKTRACE_H__
 
 #include <string>
+#include <vector>
 #include <unistd.h>
 
 //
@@ -22,6 +23,11 @@ public:
     static void Log(void * const* callstack, int frames,
                     const std::string &msg);
     static int Get(void * const* &callstack);
+
+    // Get the demangled function name of each frame in callstack. Unlike
+    // Log(), does not filter any frames.
+    static void ToSymbols(void * const* callstack, int frames,
+                          std::vector<std::string> *symbols);
 };
 
 #endif  // BASE_BACKTRACE_H__
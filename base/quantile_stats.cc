@@ -0,0 +1,280 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#include "base/quantile_stats.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <tbb/spin_mutex.h>
+
+using std::string;
+using std::vector;
+
+const double QuantileSnapshot::kDelta = 0.01;
+
+QuantileSnapshot::QuantileSnapshot() {
+    Clear();
+}
+
+void QuantileSnapshot::Clear() {
+    centroids_.clear();
+    count_ = 0;
+    min_ = std::numeric_limits<double>::max();
+    max_ = -std::numeric_limits<double>::max();
+    sum_ = 0;
+}
+
+void QuantileSnapshot::AddCentroid(double mean, uint64_t count) {
+    if (count == 0)
+        return;
+    centroids_.push_back(Centroid(mean, count));
+    count_ += count;
+    sum_ += mean * count;
+    min_ = std::min(min_, mean);
+    max_ = std::max(max_, mean);
+}
+
+void QuantileSnapshot::Merge(const QuantileSnapshot &rhs) {
+    if (rhs.count_ == 0)
+        return;
+    size_t size = centroids_.size();
+    centroids_.insert(centroids_.end(), rhs.centroids_.begin(),
+                      rhs.centroids_.end());
+    std::inplace_merge(centroids_.begin(), centroids_.begin() + size,
+                       centroids_.end());
+    count_ += rhs.count_;
+    sum_ += rhs.sum_;
+    min_ = std::min(min_, rhs.min_);
+    max_ = std::max(max_, rhs.max_);
+    Compress();
+}
+
+// Merge adjacent centroids as long as the combined centroid stays within
+// the t-digest size bound for its quantile (same bound as base/tdigest.c).
+void QuantileSnapshot::Compress() {
+    if (centroids_.size() < 2)
+        return;
+
+    CentroidList::iterator last = centroids_.begin();
+    double sum = 0;
+    for (CentroidList::iterator it = last + 1; it != centroids_.end(); ++it) {
+        uint64_t count = last->count + it->count;
+        double q = (sum + count / 2.0) / count_;
+        double threshold = 4 * count_ * kDelta * q * (1 - q);
+        if (count <= threshold) {
+            last->mean += it->count * (it->mean - last->mean) / count;
+            last->count = count;
+        } else {
+            sum += last->count;
+            *++last = *it;
+        }
+    }
+    centroids_.erase(last + 1, centroids_.end());
+}
+
+// Same interpolation as TDigest_percentile().
+double QuantileSnapshot::Percentile(double q) const {
+    if (centroids_.empty())
+        return 0;
+
+    double target = q * count_;
+    double t = 0;
+    size_t last = centroids_.size() - 1;
+    for (size_t i = 0; i <= last; ++i) {
+        const Centroid &c = centroids_[i];
+        if (target < t + c.count) {
+            if (i == 0 || i == last)
+                return c.mean;
+            double dprev = c.mean - centroids_[i - 1].mean;
+            double dnext = centroids_[i + 1].mean - c.mean;
+            double delta = 2 * std::min(dprev, dnext);
+            double value = c.mean + ((target - t) / c.count - 0.5) * delta;
+            return std::max(min_, std::min(max_, value));
+        }
+        t += c.count;
+    }
+    return centroids_[last].mean;
+}
+
+void QuantileSnapshot::GetSandeshData(QuantileStats *stats,
+                                      bool centroids) const {
+    stats->set_count(count_);
+    if (count_ != 0) {
+        stats->set_min(min_);
+        stats->set_max(max_);
+    }
+    stats->set_mean(mean());
+    stats->set_p50(Percentile(0.5));
+    stats->set_p90(Percentile(0.9));
+    stats->set_p99(Percentile(0.99));
+    stats->set_p999(Percentile(0.999));
+    if (!centroids)
+        return;
+
+    vector<QuantileCentroid> centroid_list;
+    for (CentroidList::const_iterator it = centroids_.begin();
+         it != centroids_.end(); ++it) {
+        QuantileCentroid centroid;
+        centroid.set_mean(it->mean);
+        centroid.set_count(it->count);
+        centroid_list.push_back(centroid);
+    }
+    stats->set_centroids(centroid_list);
+}
+
+void QuantileSnapshot::SetSandeshData(const QuantileStats &stats) {
+    Clear();
+    const vector<QuantileCentroid> &centroid_list = stats.get_centroids();
+    for (vector<QuantileCentroid>::const_iterator it = centroid_list.begin();
+         it != centroid_list.end(); ++it) {
+        centroids_.push_back(Centroid(it->get_mean(), it->get_count()));
+    }
+    std::sort(centroids_.begin(), centroids_.end());
+    count_ = stats.get_count();
+    if (count_ != 0) {
+        min_ = stats.get_min();
+        max_ = stats.get_max();
+        sum_ = stats.get_mean() * count_;
+    }
+}
+
+// Per-thread state of a QuantileDigest. The mutex is only contended when
+// a snapshot is being taken.
+struct QuantileDigest::LocalDigest {
+    LocalDigest() : nsamples(0) {
+    }
+
+    void Clear() {
+        digest.Clear();
+        nsamples = 0;
+    }
+
+    // Fold the buffered samples into the digest.
+    void Flush() {
+        if (nsamples == 0)
+            return;
+        std::sort(samples, samples + nsamples);
+        QuantileSnapshot batch;
+        batch.centroids_.reserve(nsamples);
+        for (size_t i = 0; i < nsamples; ++i) {
+            batch.AddCentroid(samples[i], 1);
+        }
+        nsamples = 0;
+        digest.Merge(batch);
+    }
+
+    tbb::spin_mutex mutex;
+    QuantileSnapshot digest;
+    double samples[kSampleBufferSize];
+    size_t nsamples;
+};
+
+QuantileDigest::QuantileDigest(const string &name)
+    : name_(name), local_(static_cast<LocalDigest *>(NULL)) {
+}
+
+QuantileDigest::~QuantileDigest() {
+    for (LocalDigestList::iterator it = local_list_.begin();
+         it != local_list_.end(); ++it) {
+        delete *it;
+    }
+}
+
+QuantileDigest::LocalDigest *QuantileDigest::CreateLocalDigest() {
+    LocalDigest *local = new LocalDigest();
+    tbb::mutex::scoped_lock lock(mutex_);
+    local_list_.push_back(local);
+    return local;
+}
+
+void QuantileDigest::Add(double value) {
+    LocalDigestPtr::reference local = local_.local();
+    if (local == NULL)
+        local = CreateLocalDigest();
+
+    tbb::spin_mutex::scoped_lock lock(local->mutex);
+    local->samples[local->nsamples++] = value;
+    if (local->nsamples == kSampleBufferSize)
+        local->Flush();
+}
+
+void QuantileDigest::GetSnapshot(QuantileSnapshot *snapshot) const {
+    snapshot->Clear();
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (LocalDigestList::const_iterator it = local_list_.begin();
+         it != local_list_.end(); ++it) {
+        LocalDigest *local = *it;
+        tbb::spin_mutex::scoped_lock local_lock(local->mutex);
+        local->Flush();
+        snapshot->Merge(local->digest);
+    }
+}
+
+void QuantileDigest::Clear() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (LocalDigestList::iterator it = local_list_.begin();
+         it != local_list_.end(); ++it) {
+        tbb::spin_mutex::scoped_lock local_lock((*it)->mutex);
+        (*it)->Clear();
+    }
+}
+
+QuantileRegistry *QuantileRegistry::GetInstance() {
+    static QuantileRegistry registry;
+    return &registry;
+}
+
+QuantileRegistry::QuantileRegistry() {
+}
+
+QuantileRegistry::~QuantileRegistry() {
+    for (DigestMap::iterator it = digest_map_.begin();
+         it != digest_map_.end(); ++it) {
+        delete it->second;
+    }
+}
+
+QuantileDigest *QuantileRegistry::Locate(const string &name) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    DigestMap::iterator it = digest_map_.find(name);
+    if (it != digest_map_.end())
+        return it->second;
+    QuantileDigest *digest = new QuantileDigest(name);
+    digest_map_.insert(std::make_pair(name, digest));
+    return digest;
+}
+
+QuantileDigest *QuantileRegistry::Find(const string &name) const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    DigestMap::const_iterator it = digest_map_.find(name);
+    return it != digest_map_.end() ? it->second : NULL;
+}
+
+void QuantileRegistry::GetSandeshData(const string &name, bool centroids,
+        vector<QuantileStats> *stats_list) const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (DigestMap::const_iterator it = digest_map_.begin();
+         it != digest_map_.end(); ++it) {
+        if (!name.empty() && name != it->first)
+            continue;
+        QuantileSnapshot snapshot;
+        it->second->GetSnapshot(&snapshot);
+        QuantileStats stats;
+        stats.set_name(it->first);
+        snapshot.GetSandeshData(&stats, centroids);
+        stats_list->push_back(stats);
+    }
+}
+
+void QuantileStatsReq::HandleRequest() const {
+    QuantileStatsResp *resp = new QuantileStatsResp;
+    vector<QuantileStats> stats_list;
+    QuantileRegistry::GetInstance()->GetSandeshData(get_name(),
+        get_centroids(), &stats_list);
+    resp->set_stats_list(stats_list);
+    resp->set_context(context());
+    resp->set_more(false);
+    resp->Response();
+}
@@ -0,0 +1,181 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+// quantile_stats.h
+//
+// Streaming quantile statistics using t-digests.
+//
+// QuantileDigest accumulates samples (latencies, sizes, ...) from any number
+// of threads. Each thread records into its own digest, so the hot path never
+// takes a shared lock. The per-thread digests are merged only when a snapshot
+// is taken.
+//
+// base/tdigest.c inserts every sample by walking its centroid tree, which
+// costs several usecs per sample. The digests here use the merging variant
+// of the algorithm instead: samples are buffered, sorted and merged into the
+// sorted centroid list in one pass using the same centroid size bound.
+//
+// QuantileSnapshot is a compact, mergeable summary made of the t-digest
+// centroids plus count/min/max/sum. Snapshots taken in different digests,
+// processes or daemons can be merged to compute percentiles over the union.
+//
+// QuantileRegistry is a process wide registry of named digests. Modules
+// declare a statistic with QuantileRegistry::Locate() and the statistics get
+// exported via the QuantileStatsReq introspect or as part of a daemon UVE
+// using SendQuantileStats().
+//
+#ifndef BASE_QUANTILE_STATS_H_
+#define BASE_QUANTILE_STATS_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/mutex.h>
+
+#include "base/time_util.h"
+#include "base/util.h"
+#include "base/sandesh/quantile_types.h"
+
+class QuantileSnapshot {
+public:
+    // Compression factor, centroids hold at most ~4 * delta * count samples.
+    static const double kDelta;
+
+    struct Centroid {
+        Centroid(double mean, uint64_t count) : mean(mean), count(count) {
+        }
+        bool operator<(const Centroid &rhs) const {
+            return mean < rhs.mean;
+        }
+        double mean;
+        uint64_t count;
+    };
+    typedef std::vector<Centroid> CentroidList;
+
+    QuantileSnapshot();
+
+    void Clear();
+    void AddCentroid(double mean, uint64_t count);
+    void Merge(const QuantileSnapshot &rhs);
+
+    // Returns the estimated value at quantile q (0 <= q <= 1).
+    double Percentile(double q) const;
+
+    uint64_t count() const { return count_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    double sum() const { return sum_; }
+    double mean() const { return count_ ? sum_ / count_ : 0; }
+    const CentroidList &centroids() const { return centroids_; }
+
+    void GetSandeshData(QuantileStats *stats, bool centroids) const;
+    // Rebuild a snapshot exported by GetSandeshData() with centroids.
+    void SetSandeshData(const QuantileStats &stats);
+
+private:
+    friend class QuantileDigest;
+
+    // Requires: centroids_ sorted by mean.
+    void Compress();
+
+    CentroidList centroids_;
+    uint64_t count_;
+    double min_;
+    double max_;
+    double sum_;
+};
+
+class QuantileDigest {
+public:
+    // Samples are buffered per thread and folded into the thread's digest
+    // in batches.
+    static const size_t kSampleBufferSize = 256;
+
+    explicit QuantileDigest(const std::string &name);
+    ~QuantileDigest();
+
+    // Concurrency: may be called from any thread.
+    void Add(double value);
+    void GetSnapshot(QuantileSnapshot *snapshot) const;
+    void Clear();
+
+    const std::string &name() const { return name_; }
+
+private:
+    struct LocalDigest;
+    typedef tbb::enumerable_thread_specific<LocalDigest *> LocalDigestPtr;
+    typedef std::vector<LocalDigest *> LocalDigestList;
+
+    LocalDigest *CreateLocalDigest();
+
+    std::string name_;
+    LocalDigestPtr local_;
+    // Protects local_list_, which is appended to once per thread.
+    mutable tbb::mutex mutex_;
+    LocalDigestList local_list_;
+
+    DISALLOW_COPY_AND_ASSIGN(QuantileDigest);
+};
+
+// Records the time (in usec) spent in a scope into a QuantileDigest.
+class QuantileTimer {
+public:
+    explicit QuantileTimer(QuantileDigest *digest)
+        : digest_(digest), start_(ClockMonotonicUsec()) {
+    }
+    ~QuantileTimer() {
+        digest_->Add(ClockMonotonicUsec() - start_);
+    }
+
+private:
+    QuantileDigest *digest_;
+    uint64_t start_;
+
+    DISALLOW_COPY_AND_ASSIGN(QuantileTimer);
+};
+
+class QuantileRegistry {
+public:
+    static QuantileRegistry *GetInstance();
+
+    QuantileRegistry();
+    ~QuantileRegistry();
+
+    // Returns the digest registered under name, creating it if necessary.
+    // The returned digest lives as long as the registry, so callers
+    // typically cache the pointer.
+    QuantileDigest *Locate(const std::string &name);
+    QuantileDigest *Find(const std::string &name) const;
+
+    // Fill stats for the digest matching name, or for all digests if name
+    // is empty.
+    void GetSandeshData(const std::string &name, bool centroids,
+                        std::vector<QuantileStats> *stats_list) const;
+
+private:
+    typedef std::map<std::string, QuantileDigest *> DigestMap;
+
+    mutable tbb::mutex mutex_;
+    DigestMap digest_map_;
+
+    DISALLOW_COPY_AND_ASSIGN(QuantileRegistry);
+};
+
+// The daemon UVE data type must carry a name key and a
+// list<quantile.QuantileStats> quantile_stats field.
+template <typename QuantileStatsUveType, typename QuantileStatsUveDataType>
+void SendQuantileStats(const std::string &name) {
+    QuantileStatsUveDataType data;
+    data.set_name(name);
+    std::vector<QuantileStats> stats_list;
+    QuantileRegistry::GetInstance()->GetSandeshData("", true, &stats_list);
+    data.set_quantile_stats(stats_list);
+    QuantileStatsUveType::Send(data);
+}
+
+#endif  // BASE_QUANTILE_STATS_H_
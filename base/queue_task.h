@@ -130,7 +130,6 @@ public:
         current_runner_(NULL),
         on_entry_defer_count_(0),
         deleted_(false),
-        enqueues_(0),
         dequeues_(0),
         drops_(0),
         max_iterations_(max_iterations),
@@ -144,6 +143,7 @@ public:
         measure_busy_time_(false) {
         count_ = 0;
         disabled_ = false;
+        enqueues_ = 0;
     }
 
     // Concurrency - should be called from a task whose policy
@@ -525,7 +525,7 @@ private:
     size_t on_entry_defer_count_;
     tbb::atomic<bool> disabled_;
     bool deleted_;
-    mutable size_t enqueues_;
+    mutable tbb::atomic<size_t> enqueues_;
     mutable size_t dequeues_;
     size_t drops_;
     size_t max_iterations_;
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#include "base/sharded_counter.h"
+
+#include <sched.h>
+
+#include <tbb/cache_aligned_allocator.h>
+
+using std::string;
+using std::vector;
+
+ShardedCounter::ShardedCounter() {
+    tbb::cache_aligned_allocator<Shard> allocator;
+    shards_ = allocator.allocate(kShards);
+    Set(0);
+}
+
+ShardedCounter::ShardedCounter(uint64_t value) {
+    tbb::cache_aligned_allocator<Shard> allocator;
+    shards_ = allocator.allocate(kShards);
+    Set(value);
+}
+
+ShardedCounter::~ShardedCounter() {
+    tbb::cache_aligned_allocator<Shard> allocator;
+    allocator.deallocate(shards_, kShards);
+}
+
+// Use the current CPU so that threads running on different CPUs update
+// different cache lines. Threads migrating between CPUs are harmless since
+// the shards are updated atomically. Fall back to a per-thread index if the
+// CPU is not known.
+size_t ShardedCounter::ShardIndex() {
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0)
+        return cpu % kShards;
+#endif
+    static tbb::atomic<size_t> next_index;
+    static __thread size_t thread_index;
+    if (thread_index == 0)
+        thread_index = next_index.fetch_and_increment() % kShards + 1;
+    return thread_index - 1;
+}
+
+uint64_t ShardedCounter::value() const {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < kShards; ++i) {
+        sum += shards_[i].value;
+    }
+    return sum;
+}
+
+void ShardedCounter::Set(uint64_t value) {
+    shards_[0].value = value;
+    for (size_t i = 1; i < kShards; ++i) {
+        shards_[i].value = 0;
+    }
+}
+
+// The registry is intentionally never destroyed, so that objects with
+// static storage duration (e.g. the TaskScheduler) can unregister their
+// counters at exit.
+CounterRegistry *CounterRegistry::GetInstance() {
+    static CounterRegistry *registry = new CounterRegistry();
+    return registry;
+}
+
+CounterRegistry::CounterRegistry() {
+    next_instance_id_ = 0;
+}
+
+CounterRegistry::~CounterRegistry() {
+}
+
+void CounterRegistry::Register(const string &name, ReadFn read_fn) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    counter_map_[name] = read_fn;
+}
+
+void CounterRegistry::Unregister(const string &name) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    counter_map_.erase(name);
+}
+
+void CounterRegistry::UnregisterPrefix(const string &prefix) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    CounterMap::iterator it = counter_map_.lower_bound(prefix);
+    while (it != counter_map_.end() &&
+           it->first.compare(0, prefix.size(), prefix) == 0) {
+        counter_map_.erase(it++);
+    }
+}
+
+bool CounterRegistry::Find(const string &name, uint64_t *value) const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    CounterMap::const_iterator it = counter_map_.find(name);
+    if (it == counter_map_.end())
+        return false;
+    *value = it->second();
+    return true;
+}
+
+size_t CounterRegistry::Count() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return counter_map_.size();
+}
+
+void CounterRegistry::GetSandeshData(const string &prefix,
+        vector<CounterStats> *counter_list) const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (CounterMap::const_iterator it = counter_map_.lower_bound(prefix);
+         it != counter_map_.end() &&
+         it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        CounterStats stats;
+        stats.set_name(it->first);
+        stats.set_value(it->second());
+        counter_list->push_back(stats);
+    }
+}
+
+void CounterStatsReq::HandleRequest() const {
+    CounterStatsResp *resp = new CounterStatsResp;
+    vector<CounterStats> counter_list;
+    CounterRegistry::GetInstance()->GetSandeshData(get_prefix(),
+                                                   &counter_list);
+    resp->set_counter_list(counter_list);
+    resp->set_context(context());
+    resp->set_more(false);
+    resp->Response();
+}
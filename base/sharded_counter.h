@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+// sharded_counter.h
+//
+// ShardedCounter is a statistics counter for hot paths that are executed
+// concurrently by many threads (e.g. enqueues to a WorkQueue, bytes read
+// by all sessions of a TcpServer).
+//
+// A tbb::atomic shared by all threads bounces its cache line between the
+// CPUs on every update. ShardedCounter spreads the updates over a set of
+// cache line aligned shards, indexed by the CPU the caller is running on,
+// and sums up the shards only when the counter is read. Updates are cheap
+// and reads are comparatively expensive, so it should only be used for
+// counters that are read for statistics.
+//
+// CounterRegistry is a process wide registry of named counters. Modules
+// register their counters (sharded or not) and all of them get exported
+// by a single CounterStatsReq introspect.
+//
+#ifndef BASE_SHARDED_COUNTER_H_
+#define BASE_SHARDED_COUNTER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
+#include "base/util.h"
+#include "base/sandesh/counter_types.h"
+
+class ShardedCounter {
+public:
+    static const size_t kShards = 16;
+    static const size_t kCacheLineSize = 64;
+
+    ShardedCounter();
+    explicit ShardedCounter(uint64_t value);
+    ~ShardedCounter();
+
+    void Add(uint64_t value) {
+        shards_[ShardIndex()].value.fetch_and_add(value);
+    }
+    void Increment() { Add(1); }
+
+    // Sum of all the shards. Not a snapshot with respect to concurrent
+    // updates, but never misses a completed update.
+    uint64_t value() const;
+
+    // Not atomic with respect to concurrent updates, meant to be used to
+    // clear statistics.
+    void Set(uint64_t value);
+    void Reset() { Set(0); }
+
+    ShardedCounter &operator=(uint64_t value) {
+        Set(value);
+        return *this;
+    }
+    ShardedCounter &operator+=(uint64_t value) {
+        Add(value);
+        return *this;
+    }
+    ShardedCounter &operator++() {
+        Add(1);
+        return *this;
+    }
+    // Unlike for integral types, returns nothing to avoid the cost of the
+    // read.
+    void operator++(int) { Add(1); }
+    operator uint64_t() const { return value(); }
+
+private:
+    struct Shard {
+        tbb::atomic<uint64_t> value;
+        char pad[kCacheLineSize - sizeof(tbb::atomic<uint64_t>)];
+    };
+
+    static size_t ShardIndex();
+
+    Shard *shards_;
+
+    DISALLOW_COPY_AND_ASSIGN(ShardedCounter);
+};
+
+class CounterRegistry {
+public:
+    typedef boost::function<uint64_t(void)> ReadFn;
+
+    static CounterRegistry *GetInstance();
+
+    CounterRegistry();
+    ~CounterRegistry();
+
+    // Register a counter under name, replacing any counter previously
+    // registered under the same name. The counter must be unregistered
+    // before it is destroyed.
+    void Register(const std::string &name, ReadFn read_fn);
+    template <typename CounterT>
+    void Register(const std::string &name, const CounterT *counter) {
+        Register(name, boost::bind(&CounterRegistry::Read<CounterT>, counter));
+    }
+    void Unregister(const std::string &name);
+    // Unregister all the counters whose name starts with prefix.
+    void UnregisterPrefix(const std::string &prefix);
+
+    // Id to tell apart in the counter names the objects that share a name,
+    // e.g. the servers bound to the same endpoint with SO_REUSEPORT.
+    uint32_t NewInstanceId() { return next_instance_id_.fetch_and_increment(); }
+
+    bool Find(const std::string &name, uint64_t *value) const;
+    size_t Count() const;
+
+    // Fill stats for all the counters whose name starts with prefix.
+    void GetSandeshData(const std::string &prefix,
+                        std::vector<CounterStats> *counter_list) const;
+
+private:
+    typedef std::map<std::string, ReadFn> CounterMap;
+
+    template <typename CounterT>
+    static uint64_t Read(const CounterT *counter) {
+        return *counter;
+    }
+
+    tbb::atomic<uint32_t> next_instance_id_;
+    mutable tbb::mutex mutex_;
+    CounterMap counter_map_;
+
+    DISALLOW_COPY_AND_ASSIGN(CounterRegistry);
+};
+
+#endif  // BASE_SHARDED_COUNTER_H_
@@ -13,13 +13,17 @@
 #include "tbb/task.h"
 #include "tbb/enumerable_thread_specific.h"
 #include "base/logging.h"
+#include "base/sharded_counter.h"
 #include "base/task.h"
 #include "base/task_annotations.h"
 #include "base/task_tbbkeepawake.h"
 #include "base/task_monitor.h"
+#include "base/task_profiler.h"
 
 #include <base/sandesh/task_types.h>
 
+#include <sys/resource.h>
+
 #if defined(__FreeBSD__)
 #include <sys/param.h>
 #include <sys/sysctl.h>
@@ -194,6 +198,11 @@ public:
     void PolicySet();
     void TaskStarted() {run_count_++;};
     void IncrementTotalRunTime(int64_t rtime) { total_run_time_ += rtime; }
+    void IncrementTotalCpuTime(int64_t ctime) { total_cpu_time_ += ctime; }
+    void IncrementInvoluntaryContextSwitches(int64_t count) {
+        involuntary_context_switches_ += count;
+    }
+    void GetRunTimeStats(TaskRunTimeStats *stats) const;
     TaskStats *GetTaskGroupStats();
     TaskStats *GetTaskStats();
     TaskStats *GetTaskStats(int task_instance);
@@ -236,6 +245,8 @@ private:
     bool                    policy_set_;// policy already set?
     int                     run_count_; // # of tasks running in the group
     tbb::atomic<uint64_t>   total_run_time_;
+    tbb::atomic<uint64_t>   total_cpu_time_;
+    tbb::atomic<uint64_t>   involuntary_context_switches_;
 
     TaskGroupPolicyList     policy_;    // Policy rules for the group
     TaskDeferList           deferq_;    // Tasks deferred till run_count_ is 0
@@ -254,6 +265,16 @@ private:
 // Implementation for class TaskImpl
 ////////////////////////////////////////////////////////////////////////////
 
+// Number of times the calling thread was preempted.
+static int64_t ThreadInvoluntaryContextSwitches() {
+#if defined(RUSAGE_THREAD)
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+        return usage.ru_nivcsw;
+#endif
+    return 0;
+}
+
 // Method called from tbb::task to execute.
 // Invoke Run() method of client.
 // Supports task continuation when Run() returns false
@@ -275,18 +296,44 @@ tbb::task *TaskImpl::execute() {
             t = ClockMonotonicUsec();
         }
 
+        // Wall clock time includes the time the thread is preempted or
+        // blocked, so also measure the cpu time when tracking run time.
+        TaskScheduler *scheduler = TaskScheduler::GetInstance();
+        bool track_run_time = scheduler->track_run_time();
+        bool track_context_switches =
+            track_run_time && scheduler->track_context_switches();
+        uint64_t cpu_time = 0;
+        int64_t context_switches = 0;
+        if (track_run_time) {
+            cpu_time = ThreadCpuTimeUsec();
+            if (track_context_switches)
+                context_switches = ThreadInvoluntaryContextSwitches();
+        }
+
+        TaskProfiler::TaskStart(parent_);
         bool is_complete = parent_->Run();
+        TaskProfiler::TaskEnd();
+        if (track_run_time)
+            cpu_time = ThreadCpuTimeUsec() - cpu_time;
         if (t != 0) {
             int64_t delay = ClockMonotonicUsec() - t;
-            TaskScheduler *scheduler = TaskScheduler::GetInstance();
             uint32_t execute_delay = scheduler->execute_delay(parent_);
             if (execute_delay && delay > execute_delay) {
                 TASK_TRACE(scheduler, parent_, "Run time(in usec) ", delay);
+                if (track_run_time) {
+                    TASK_TRACE(scheduler, parent_, "CPU time(in usec) ",
+                               cpu_time);
+                }
             }
-            if (scheduler->track_run_time()) {
+            if (track_run_time) {
                 TaskGroup *group =
                     scheduler->QueryTaskGroup(parent_->GetTaskId());
                 group->IncrementTotalRunTime(delay);
+                group->IncrementTotalCpuTime(cpu_time);
+                if (track_context_switches) {
+                    group->IncrementInvoluntaryContextSwitches(
+                        ThreadInvoluntaryContextSwitches() - context_switches);
+                }
             }
         }
 
@@ -369,18 +416,29 @@ bool TaskScheduler::ShouldUseSpawn() {
 TaskScheduler::TaskScheduler(int task_count) :
     use_spawn_(ShouldUseSpawn()), task_scheduler_(GetThreadCount(task_count) + 1),
     running_(true), seqno_(0), id_max_(0), log_fn_(), track_run_time_(false),
+    track_context_switches_(false),
     measure_delay_(false), schedule_delay_(0), execute_delay_(0),
     enqueue_count_(0), done_count_(0), cancel_count_(0), evm_(NULL),
     tbb_awake_task_(NULL), task_monitor_(NULL) {
     hw_thread_count_ = GetThreadCount(task_count);
     task_group_db_.resize(TaskScheduler::kVectorGrowSize);
     stop_entry_ = new TaskEntry(-1);
+
+    CounterRegistry *registry = CounterRegistry::GetInstance();
+    registry->Register("task.scheduler.enqueue_count",
+                       boost::bind(&TaskScheduler::enqueue_count, this));
+    registry->Register("task.scheduler.done_count",
+                       boost::bind(&TaskScheduler::done_count, this));
+    registry->Register("task.scheduler.cancel_count",
+                       boost::bind(&TaskScheduler::cancel_count, this));
 }
 
 // Free up the task_entry_db_ allocated for scheduler
 TaskScheduler::~TaskScheduler() {
     TaskGroup   *group;
 
+    CounterRegistry::GetInstance()->UnregisterPrefix("task.scheduler.");
+
     for (TaskGroupDb::iterator iter = task_group_db_.begin();
          iter != task_group_db_.end(); ++iter) {
         if ((group = *iter) == NULL) {
@@ -857,6 +915,16 @@ TaskStats *TaskScheduler::GetTaskGroupStats(int task_id) {
     return group->GetTaskGroupStats();
 }
 
+bool TaskScheduler::GetTaskGroupRunTimeStats(int task_id,
+                                             TaskRunTimeStats *stats) {
+    TaskGroup *group = QueryTaskGroup(task_id);
+    if (group == NULL)
+        return false;
+
+    group->GetRunTimeStats(stats);
+    return true;
+}
+
 TaskStats *TaskScheduler::GetTaskStats(int task_id) {
     TaskGroup *group = GetTaskGroup(task_id);
     if (group == NULL)
@@ -1052,6 +1120,8 @@ void TaskScheduler::EnableTaskEntry(int task_id, int instance_id) {
 TaskGroup::TaskGroup(int task_id) : task_id_(task_id), policy_set_(false),
     run_count_(0), execute_delay_(0), schedule_delay_(0), disable_(false) {
     total_run_time_ = 0;
+    total_cpu_time_ = 0;
+    involuntary_context_switches_ = 0;
     task_entry_db_.resize(TaskGroup::kVectorGrowSize);
     task_entry_ = new TaskEntry(task_id);
     memset(&stats_, 0, sizeof(stats_));
@@ -1258,6 +1328,12 @@ TaskStats *TaskGroup::GetTaskGroupStats() {
     return &stats_;
 }
 
+void TaskGroup::GetRunTimeStats(TaskRunTimeStats *stats) const {
+    stats->run_time_ = total_run_time_;
+    stats->cpu_time_ = total_cpu_time_;
+    stats->involuntary_context_switches_ = involuntary_context_switches_;
+}
+
 TaskStats *TaskGroup::GetTaskStats() {
     return task_entry_->GetTaskStats();
 }
@@ -1607,6 +1683,12 @@ void TaskEntry::GetSandeshData(SandeshTaskEntry *resp) const {
 void TaskGroup::GetSandeshData(SandeshTaskGroup *resp, bool summary) const {
     if (total_run_time_)
         resp->set_total_run_time(duration_usecs_to_string(total_run_time_));
+    if (total_cpu_time_)
+        resp->set_total_cpu_time(duration_usecs_to_string(total_cpu_time_));
+    if (involuntary_context_switches_) {
+        resp->set_involuntary_context_switches(
+            involuntary_context_switches_);
+    }
 
     std::vector<SandeshTaskEntry> list;
     TaskEntry *task_entry = QueryTaskEntry(-1);
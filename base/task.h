@@ -58,6 +58,14 @@ struct TaskStats {
     uint64_t last_exit_time_;           // #Time stamp of latest exist
 };
 
+// Time spent running the tasks of a group. Only collected when
+// TaskScheduler::track_run_time() is set.
+struct TaskRunTimeStats {
+    uint64_t run_time_;                 // Wall clock time in usecs
+    uint64_t cpu_time_;                 // Thread cpu time in usecs
+    uint64_t involuntary_context_switches_;
+};
+
 struct TaskExclusion {
     TaskExclusion(int task_id) : match_id(task_id), match_instance(-1) {}
     TaskExclusion(int task_id, int instance_id)
@@ -226,8 +234,16 @@ public:
              const char *description, uint64_t delay);
     void RegisterLog(LogFn fn);
 
+    // Track the wall clock and cpu time taken by the tasks of each group.
     void SetTrackRunTime(bool value) { track_run_time_ = value; }
     bool track_run_time() const { return track_run_time_; }
+    // Also count involuntary context switches while tasks run. Costs a
+    // system call before and after each task, only supported on Linux.
+    void SetTrackContextSwitches(bool value) {
+        track_context_switches_ = value;
+    }
+    bool track_context_switches() const { return track_context_switches_; }
+    bool GetTaskGroupRunTimeStats(int task_id, TaskRunTimeStats *stats);
 
     // Enable logging of tasks exceeding configured latency
     void EnableLatencyThresholds(uint32_t execute, uint32_t schedule);
@@ -295,6 +311,7 @@ private:
     int                     hw_thread_count_;
 
     bool                    track_run_time_;
+    bool                    track_context_switches_;
     bool                    measure_delay_;
     // Log if time between enqueue and task-execute exceeds the delay
     uint32_t                schedule_delay_;
@@ -0,0 +1,352 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#include "base/task_profiler.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+
+#include "base/backtrace.h"
+#include "base/logging.h"
+#include "base/task.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const int kMaxDepth = 48;
+const size_t kDescriptionSize = 64;
+const uint64_t kBufferSize = 512;
+// Frames of the signal handler and the signal trampoline.
+const int kSkipFrames = 2;
+
+}  // namespace
+
+tbb::atomic<bool> TaskProfiler::running_;
+__thread TaskProfiler::ThreadProfile *TaskProfiler::thread_profile_;
+
+struct TaskProfiler::ThreadProfile {
+    struct Sample {
+        int task_id;
+        char description[kDescriptionSize];
+        int depth;
+        void *pcs[kMaxDepth];
+    };
+
+    ThreadProfile()
+        : generation(0), timer_valid(false), valid(0), task_id(-1) {
+        description[0] = '\0';
+        head = 0;
+        tail = 0;
+        dropped = 0;
+    }
+
+    // Called from the signal handler, must be async signal safe.
+    void Record() {
+        uint64_t index = head;
+        if (index - tail >= kBufferSize) {
+            dropped++;
+            return;
+        }
+        Sample *sample = &samples[index % kBufferSize];
+        if (valid) {
+            sample->task_id = task_id;
+            memcpy(sample->description, description, kDescriptionSize);
+        } else {
+            sample->task_id = -1;
+            sample->description[0] = '\0';
+        }
+        sample->depth = backtrace(sample->pcs, kMaxDepth);
+        head = index + 1;
+    }
+
+    // Protected by TaskProfiler::mutex_.
+    uint32_t generation;
+    bool timer_valid;
+    timer_t timer;
+
+    // Task running on the thread. Only accessed by the thread itself and
+    // its signal handler, valid is cleared while the task is updated.
+    volatile sig_atomic_t valid;
+    int task_id;
+    char description[kDescriptionSize];
+
+    // Samples in [tail, head) are pending. head is only updated by the
+    // signal handler and tail by Drain().
+    tbb::atomic<uint64_t> head;
+    tbb::atomic<uint64_t> tail;
+    tbb::atomic<uint64_t> dropped;
+    Sample samples[kBufferSize];
+};
+
+struct TaskProfiler::StackKey {
+    bool operator<(const StackKey &rhs) const {
+        if (task_id != rhs.task_id)
+            return task_id < rhs.task_id;
+        if (description != rhs.description)
+            return description < rhs.description;
+        return pcs < rhs.pcs;
+    }
+
+    int task_id;
+    string description;
+    vector<void *> pcs;
+};
+
+TaskProfiler *TaskProfiler::GetInstance() {
+    static TaskProfiler profiler;
+    return &profiler;
+}
+
+TaskProfiler::TaskProfiler() : frequency_(0), samples_(0) {
+    generation_ = 0;
+}
+
+TaskProfiler::~TaskProfiler() {
+    Stop();
+}
+
+bool TaskProfiler::Start(uint32_t frequency) {
+#if defined(__linux__)
+    tbb::mutex::scoped_lock lock(mutex_);
+    static bool handler_installed;
+    if (!handler_installed) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = &TaskProfiler::SignalHandler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, NULL) != 0) {
+            LOG(ERROR, "TaskProfiler: sigaction failed: " << strerror(errno));
+            return false;
+        }
+        handler_installed = true;
+
+        // The first call to backtrace() loads the unwinder, which is not
+        // safe to do from the signal handler.
+        void *pcs[1];
+        backtrace(pcs, 1);
+    }
+
+    if (frequency == 0)
+        frequency = kDefaultFrequency;
+    frequency_ = std::min(frequency, kMaxFrequency);
+    generation_++;
+    running_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TaskProfiler::Stop() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+    for (ThreadProfileList::iterator it = profiles_.begin();
+         it != profiles_.end(); ++it) {
+        ThreadProfile *profile = *it;
+        if (profile->timer_valid) {
+            timer_delete(profile->timer);
+            profile->timer_valid = false;
+        }
+        Drain(profile);
+    }
+}
+
+void TaskProfiler::Clear() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (ThreadProfileList::iterator it = profiles_.begin();
+         it != profiles_.end(); ++it) {
+        Drain(*it);
+        (*it)->dropped = 0;
+    }
+    stacks_.clear();
+    samples_ = 0;
+}
+
+uint64_t TaskProfiler::dropped() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    uint64_t dropped = 0;
+    for (ThreadProfileList::const_iterator it = profiles_.begin();
+         it != profiles_.end(); ++it) {
+        dropped += (*it)->dropped;
+    }
+    return dropped;
+}
+
+void TaskProfiler::SignalHandler(int signo, siginfo_t *info, void *context) {
+    int saved_errno = errno;
+    ThreadProfile *profile = thread_profile_;
+    if (profile != NULL && running_)
+        profile->Record();
+    errno = saved_errno;
+}
+
+// Create the profile of the calling thread if needed, and arm a timer on
+// the CPU clock of the thread.
+TaskProfiler::ThreadProfile *TaskProfiler::SetupThread() {
+#if defined(__linux__)
+    tbb::mutex::scoped_lock lock(mutex_);
+    ThreadProfile *profile = thread_profile_;
+    if (profile == NULL) {
+        profile = new ThreadProfile();
+        profiles_.push_back(profile);
+        thread_profile_ = profile;
+    }
+    if (!running_)
+        return NULL;
+    if (profile->generation == generation_)
+        return profile->timer_valid ? profile : NULL;
+
+    profile->generation = generation_;
+    if (profile->timer_valid) {
+        timer_delete(profile->timer);
+        profile->timer_valid = false;
+    }
+
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &profile->timer) != 0) {
+        LOG(ERROR, "TaskProfiler: timer_create failed: " << strerror(errno));
+        return NULL;
+    }
+
+    struct itimerspec spec;
+    // tv_nsec must be below 1s, which is the period at 1 Hz
+    uint64_t period_nsecs = 1000000000ULL / frequency_;
+    spec.it_interval.tv_sec = period_nsecs / 1000000000ULL;
+    spec.it_interval.tv_nsec = period_nsecs % 1000000000ULL;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(profile->timer, 0, &spec, NULL) != 0) {
+        LOG(ERROR, "TaskProfiler: timer_settime failed: " << strerror(errno));
+        timer_delete(profile->timer);
+        return NULL;
+    }
+    profile->timer_valid = true;
+    return profile;
+#else
+    return NULL;
+#endif
+}
+
+void TaskProfiler::TaskStartInternal(const Task *task) {
+    ThreadProfile *profile = thread_profile_;
+    if (profile == NULL || profile->generation != generation_) {
+        profile = SetupThread();
+        if (profile == NULL)
+            return;
+    }
+
+    string description = task->Description();
+    profile->valid = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    profile->task_id = task->GetTaskId();
+    strncpy(profile->description, description.c_str(), kDescriptionSize - 1);
+    profile->description[kDescriptionSize - 1] = '\0';
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    profile->valid = 1;
+
+    // Drain the samples before the buffer fills up.
+    if (profile->head - profile->tail >= kBufferSize / 4) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        Drain(profile);
+    }
+}
+
+void TaskProfiler::TaskEndInternal() {
+    ThreadProfile *profile = thread_profile_;
+    if (profile != NULL)
+        profile->valid = 0;
+}
+
+void TaskProfiler::Drain(ThreadProfile *profile) {
+    uint64_t head = profile->head;
+    uint64_t tail = profile->tail;
+    for (; tail != head; ++tail) {
+        const ThreadProfile::Sample &sample =
+            profile->samples[tail % kBufferSize];
+        StackKey key;
+        key.task_id = sample.task_id;
+        key.description = sample.description;
+        if (sample.depth > kSkipFrames) {
+            key.pcs.assign(sample.pcs + kSkipFrames,
+                           sample.pcs + sample.depth);
+        }
+        stacks_[key]++;
+        samples_++;
+    }
+    profile->tail = tail;
+}
+
+static bool StackCompare(const std::pair<uint64_t, string> &lhs,
+                         const std::pair<uint64_t, string> &rhs) {
+    return lhs.first > rhs.first;
+}
+
+void TaskProfiler::GetStacks(size_t max_stacks, StackList *stacks) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (ThreadProfileList::iterator it = profiles_.begin();
+         it != profiles_.end(); ++it) {
+        Drain(*it);
+    }
+
+    // Resolve every distinct address once.
+    vector<void *> pcs;
+    for (StackMap::const_iterator it = stacks_.begin();
+         it != stacks_.end(); ++it) {
+        pcs.insert(pcs.end(), it->first.pcs.begin(), it->first.pcs.end());
+    }
+    std::sort(pcs.begin(), pcs.end());
+    pcs.erase(std::unique(pcs.begin(), pcs.end()), pcs.end());
+    vector<string> symbols;
+    if (!pcs.empty())
+        BackTrace::ToSymbols(&pcs[0], pcs.size(), &symbols);
+    std::map<void *, string> symbol_map;
+    for (size_t i = 0; i < pcs.size() && i < symbols.size(); ++i) {
+        symbol_map.insert(std::make_pair(pcs[i], symbols[i]));
+    }
+
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    vector<std::pair<uint64_t, string> > folded;
+    for (StackMap::const_iterator it = stacks_.begin();
+         it != stacks_.end(); ++it) {
+        const StackKey &key = it->first;
+        string stack;
+        if (key.task_id < 0) {
+            stack = "[no task]";
+        } else {
+            stack = scheduler->GetTaskName(key.task_id);
+            if (!key.description.empty())
+                stack += ";" + key.description;
+        }
+        for (vector<void *>::const_reverse_iterator pc = key.pcs.rbegin();
+             pc != key.pcs.rend(); ++pc) {
+            stack += ";" + symbol_map[*pc];
+        }
+        folded.push_back(std::make_pair(it->second, stack));
+    }
+
+    std::stable_sort(folded.begin(), folded.end(), StackCompare);
+    if (max_stacks && folded.size() > max_stacks)
+        folded.resize(max_stacks);
+    for (size_t i = 0; i < folded.size(); ++i) {
+        stacks->push_back(std::make_pair(folded[i].second, folded[i].first));
+    }
+}
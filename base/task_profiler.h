@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+// task_profiler.h
+//
+// Sampling profiler integrated with the TaskScheduler.
+//
+// When started, every thread that runs tasks arms a timer on its own CPU
+// clock, which raises SIGPROF each time the thread has consumed 1/frequency
+// seconds of CPU. The signal handler records the task group and the
+// description of the task running on the thread, along with a backtrace,
+// into a per-thread ring buffer. The ring buffers have a single producer
+// (the signal handler) and are drained into an aggregate map of stacks by
+// the owning thread when they fill up, or when the profile is read.
+//
+// The profile is exported in folded stack format, with the task group and
+// task description as the outermost frames:
+//     <task group>;<task description>;<outermost function>;...;<leaf> count
+// which can be fed directly to flamegraph tools.
+//
+// The profiler is opt-in and costs a single flag check per task when it is
+// not running. It is controlled with the SandeshTaskProfileRequest
+// introspect. Only supported on Linux.
+//
+#ifndef BASE_TASK_PROFILER_H_
+#define BASE_TASK_PROFILER_H_
+
+#include <signal.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
+#include "base/util.h"
+
+class Task;
+
+class TaskProfiler {
+public:
+    static const uint32_t kDefaultFrequency = 100;
+    static const uint32_t kMaxFrequency = 1000;
+
+    // Folded stack and the number of samples it was seen in.
+    typedef std::vector<std::pair<std::string, uint64_t> > StackList;
+
+    static TaskProfiler *GetInstance();
+
+    // Called by TaskImpl on the thread executing the task.
+    static void TaskStart(const Task *task) {
+        if (running_)
+            GetInstance()->TaskStartInternal(task);
+    }
+    static void TaskEnd() {
+        if (running_)
+            TaskEndInternal();
+    }
+
+    // Returns false if the profiler is not supported on this platform.
+    bool Start(uint32_t frequency);
+    void Stop();
+    void Clear();
+
+    // Fill the folded stacks, most frequent first. Returns at most
+    // max_stacks stacks, if non-zero.
+    void GetStacks(size_t max_stacks, StackList *stacks);
+
+    static bool running() { return running_; }
+    uint32_t frequency() const { return frequency_; }
+    uint64_t samples() const { return samples_; }
+    uint64_t dropped() const;
+
+private:
+    struct ThreadProfile;
+    struct StackKey;
+    typedef std::vector<ThreadProfile *> ThreadProfileList;
+    typedef std::map<StackKey, uint64_t> StackMap;
+
+    TaskProfiler();
+    ~TaskProfiler();
+
+    void TaskStartInternal(const Task *task);
+    static void TaskEndInternal();
+    ThreadProfile *SetupThread();
+    // Requires: mutex_ is held.
+    void Drain(ThreadProfile *profile);
+    static void SignalHandler(int signo, siginfo_t *info, void *context);
+
+    static tbb::atomic<bool> running_;
+    static __thread ThreadProfile *thread_profile_;
+    // Incremented on every Start(), threads re-arm their timer when it
+    // changes.
+    tbb::atomic<uint32_t> generation_;
+    uint32_t frequency_;
+    // Protects everything below.
+    mutable tbb::mutex mutex_;
+    ThreadProfileList profiles_;
+    StackMap stacks_;
+    uint64_t samples_;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskProfiler);
+};
+
+#endif  // BASE_TASK_PROFILER_H_
@@ -4,6 +4,7 @@
 
 #include <base/task.h>
 #include <base/task_monitor.h>
+#include <base/task_profiler.h>
 #include <base/sandesh/task_types.h>
 #include <base/task_tbbkeepawake.h>
 
@@ -50,3 +51,35 @@ void SandeshTaskMonitorRequest::HandleRequest() const {
 
     resp->Response();
 }
+
+void SandeshTaskProfileRequest::HandleRequest() const {
+    TaskProfiler *profiler = TaskProfiler::GetInstance();
+    if (get_command() == "start") {
+        profiler->Start(get_frequency());
+    } else if (get_command() == "stop") {
+        profiler->Stop();
+    } else if (get_command() == "clear") {
+        profiler->Clear();
+    }
+
+    SandeshTaskProfileResponse *resp = new SandeshTaskProfileResponse;
+    resp->set_context(context());
+    resp->set_more(false);
+    resp->set_running(TaskProfiler::running());
+    resp->set_frequency(profiler->frequency());
+
+    TaskProfiler::StackList stacks;
+    profiler->GetStacks(get_max_stacks(), &stacks);
+    std::vector<SandeshTaskProfileStack> stack_list;
+    for (TaskProfiler::StackList::const_iterator it = stacks.begin();
+         it != stacks.end(); ++it) {
+        SandeshTaskProfileStack stack;
+        stack.set_stack(it->first);
+        stack.set_count(it->second);
+        stack_list.push_back(stack);
+    }
+    resp->set_samples(profiler->samples());
+    resp->set_dropped(profiler->dropped());
+    resp->set_stack_list(stack_list);
+    resp->Response();
+}
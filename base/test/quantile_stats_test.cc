@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/quantile_stats.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "base/logging.h"
+#include "testing/gunit.h"
+
+class QuantileStatsTest : public ::testing::Test {
+protected:
+    static void AddRange(QuantileDigest *digest, int start, int end) {
+        for (int i = start; i < end; ++i) {
+            digest->Add(i);
+        }
+    }
+};
+
+TEST_F(QuantileStatsTest, Empty) {
+    QuantileDigest digest("empty");
+    QuantileSnapshot snapshot;
+    digest.GetSnapshot(&snapshot);
+    EXPECT_EQ(0U, snapshot.count());
+    EXPECT_EQ(0, snapshot.Percentile(0.5));
+}
+
+TEST_F(QuantileStatsTest, Uniform) {
+    QuantileDigest digest("uniform");
+    AddRange(&digest, 0, 100000);
+
+    QuantileSnapshot snapshot;
+    digest.GetSnapshot(&snapshot);
+    EXPECT_EQ(100000U, snapshot.count());
+    EXPECT_EQ(0, snapshot.min());
+    EXPECT_EQ(99999, snapshot.max());
+    EXPECT_NEAR(49999.5, snapshot.mean(), 0.01);
+    EXPECT_NEAR(50000, snapshot.Percentile(0.5), 1000);
+    EXPECT_NEAR(90000, snapshot.Percentile(0.9), 1000);
+    EXPECT_NEAR(99000, snapshot.Percentile(0.99), 200);
+    EXPECT_LT(snapshot.centroids().size(), 1000U);
+}
+
+TEST_F(QuantileStatsTest, MultiThread) {
+    static const int kThreads = 4;
+    static const int kSamples = 25000;
+    QuantileDigest digest("multi_thread");
+    boost::thread_group threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.create_thread(boost::bind(&QuantileStatsTest::AddRange,
+            &digest, i * kSamples, (i + 1) * kSamples));
+    }
+    threads.join_all();
+
+    QuantileSnapshot snapshot;
+    digest.GetSnapshot(&snapshot);
+    EXPECT_EQ(kThreads * kSamples, static_cast<int>(snapshot.count()));
+    EXPECT_EQ(0, snapshot.min());
+    EXPECT_EQ(kThreads * kSamples - 1, snapshot.max());
+    EXPECT_NEAR(kThreads * kSamples / 2, snapshot.Percentile(0.5), 1000);
+
+    digest.Clear();
+    digest.GetSnapshot(&snapshot);
+    EXPECT_EQ(0U, snapshot.count());
+}
+
+TEST_F(QuantileStatsTest, Merge) {
+    QuantileDigest low("low");
+    QuantileDigest high("high");
+    AddRange(&low, 0, 50000);
+    AddRange(&high, 50000, 100000);
+
+    QuantileSnapshot snapshot, high_snapshot;
+    low.GetSnapshot(&snapshot);
+    high.GetSnapshot(&high_snapshot);
+    EXPECT_NEAR(25000, snapshot.Percentile(0.5), 1000);
+    snapshot.Merge(high_snapshot);
+    EXPECT_EQ(100000U, snapshot.count());
+    EXPECT_EQ(0, snapshot.min());
+    EXPECT_EQ(99999, snapshot.max());
+    EXPECT_NEAR(50000, snapshot.Percentile(0.5), 1000);
+    EXPECT_NEAR(90000, snapshot.Percentile(0.9), 1000);
+}
+
+TEST_F(QuantileStatsTest, SandeshRoundTrip) {
+    QuantileDigest digest("round_trip");
+    AddRange(&digest, 0, 10000);
+    QuantileSnapshot snapshot;
+    digest.GetSnapshot(&snapshot);
+
+    QuantileStats stats;
+    snapshot.GetSandeshData(&stats, true);
+    QuantileSnapshot copy;
+    copy.SetSandeshData(stats);
+    EXPECT_EQ(snapshot.count(), copy.count());
+    EXPECT_EQ(snapshot.centroids().size(), copy.centroids().size());
+    EXPECT_NEAR(snapshot.Percentile(0.9), copy.Percentile(0.9), 0.01);
+}
+
+TEST_F(QuantileStatsTest, Registry) {
+    QuantileRegistry *registry = QuantileRegistry::GetInstance();
+    EXPECT_TRUE(registry->Find("registry_test") == NULL);
+    QuantileDigest *digest = registry->Locate("registry_test");
+    EXPECT_EQ(digest, registry->Locate("registry_test"));
+    EXPECT_EQ(digest, registry->Find("registry_test"));
+    AddRange(digest, 0, 100);
+
+    std::vector<QuantileStats> stats_list;
+    registry->GetSandeshData("registry_test", false, &stats_list);
+    ASSERT_EQ(1U, stats_list.size());
+    EXPECT_EQ("registry_test", stats_list[0].get_name());
+    EXPECT_EQ(100U, stats_list[0].get_count());
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/sharded_counter.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "testing/gunit.h"
+
+class ShardedCounterTest : public ::testing::Test {
+protected:
+    static const int kThreads = 8;
+    static const int kIncrements = 10 * 1000;
+    static const int kPerfIncrements = 1000 * 1000;
+
+    template <typename CounterT>
+    static void IncrementCounter(CounterT *counter, int increments) {
+        for (int i = 0; i < increments; ++i) {
+            (*counter)++;
+        }
+    }
+
+    template <typename CounterT>
+    static uint64_t RunThreads(CounterT *counter, int increments) {
+        uint64_t start = ClockMonotonicUsec();
+        boost::thread_group threads;
+        for (int i = 0; i < kThreads; ++i) {
+            threads.create_thread(
+                boost::bind(&ShardedCounterTest::IncrementCounter<CounterT>,
+                            counter, increments));
+        }
+        threads.join_all();
+        return ClockMonotonicUsec() - start;
+    }
+
+    static uint64_t ReturnValue(uint64_t value) {
+        return value;
+    }
+};
+
+TEST_F(ShardedCounterTest, Basic) {
+    ShardedCounter counter;
+    EXPECT_EQ(0U, counter.value());
+    counter++;
+    ++counter;
+    counter += 10;
+    counter.Add(5);
+    EXPECT_EQ(17U, counter.value());
+    EXPECT_EQ(17U, static_cast<uint64_t>(counter));
+
+    counter = 100;
+    EXPECT_EQ(100U, counter.value());
+    counter.Increment();
+    EXPECT_EQ(101U, counter.value());
+    counter.Reset();
+    EXPECT_EQ(0U, counter.value());
+
+    ShardedCounter initialized(42);
+    EXPECT_EQ(42U, initialized.value());
+}
+
+// Verify that no updates are lost.
+TEST_F(ShardedCounterTest, MultiThread) {
+    ShardedCounter counter;
+    RunThreads(&counter, kIncrements);
+    EXPECT_EQ(static_cast<uint64_t>(kThreads) * kIncrements, counter.value());
+}
+
+// Compare the cost with a shared tbb::atomic.
+TEST_F(ShardedCounterTest, DISABLED_Performance) {
+    ShardedCounter counter;
+    uint64_t sharded_usecs = RunThreads(&counter, kPerfIncrements);
+    EXPECT_EQ(static_cast<uint64_t>(kThreads) * kPerfIncrements,
+              counter.value());
+
+    tbb::atomic<uint64_t> atomic_counter;
+    atomic_counter = 0;
+    uint64_t atomic_usecs = RunThreads(&atomic_counter, kPerfIncrements);
+    EXPECT_EQ(static_cast<uint64_t>(kThreads) * kPerfIncrements,
+              atomic_counter);
+
+    LOG(DEBUG, "ShardedCounter: " << kThreads << " threads, " << kPerfIncrements
+        << " increments each, atomic " << atomic_usecs << " usecs, sharded "
+        << sharded_usecs << " usecs");
+}
+
+TEST_F(ShardedCounterTest, Registry) {
+    CounterRegistry *registry = CounterRegistry::GetInstance();
+    ShardedCounter sharded(10);
+    tbb::atomic<uint64_t> atomic;
+    atomic = 20;
+    registry->Register("test.a.sharded", &sharded);
+    registry->Register("test.a.atomic", &atomic);
+    registry->Register("test.b.function",
+        boost::bind(&ShardedCounterTest::ReturnValue, 30));
+
+    uint64_t value = 0;
+    EXPECT_TRUE(registry->Find("test.a.sharded", &value));
+    EXPECT_EQ(10U, value);
+    sharded++;
+    atomic++;
+    EXPECT_TRUE(registry->Find("test.a.sharded", &value));
+    EXPECT_EQ(11U, value);
+    EXPECT_TRUE(registry->Find("test.a.atomic", &value));
+    EXPECT_EQ(21U, value);
+    EXPECT_FALSE(registry->Find("test.c", &value));
+
+    std::vector<CounterStats> counter_list;
+    registry->GetSandeshData("test.", &counter_list);
+    ASSERT_EQ(3U, counter_list.size());
+    EXPECT_EQ("test.a.atomic", counter_list[0].get_name());
+    EXPECT_EQ(21U, counter_list[0].get_value());
+    EXPECT_EQ("test.a.sharded", counter_list[1].get_name());
+    EXPECT_EQ("test.b.function", counter_list[2].get_name());
+    EXPECT_EQ(30U, counter_list[2].get_value());
+
+    counter_list.clear();
+    registry->GetSandeshData("test.a.", &counter_list);
+    EXPECT_EQ(2U, counter_list.size());
+
+    registry->UnregisterPrefix("test.a.");
+    EXPECT_FALSE(registry->Find("test.a.sharded", &value));
+    EXPECT_TRUE(registry->Find("test.b.function", &value));
+    registry->Unregister("test.b.function");
+    counter_list.clear();
+    registry->GetSandeshData("test.", &counter_list);
+    EXPECT_TRUE(counter_list.empty());
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
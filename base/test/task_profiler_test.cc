@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/task_profiler.h"
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "testing/gunit.h"
+
+using std::string;
+
+class ProfileTestTask : public Task {
+public:
+    ProfileTestTask(int task_id, uint64_t usecs)
+        : Task(task_id, 0), usecs_(usecs) {
+    }
+
+    // Spin to make sure the thread consumes cpu time.
+    bool Run() {
+        uint64_t end = ClockMonotonicUsec() + usecs_;
+        while (ClockMonotonicUsec() < end) {
+        }
+        return true;
+    }
+    std::string Description() const { return "ProfileTestTask"; }
+
+private:
+    uint64_t usecs_;
+};
+
+class TaskProfilerTest : public ::testing::Test {
+protected:
+    TaskProfilerTest()
+        : scheduler_(TaskScheduler::GetInstance()),
+          profiler_(TaskProfiler::GetInstance()) {
+    }
+
+    virtual void SetUp() {
+        profiler_->Clear();
+    }
+
+    virtual void TearDown() {
+        profiler_->Stop();
+        profiler_->Clear();
+    }
+
+    void RunTask(uint64_t usecs) {
+        int task_id = scheduler_->GetTaskId("profile::Test");
+        scheduler_->Enqueue(new ProfileTestTask(task_id, usecs));
+        task_util::WaitForIdle();
+    }
+
+    uint64_t TaskSamples(const TaskProfiler::StackList &stacks) {
+        uint64_t count = 0;
+        for (TaskProfiler::StackList::const_iterator it = stacks.begin();
+             it != stacks.end(); ++it) {
+            if (it->first.find("profile::Test;ProfileTestTask") == 0)
+                count += it->second;
+        }
+        return count;
+    }
+
+    TaskScheduler *scheduler_;
+    TaskProfiler *profiler_;
+};
+
+TEST_F(TaskProfilerTest, NotRunning) {
+    RunTask(10000);
+    TaskProfiler::StackList stacks;
+    profiler_->GetStacks(0, &stacks);
+    EXPECT_TRUE(stacks.empty());
+    EXPECT_EQ(0U, profiler_->samples());
+}
+
+TEST_F(TaskProfilerTest, Basic) {
+    ASSERT_TRUE(profiler_->Start(1000));
+    EXPECT_TRUE(TaskProfiler::running());
+    EXPECT_EQ(1000U, profiler_->frequency());
+    RunTask(300000);
+    profiler_->Stop();
+    EXPECT_FALSE(TaskProfiler::running());
+
+    TaskProfiler::StackList stacks;
+    profiler_->GetStacks(0, &stacks);
+    EXPECT_GT(TaskSamples(stacks), 0U);
+    EXPECT_LE(TaskSamples(stacks), profiler_->samples());
+    for (size_t i = 1; i < stacks.size(); ++i) {
+        EXPECT_GE(stacks[i - 1].second, stacks[i].second);
+    }
+    for (size_t i = 0; i < stacks.size() && i < 5; ++i) {
+        LOG(DEBUG, stacks[i].first << " " << stacks[i].second);
+    }
+
+    stacks.clear();
+    profiler_->GetStacks(1, &stacks);
+    EXPECT_EQ(1U, stacks.size());
+
+    // No samples are taken once stopped.
+    uint64_t samples = profiler_->samples();
+    RunTask(100000);
+    stacks.clear();
+    profiler_->GetStacks(0, &stacks);
+    EXPECT_EQ(samples, profiler_->samples());
+
+    profiler_->Clear();
+    EXPECT_EQ(0U, profiler_->samples());
+    stacks.clear();
+    profiler_->GetStacks(0, &stacks);
+    EXPECT_TRUE(stacks.empty());
+}
+
+TEST_F(TaskProfilerTest, Restart) {
+    ASSERT_TRUE(profiler_->Start(1000));
+    RunTask(100000);
+    profiler_->Stop();
+    ASSERT_TRUE(profiler_->Start(0));
+    EXPECT_EQ(TaskProfiler::kDefaultFrequency, profiler_->frequency());
+    RunTask(200000);
+    profiler_->Stop();
+
+    TaskProfiler::StackList stacks;
+    profiler_->GetStacks(0, &stacks);
+    EXPECT_GT(TaskSamples(stacks), 0U);
+}
+
+// The sampling period is a whole second at 1 Hz.
+TEST_F(TaskProfilerTest, LowFrequency) {
+    ASSERT_TRUE(profiler_->Start(1));
+    RunTask(1200000);
+    profiler_->Stop();
+
+    TaskProfiler::StackList stacks;
+    profiler_->GetStacks(0, &stacks);
+    EXPECT_GT(TaskSamples(stacks), 0U);
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
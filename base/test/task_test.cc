@@ -7,6 +7,7 @@
 #include "tbb/task.h"
 #include "base/task.h"
 #include "base/logging.h"
+#include "base/time_util.h"
 #include "testing/gunit.h"
 
 void TestWait(int max);
@@ -1478,6 +1479,62 @@ TEST_F(TestUT, test10_4)
     TestWait(10);
 }
 
+class RunTimeTestTask : public Task {
+public:
+    RunTimeTestTask(int task_id, bool spin, uint64_t usecs)
+        : Task(task_id, 0), spin_(spin), usecs_(usecs) {
+    }
+
+    bool Run() {
+        if (!spin_) {
+            usleep(usecs_);
+            return true;
+        }
+        uint64_t end = ClockMonotonicUsec() + usecs_;
+        while (ClockMonotonicUsec() < end) {
+        }
+        return true;
+    }
+    std::string Description() const { return "RunTimeTestTask"; }
+
+private:
+    bool spin_;
+    uint64_t usecs_;
+};
+
+/* Verify that cpu time is accounted separately from wall clock time: a
+ * task blocked in usleep takes run time but almost no cpu time. */
+TEST_F(TestUT, RunTimeStats)
+{
+    scheduler->SetTrackRunTime(true);
+    scheduler->SetTrackContextSwitches(true);
+    int spin_id = scheduler->GetTaskId("test::RunTimeSpin");
+    int sleep_id = scheduler->GetTaskId("test::RunTimeSleep");
+
+    scheduler->Enqueue(new RunTimeTestTask(spin_id, true, 100000));
+    scheduler->Enqueue(new RunTimeTestTask(sleep_id, false, 100000));
+    for (int i = 0; i < 100 && !scheduler->IsEmpty(); ++i) {
+        usleep(100000);
+    }
+    EXPECT_TRUE(scheduler->IsEmpty());
+    scheduler->SetTrackRunTime(false);
+    scheduler->SetTrackContextSwitches(false);
+
+    TaskRunTimeStats spin_stats, sleep_stats;
+    ASSERT_TRUE(scheduler->GetTaskGroupRunTimeStats(spin_id, &spin_stats));
+    ASSERT_TRUE(scheduler->GetTaskGroupRunTimeStats(sleep_id, &sleep_stats));
+    EXPECT_GE(spin_stats.run_time_, 100000U);
+    EXPECT_GT(spin_stats.cpu_time_, 0U);
+    EXPECT_LE(spin_stats.cpu_time_, spin_stats.run_time_ + 10000);
+    EXPECT_GE(sleep_stats.run_time_, 100000U);
+    EXPECT_LT(sleep_stats.cpu_time_, sleep_stats.run_time_ / 2);
+    LOG(DEBUG, "Spin: run " << spin_stats.run_time_ << " cpu "
+        << spin_stats.cpu_time_ << " preempted "
+        << spin_stats.involuntary_context_switches_);
+    LOG(DEBUG, "Sleep: run " << sleep_stats.run_time_ << " cpu "
+        << sleep_stats.cpu_time_);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/watermark.h"
+
+#include <stdlib.h>
+
+#include <boost/bind.hpp>
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "testing/gunit.h"
+
+// Reference implementation, which looks up the watermark sets on every
+// count change.
+class LegacyWaterMarkTuple {
+public:
+    LegacyWaterMarkTuple(const WaterMarkInfos &high_water,
+                         const WaterMarkInfos &low_water)
+        : high_water_(high_water), low_water_(low_water), last_count_(0) {
+    }
+
+    void ProcessHighWaterMarks(size_t count) {
+        if (high_water_.size() != 0) {
+            WaterMarkInfos::const_iterator ubound = high_water_.upper_bound(
+                WaterMarkInfo(count, NULL));
+            if (ubound != high_water_.begin()) {
+                --ubound;
+                if (last_count_ < ubound->count_) {
+                    ubound->cb_(count);
+                }
+            }
+        }
+        last_count_ = count;
+    }
+
+    void ProcessLowWaterMarks(size_t count) {
+        if (low_water_.size() != 0) {
+            WaterMarkInfos::const_iterator lbound = low_water_.lower_bound(
+                WaterMarkInfo(count, NULL));
+            if (lbound != low_water_.end()) {
+                if (last_count_ > lbound->count_) {
+                    lbound->cb_(count);
+                }
+            }
+        }
+        last_count_ = count;
+    }
+
+private:
+    WaterMarkInfos high_water_;
+    WaterMarkInfos low_water_;
+    size_t last_count_;
+};
+
+class WaterMarkTest : public ::testing::Test {
+public:
+    void Callback(size_t count, size_t watermark) {
+        if (callbacks_)
+            callbacks_->push_back(std::make_pair(watermark, count));
+    }
+
+protected:
+    typedef std::vector<std::pair<size_t, size_t> > CallbackList;
+
+    WaterMarkTest() : callbacks_(NULL) {
+    }
+
+    void SetUpWaterMarks() {
+        static const size_t hwm[] = { 1000, 5000, 10000 };
+        static const size_t lwm[] = { 500, 4000, 8000 };
+        for (size_t i = 0; i < sizeof(hwm) / sizeof(hwm[0]); ++i) {
+            high_water_.insert(WaterMarkInfo(hwm[i],
+                boost::bind(&WaterMarkTest::Callback, this, _1, hwm[i])));
+            low_water_.insert(WaterMarkInfo(lwm[i],
+                boost::bind(&WaterMarkTest::Callback, this, _1, lwm[i])));
+        }
+    }
+
+    // Random walk of the queue length between 0 and max, biased to fill up
+    // and drain the queue in bursts like a WorkQueue does.
+    void RandomWalk(size_t max, size_t steps, std::vector<int> *walk) {
+        int direction = 1;
+        size_t count = 0;
+        for (size_t i = 0; i < steps; ++i) {
+            if (rand() % 1000 == 0)
+                direction = -direction;
+            int step = (rand() % 4 == 0) ? -direction : direction;
+            if (count == 0)
+                step = 1;
+            else if (count == max)
+                step = -1;
+            count += step;
+            walk->push_back(step);
+        }
+    }
+
+    template <typename TupleT>
+    uint64_t Run(TupleT *tuple, const std::vector<int> &walk) {
+        uint64_t start = ClockMonotonicUsec();
+        size_t count = 0;
+        for (std::vector<int>::const_iterator it = walk.begin();
+             it != walk.end(); ++it) {
+            if (*it > 0) {
+                tuple->ProcessHighWaterMarks(++count);
+            } else {
+                tuple->ProcessLowWaterMarks(--count);
+            }
+        }
+        return ClockMonotonicUsec() - start;
+    }
+
+    WaterMarkInfos high_water_;
+    WaterMarkInfos low_water_;
+    CallbackList *callbacks_;
+};
+
+TEST_F(WaterMarkTest, Basic) {
+    SetUpWaterMarks();
+    WaterMarkTuple tuple;
+    tuple.SetHighWaterMark(high_water_);
+    tuple.SetLowWaterMark(low_water_);
+    CallbackList callbacks;
+    callbacks_ = &callbacks;
+
+    for (size_t count = 1; count <= 12000; ++count) {
+        tuple.ProcessHighWaterMarks(count);
+    }
+    ASSERT_EQ(3U, callbacks.size());
+    EXPECT_EQ(std::make_pair(size_t(1000), size_t(1000)), callbacks[0]);
+    EXPECT_EQ(std::make_pair(size_t(5000), size_t(5000)), callbacks[1]);
+    EXPECT_EQ(std::make_pair(size_t(10000), size_t(10000)), callbacks[2]);
+
+    callbacks.clear();
+    for (size_t count = 12000; count > 0; --count) {
+        tuple.ProcessLowWaterMarks(count - 1);
+    }
+    ASSERT_EQ(3U, callbacks.size());
+    EXPECT_EQ(std::make_pair(size_t(8000), size_t(8000)), callbacks[0]);
+    EXPECT_EQ(std::make_pair(size_t(4000), size_t(4000)), callbacks[1]);
+    EXPECT_EQ(std::make_pair(size_t(500), size_t(500)), callbacks[2]);
+
+    // Jumping over multiple watermarks invokes the callback of the last one.
+    callbacks.clear();
+    tuple.ProcessHighWaterMarks(6000);
+    ASSERT_EQ(1U, callbacks.size());
+    EXPECT_EQ(std::make_pair(size_t(5000), size_t(6000)), callbacks[0]);
+
+    // Watermarks changed while in the middle of a band.
+    callbacks.clear();
+    tuple.SetHighWaterMark(WaterMarkInfo(6001,
+        boost::bind(&WaterMarkTest::Callback, this, _1, 6001)));
+    tuple.ProcessHighWaterMarks(6001);
+    ASSERT_EQ(1U, callbacks.size());
+    EXPECT_EQ(std::make_pair(size_t(6001), size_t(6001)), callbacks[0]);
+
+    callbacks.clear();
+    tuple.ResetHighWaterMark();
+    tuple.ResetLowWaterMark();
+    tuple.ProcessHighWaterMarks(20000);
+    tuple.ProcessLowWaterMarks(0);
+    EXPECT_TRUE(callbacks.empty());
+}
+
+// Watermarks set after the count has moved must not be reported as crossed
+// by the next update.
+TEST_F(WaterMarkTest, SetAfterTraffic) {
+    WaterMarkTuple tuple;
+    CallbackList callbacks;
+    callbacks_ = &callbacks;
+
+    for (size_t count = 1; count <= 100; ++count) {
+        tuple.ProcessHighWaterMarks(count);
+    }
+    tuple.SetHighWaterMark(WaterMarkInfo(50,
+        boost::bind(&WaterMarkTest::Callback, this, _1, 50)));
+    tuple.SetLowWaterMark(WaterMarkInfo(150,
+        boost::bind(&WaterMarkTest::Callback, this, _1, 150)));
+    tuple.ProcessHighWaterMarks(101);
+    tuple.ProcessLowWaterMarks(100);
+    EXPECT_TRUE(callbacks.empty());
+
+    // The marks are still reported when crossed.
+    tuple.ProcessLowWaterMarks(40);
+    tuple.ProcessHighWaterMarks(60);
+    ASSERT_EQ(1U, callbacks.size());
+    EXPECT_EQ(std::make_pair(size_t(50), size_t(60)), callbacks[0]);
+}
+
+// Verify that the band based implementation invokes the same callbacks as
+// the reference implementation.
+TEST_F(WaterMarkTest, CompareWithLegacy) {
+    SetUpWaterMarks();
+    std::vector<int> walk;
+    srand(1);
+    RandomWalk(12000, 1000 * 1000, &walk);
+
+    CallbackList legacy_callbacks;
+    callbacks_ = &legacy_callbacks;
+    LegacyWaterMarkTuple legacy(high_water_, low_water_);
+    Run(&legacy, walk);
+
+    CallbackList callbacks;
+    callbacks_ = &callbacks;
+    WaterMarkTuple tuple;
+    tuple.SetHighWaterMark(high_water_);
+    tuple.SetLowWaterMark(low_water_);
+    Run(&tuple, walk);
+
+    EXPECT_FALSE(callbacks.empty());
+    EXPECT_TRUE(legacy_callbacks == callbacks);
+}
+
+// Compare the cost of the band based and the reference implementations.
+TEST_F(WaterMarkTest, DISABLED_Performance) {
+    SetUpWaterMarks();
+    std::vector<int> walk;
+    srand(1);
+    RandomWalk(12000, 10 * 1000 * 1000, &walk);
+
+    CallbackList legacy_callbacks;
+    callbacks_ = &legacy_callbacks;
+    LegacyWaterMarkTuple legacy(high_water_, low_water_);
+    uint64_t legacy_usecs = Run(&legacy, walk);
+
+    CallbackList callbacks;
+    callbacks_ = &callbacks;
+    WaterMarkTuple tuple;
+    tuple.SetHighWaterMark(high_water_);
+    tuple.SetLowWaterMark(low_water_);
+    uint64_t usecs = Run(&tuple, walk);
+
+    EXPECT_TRUE(legacy_callbacks == callbacks);
+    LOG(DEBUG, "WaterMarkTuple: " << walk.size() << " updates, "
+        << callbacks.size() << " callbacks, legacy " << legacy_usecs
+        << " usecs, band " << usecs << " usecs");
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -35,6 +35,16 @@ static inline uint64_t ClockMonotonicUsec() {
     return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
+// CPU time consumed by the calling thread
+static inline uint64_t ThreadCpuTimeUsec() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        assert(0);
+    }
+
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static inline boost::posix_time::ptime UTCUsecToPTime(uint64_t tusec) {
     typedef boost::posix_time::time_duration::sec_type sec_type;
     typedef boost::posix_time::time_duration::fractional_seconds_type frac_type;
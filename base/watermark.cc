@@ -4,20 +4,60 @@
 
 #include "watermark.h"
 
+#include <algorithm>
+#include <limits>
+
 WaterMarkTuple::WaterMarkTuple() :
-    last_count_(0) {
+    last_count_(0),
+    band_low_(0),
+    band_high_(std::numeric_limits<size_t>::max()) {
+}
+
+void WaterMarkTuple::UpdateBand() {
+    size_t low = 0;
+    size_t high = std::numeric_limits<size_t>::max();
+
+    // A high watermark is crossed when the count reaches the first one
+    // above last_count_. The next one down is the bound below which the
+    // first one above changes.
+    WaterMarkInfos::const_iterator it = high_water_.upper_bound(
+        WaterMarkInfo(last_count_, NULL));
+    if (it != high_water_.end()) {
+        high = it->count_ - 1;
+    }
+    if (it != high_water_.begin()) {
+        --it;
+        low = it->count_;
+    }
+
+    // A low watermark is crossed when the count drops to the first one
+    // below last_count_.
+    it = low_water_.lower_bound(WaterMarkInfo(last_count_, NULL));
+    if (it != low_water_.end()) {
+        high = std::min(high, it->count_);
+    }
+    if (it != low_water_.begin()) {
+        --it;
+        low = std::max(low, it->count_ + 1);
+    }
+
+    band_low_ = low;
+    band_high_ = high;
 }
 
 void WaterMarkTuple::SetHighWaterMark(const WaterMarkInfos &high_water) {
     high_water_ = high_water;
+    UpdateBand();
 }
 
 void WaterMarkTuple::SetHighWaterMark(const WaterMarkInfo& hwm_info) {
     high_water_.insert(hwm_info);
+    UpdateBand();
 }
 
 void WaterMarkTuple::ResetHighWaterMark() {
     high_water_.clear();
+    UpdateBand();
 }
 
 WaterMarkInfos WaterMarkTuple::GetHighWaterMark() const {
@@ -26,14 +66,17 @@ WaterMarkInfos WaterMarkTuple::GetHighWaterMark() const {
 
 void WaterMarkTuple::SetLowWaterMark(const WaterMarkInfos &low_water) {
     low_water_ = low_water;
+    UpdateBand();
 }
 
 void WaterMarkTuple::SetLowWaterMark(const WaterMarkInfo& lwm_info) {
     low_water_.insert(lwm_info);
+    UpdateBand();
 }
 
 void WaterMarkTuple::ResetLowWaterMark() {
     low_water_.clear();
+    UpdateBand();
 }
 
 WaterMarkInfos WaterMarkTuple::GetLowWaterMark() const {
@@ -52,7 +95,7 @@ bool WaterMarkTuple::AreWaterMarksSet() const {
     return high_water_.size() != 0 || low_water_.size() != 0;
 }
 
-void WaterMarkTuple::ProcessHighWaterMarks(size_t count) {
+void WaterMarkTuple::ProcessHighWaterMarksInternal(size_t count) {
     if (high_water_.size() != 0) {
         WaterMarkInfos::const_iterator ubound = high_water_.upper_bound(
             WaterMarkInfo(count, NULL));
@@ -69,9 +112,10 @@ void WaterMarkTuple::ProcessHighWaterMarks(size_t count) {
         }
     }
     last_count_ = count;
+    UpdateBand();
 }
 
-void WaterMarkTuple::ProcessLowWaterMarks(size_t count) {
+void WaterMarkTuple::ProcessLowWaterMarksInternal(size_t count) {
     if (low_water_.size() != 0) {
         WaterMarkInfos::const_iterator lbound = low_water_.lower_bound(
             WaterMarkInfo(count, NULL));
@@ -84,4 +128,5 @@ void WaterMarkTuple::ProcessLowWaterMarks(size_t count) {
         }
     }
     last_count_ = count;
+    UpdateBand();
 }
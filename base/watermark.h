@@ -53,13 +53,40 @@ public:
     WaterMarkInfos GetLowWaterMark() const;
     void ProcessWaterMarks(size_t in_count, size_t curr_count);
     bool AreWaterMarksSet() const;
-    void ProcessHighWaterMarks(size_t count);
-    void ProcessLowWaterMarks(size_t count);
+    void ProcessHighWaterMarks(size_t count) {
+        if (InBand(count))
+            last_count_ = count;
+        else
+            ProcessHighWaterMarksInternal(count);
+    }
+    void ProcessLowWaterMarks(size_t count) {
+        if (InBand(count))
+            last_count_ = count;
+        else
+            ProcessLowWaterMarksInternal(count);
+    }
 
 private:
+    void ProcessHighWaterMarksInternal(size_t count);
+    void ProcessLowWaterMarksInternal(size_t count);
+
+    // Recompute [band_low_, band_high_], the range of counts around
+    // last_count_ within which no high or low watermark can be crossed.
+    void UpdateBand();
+    bool InBand(size_t count) const {
+        return count >= band_low_ && count <= band_high_;
+    }
+
     WaterMarkInfos high_water_;
     WaterMarkInfos low_water_;
     size_t last_count_;
+    // Whether a watermark is crossed only depends on which band last_count_
+    // is in, hence the band is recomputed only when the count leaves it or
+    // the watermarks change, and the common case is a compare against the
+    // cached bounds. last_count_ is still recorded on every update so that
+    // the band is rebuilt around the current count.
+    size_t band_low_;
+    size_t band_high_;
 
     DISALLOW_COPY_AND_ASSIGN(WaterMarkTuple);
 };
@@ -15,7 +15,7 @@ using namespace std;
 using tbb::mutex;
 
 HttpClientSession::HttpClientSession(HttpClient *client, Socket *socket) 
-    : TcpSession(client, socket) , delete_called_(0) {
+    : TcpSession(client, socket) , connection_(NULL), delete_called_(0) {
         set_observer(boost::bind(&HttpClientSession::OnEvent, this, _1, _2));
 }
 
@@ -75,6 +75,7 @@ HttpConnection::HttpConnection(boost::asio::ip::tcp::endpoint ep,
     id_(id), cb_(NULL), offset_(0), curl_handle_(NULL),
     session_(NULL), client_(client), use_ssl_(false), client_cert_(""),
     client_cert_type_("PEM"), client_key_(""), ca_cert_(""), state_(STATUS) {
+    paused_ = false;
 }
 
 HttpConnection::HttpConnection(const std::string& host, int port,
@@ -83,10 +84,17 @@ HttpConnection::HttpConnection(const std::string& host, int port,
     id_(id), cb_(NULL), offset_(0), curl_handle_(NULL),
     session_(NULL), client_(client), use_ssl_(false), client_cert_(""),
     client_cert_type_("PEM"), client_key_(""), ca_cert_(""), state_(STATUS) {
+    paused_ = false;
 }
 
 HttpConnection::~HttpConnection() {
-    delete_session();
+    // The session remains owned by the client until libcurl closes the
+    // socket, which may be reused by another connection
+    if (session_) {
+        tbb::mutex::scoped_lock lock(session_->mutex());
+        session_->SetConnection(NULL);
+        session_ = NULL;
+    }
 }
 
 std::string HttpConnection::make_url(std::string &path) {
@@ -114,18 +122,6 @@ HttpClientSession *HttpConnection::CreateSession() {
     return session;
 }
 
-void HttpConnection::delete_session() {
-    HttpClientSession *session = session_;
-    if (session_) {
-        {
-            tbb::mutex::scoped_lock lock(session_->mutex());
-            session_->SetConnection(NULL);
-            session_ = NULL;
-        }
-        client_->DeleteSession(session);
-    }
-}
-
 void HttpConnection::set_session(HttpClientSession *session) {
     session_ = session;
     if (session && event_cb_ && !event_cb_.empty())
@@ -145,7 +141,8 @@ int HttpConnection::HttpGet(const std::string &path, bool header,
 
     client()->ProcessEvent(boost::bind(&HttpConnection::HttpProcessInternal,
                            this, body, path, bool2bf(header, short_timeout,
-                               reuse), hdr_options, cb, HTTP_GET));
+                               reuse), hdr_options, cb, HTTP_GET,
+                           DataCb()));
     return 0;
 }
 
@@ -155,7 +152,8 @@ int HttpConnection::HttpHead(const std::string &path, bool header, bool short_ti
     const std::string body;
     client()->ProcessEvent(boost::bind(&HttpConnection::HttpProcessInternal,
                            this, body, path, bool2bf(header, short_timeout,
-                               reuse), hdr_options, cb, HTTP_HEAD));
+                               reuse), hdr_options, cb, HTTP_HEAD,
+                           DataCb()));
     return 0;
 }
 
@@ -173,7 +171,8 @@ int HttpConnection::HttpPut(const std::string &put_string,
     client()->ProcessEvent(boost::bind(&HttpConnection::HttpProcessInternal,
                                        this, put_string, path,
                                        bool2bf(header, short_timeout, reuse),
-                                       hdr_options, cb, HTTP_PUT));
+                                       hdr_options, cb, HTTP_PUT,
+                                       DataCb()));
     return 0;
 }
 
@@ -189,7 +188,8 @@ int HttpConnection::HttpPost(const std::string &post_string,
                              std::vector<std::string> &hdr_options, HttpCb cb) {
     client()->ProcessEvent(boost::bind(&HttpConnection::HttpProcessInternal,
                            this, post_string, path, bool2bf(header,
-                           short_timeout, reuse), hdr_options, cb, HTTP_POST));
+                           short_timeout, reuse), hdr_options, cb, HTTP_POST,
+                           DataCb()));
     return 0;
 }
 
@@ -204,47 +204,82 @@ int HttpConnection::HttpDelete(const std::string &path, bool header, bool short_
     const std::string body;
     client()->ProcessEvent(boost::bind(&HttpConnection::HttpProcessInternal,
                            this, body, path, bool2bf(header, short_timeout,
-                               reuse), hdr_options, cb, HTTP_DELETE));
+                               reuse), hdr_options, cb, HTTP_DELETE,
+                           DataCb()));
     return 0;
 }
 
+int HttpConnection::HttpGetStream(const std::string &path, bool reuse,
+                                  std::vector<std::string> &hdr_options,
+                                  DataCb data_cb, HttpCb cb) {
+    const std::string body;
+    client()->ProcessEvent(boost::bind(&HttpConnection::HttpProcessInternal,
+                           this, body, path, bool2bf(false, false, reuse),
+                           hdr_options, cb, HTTP_GET, data_cb));
+    return 0;
+}
+
+void HttpConnection::Resume() {
+    client()->ProcessEvent(boost::bind(&HttpConnection::ResumeInternal,
+                                       this));
+}
+
+void HttpConnection::ResumeInternal() {
+    if (paused_ && curl_handle_) {
+        paused_ = false;
+        resume_conn(curl_handle_);
+    }
+}
+
 void HttpConnection::ClearCallback() {
    cb_ = NULL; 
+   data_cb_ = NULL;
 }
 
-void HttpConnection::HttpProcessInternal(const std::string body,
+void HttpConnection::RequestComplete() {
+    if (!complete_cb_.empty()) {
+        complete_cb_(this);
+    }
+}
+
+bool HttpConnection::HttpProcessInternal(const std::string body,
                                          std::string path,
                                          unsigned short hdr_shortTimeout_reuse,
                                          std::vector<std::string> hdr_options,
-                                         HttpCb cb, http_method method) {
+                                         HttpCb cb, http_method method,
+                                         DataCb data_cb) {
     bool short_timeout, reuse;
     bf2bool(hdr_shortTimeout_reuse, sent_hdr_, short_timeout, reuse);
     state_ = STATUS;
     status_ = 0;
     version_.clear();
     reason_.clear();
+    headers_.clear();
+    offset_ = 0;
     if (client()->AddConnection(this) == false) {
         // connection already exists
         if (!reuse)
-            return;
+            return false;
     }
 
     struct _GlobalInfo *gi = client()->GlobalInfo();
-    struct _ConnInfo *curl_handle = new_conn(this, gi, sent_hdr_, short_timeout,
-                                             reuse);
-    if (!curl_handle) {
-        LOG(DEBUG, "Http : unable to create new connection");
-        return;
-    }
-
     if (curl_handle_) {
-        // delete existing curl_handle
-        del_curl_handle(curl_handle_, gi);
+        // reuse the curl handle of the previous request
+        reset_conn(curl_handle_, gi, sent_hdr_, short_timeout, reuse);
+    } else {
+        struct _ConnInfo *curl_handle = new_conn(this, gi, sent_hdr_,
+                                                 short_timeout, reuse);
+        if (!curl_handle) {
+            LOG(DEBUG, "Http : unable to create new connection");
+            return false;
+        }
+        curl_handle->connection = this;
+        set_curl_handle(curl_handle);
     }
-    curl_handle->connection = this;
-    set_curl_handle(curl_handle);
 
     cb_ = cb;
+    data_cb_ = data_cb;
+    paused_ = false;
 
     std::string url = make_url(path);
     set_url(curl_handle_, url.c_str());
@@ -261,6 +296,9 @@ void HttpConnection::HttpProcessInternal(const std::string body,
     if (use_ssl_) {
         set_ssl_options(curl_handle_, client_cert_.c_str(),
             client_cert_type_.c_str(), client_key_.c_str(), ca_cert_.c_str());
+        if (reuse) {
+            set_multiplex_options(curl_handle_);
+        }
     }
 
     // Add header options to the get request
@@ -301,10 +339,20 @@ void HttpConnection::HttpProcessInternal(const std::string body,
         default:
             assert(0);
     }
+    return true;
 }
 
 void HttpConnection::AssignData(const char *ptr, size_t size) {
 
+    // streaming mode, pass the data received without a copy
+    if (data_cb_ != NULL) {
+        if (!data_cb_(ptr, size) && curl_handle_) {
+            paused_ = true;
+            pause_conn(curl_handle_);
+        }
+        return;
+    }
+
     buf_.assign(ptr, size);
 
     // callback to client
@@ -370,11 +418,137 @@ size_t HttpConnection::GetOffset() {
     return offset_;
 }
 
+HttpConnectionPool::HttpConnectionPool(HttpClient *client,
+                                       const std::string &host, int port,
+                                       size_t size)
+    : client_(client), host_(host), port_(port), size_(size),
+      use_ssl_(false), client_cert_type_("PEM") {
+}
+
+// The connections are deleted with the other connections of the client.
+HttpConnectionPool::~HttpConnectionPool() {
+}
+
+void HttpConnectionPool::set_ssl_options(const std::string &client_cert,
+                                         const std::string &client_cert_type,
+                                         const std::string &client_key,
+                                         const std::string &ca_cert) {
+    use_ssl_ = true;
+    client_cert_ = client_cert;
+    client_cert_type_ = client_cert_type;
+    client_key_ = client_key;
+    ca_cert_ = ca_cert;
+}
+
+int HttpConnectionPool::HttpGet(const std::string &path,
+                                const std::vector<std::string> &hdr_options,
+                                HttpCb cb) {
+    return Enqueue(HTTP_GET, std::string(), path, hdr_options, cb);
+}
+
+int HttpConnectionPool::HttpPost(const std::string &post_string,
+                                 const std::string &path,
+                                 const std::vector<std::string> &hdr_options,
+                                 HttpCb cb) {
+    return Enqueue(HTTP_POST, post_string, path, hdr_options, cb);
+}
+
+int HttpConnectionPool::HttpPut(const std::string &put_string,
+                                const std::string &path,
+                                const std::vector<std::string> &hdr_options,
+                                HttpCb cb) {
+    return Enqueue(HTTP_PUT, put_string, path, hdr_options, cb);
+}
+
+int HttpConnectionPool::HttpDelete(const std::string &path,
+                                   const std::vector<std::string> &hdr_options,
+                                   HttpCb cb) {
+    return Enqueue(HTTP_DELETE, std::string(), path, hdr_options, cb);
+}
+
+int HttpConnectionPool::Enqueue(http_method method, const std::string &body,
+                                const std::string &path,
+                                const std::vector<std::string> &hdr_options,
+                                HttpCb cb) {
+    client_->ProcessEvent(boost::bind(&HttpConnectionPool::EnqueueInternal,
+                          this, Request(method, body, path, hdr_options, cb)));
+    return 0;
+}
+
+void HttpConnectionPool::EnqueueInternal(Request request) {
+    pending_.push_back(request);
+    Dispatch();
+}
+
+HttpConnection *HttpConnectionPool::AllocConnection() {
+    if (!idle_.empty()) {
+        HttpConnection *connection = idle_.back();
+        idle_.pop_back();
+        return connection;
+    }
+    if (connections_.size() >= size_) {
+        return NULL;
+    }
+    HttpConnection *connection = client_->CreateConnection(host_, port_);
+    if (use_ssl_) {
+        connection->set_use_ssl(true);
+        connection->set_client_cert(client_cert_);
+        connection->set_client_cert_type(client_cert_type_);
+        connection->set_client_key(client_key_);
+        connection->set_ca_cert(ca_cert_);
+    }
+    connection->RegisterCompleteCb(
+        boost::bind(&HttpConnectionPool::RequestComplete, this, _1));
+    connections_.push_back(connection);
+    return connection;
+}
+
+void HttpConnectionPool::Dispatch() {
+    while (!pending_.empty()) {
+        HttpConnection *connection = AllocConnection();
+        if (!connection) {
+            return;
+        }
+        Request &request = pending_.front();
+        bool started = connection->HttpProcessInternal(request.body,
+            request.path, connection->bool2bf(false, false, true),
+            request.hdr_options,
+            boost::bind(&HttpConnectionPool::ResponseCb, this, connection,
+                        request.cb, _1, _2),
+            request.method, HttpConnection::DataCb());
+        if (!started) {
+            // The connection stays usable for the next requests, fail this
+            // one as it will not complete
+            idle_.push_back(connection);
+            std::string empty_str;
+            boost::system::error_code error(CURLE_FAILED_INIT,
+                                            curl_error_category);
+            request.cb(connection, empty_str, error);
+        }
+        pending_.pop_front();
+    }
+}
+
+void HttpConnectionPool::ResponseCb(HttpConnection *connection, HttpCb cb,
+                                    std::string &str,
+                                    boost::system::error_code &ec) {
+    cb(connection, str, ec);
+}
+
+void HttpConnectionPool::RequestComplete(HttpConnection *connection) {
+    idle_.push_back(connection);
+    // Start the next request once libcurl is done with the completed one
+    if (!pending_.empty()) {
+        client_->ProcessEvent(boost::bind(&HttpConnectionPool::Dispatch,
+                                          this));
+    }
+}
+
 HttpClient::HttpClient(EventManager *evm, std::string task_name) :
   TcpServer(evm),
   curl_timer_(TimerManager::CreateTimer(*evm->io_service(), task_name,
               TaskScheduler::GetInstance()->GetTaskId(task_name), 0)),
-  id_(0), work_queue_(TaskScheduler::GetInstance()->GetTaskId(task_name), 0,
+  id_(0), pool_size_(kDefaultPoolSize), work_queue_(TaskScheduler::GetInstance()->GetTaskId(task_name), 0,
               boost::bind(&HttpClient::DequeueEvent, this, _1)) {
     gi_ = (struct _GlobalInfo *)malloc(sizeof(struct _GlobalInfo));
     memset(gi_, 0, sizeof(struct _GlobalInfo));
@@ -388,7 +562,12 @@ void HttpClient::ShutdownInternal() {
         RemoveConnectionInternal(iter->second);
     }
 
+    // Closes the sockets cached by libcurl
     curl_multi_cleanup(gi_->multi);
+    {
+        tbb::mutex::scoped_lock lock(pool_mutex_);
+        pool_map_.clear();
+    }
     TimerManager::DeleteTimer(curl_timer_);
     SessionShutdown();
 
@@ -448,7 +627,50 @@ TcpSession *HttpClient::CreateSession() {
     }
 
     err = session->SetSocketOptions();
-    return session;
+    HttpClientSession *client_session =
+        static_cast<HttpClientSession *>(session);
+    socket_sessions_[socket->native_handle()] = client_session;
+    return client_session;
+}
+
+HttpClientSession *HttpClient::SocketSession(int fd) {
+    SocketSessionMap::iterator it = socket_sessions_.find(fd);
+    if (it == socket_sessions_.end()) {
+        return NULL;
+    }
+    return it->second;
+}
+
+void HttpClient::CloseSocketSession(int fd) {
+    SocketSessionMap::iterator it = socket_sessions_.find(fd);
+    if (it == socket_sessions_.end()) {
+        return;
+    }
+    HttpClientSession *session = it->second;
+    socket_sessions_.erase(it);
+    {
+        tbb::mutex::scoped_lock lock(session->mutex());
+        HttpConnection *connection = session->Connection();
+        if (connection && connection->session() == session) {
+            connection->set_session(NULL);
+        }
+        session->SetConnection(NULL);
+    }
+    DeleteSession(session);
+}
+
+HttpConnectionPool *HttpClient::ConnectionPool(const std::string &host,
+                                               int port) {
+    tbb::mutex::scoped_lock lock(pool_mutex_);
+    PoolKey key = std::make_pair(host, port);
+    HttpConnectionPoolMap::iterator it = pool_map_.find(key);
+    if (it != pool_map_.end()) {
+        return it->second;
+    }
+    HttpConnectionPool *pool =
+        new HttpConnectionPool(this, host, port, pool_size_);
+    pool_map_.insert(key, pool);
+    return pool;
 }
 
 HttpConnection *HttpClient::CreateConnection(boost::asio::ip::tcp::endpoint ep) {
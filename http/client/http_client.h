@@ -9,8 +9,12 @@
 #include <boost/function.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/system/error_code.hpp>
+#include <deque>
+#include <map>
 #include <string>
+#include <vector>
 #include <curl/curl.h>
+#include <tbb/atomic.h>
 #include "base/queue_task.h"
 #include "base/timer.h"
 #include "io/tcp_server.h"
@@ -21,6 +25,7 @@ class LifetimeActor;
 class LifetimeManager;
 class HttpClient;
 class HttpConnection;
+class HttpConnectionPool;
 struct _ConnInfo;
 struct _GlobalInfo;
 
@@ -68,6 +73,11 @@ public:
     int Initialize();
 
     typedef boost::function<void(std::string &, boost::system::error_code &)> HttpCb;
+    typedef boost::function<void(HttpConnection *)> CompleteCb;
+    // Called with each piece of the response body as it is received, the
+    // data is only valid during the call. Returns false if the consumer is
+    // busy, which pauses the transfer until Resume is called.
+    typedef boost::function<bool(const char *, size_t)> DataCb;
 
     int HttpPut(const std::string &put_string, const std::string &path, HttpCb);
     int HttpPut(const std::string &put_string, const std::string &path,
@@ -83,6 +93,15 @@ public:
                 bool reuse, std::vector<std::string> &hdr_options, HttpCb cb);
     int HttpHead(const std::string &path, bool header, bool short_timeout,
                 bool reuse, std::vector<std::string> &hdr_options, HttpCb cb);
+    // Streams the response body to data_cb rather than to cb, which is
+    // only called with the end of the response. The body is not buffered,
+    // and the transfer is paused while the consumer is busy, which makes the
+    // server wait.
+    int HttpGetStream(const std::string &path, bool reuse,
+                      std::vector<std::string> &hdr_options, DataCb data_cb,
+                      HttpCb cb);
+    void Resume();
+    bool paused() const { return paused_; }
     int HttpDelete(const std::string &path, HttpCb);
     int HttpDelete(const std::string &path, bool header, bool short_timeout,
                    bool reuse, std::vector<std::string> &hdr_options,
@@ -104,14 +123,20 @@ public:
     const std::string &GetData();
     void set_curl_handle(struct _ConnInfo *handle) { curl_handle_ = handle; }
     HttpClientSession *CreateSession();
+    // Session of the last socket opened for the connection. The session is
+    // owned by the client until libcurl closes the socket.
     void set_session(HttpClientSession *session);
-    void delete_session();
     void AssignData(const char *ptr, size_t size);
     void AssignHeader(const char *ptr, size_t size);
     void UpdateOffset(size_t bytes);
     size_t GetOffset();
     HttpCb HttpClientCb() { return cb_; }
     void RegisterEventCb(HttpClientSession::SessionEventCb cb) { event_cb_ = cb; }
+    // Called once the callback of a request has been invoked with the end
+    // of the response, after which the connection can be used for the next
+    // request.
+    void RegisterCompleteCb(CompleteCb cb) { complete_cb_ = cb; }
+    void RequestComplete();
     void set_use_ssl(bool ssl_flag) { use_ssl_ = ssl_flag; }
     bool use_ssl() { return use_ssl_; }
     void set_client_cert(const std::string &client_cert) {
@@ -128,6 +153,8 @@ public:
     }
 
 private:
+    friend class HttpConnectionPool;
+
     std::string make_url(std::string &path);
 
     unsigned short bool2bf(bool header, bool short_timeout, bool reuse) {
@@ -140,17 +167,22 @@ private:
         short_timeout = (bf & 2u) != 0;
         reuse = (bf & 1u) != 0;
     }
-    void HttpProcessInternal(const std::string body, std::string path,
+    // Returns false if the request could not be started, in which case the
+    // callbacks are not invoked.
+    bool HttpProcessInternal(const std::string body, std::string path,
                              //bool header, bool short_timeout, bool reuse,
                              unsigned short header_shortTimeout_reuse,
                              std::vector<std::string> hdr_options,
-                             HttpCb cb, http_method m);
+                             HttpCb cb, http_method m, DataCb data_cb);
+    void ResumeInternal();
 
     // key = endpoint_ + id_
     const std::string host_;
     boost::asio::ip::tcp::endpoint endpoint_;
     size_t id_;
     HttpCb cb_;
+    DataCb data_cb_;
+    tbb::atomic<bool> paused_;
     size_t offset_;
     std::string buf_;
     struct _ConnInfo *curl_handle_;
@@ -159,6 +191,7 @@ private:
     HttpClient *client_;
     mutable tbb::mutex mutex_;
     HttpClientSession::SessionEventCb event_cb_;
+    CompleteCb complete_cb_;
     int status_;
     std::string version_;
     std::string reason_;
@@ -177,10 +210,105 @@ private:
     DISALLOW_COPY_AND_ASSIGN(HttpConnection);
 };
 
+//
+// Connections to an endpoint shared by the requests to that endpoint.
+//
+// Up to size requests are in progress at a time, each on a connection of the
+// pool, the others wait for a connection to complete its request. The
+// connections keep their curl handle from one request to the next, and
+// libcurl keeps the TCP connections open in its connection cache. Requests
+// are pipelined or multiplexed over a shared TCP connection when libcurl and
+// the server support it.
+//
+// The pool is owned by the client, and its connections must not be removed
+// by the caller.
+//
+class HttpConnectionPool {
+public:
+    // Called with the response data as it is received, then with an empty
+    // string once the response is complete or has failed. The connection
+    // gives the status and headers of the response, and is only valid during
+    // the call.
+    typedef boost::function<void(HttpConnection *, std::string &,
+                                 boost::system::error_code &)> HttpCb;
+
+    HttpConnectionPool(HttpClient *client, const std::string &host, int port,
+                       size_t size);
+    ~HttpConnectionPool();
+
+    int HttpGet(const std::string &path,
+                const std::vector<std::string> &hdr_options, HttpCb cb);
+    int HttpPost(const std::string &post_string, const std::string &path,
+                 const std::vector<std::string> &hdr_options, HttpCb cb);
+    int HttpPut(const std::string &put_string, const std::string &path,
+                const std::vector<std::string> &hdr_options, HttpCb cb);
+    int HttpDelete(const std::string &path,
+                   const std::vector<std::string> &hdr_options, HttpCb cb);
+
+    // SSL options of the connections, set before the first request.
+    void set_ssl_options(const std::string &client_cert,
+                         const std::string &client_cert_type,
+                         const std::string &client_key,
+                         const std::string &ca_cert);
+
+    const std::string &host() const { return host_; }
+    int port() const { return port_; }
+    size_t size() const { return size_; }
+    void set_size(size_t size) { size_ = size; }
+    // Connections created so far, and the ones with a request in progress.
+    size_t connection_count() const { return connections_.size(); }
+    size_t active_count() const { return connections_.size() - idle_.size(); }
+    size_t pending_count() const { return pending_.size(); }
+
+private:
+    struct Request {
+        Request(http_method method, const std::string &body,
+                const std::string &path,
+                const std::vector<std::string> &hdr_options, HttpCb cb)
+            : method(method), body(body), path(path),
+              hdr_options(hdr_options), cb(cb) {
+        }
+        http_method method;
+        std::string body;
+        std::string path;
+        std::vector<std::string> hdr_options;
+        HttpCb cb;
+    };
+
+    int Enqueue(http_method method, const std::string &body,
+                const std::string &path,
+                const std::vector<std::string> &hdr_options, HttpCb cb);
+    void EnqueueInternal(Request request);
+    void Dispatch();
+    HttpConnection *AllocConnection();
+    void ResponseCb(HttpConnection *connection, HttpCb cb, std::string &str,
+                    boost::system::error_code &ec);
+    void RequestComplete(HttpConnection *connection);
+
+    HttpClient *client_;
+    std::string host_;
+    int port_;
+    size_t size_;
+    bool use_ssl_;
+    std::string client_cert_;
+    std::string client_cert_type_;
+    std::string client_key_;
+    std::string ca_cert_;
+
+    // Accessed in the client task. The connections are owned by the client.
+    std::vector<HttpConnection *> connections_;
+    std::vector<HttpConnection *> idle_;
+    std::deque<Request> pending_;
+
+    DISALLOW_COPY_AND_ASSIGN(HttpConnectionPool);
+};
+
 // Http Client class
 class HttpClient : public TcpServer {
 public:
     static const uint32_t kDefaultTimeout = 1;  // one millisec
+    // Requests in progress at a time to an endpoint of a connection pool.
+    static const size_t kDefaultPoolSize = 8;
 
     explicit HttpClient(EventManager *evm, std::string task_name=std::string(
                 "http client"));
@@ -197,6 +325,17 @@ public:
     bool AddConnection(HttpConnection *);
     void RemoveConnection(HttpConnection *);
 
+    // Connection pool of the endpoint, created with pool_size connections
+    // on first use.
+    HttpConnectionPool *ConnectionPool(const std::string &host, int port);
+    size_t pool_size() const { return pool_size_; }
+    void set_pool_size(size_t pool_size) { pool_size_ = pool_size; }
+
+    // Session of a socket opened by libcurl, which may be used by the
+    // transfers of any connection to the same endpoint.
+    HttpClientSession *SocketSession(int fd);
+    void CloseSocketSession(int fd);
+
 
     void ProcessEvent(EnqueuedCb cb);
     struct _GlobalInfo *GlobalInfo() { return gi_; }
@@ -219,12 +358,20 @@ private:
     typedef boost::asio::ip::tcp::endpoint endpoint;
     typedef std::pair<endpoint, size_t> Key;
     typedef boost::ptr_map<Key, HttpConnection> HttpConnectionMap;
+    typedef std::pair<std::string, int> PoolKey;
+    typedef boost::ptr_map<PoolKey, HttpConnectionPool> HttpConnectionPoolMap;
+    typedef std::map<int, HttpClientSession *> SocketSessionMap;
 
     bool TimerCb();
     struct _GlobalInfo *gi_;
     Timer *curl_timer_;
     HttpConnectionMap map_;
     size_t id_;
+    tbb::mutex pool_mutex_;
+    HttpConnectionPoolMap pool_map_;
+    size_t pool_size_;
+    // Accessed in the client task, from the callbacks of libcurl.
+    SocketSessionMap socket_sessions_;
 
     WorkQueue<EnqueuedCb> work_queue_;
 
@@ -93,10 +93,16 @@ static void check_multi_info(GlobalInfo *g)
       curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_URL, &eff_url);
 
       if (conn) {
+        HttpConnection *connection = conn->connection;
         boost::system::error_code error(res, curl_error_category);
         std::string empty_str("");
-        if (conn->connection->HttpClientCb() != NULL)
-            conn->connection->HttpClientCb()(empty_str, error);
+        if (connection->HttpClientCb() != NULL)
+            connection->HttpClientCb()(empty_str, error);
+
+        // Detach the handle so that libcurl caches its TCP connection for
+        // the next transfer to the endpoint and the handle can be reused
+        curl_multi_remove_handle(g->multi, easy);
+        connection->RequestComplete();
       }
     }
   }
@@ -131,12 +137,11 @@ static void event_cb(GlobalInfo *g, TcpSessionPtr session, int action,
 {
   tbb::mutex::scoped_lock lock(session->mutex());
 
-  // Ignore if the connection is already deleted.
-  if (!session->Connection()) return;
+  // Ignore if libcurl already closed the socket.
+  if (session->IsClosed()) return;
 
-  HttpClient *client = session->Connection()->client();
-  client->ProcessEvent(boost::bind(&event_cb_impl, g, session, action, error, 
-                                   bytes_transferred));
+  g->client->ProcessEvent(boost::bind(&event_cb_impl, g, session, action,
+                                      error, bytes_transferred));
 }
 
 /* Called by asio when our timeout expires */
@@ -166,12 +171,14 @@ static void remsock(SockInfo *sock_info, GlobalInfo *g)
 
 static bool setsock(SockInfo *sock_info, curl_socket_t s, CURL*e, int act, GlobalInfo *g)
 {
-  if (!sock_info || !sock_info->conn_info || !sock_info->conn_info->connection)
+  if (!sock_info)
   {
     return false;
   }
 
-  HttpClientSession *session = sock_info->conn_info->connection->session();
+  // The socket may have been opened for the transfer of another connection
+  // and then reused from the connection cache of libcurl.
+  HttpClientSession *session = g->client->SocketSession(s);
   if (!session || session->IsClosed())
        return false;
 
@@ -324,11 +331,28 @@ static curl_socket_t open_socket(void *data,
 /* CURLOPT_CLOSESOCKETFUNCTION */
 static int close_socket(void *clientp, curl_socket_t item)
 {
-  HttpConnection *conn = static_cast<HttpConnection *>(clientp);
-  conn->delete_session();
+  // The connection that opened the socket may be gone when libcurl closes
+  // a cached socket.
+  GlobalInfo *g = static_cast<GlobalInfo *>(clientp);
+  g->client->CloseSocketSession(item);
   return 0;
 }
 
+/* Session of the socket used by the transfer of the easy handle */
+static HttpClientSession *active_session(ConnInfo *conn, GlobalInfo *g)
+{
+#if LIBCURL_VERSION_NUM >= 0x072d00
+  curl_socket_t sockfd = CURL_SOCKET_BAD;
+  curl_easy_getinfo(conn->easy, CURLINFO_ACTIVESOCKET, &sockfd);
+#else
+  long sockfd = -1;
+  curl_easy_getinfo(conn->easy, CURLINFO_LASTSOCKET, &sockfd);
+#endif
+  if (sockfd == -1)
+    return NULL;
+  return g->client->SocketSession(sockfd);
+}
+
 static int send_perform(ConnInfo *conn, GlobalInfo *g) {
     // add the handle
     CURLMcode m_rc = curl_multi_add_handle(g->multi, conn->easy);
@@ -340,9 +364,10 @@ static int send_perform(ConnInfo *conn, GlobalInfo *g) {
     CURLMcode rc = curl_multi_perform(g->multi, &counter);
     if (rc == CURLM_OK && counter <= 0) {
         // send done; invoke callback to indicate this
-        if (conn->connection && conn->connection->session()) {
+        HttpClientSession *session = active_session(conn, g);
+        if (session) {
             const boost::system::error_code ec;
-            event_cb(g, TcpSessionPtr(conn->connection->session()), 0, ec, 0);
+            event_cb(g, TcpSessionPtr(session), 0, ec, 0);
         }
     } else {
         // start timer and check for send completion on timeout
@@ -358,6 +383,7 @@ void del_conn(HttpConnection *connection, GlobalInfo *g) {
         tbb::mutex::scoped_lock lock(connection->session()->mutex());
         connection->session()->SetConnection(NULL);
     }
+    connection->set_session(NULL);
 
     struct _ConnInfo *curl_handle = connection->curl_handle();
     if (curl_handle) {
@@ -378,21 +404,10 @@ void del_curl_handle(ConnInfo *curl_handle, GlobalInfo *g) {
     }   
 }
 
-/* Create a new easy handle, and add it to the global curl_multi */
-ConnInfo *new_conn(HttpConnection *connection, GlobalInfo *g,
-                   bool header, bool short_timeout, bool reuse)
+/* Set the options of a new or reset easy handle */
+static void set_conn_options(ConnInfo *conn, HttpConnection *connection,
+                             GlobalInfo *g, bool short_timeout, bool reuse)
 {
-  ConnInfo *conn = (ConnInfo *)calloc(1, sizeof(ConnInfo));
-  memset(conn, 0, sizeof(ConnInfo));
-  conn->error[CURL_ERROR_SIZE]='\0';
-
-  conn->easy = curl_easy_init();
-
-  if ( !conn->easy ) {
-    free(conn);
-    return NULL;
-  }
-  conn->global = g;
   curl_easy_setopt(conn->easy, CURLOPT_FOLLOWLOCATION, 1L);
   curl_easy_setopt(conn->easy, CURLOPT_WRITEFUNCTION, write_cb);
   curl_easy_setopt(conn->easy, CURLOPT_WRITEDATA, connection);
@@ -415,7 +430,8 @@ ConnInfo *new_conn(HttpConnection *connection, GlobalInfo *g,
       curl_easy_setopt(conn->easy, CURLOPT_LOW_SPEED_TIME, 30L);
       curl_easy_setopt(conn->easy, CURLOPT_LOW_SPEED_LIMIT, 10L);
   }
-  curl_easy_setopt(conn->easy, CURLOPT_FORBID_REUSE, 1L);
+  /* keep the TCP connection in the cache of the multi handle if reused */
+  curl_easy_setopt(conn->easy, CURLOPT_FORBID_REUSE, reuse ? 0L : 1L);
 
   /* call this function to get a socket */
   curl_easy_setopt(conn->easy, CURLOPT_OPENSOCKETFUNCTION, open_socket);
@@ -423,11 +439,48 @@ ConnInfo *new_conn(HttpConnection *connection, GlobalInfo *g,
 
   /* call this function to close a socket */
   curl_easy_setopt(conn->easy, CURLOPT_CLOSESOCKETFUNCTION, close_socket);
-  curl_easy_setopt(conn->easy, CURLOPT_CLOSESOCKETDATA, connection);
+  curl_easy_setopt(conn->easy, CURLOPT_CLOSESOCKETDATA, g);
+}
+
+/* Create a new easy handle, and add it to the global curl_multi */
+ConnInfo *new_conn(HttpConnection *connection, GlobalInfo *g,
+                   bool header, bool short_timeout, bool reuse)
+{
+  ConnInfo *conn = (ConnInfo *)calloc(1, sizeof(ConnInfo));
+  memset(conn, 0, sizeof(ConnInfo));
+  conn->error[CURL_ERROR_SIZE]='\0';
+
+  conn->easy = curl_easy_init();
+
+  if ( !conn->easy ) {
+    free(conn);
+    return NULL;
+  }
+  conn->global = g;
+  set_conn_options(conn, connection, g, short_timeout, reuse);
 
   return conn;
 }
 
+/* Prepare the easy handle of a completed transfer for the next request */
+void reset_conn(ConnInfo *conn, GlobalInfo *g,
+                bool header, bool short_timeout, bool reuse)
+{
+  curl_multi_remove_handle(g->multi, conn->easy);
+  curl_slist_free_all(conn->headers);
+  conn->headers = NULL;
+  free(conn->post);
+  conn->post = NULL;
+  conn->post_len = 0;
+  free(conn->url);
+  conn->url = NULL;
+  conn->error[0] = '\0';
+
+  /* the handle keeps its DNS, TLS session and connection caches */
+  curl_easy_reset(conn->easy);
+  set_conn_options(conn, conn->connection, g, short_timeout, reuse);
+}
+
 void set_url(ConnInfo *conn, const char *url) {
   conn->url = strdup(url);
   curl_easy_setopt(conn->easy, CURLOPT_URL, conn->url);
@@ -468,6 +521,28 @@ void set_put_string(ConnInfo *conn, const char *put, uint32_t len) {
     curl_easy_setopt(conn->easy, CURLOPT_UPLOAD, 1);
     curl_easy_setopt(conn->easy, CURLOPT_PUT, 1);
     curl_easy_setopt(conn->easy, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)len);
+    /* send the length of the body rather than a chunked body */
+    curl_easy_setopt(conn->easy, CURLOPT_INFILESIZE_LARGE, (curl_off_t)len);
+}
+
+void set_multiplex_options(ConnInfo *conn) {
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    /* HTTP/2 over TLS if the server supports it */
+    curl_easy_setopt(conn->easy, CURLOPT_HTTP_VERSION,
+                     (long)CURL_HTTP_VERSION_2TLS);
+    /* wait for a connection to multiplex on rather than opening a new one */
+    curl_easy_setopt(conn->easy, CURLOPT_PIPEWAIT, 1L);
+#endif
+}
+
+/* Stop receiving, from the write callback or once it returned */
+int pause_conn(ConnInfo *conn) {
+    return (int)curl_easy_pause(conn->easy, CURLPAUSE_RECV);
+}
+
+/* Deliver the data kept while paused and receive the rest */
+int resume_conn(ConnInfo *conn) {
+    return (int)curl_easy_pause(conn->easy, CURLPAUSE_CONT);
 }
 
 int http_get(ConnInfo *conn, GlobalInfo *g) {
@@ -508,5 +583,15 @@ int curl_init(HttpClient *client)
   curl_multi_setopt(g->multi, CURLMOPT_TIMERFUNCTION, multi_timer_cb);
   curl_multi_setopt(g->multi, CURLMOPT_TIMERDATA, client);
 
+  /* send the requests of the connection pools to an endpoint on a shared
+   * connection: HTTP/1.1 pipelining, dropped by libcurl 7.62, or HTTP/2
+   * multiplexing */
+#if LIBCURL_VERSION_NUM < 0x073e00 && defined(CURLPIPE_HTTP1)
+  curl_multi_setopt(g->multi, CURLMOPT_PIPELINING,
+                    CURLPIPE_HTTP1 | CURLPIPE_MULTIPLEX);
+#elif defined(CURLPIPE_MULTIPLEX)
+  curl_multi_setopt(g->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
   return 0;
 }
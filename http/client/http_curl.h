@@ -60,14 +60,19 @@ void set_url(ConnInfo *conn, const char *url);
 int curl_init(HttpClient *);
 ConnInfo *new_conn(HttpConnection *connection, GlobalInfo *g,
                    bool header, bool short_timeout, bool reuse);
+void reset_conn(ConnInfo *conn, GlobalInfo *g,
+                bool header, bool short_timeout, bool reuse);
 void del_conn(HttpConnection *connection, GlobalInfo *g);
 void del_curl_handle(ConnInfo *curl_handle, GlobalInfo *g);
 void set_header_options(ConnInfo *conn, const char *options);
 void set_ssl_options(ConnInfo *conn, const char *client_cert,
                      const char *client_cert_type, const char *client_key,
                      const char *ca_cert);
+void set_multiplex_options(ConnInfo *conn);
 void set_post_string(ConnInfo *conn, const char *post, uint32_t len);
 void set_put_string(ConnInfo *conn, const char *put, uint32_t len);
+int pause_conn(ConnInfo *conn);
+int resume_conn(ConnInfo *conn);
 int http_head(ConnInfo *conn, GlobalInfo *g); 
 int http_put(ConnInfo *conn, GlobalInfo *g);
 int http_post(ConnInfo *conn, GlobalInfo *g);
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "http/client/http_client.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "http/client/vncapi.h"
+#include "http/http_request.h"
+#include "http/http_server.h"
+#include "http/http_session.h"
+#include "io/event_manager.h"
+#include "io/test/event_manager_test.h"
+#include "testing/gunit.h"
+
+using boost::asio::ip::tcp;
+using std::ostringstream;
+using std::set;
+using std::string;
+using std::vector;
+
+// Responses of the stand-in server are fast enough for requests to complete
+// within a minute in the benchmark.
+#define TASK_UTIL_EXPECT_EQ_LONG(expected, actual) \
+    TASK_UTIL_WAIT_EQ(expected, actual, 1000, 60000, "")
+
+class HttpClientTest : public ::testing::Test {
+protected:
+    HttpClientTest() : client_(NULL), server_(NULL), port_(0) {
+    }
+
+    virtual void SetUp() {
+        evm_.reset(new EventManager());
+        thread_.reset(new ServerThread(evm_.get()));
+        server_ = new HttpServer(evm_.get());
+        server_->RegisterHandler(HTTP_WILDCARD_ENTRY,
+            boost::bind(&HttpClientTest::HandleRequest, this, _1, _2));
+        ASSERT_TRUE(server_->Initialize(0));
+        port_ = server_->GetPort();
+        client_ = new HttpClient(evm_.get(), "http client test");
+        client_->Init();
+        thread_->Start();
+        task_util::WaitForIdle();
+        completed_ = 0;
+        succeeded_ = 0;
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        client_->Shutdown();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(client_);
+        server_->Shutdown();
+        server_->ClearSessions();
+        server_->WaitForEmpty();
+        TcpServerManager::DeleteServer(server_);
+        evm_->Shutdown();
+        task_util::WaitForIdle();
+        thread_->Join();
+        thread_.reset();
+        evm_.reset();
+    }
+
+    // Stand-in for the API server: the body of the response is a JSON
+    // object with the path of the request, and the body of the request if
+    // any.
+    void HandleRequest(HttpSession *session, const HttpRequest *request) {
+        {
+            tbb::mutex::scoped_lock lock(mutex_);
+            sessions_.insert(session);
+        }
+        string path = request->UrlPath();
+        ostringstream body;
+        body << "{\"" << path.substr(1) << "\": [";
+        if (!request->Body().empty()) {
+            body << "\"" << request->Body() << "\"";
+        }
+        body << "]}";
+        ostringstream response;
+        response << "HTTP/1.1 200 OK\r\n"
+                 << "Content-Type: application/json\r\n"
+                 << "Content-Length: " << body.str().size() << "\r\n\r\n"
+                 << body.str();
+        string str = response.str();
+        session->Send(reinterpret_cast<const u_int8_t *>(str.c_str()),
+                      str.size(), NULL);
+        delete request;
+    }
+
+    static string Expected(const string &path, const string &body) {
+        return "{\"" + path + "\": [" +
+            (body.empty() ? "" : "\"" + body + "\"") + "]}";
+    }
+
+    void PoolResponse(string expected, boost::shared_ptr<string> data,
+                      HttpConnection *connection, string &str,
+                      boost::system::error_code &ec) {
+        if (!str.empty()) {
+            data->append(str);
+            return;
+        }
+        if (!ec && connection->Status() == 200 && *data == expected) {
+            succeeded_++;
+        }
+        completed_++;
+    }
+
+    HttpConnectionPool::HttpCb PoolResponseCb(const string &expected) {
+        return boost::bind(&HttpClientTest::PoolResponse, this, expected,
+                           boost::shared_ptr<string>(new string), _1, _2, _3);
+    }
+
+    void PoolGet(HttpConnectionPool *pool, const string &path) {
+        vector<string> hdr_options;
+        pool->HttpGet(path, hdr_options, PoolResponseCb(Expected(path, "")));
+    }
+
+    // Request on a connection of its own, as the clients of the HttpClient
+    // did before the connection pools, issuing the next request once the
+    // response is received.
+    void ConnectionGet(int index, int count) {
+        HttpConnection *connection =
+            client_->CreateConnection("127.0.0.1", port_);
+        ostringstream path;
+        path << "virtual-network" << index;
+        connection->HttpGet(path.str(),
+            boost::bind(&HttpClientTest::ConnectionResponse, this, connection,
+                        Expected(path.str(), ""),
+                        boost::shared_ptr<string>(new string), index, count,
+                        _1, _2));
+    }
+
+    void ConnectionResponse(HttpConnection *connection, string expected,
+                            boost::shared_ptr<string> data, int index,
+                            int count, string &str,
+                            boost::system::error_code &ec) {
+        if (!str.empty()) {
+            data->append(str);
+            return;
+        }
+        if (!ec && connection->Status() == 200 && *data == expected) {
+            succeeded_++;
+        }
+        completed_++;
+        client_->RemoveConnection(connection);
+        if (index + 1 < count) {
+            ConnectionGet(index + 1, count);
+        }
+    }
+
+    size_t session_count() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return sessions_.size();
+    }
+
+    std::auto_ptr<EventManager> evm_;
+    std::auto_ptr<ServerThread> thread_;
+    HttpClient *client_;
+    HttpServer *server_;
+    int port_;
+    tbb::mutex mutex_;
+    set<HttpSession *> sessions_;
+    tbb::atomic<int> completed_;
+    tbb::atomic<int> succeeded_;
+};
+
+TEST_F(HttpClientTest, ConnectionPool) {
+    static const int kRequests = 200;
+    client_->set_pool_size(4);
+    HttpConnectionPool *pool = client_->ConnectionPool("127.0.0.1", port_);
+    EXPECT_EQ(pool, client_->ConnectionPool("127.0.0.1", port_));
+    EXPECT_EQ(4U, pool->size());
+
+    for (int i = 0; i < kRequests; i++) {
+        ostringstream path;
+        path << "virtual-network" << i;
+        PoolGet(pool, path.str());
+    }
+    TASK_UTIL_EXPECT_EQ(kRequests, completed_);
+    EXPECT_EQ(kRequests, succeeded_);
+
+    // The requests were sent on at most pool size TCP connections
+    TASK_UTIL_EXPECT_EQ(0U, pool->active_count());
+    EXPECT_EQ(4U, pool->connection_count());
+    EXPECT_EQ(0U, pool->pending_count());
+    EXPECT_GE(4U, session_count());
+    EXPECT_LE(1U, session_count());
+}
+
+TEST_F(HttpClientTest, Methods) {
+    HttpConnectionPool *pool = client_->ConnectionPool("127.0.0.1", port_);
+    pool->set_size(1);
+    vector<string> hdr_options;
+    hdr_options.push_back("Content-Type: application/json");
+
+    // Requests of each method reuse the curl handle of the previous one
+    for (int i = 0; i < 10; i++) {
+        pool->HttpPost("red", "post", hdr_options,
+                       PoolResponseCb(Expected("post", "red")));
+        pool->HttpPut("blue", "put", hdr_options,
+                      PoolResponseCb(Expected("put", "blue")));
+        pool->HttpGet("get", hdr_options, PoolResponseCb(Expected("get", "")));
+        pool->HttpDelete("delete", hdr_options,
+                         PoolResponseCb(Expected("delete", "")));
+    }
+    TASK_UTIL_EXPECT_EQ(40, completed_);
+    EXPECT_EQ(40, succeeded_);
+    EXPECT_EQ(1U, pool->connection_count());
+    EXPECT_EQ(1U, session_count());
+}
+
+class VncApiBatchHandler {
+public:
+    VncApiBatchHandler() {
+        responses_ = 0;
+        done_ = false;
+    }
+
+    void ConfigResponse(contrail_rapidjson::Document &jdoc,
+                        boost::system::error_code &ec, string version,
+                        int status, string reason,
+                        std::map<string, string> *headers) {
+        if (!ec && status == 200 && jdoc.IsObject() &&
+            jdoc.HasMember("virtual-networks")) {
+            responses_++;
+        }
+    }
+
+    void Done() {
+        done_ = true;
+    }
+
+    tbb::atomic<int> responses_;
+    tbb::atomic<bool> done_;
+};
+
+TEST_F(HttpClientTest, VncApiBatch) {
+    static const int kRequests = 100;
+    VncApiConfig cfg;
+    cfg.api_srv_ip = "127.0.0.1";
+    cfg.api_srv_port = port_;
+    cfg.api_use_ssl = false;
+    cfg.ks_srv_ip = "127.0.0.1";
+    cfg.ks_srv_port = port_;
+    cfg.ks_protocol = "http";
+    boost::shared_ptr<VncApi> vnc(new VncApi(evm_.get(), &cfg));
+
+    VncApiBatchHandler handler;
+    vector<VncApi::ConfigRequest> requests(kRequests);
+    for (int i = 0; i < kRequests; i++) {
+        ostringstream id;
+        id << "vn" << i;
+        requests[i].type = "virtual-network";
+        requests[i].ids.push_back(id.str());
+        requests[i].fields.push_back("network_ipam_refs");
+        requests[i].cb = boost::bind(&VncApiBatchHandler::ConfigResponse,
+                                     &handler, _1, _2, _3, _4, _5, _6);
+    }
+    vnc->GetConfigBatch(requests,
+                        boost::bind(&VncApiBatchHandler::Done, &handler));
+    TASK_UTIL_EXPECT_TRUE(handler.done_);
+    EXPECT_EQ(kRequests, handler.responses_);
+    EXPECT_GE(static_cast<size_t>(HttpClient::kDefaultPoolSize),
+              session_count());
+
+    task_util::WaitForIdle();
+    vnc->Stop();
+}
+
+// Serves responses of size bytes, one per connection, with blocking writes
+// so that the server is paced by the client.
+class BulkServer {
+public:
+    BulkServer(size_t size, int connections)
+        : acceptor_(io_service_, tcp::endpoint(
+              boost::asio::ip::address::from_string("127.0.0.1"), 0)),
+          size_(size), connections_(connections) {
+    }
+
+    int port() const { return acceptor_.local_endpoint().port(); }
+    void Start() { pthread_create(&thread_, NULL, &BulkServer::Run, this); }
+    void Join() { pthread_join(thread_, NULL); }
+
+    // Byte at an offset of the body.
+    static char Byte(size_t offset) { return offset % 251; }
+
+private:
+    static void *Run(void *arg) {
+        static_cast<BulkServer *>(arg)->Serve();
+        return NULL;
+    }
+
+    void Serve() {
+        vector<char> block(64 * 1024);
+        for (int i = 0; i < connections_; i++) {
+            tcp::socket socket(io_service_);
+            boost::system::error_code ec;
+            acceptor_.accept(socket, ec);
+            boost::asio::streambuf request;
+            boost::asio::read_until(socket, request, "\r\n\r\n", ec);
+            ostringstream head;
+            head << "HTTP/1.1 200 OK\r\n"
+                 << "Content-Type: application/octet-stream\r\n"
+                 << "Connection: close\r\n"
+                 << "Content-Length: " << size_ << "\r\n\r\n";
+            boost::asio::write(socket, boost::asio::buffer(head.str()), ec);
+            for (size_t sent = 0; sent < size_ && !ec; sent += block.size()) {
+                size_t len = std::min(block.size(), size_ - sent);
+                for (size_t j = 0; j < len; j++) {
+                    block[j] = Byte(sent + j);
+                }
+                boost::asio::write(socket, boost::asio::buffer(&block[0], len),
+                                   ec);
+            }
+            socket.close(ec);
+        }
+    }
+
+    boost::asio::io_service io_service_;
+    tcp::acceptor acceptor_;
+    size_t size_;
+    int connections_;
+    pthread_t thread_;
+};
+
+// Consumer of a streamed body, busy every pause_bytes received if set.
+class StreamConsumer {
+public:
+    explicit StreamConsumer(size_t pause_bytes)
+        : pause_bytes_(pause_bytes), next_pause_(pause_bytes) {
+        received_ = 0;
+        errors_ = 0;
+        pauses_ = 0;
+        done_ = false;
+    }
+
+    bool Data(const char *data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != BulkServer::Byte(received_ + i)) {
+                errors_++;
+            }
+        }
+        received_ += size;
+        if (pause_bytes_ && received_ >= next_pause_) {
+            next_pause_ += pause_bytes_;
+            pauses_++;
+            return false;
+        }
+        return true;
+    }
+
+    void Done(string &str, boost::system::error_code &ec) {
+        if (ec) {
+            errors_++;
+        }
+        done_ = true;
+    }
+
+    size_t pause_bytes_;
+    size_t next_pause_;
+    tbb::atomic<size_t> received_;
+    tbb::atomic<int> errors_;
+    tbb::atomic<int> pauses_;
+    tbb::atomic<bool> done_;
+};
+
+// Consumer of a body passed to the callback of the request, buffering it
+// as VncApi does.
+class BufferedConsumer {
+public:
+    BufferedConsumer() {
+        done_ = false;
+    }
+
+    void Data(string &str, boost::system::error_code &ec) {
+        if (!str.empty()) {
+            body_.append(str);
+            return;
+        }
+        done_ = true;
+    }
+
+    string body_;
+    tbb::atomic<bool> done_;
+};
+
+// Reset the peak resident set size of the process, false if not supported.
+static bool ResetPeakRss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.close();
+    return !clear_refs.fail();
+}
+
+// Peak resident set size of the process in KB.
+static size_t PeakRssKb() {
+    std::ifstream status("/proc/self/status");
+    string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return strtoul(line.c_str() + 6, NULL, 10);
+        }
+    }
+    return 0;
+}
+
+TEST_F(HttpClientTest, StreamingPause) {
+    static const size_t kSize = 8 * 1024 * 1024;
+    BulkServer server(kSize, 1);
+    server.Start();
+    HttpConnection *connection =
+        client_->CreateConnection("127.0.0.1", server.port());
+    StreamConsumer consumer(1024 * 1024);
+    vector<string> hdr_options;
+    connection->HttpGetStream("bulk", false, hdr_options,
+        boost::bind(&StreamConsumer::Data, &consumer, _1, _2),
+        boost::bind(&StreamConsumer::Done, &consumer, _1, _2));
+
+    // Nothing is received while the consumer is busy
+    int resumes = 0;
+    for (int i = 0; i < 60000 && !consumer.done_; i++) {
+        if (consumer.pauses_ > resumes) {
+            TASK_UTIL_EXPECT_TRUE(connection->paused());
+            size_t received = consumer.received_;
+            usleep(10000);
+            EXPECT_EQ(received, consumer.received_);
+            resumes++;
+            connection->Resume();
+        }
+        usleep(1000);
+    }
+    EXPECT_TRUE(consumer.done_);
+    EXPECT_EQ(kSize, consumer.received_);
+    EXPECT_EQ(0, consumer.errors_);
+    EXPECT_EQ(8, consumer.pauses_);
+    server.Join();
+}
+
+// Receive a response streamed to a consumer and passed to the callback of
+// the request to be buffered. The peak memory use of each is checked when
+// check_memory is set.
+static void StreamAndBuffer(HttpClient *client, size_t size,
+                            bool check_memory) {
+    BulkServer server(size, 2);
+    server.Start();
+    HttpConnection *connection =
+        client->CreateConnection("127.0.0.1", server.port());
+    vector<string> hdr_options;
+
+    bool reset = ResetPeakRss();
+    size_t base_kb = PeakRssKb();
+    StreamConsumer consumer(0);
+    uint64_t start = ClockMonotonicUsec();
+    connection->HttpGetStream("bulk", true, hdr_options,
+        boost::bind(&StreamConsumer::Data, &consumer, _1, _2),
+        boost::bind(&StreamConsumer::Done, &consumer, _1, _2));
+    TASK_UTIL_EXPECT_EQ_LONG(true, consumer.done_);
+    uint64_t stream_usecs = ClockMonotonicUsec() - start;
+    size_t stream_kb = PeakRssKb() - base_kb;
+    EXPECT_EQ(size, consumer.received_);
+    EXPECT_EQ(0, consumer.errors_);
+
+    ResetPeakRss();
+    base_kb = PeakRssKb();
+    BufferedConsumer buffered;
+    start = ClockMonotonicUsec();
+    connection->HttpGet("bulk", false, false, true, hdr_options,
+        boost::bind(&BufferedConsumer::Data, &buffered, _1, _2));
+    TASK_UTIL_EXPECT_EQ_LONG(true, buffered.done_);
+    uint64_t buffered_usecs = ClockMonotonicUsec() - start;
+    size_t buffered_kb = PeakRssKb() - base_kb;
+    EXPECT_EQ(size, buffered.body_.size());
+
+    LOG(DEBUG, size / 1024 << " KB response: streamed peak +" << stream_kb
+        << " KB in " << stream_usecs / 1000 << " ms, buffered peak +"
+        << buffered_kb << " KB in " << buffered_usecs / 1000 << " ms");
+    if (check_memory && reset) {
+        EXPECT_GT(buffered_kb, stream_kb + size / 2048);
+    }
+    server.Join();
+}
+
+TEST_F(HttpClientTest, StreamingBody) {
+    StreamAndBuffer(client_, 4 * 1024 * 1024, false);
+}
+
+// Peak memory use with a 100 MB response.
+TEST_F(HttpClientTest, DISABLED_StreamingMemory) {
+    StreamAndBuffer(client_, 100 * 1024 * 1024, true);
+}
+
+// Requests sent one at a time, each on a TCP connection of its own, compared
+// to requests sent on the connections of pools of 1 and 8 connections.
+TEST_F(HttpClientTest, DISABLED_Benchmark) {
+    static const int kRequests = 2000;
+
+    uint64_t start = ClockMonotonicUsec();
+    ConnectionGet(0, kRequests);
+    TASK_UTIL_EXPECT_EQ_LONG(kRequests, completed_);
+    uint64_t connection_usecs = ClockMonotonicUsec() - start;
+    EXPECT_EQ(kRequests, succeeded_);
+
+    uint64_t pool_usecs[2];
+    size_t pool_sizes[2] = { 1, 8 };
+    for (int i = 0; i < 2; i++) {
+        completed_ = 0;
+        succeeded_ = 0;
+        ostringstream host;
+        host << "127.0.0." << i + 1;
+        client_->set_pool_size(pool_sizes[i]);
+        HttpConnectionPool *pool = client_->ConnectionPool(host.str(), port_);
+        start = ClockMonotonicUsec();
+        for (int j = 0; j < kRequests; j++) {
+            ostringstream path;
+            path << "virtual-network" << j;
+            PoolGet(pool, path.str());
+        }
+        TASK_UTIL_EXPECT_EQ_LONG(kRequests, completed_);
+        pool_usecs[i] = ClockMonotonicUsec() - start;
+        EXPECT_EQ(kRequests, succeeded_);
+    }
+
+    LOG(DEBUG, kRequests << " requests: one connection per request "
+        << kRequests * 1000000ULL / connection_usecs
+        << " req/s, pool of 1 " << kRequests * 1000000ULL / pool_usecs[0]
+        << " req/s, pool of 8 " << kRequests * 1000000ULL / pool_usecs[1]
+        << " req/s");
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
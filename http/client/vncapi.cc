@@ -37,6 +37,18 @@ RespBlock::GetConnection()
     return conn_;
 }
 
+void
+RespBlock::SetConnection(HttpConnection *c)
+{
+    conn_ = c;
+}
+
+void
+RespBlock::SetBatch(boost::shared_ptr<VncApiBatch> batch)
+{
+    batch_ = batch;
+}
+
 void
 RespBlock::AddBody(std::string s)
 {
@@ -181,16 +193,12 @@ VncApi::KsRespHandler(RespBlock *rb, RespBlock *orb, std::string &str,
                         boost::bind(&VncApi::CondTest,
                             shared_from_this(), _1)), hdr_.end());
                     hdr_.push_back(std::string("X-AUTH-TOKEN: ") + token);
-                    orb->GetConnection()->HttpGet(orb->GetUri(), false,
-                            false, true, hdr_, boost::bind(
-                                &VncApi::RespHandler,
-                            shared_from_this(), orb, _1, _2));
+                    SendConfigRequest(orb);
                     client_->RemoveConnection(rb->GetConnection());
                     delete rb;
                     return;
                 }
             }
-            client_->RemoveConnection(orb->GetConnection());
             delete orb;
             client_->RemoveConnection(rb->GetConnection());
             delete rb;
@@ -237,7 +245,7 @@ VncApi::MakeUri(std::string type, std::vector<std::string> ids,
 }
 
 VncApi::VncApi(EventManager *evm, VncApiConfig *cfg) : evm_(evm), cfg_(cfg),
-        client_(new HttpClient(evm_, "vnc-api http client"))
+        client_(new HttpClient(evm_, "vnc-api http client")), pool_(0)
 {
     client_->Init();
     hdr_.push_back(std::string(
@@ -261,14 +269,24 @@ VncApi::VncApi(EventManager *evm, VncApiConfig *cfg) : evm_(evm), cfg_(cfg),
         cfg_->api_certfile = pt.get<std::string>("global.certfile", "");
         cfg_->api_cafile = pt.get<std::string>("global.cafile", "");
     }
+
+    pool_ = client_->ConnectionPool(cfg_->api_srv_ip, cfg_->api_srv_port);
+    if (cfg_->api_use_ssl) {
+        pool_->set_ssl_options(cfg_->api_certfile, "PEM", cfg_->api_keyfile,
+                cfg_->api_cafile);
+    }
 }
 
 void
 VncApi::Stop()
 {
     std::cout  << "VncApi::Stop\n";
-    TcpServerManager::DeleteServer(client_);
+    if (client_) {
+        client_->Shutdown();
+        TcpServerManager::DeleteServer(client_);
+    }
     client_ = 0;
+    pool_ = 0;
     {
         hdr_.clear();
         kshdr_.clear();
@@ -285,27 +303,47 @@ VncApi::GetConfig(std::string type, std::vector<std::string> ids,
             std::map<std::string, std::string> *headers)> cb)
 {
     if (client_) {
-        HttpConnection *conn = client_->CreateConnection(cfg_->api_srv_ip,
-                                                         cfg_->api_srv_port);
-        if (cfg_->api_use_ssl) {
-            conn->set_use_ssl(true);
-            conn->set_client_cert(cfg_->api_certfile);
-            conn->set_client_cert_type("PEM");
-            conn->set_client_key(cfg_->api_keyfile);
-            conn->set_ca_cert(cfg_->api_cafile);
-        }
-        RespBlock *rb = new RespBlock(conn,
+        RespBlock *rb = new RespBlock(0,
                 MakeUri(type, ids, filters, parents, refs, fields), cb);
-        rb->GetConnection()->HttpGet(rb->GetUri(), false, false, true, hdr_,
-                boost::bind(&VncApi::RespHandler, shared_from_this(),
-                        rb, _1, _2));
+        SendConfigRequest(rb);
     }
 }
 
 void
-VncApi::RespHandler(RespBlock *rb, std::string &str,
+VncApi::GetConfigBatch(const std::vector<ConfigRequest> &requests,
+        boost::function<void()> done)
+{
+    boost::shared_ptr<VncApiBatch> batch(new VncApiBatch(done));
+    if (client_) {
+        for (std::vector<ConfigRequest>::const_iterator i = requests.begin();
+                i != requests.end(); i++) {
+            RespBlock *rb = new RespBlock(0, MakeUri(i->type, i->ids,
+                    i->filters, i->parents, i->refs, i->fields), i->cb);
+            rb->SetBatch(batch);
+            SendConfigRequest(rb);
+        }
+    }
+}
+
+void
+VncApi::SetConnectionPoolSize(size_t size)
+{
+    if (pool_)
+        pool_->set_size(size);
+}
+
+void
+VncApi::SendConfigRequest(RespBlock *rb)
+{
+    pool_->HttpGet(rb->GetUri(), hdr_, boost::bind(&VncApi::RespHandler,
+            shared_from_this(), rb, _1, _2, _3));
+}
+
+void
+VncApi::RespHandler(RespBlock *rb, HttpConnection *conn, std::string &str,
         boost::system::error_code &ec)
 {
+    rb->SetConnection(conn);
 #ifdef __DEBUG__
     hex_dump(str);
     rb->ShowDetails();
@@ -313,23 +351,16 @@ VncApi::RespHandler(RespBlock *rb, std::string &str,
 #endif // __DEBUG__
     if (client_) {
         if (str == "") {
-            if (rb->GetConnection()->Status() == 401) {
-                // retry
-                // client_->RemoveConnection(rb->GetConnection());
-                // rb->Clear(client_->CreateConnection(cfg_->api_srv_ip,
-                //                                     cfg_->api_srv_port));
+            if (conn->Status() == 401) {
+                // retry once authenticated, on a connection of the pool
                 rb->Clear();
                 Reauthenticate(rb);
             } else {
                 contrail_rapidjson::Document jdoc;
-                if (rb->GetConnection()->Status() == 200)
+                if (conn->Status() == 200)
                     jdoc.Parse<0>(rb->GetBody().c_str());
-                rb->GetCallBack()(jdoc, ec,
-                        rb->GetConnection()->Version(),
-                        rb->GetConnection()->Status(),
-                        rb->GetConnection()->Reason(),
-                        rb->GetConnection()->Headers());
-                client_->RemoveConnection(rb->GetConnection());
+                rb->GetCallBack()(jdoc, ec, conn->Version(), conn->Status(),
+                        conn->Reason(), conn->Headers());
                 delete rb;
             }
         } else {
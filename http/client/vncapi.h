@@ -13,6 +13,7 @@
 #include <rapidjson/stringbuffer.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
 
 struct VncApiConfig {
     std::string  api_srv_ip;
@@ -32,6 +33,19 @@ struct VncApiConfig {
     std::string  ks_cafile;
 };
 
+// Completion of the requests of a batch, signalled once the response blocks
+// of all the requests are deleted.
+class VncApiBatch {
+    public:
+    explicit VncApiBatch(boost::function<void()> done) : done_(done) {}
+    ~VncApiBatch() {
+        if (!done_.empty())
+            done_();
+    }
+    private:
+    boost::function<void()> done_;
+};
+
 class RespBlock {
     public:
     RespBlock(HttpConnection *c, std::string uri,
@@ -39,6 +53,8 @@ class RespBlock {
                 boost::system::error_code&, std::string, int, std::string,
                 std::map<std::string, std::string>*)> cb);
     HttpConnection *GetConnection();
+    void SetConnection(HttpConnection *c);
+    void SetBatch(boost::shared_ptr<VncApiBatch> batch);
     void AddBody(std::string s);
     void Clear(HttpConnection *c=0);
     std::string GetBody();
@@ -49,6 +65,7 @@ class RespBlock {
             std::map<std::string, std::string>*)> GetCallBack();
     private:
     HttpConnection* conn_;
+    boost::shared_ptr<VncApiBatch> batch_;
     std::string uri_;
     boost::function<void(contrail_rapidjson::Document&,
             boost::system::error_code&, std::string, int, std::string,
@@ -62,6 +79,7 @@ class VncApi : public boost::enable_shared_from_this<VncApi> {
     EventManager *evm_;
     VncApiConfig *cfg_;
     HttpClient* client_;
+    HttpConnectionPool* pool_;
     std::vector<std::string> hdr_;
     std::vector<std::string> kshdr_;
 
@@ -75,7 +93,24 @@ class VncApi : public boost::enable_shared_from_this<VncApi> {
     void KsRespHandler(RespBlock *rb, RespBlock *orb, std::string &str,
             boost::system::error_code &ec);
     bool CondTest(std::string s);
+    void SendConfigRequest(RespBlock *rb);
     public:
+    typedef boost::function<void(contrail_rapidjson::Document&,
+            boost::system::error_code &ec, std::string version, int status,
+            std::string reason,
+            std::map<std::string, std::string> *headers)> ConfigCb;
+
+    // A GetConfig request of a batch.
+    struct ConfigRequest {
+        std::string type;
+        std::vector<std::string> ids;
+        std::vector<std::string> filters;
+        std::vector<std::string> parents;
+        std::vector<std::string> refs;
+        std::vector<std::string> fields;
+        ConfigCb cb;
+    };
+
     VncApi(EventManager *evm, VncApiConfig *cfg);
     virtual ~VncApi() { Stop(); }
     void Stop();
@@ -86,7 +121,13 @@ class VncApi : public boost::enable_shared_from_this<VncApi> {
                 boost::system::error_code &ec, std::string version, int status,
                 std::string reason,
                 std::map<std::string, std::string> *headers)> cb);
-    void RespHandler(RespBlock *rb, std::string &str,
+    // Send the requests concurrently on the connections to the API server,
+    // done is called once all the requests are complete.
+    void GetConfigBatch(const std::vector<ConfigRequest> &requests,
+            boost::function<void()> done);
+    // Requests in progress at a time on the connections to the API server.
+    void SetConnectionPoolSize(size_t size);
+    void RespHandler(RespBlock *rb, HttpConnection *conn, std::string &str,
             boost::system::error_code &ec);
     std::string GetToken(RespBlock *rb) const;
 };
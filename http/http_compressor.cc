@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "http/http_compressor.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+
+using namespace std;
+
+// zlib window bits of the gzip and zlib formats.
+static const int kGzipWindowBits = 15 + 16;
+static const int kDeflateWindowBits = 15;
+static const int kMemLevel = 8;
+static const size_t kOutputSize = 16 * 1024;
+
+HttpCompressor::HttpCompressor(Encoding encoding)
+    : encoding_(encoding), initialized_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+    if (encoding_ == IDENTITY) {
+        return;
+    }
+    int window_bits =
+        (encoding_ == GZIP) ? kGzipWindowBits : kDeflateWindowBits;
+    initialized_ = (deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                 window_bits, kMemLevel,
+                                 Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+HttpCompressor::~HttpCompressor() {
+    if (initialized_) {
+        deflateEnd(&stream_);
+    }
+}
+
+bool HttpCompressor::Compress(const uint8_t *data, size_t len, bool finish,
+                              string *out) {
+    if (encoding_ == IDENTITY) {
+        out->append(reinterpret_cast<const char *>(data), len);
+        return true;
+    }
+    if (!initialized_) {
+        return false;
+    }
+
+    stream_.next_in = const_cast<Bytef *>(data);
+    stream_.avail_in = len;
+    int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    uint8_t output[kOutputSize];
+    int ret;
+    do {
+        stream_.next_out = output;
+        stream_.avail_out = sizeof(output);
+        ret = deflate(&stream_, flush);
+        if (ret == Z_STREAM_ERROR) {
+            return false;
+        }
+        out->append(reinterpret_cast<const char *>(output),
+                    sizeof(output) - stream_.avail_out);
+    } while (stream_.avail_out == 0 || (finish && ret != Z_STREAM_END));
+    return true;
+}
+
+const char *HttpCompressor::EncodingName(Encoding encoding) {
+    switch (encoding) {
+    case GZIP:
+        return "gzip";
+    case DEFLATE:
+        return "deflate";
+    default:
+        return NULL;
+    }
+}
+
+HttpCompressor::Encoding HttpCompressor::Negotiate(
+        const string &accept_encoding) {
+    bool gzip = false, deflate = false;
+    vector<string> codings;
+    boost::split(codings, accept_encoding, boost::is_any_of(","));
+    for (vector<string>::iterator it = codings.begin(); it != codings.end();
+         ++it) {
+        // Coding, optionally followed by a quality value of 0 refusing it.
+        vector<string> params;
+        boost::split(params, *it, boost::is_any_of(";"));
+        string coding = boost::algorithm::to_lower_copy(
+            boost::algorithm::trim_copy(params[0]));
+        bool accepted = true;
+        for (size_t i = 1; i < params.size(); i++) {
+            string param = boost::algorithm::trim_copy(params[i]);
+            if (boost::algorithm::istarts_with(param, "q=")) {
+                accepted = (strtod(param.c_str() + 2, NULL) > 0);
+            }
+        }
+        if (coding == "gzip" || coding == "x-gzip" || coding == "*") {
+            gzip = gzip || accepted;
+        } else if (coding == "deflate") {
+            deflate = deflate || accepted;
+        }
+    }
+    if (gzip) {
+        return GZIP;
+    }
+    if (deflate) {
+        return DEFLATE;
+    }
+    return IDENTITY;
+}
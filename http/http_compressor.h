@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __HTTP_COMPRESSOR_H__
+#define __HTTP_COMPRESSOR_H__
+
+#include <stdint.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "base/util.h"
+
+//
+// Content encoding of an HTTP response body with zlib.
+//
+// The body is compressed as a single stream, across the chunks of a chunked
+// response: the output of each chunk is what the compressor produced so far,
+// possibly nothing, and the stream is completed with the last chunk.
+//
+class HttpCompressor {
+public:
+    enum Encoding {
+        IDENTITY,
+        GZIP,
+        DEFLATE,
+    };
+
+    explicit HttpCompressor(Encoding encoding);
+    ~HttpCompressor();
+
+    // Compress the data and append the output to out, completing the stream
+    // when finish is set.
+    bool Compress(const uint8_t *data, size_t len, bool finish,
+                  std::string *out);
+
+    Encoding encoding() const { return encoding_; }
+
+    // Content-Encoding header value of the encoding, NULL for IDENTITY.
+    static const char *EncodingName(Encoding encoding);
+    // Encoding to use given the Accept-Encoding header of a request,
+    // preferring gzip.
+    static Encoding Negotiate(const std::string &accept_encoding);
+
+private:
+    Encoding encoding_;
+    z_stream stream_;
+    bool initialized_;
+
+    DISALLOW_COPY_AND_ASSIGN(HttpCompressor);
+};
+
+#endif /* __HTTP_COMPRESSOR_H__ */
@@ -4,12 +4,15 @@
 
 #include "http/http_request.h"
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include "base/util.h"
 
 using namespace std;
 
 HttpRequest::HttpRequest() :
-    method_(static_cast<http_method>(-1)), event_(TcpSession::EVENT_NONE) {
+    method_(static_cast<http_method>(-1)), event_(TcpSession::EVENT_NONE),
+    keep_alive_(true) {
 }
 
 string HttpRequest::ToString() const {
@@ -43,3 +46,32 @@ string HttpRequest::UrlQuery() const {
     }
     return query;
 }
+
+string HttpRequest::Header(const string &name) const {
+    for (HeaderMap::const_iterator it = headers_.begin();
+         it != headers_.end(); ++it) {
+        if (boost::algorithm::iequals(it->first, name)) {
+            return it->second;
+        }
+    }
+    return "";
+}
+
+void HttpRequest::SetPathParams(const HttpRouter::Params &params) {
+    path_params_.clear();
+    string path = UrlPath();
+    for (size_t i = 0; i < params.count; i++) {
+        const HttpRouter::Params::Param &param = params.params[i];
+        path_params_.push_back(make_pair(*param.name,
+            path.substr(param.offset, param.length)));
+    }
+}
+
+string HttpRequest::PathParam(const string &name) const {
+    for (size_t i = 0; i < path_params_.size(); i++) {
+        if (path_params_[i].first == name) {
+            return path_params_[i].second;
+        }
+    }
+    return "";
+}
@@ -7,7 +7,10 @@
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "http/http_router.h"
 #include "io/tcp_session.h"
 #include "http_parser/http_parser.h"
 
@@ -30,20 +33,32 @@ public:
         body_.append(data, length);
     }
     void SetEvent(enum TcpSession::Event event) { event_ = event; }
+    // Whether the connection is kept open after the response, from the
+    // version and the Connection header of the request.
+    void SetKeepAlive(bool keep_alive) { keep_alive_ = keep_alive; }
+    // Parameters of the route matching the path.
+    void SetPathParams(const HttpRouter::Params &params);
 
     std::string ToString() const;
 
     std::string UrlPath() const;
     std::string UrlQuery() const;
     const HeaderMap & Headers() const { return headers_; }
+    // Value of the header, with a case-insensitive name, empty if absent.
+    std::string Header(const std::string &name) const;
     const std::string & Body() const { return body_; }
     TcpSession::Event Event() const { return event_; }
+    bool KeepAlive() const { return keep_alive_; }
+    // Value of a :name segment of the route, empty if absent.
+    std::string PathParam(const std::string &name) const;
 private:
     http_method method_;
     std::string url_;
     HeaderMap headers_;
     std::string body_;
     TcpSession::Event event_; // used when the request indicates an event
+    bool keep_alive_;
+    std::vector<std::pair<std::string, std::string> > path_params_;
 };
 
 #endif
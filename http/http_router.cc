@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "http/http_router.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// A node is reached by the static text of its prefix, from its parent, or by
+// a parameter segment when it is the parameter child of its parent.
+struct HttpRouter::Node {
+    Node() : param_child(NULL), has_handler(false), has_prefix_handler(false) {
+    }
+    explicit Node(const string &prefix)
+        : prefix(prefix), param_child(NULL), has_handler(false),
+          has_prefix_handler(false) {
+    }
+    ~Node() {
+        STLDeleteValues(&children);
+        delete param_child;
+    }
+
+    Node *FindChild(char c) const {
+        for (vector<Node *>::const_iterator it = children.begin();
+             it != children.end(); ++it) {
+            if ((*it)->prefix[0] == c) {
+                return *it;
+            }
+        }
+        return NULL;
+    }
+
+    string prefix;
+    // Static children, with distinct first characters.
+    vector<Node *> children;
+    Node *param_child;
+    string param_name;
+    Handler handler;
+    bool has_handler;
+    // Handler of the routes ending with '*' at this node.
+    Handler prefix_handler;
+    bool has_prefix_handler;
+};
+
+// A parameter starts a path segment, a '*' ends the route.
+static bool IsParam(const string &route, size_t pos) {
+    return route[pos] == ':' && pos > 0 && route[pos - 1] == '/';
+}
+
+static bool IsWildcard(const string &route, size_t pos) {
+    return route[pos] == '*' && pos + 1 == route.size();
+}
+
+HttpRouter::HttpRouter() : root_(new Node()), size_(0) {
+}
+
+HttpRouter::~HttpRouter() {
+    delete root_;
+}
+
+bool HttpRouter::Add(const string &route, const Handler &handler) {
+    if (route.empty()) {
+        return false;
+    }
+    // The parameters beyond kMaxParams are not captured by Match()
+    size_t param_count = 0;
+    for (size_t pos = 0; pos < route.size(); pos++) {
+        if (IsParam(route, pos)) {
+            param_count++;
+        }
+    }
+    if (param_count > kMaxParams) {
+        return false;
+    }
+    if (!Insert(root_, route, 0, handler)) {
+        return false;
+    }
+    size_++;
+    return true;
+}
+
+bool HttpRouter::Insert(Node *node, const string &route, size_t pos,
+                        const Handler &handler) {
+    if (pos == route.size()) {
+        if (node->has_handler) {
+            return false;
+        }
+        node->handler = handler;
+        node->has_handler = true;
+        return true;
+    }
+
+    if (IsWildcard(route, pos)) {
+        if (node->has_prefix_handler) {
+            return false;
+        }
+        node->prefix_handler = handler;
+        node->has_prefix_handler = true;
+        return true;
+    }
+
+    if (IsParam(route, pos)) {
+        size_t end = route.find('/', pos);
+        if (end == string::npos) {
+            end = route.size();
+        }
+        string name = route.substr(pos + 1, end - pos - 1);
+        if (name.empty()) {
+            return false;
+        }
+        if (!node->param_child) {
+            node->param_child = new Node();
+            node->param_child->param_name = name;
+        } else if (node->param_child->param_name != name) {
+            return false;
+        }
+        return Insert(node->param_child, route, end, handler);
+    }
+
+    // Static text up to the next parameter or wildcard
+    size_t end = pos + 1;
+    while (end < route.size() && !IsParam(route, end) &&
+           !IsWildcard(route, end)) {
+        end++;
+    }
+    Node *child = node->FindChild(route[pos]);
+    if (!child) {
+        child = new Node(route.substr(pos, end - pos));
+        node->children.push_back(child);
+        return Insert(child, route, end, handler);
+    }
+
+    size_t common = 0;
+    while (common < child->prefix.size() && pos + common < end &&
+           child->prefix[common] == route[pos + common]) {
+        common++;
+    }
+    if (common < child->prefix.size()) {
+        // Split the child at the end of the common prefix
+        Node *split = new Node(child->prefix.substr(0, common));
+        child->prefix.erase(0, common);
+        split->children.push_back(child);
+        replace(node->children.begin(), node->children.end(), child, split);
+        child = split;
+    }
+    return Insert(child, route, pos + common, handler);
+}
+
+const HttpRouter::Handler *HttpRouter::Match(const char *path, size_t length,
+                                             Params *params) const {
+    params->count = 0;
+    return Match(root_, path, length, 0, params);
+}
+
+const HttpRouter::Handler *HttpRouter::Match(const Node *node,
+        const char *path, size_t length, size_t pos, Params *params) const {
+    if (pos == length && node->has_handler) {
+        return &node->handler;
+    }
+
+    if (pos < length) {
+        const Node *child = node->FindChild(path[pos]);
+        if (child && length - pos >= child->prefix.size() &&
+            memcmp(path + pos, child->prefix.data(),
+                   child->prefix.size()) == 0) {
+            const Handler *handler =
+                Match(child, path, length, pos + child->prefix.size(), params);
+            if (handler) {
+                return handler;
+            }
+        }
+    }
+
+    if (node->param_child && pos < length && path[pos] != '/' &&
+        params->count < kMaxParams) {
+        const char *end =
+            static_cast<const char *>(memchr(path + pos, '/', length - pos));
+        size_t end_pos = end ? end - path : length;
+        Params::Param *param = &params->params[params->count++];
+        param->name = &node->param_child->param_name;
+        param->offset = pos;
+        param->length = end_pos - pos;
+        const Handler *handler =
+            Match(node->param_child, path, length, end_pos, params);
+        if (handler) {
+            return handler;
+        }
+        params->count--;
+    }
+
+    if (node->has_prefix_handler) {
+        return &node->prefix_handler;
+    }
+    return NULL;
+}
+
+void HttpRouter::Clear() {
+    delete root_;
+    root_ = new Node();
+    size_ = 0;
+}
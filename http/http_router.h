@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __HTTP_ROUTER_H__
+#define __HTTP_ROUTER_H__
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "base/util.h"
+
+class HttpRequest;
+class HttpSession;
+
+//
+// Radix trie of the URL paths served by an HttpServer.
+//
+// A route is a path made of
+//  - static text, matched exactly,
+//  - :name segments, matching a non-empty path segment up to the next '/',
+//    the matched text is reported as the parameter name,
+//  - an optional trailing '*', matching any remainder of the path.
+//
+// e.g. "/Snh_SandeshTraceRequest", "/vn/:name/routes" or "/css/*".
+//
+// Static text takes precedence over a parameter, which takes precedence over
+// a trailing '*'. Matching does not allocate memory, the parameters are
+// reported as offsets in the path.
+//
+class HttpRouter {
+public:
+    typedef boost::function<void(HttpSession *session, const HttpRequest *)>
+        Handler;
+
+    static const size_t kMaxParams = 8;
+
+    struct Params {
+        struct Param {
+            const std::string *name;
+            size_t offset;
+            size_t length;
+        };
+
+        Params() : count(0) {}
+
+        size_t count;
+        Param params[kMaxParams];
+    };
+
+    HttpRouter();
+    ~HttpRouter();
+
+    // Returns false if the route is already registered, is invalid or has
+    // more than kMaxParams parameters.
+    bool Add(const std::string &route, const Handler &handler);
+    // Handler of the route matching the path, NULL if none matches.
+    const Handler *Match(const char *path, size_t length,
+                         Params *params) const;
+    const Handler *Match(const std::string &path, Params *params) const {
+        return Match(path.data(), path.size(), params);
+    }
+
+    void Clear();
+    size_t size() const { return size_; }
+
+private:
+    struct Node;
+
+    bool Insert(Node *node, const std::string &route, size_t pos,
+                const Handler &handler);
+    const Handler *Match(const Node *node, const char *path, size_t length,
+                         size_t pos, Params *params) const;
+
+    Node *root_;
+    size_t size_;
+
+    DISALLOW_COPY_AND_ASSIGN(HttpRouter);
+};
+
+#endif /* __HTTP_ROUTER_H__ */
@@ -4,6 +4,7 @@
 
 #include "http/http_server.h"
 
+#include "http/http_request.h"
 #include "http/http_session.h"
 #include "io/event_manager.h"
 
@@ -11,7 +12,10 @@ using namespace std;
 
 HttpServer::HttpServer(EventManager *evm, const SslConfig &config, uint8_t dscp)
     : SslServer(evm, boost::asio::ssl::context::sslv23_server,
-                config.ssl_enabled, false), dscp_value_(dscp) {
+                config.ssl_enabled, false), dscp_value_(dscp),
+      keepalive_timeout_(kDefaultKeepaliveTimeoutMsecs),
+      response_timeout_(kDefaultResponseTimeoutMsecs),
+      max_sessions_(kDefaultMaxSessions) {
     //ctor
     if (config.ssl_enabled) {
 
@@ -67,7 +71,11 @@ HttpServer::~HttpServer() {
 }
 
 void HttpServer::Shutdown() {
-    http_handlers_.clear();
+    {
+        tbb::mutex::scoped_lock lock(handlers_mutex_);
+        http_handlers_.Clear();
+        default_handler_.clear();
+    }
     TcpServer::Shutdown();
 }
 
@@ -79,38 +87,65 @@ SslSession *HttpServer::AllocSession(SslSocket *socket) {
     return session;
 }
 
-bool HttpServer::AcceptSession(TcpSession *session) {
-    HttpSession *h_session = dynamic_cast<HttpSession *>(session);
+// Called with the server mutex held, the session is rejected when the
+// limit of sessions is reached.
+bool HttpServer::AcceptHttpSession(HttpSession *session) {
+    if (max_sessions_ && GetSessionCount() >= max_sessions_) {
+        return false;
+    }
     if (dscp_value_) {
-        h_session->SetDscpSocketOption(dscp_value_);
+        session->SetDscpSocketOption(dscp_value_);
     }
-    h_session->AcceptSession();
+    session->AcceptSession();
     return true;
 }
 
+bool HttpServer::AcceptSession(TcpSession *session) {
+    return AcceptHttpSession(dynamic_cast<HttpSession *>(session));
+}
+
 bool HttpServer::AcceptSession(SslSession *session) {
-    HttpSession *h_session = dynamic_cast<HttpSession *>(session);
-    if (dscp_value_) {
-        h_session->SetDscpSocketOption(dscp_value_);
-    }
-    h_session->AcceptSession();
-    return true;
+    return AcceptHttpSession(dynamic_cast<HttpSession *>(session));
 }
 
 void HttpServer::RegisterHandler(const string &path, HttpHandlerFn handler) {
-    http_handlers_.insert(make_pair(path, handler));
+    tbb::mutex::scoped_lock lock(handlers_mutex_);
+    if (path == HTTP_WILDCARD_ENTRY) {
+        if (default_handler_.empty()) {
+            default_handler_ = handler;
+        }
+        return;
+    }
+    http_handlers_.Add(path, handler);
 }
 
 HttpServer::HttpHandlerFn HttpServer::GetHandler(const string &path) {
-    HandlerTrie::iterator iter = http_handlers_.find(path);
-    if (iter == http_handlers_.end()) {
-        // check if wildcard entry is present
-        iter = http_handlers_.find(HTTP_WILDCARD_ENTRY);
-        if (iter == http_handlers_.end()) {
-    	    return NULL;
-        }
+    HttpRouter::Params params;
+    tbb::mutex::scoped_lock lock(handlers_mutex_);
+    const HttpHandlerFn *handler = http_handlers_.Match(path, &params);
+    if (handler == NULL) {
+        // wildcard entry, if any
+        return default_handler_;
+    }
+    return *handler;
+}
+
+HttpServer::HttpHandlerFn HttpServer::MatchHandler(
+        HttpRequest *request) const {
+    string path(request->UrlPath());
+    HttpRouter::Params params;
+    // The parameter names point into the routes, they are copied into the
+    // request with the lock held.
+    tbb::mutex::scoped_lock lock(handlers_mutex_);
+    const HttpHandlerFn *handler = http_handlers_.Match(path, &params);
+    if (handler == NULL) {
+        // wildcard entry, if any
+        return default_handler_;
+    }
+    if (params.count) {
+        request->SetPathParams(params);
     }
-    return iter->second;
+    return *handler;
 }
 
 void HttpServer::UpdateDscp(uint8_t value) {
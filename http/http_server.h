@@ -5,13 +5,14 @@
 #ifndef __HTTP_SERVER_H__
 #define __HTTP_SERVER_H__
 
-#include <map>
 #include <string>
 
 #include <boost/function.hpp>
+#include <tbb/mutex.h>
 
 #include "io/ssl_server.h"
 #include "base/util.h"
+#include "http/http_router.h"
 
 #define HTTP_WILDCARD_ENTRY "_match_any_"
 
@@ -34,8 +35,16 @@ struct SslConfig {
 
 class HttpServer : public SslServer {
 public:
-    typedef boost::function<void(HttpSession *session, const HttpRequest *)>
-	HttpHandlerFn;
+    typedef HttpRouter::Handler HttpHandlerFn;
+    // Idle time after which a persistent connection is closed, 0 to keep
+    // the connections open.
+    static const int kDefaultKeepaliveTimeoutMsecs = 60 * 1000;
+    // Time after which a session is closed when the response to its
+    // request is still not complete, 0 to wait for the response.
+    static const int kDefaultResponseTimeoutMsecs = 10 * 60 * 1000;
+    // Sessions accepted at the same time, 0 for no limit.
+    static const size_t kDefaultMaxSessions = 1024;
+
     explicit HttpServer(EventManager *evm, const SslConfig &config=SslConfig(),
                         uint8_t dscp = 0);
     virtual ~HttpServer();
@@ -44,15 +53,37 @@ public:
     virtual bool AcceptSession(SslSession *session);
     virtual bool AcceptSession(TcpSession *session);
 
+    // The path is a route of HttpRouter, or HTTP_WILDCARD_ENTRY for the
+    // handler of the paths not matching any route.
     void RegisterHandler(const std::string &path, HttpHandlerFn handler);
     HttpHandlerFn GetHandler(const std::string &path);
+    // Copy of the handler of the request path, empty if none, so that it
+    // remains valid when the routes are cleared. The parameters of the
+    // route are set in the request.
+    HttpHandlerFn MatchHandler(HttpRequest *request) const;
     void Shutdown();
     void UpdateDscp(uint8_t value);
 
+    int keepalive_timeout() const { return keepalive_timeout_; }
+    void set_keepalive_timeout(int msecs) { keepalive_timeout_ = msecs; }
+    int response_timeout() const { return response_timeout_; }
+    void set_response_timeout(int msecs) { response_timeout_ = msecs; }
+    size_t max_sessions() const { return max_sessions_; }
+    void set_max_sessions(size_t max_sessions) {
+        max_sessions_ = max_sessions;
+    }
+
 private:
-    typedef std::map<std::string, HttpHandlerFn> HandlerTrie;
-    HandlerTrie http_handlers_;
+    bool AcceptHttpSession(HttpSession *session);
+
+    // Protects the routes and the default handler.
+    mutable tbb::mutex handlers_mutex_;
+    HttpRouter http_handlers_;
+    HttpHandlerFn default_handler_;
     uint8_t dscp_value_;
+    int keepalive_timeout_;
+    int response_timeout_;
+    size_t max_sessions_;
     DISALLOW_COPY_AND_ASSIGN(HttpServer);
 };
 
@@ -10,17 +10,20 @@
 
 #include "base/logging.h"
 #include "base/task.h"
+#include "base/time_util.h"
+#include "base/timer.h"
 #include "http/http_request.h"
 #include "http/http_server.h"
 #include "http_parser/http_parser.h"
+#include "io/event_manager.h"
 #include "sandesh/sandesh_http.h"
 #include "http/http_log_types.h"
 
 using namespace std;
 
 int HttpSession::req_handler_task_id_ = -1;
-HttpSession::map_type * HttpSession::context_map_ = 0;
-tbb::mutex HttpSession::map_mutex_;
+// Never destroyed, the sessions may outlive the static objects.
+HttpSession::map_type *HttpSession::context_map_ = new map_type();
 tbb::atomic<long> HttpSession::task_count_;
 
 // Input processing context
@@ -46,6 +49,10 @@ public:
     }
 
     bool complete() const { return complete_; }
+    bool error() const {
+        enum http_errno error = HTTP_PARSER_ERRNO(&parser_);
+        return error != HPE_OK && error != HPE_PAUSED;
+    }
 
     // Transfers ownership
     HttpRequest *GetRequest() {
@@ -63,14 +70,18 @@ private:
             reinterpret_cast<RequestBuilder *>(parser->data);
         builder->request_->SetMethod(static_cast<http_method>(parser->method));
         builder->request_->SetUrl(&builder->tmp_url_);
+        builder->request_->SetKeepAlive(http_should_keep_alive(parser));
         builder->PushHeader();
         return 0;
     }
 
+    // Stop parsing at the end of the request, the data that follows is the
+    // next pipelined request.
     static int OnMessageComplete(struct http_parser *parser) {
         RequestBuilder *builder =
             reinterpret_cast<RequestBuilder *>(parser->data);
         builder->complete_ = true;
+        http_parser_pause(parser, 1);
         return 0;
     }
 
@@ -155,26 +166,22 @@ public:
         HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO, "RequestHandler destructor");
     }
 
-    void NotFound(HttpSession *session, const HttpRequest *request) {
-        static const char no_response[] =
-"HTTP/1.1 404 Not Found\r\n"
-"Content-Type: text/html; charset=UTF-8\r\n"
-"Content-Length: 46\r\n"
-"\r\n"
-"<html>\n"
-"<title>404 Not Found</title>\n"
-"</html>\r\n"
-;
-        session->Send(reinterpret_cast<const u_int8_t *>(no_response),
-              sizeof(no_response), NULL);
-        delete request;
-    }
-
     // Retrieve a request item from the queue. Return true if the queue
     // is empty.
     bool FromQ(HttpRequest *& r) {
         return !session_->request_queue_.try_pop(r);
     }
+
+    // A request may be queued, or the deferred response completed, after
+    // the loop stopped and before the flag is cleared, without starting a
+    // new task. The exchange orders the clearing before the checks.
+    void Stop() {
+        session_->handler_running_.fetch_and_store(false);
+        if (!session_->IsResponseDeferred() &&
+            !session_->request_queue_.empty()) {
+            session_->StartRequestHandler();
+        }
+    }
     virtual bool Run() {
         HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
                      "RequestHandler execute");
@@ -182,9 +189,11 @@ public:
         bool del_session = false;
         HttpServer *server = static_cast<HttpServer *>(session_->server());
         while (true) {
+            // The next request is handled once the response being sent
+            // is complete, which enqueues a new task
+            if (session_->IsResponseDeferred()) break;
             request = NULL;
-            session_->req_queue_empty_ = FromQ(request);
-            if (!request) break;
+            if (FromQ(request)) break;
             HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
                          "URL is " + request->ToString());
             if (request->ToString().empty()) {
@@ -195,21 +204,32 @@ public:
                 session_->set_observer(NULL);
                 session_->Close();
                 delete request;
+            } else if (session_->closing_) {
+                // Pipelined request of a closed session
+                delete request;
             } else {
                 HttpServer::HttpHandlerFn handler =
-                        server->GetHandler(request->UrlPath());
-                if (handler == NULL) {
-                    handler = boost::bind(&RequestHandler::NotFound,
-                                          this, _1, _2);
+                        server->MatchHandler(request);
+                // The handler deletes the request
+                bool keep_alive = request->KeepAlive();
+                if (handler.empty()) {
+                    session_->SendNotFound(request);
+                } else {
+                    handler(session_.get(), request);
+                }
+                if (!keep_alive) {
+                    session_->CloseAfterResponse();
                 }
-                handler(session_.get(), request);
             }
         }
         if (del_session) {
             HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO, "DeleteSession "
                 + session_->ToString());
             session_->set_observer(NULL);
+            session_->DeleteKeepaliveTimer();
             server->DeleteSession(session_.get());
+        } else {
+            Stop();
         }
         HttpSession::task_count_--;
         return true;
@@ -221,12 +241,16 @@ private:
 
 HttpSession::HttpSession(HttpServer *server, SslSocket *socket,
     bool async_ready)
-    : SslSession(server, socket, async_ready), event_cb_(NULL) {
+    : SslSession(server, socket, async_ready), response_deferred_(false),
+      close_after_response_(false), keepalive_timer_(NULL), event_cb_(NULL) {
     if (req_handler_task_id_ == -1) {
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
         req_handler_task_id_ = scheduler->GetTaskId("http::RequestHandlerTask");
     }
-    req_queue_empty_ = true;
+    handler_running_ = false;
+    closing_ = false;
+    last_activity_ = ClockMonotonicUsec();
+    response_start_ = 0;
     set_observer(boost::bind(&HttpSession::OnSessionEvent, this, _1, _2));
 }
 
@@ -238,11 +262,155 @@ HttpSession::~HttpSession() {
 }
 
 void HttpSession::AcceptSession() {
-    tbb::mutex::scoped_lock lock(map_mutex_);
     context_str_ = "http%" + ToString();
-    GetMap()->insert(std::make_pair(context_str_, HttpSessionPtr(this)));
+    context_map_->insert(std::make_pair(context_str_, HttpSessionPtr(this)));
     HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
         "Created Session " + context_str_);
+
+    HttpServer *server = static_cast<HttpServer *>(this->server());
+    if (server->keepalive_timeout() > 0) {
+        keepalive_timer_ = TimerManager::CreateTimer(
+            *server->event_manager()->io_service(), "HttpSession keepalive");
+        keepalive_timer_->Start(server->keepalive_timeout(),
+            boost::bind(&HttpSession::KeepaliveTimerExpired,
+                        HttpSessionPtr(this)));
+    }
+}
+
+void HttpSession::EnqueueRequest(HttpRequest *request) {
+    request_queue_.push(request);
+    StartRequestHandler();
+}
+
+// Enqueue a RequestHandler task unless one is running already, which
+// handles the requests queued before it stops.
+void HttpSession::StartRequestHandler() {
+    if (handler_running_.compare_and_swap(true, false)) {
+        return;
+    }
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    RequestHandler *task = new RequestHandler(this);
+    HttpSession::task_count_++;
+    scheduler->Enqueue(task);
+}
+
+void HttpSession::SendNotFound(const HttpRequest *request) {
+    static const char no_response[] =
+"HTTP/1.1 404 Not Found\r\n"
+"Content-Type: text/html; charset=UTF-8\r\n"
+"Content-Length: 46\r\n"
+"\r\n"
+"<html>\n"
+"<title>404 Not Found</title>\n"
+"</html>\r\n"
+;
+    Send(reinterpret_cast<const u_int8_t *>(no_response), sizeof(no_response),
+         NULL);
+    delete request;
+}
+
+void HttpSession::DeferResponse() {
+    response_start_ = ClockMonotonicUsec();
+    tbb::mutex::scoped_lock lock(response_mutex_);
+    response_deferred_ = true;
+    close_after_response_ = false;
+}
+
+void HttpSession::ResponseComplete() {
+    bool close;
+    {
+        tbb::mutex::scoped_lock lock(response_mutex_);
+        if (!response_deferred_) {
+            return;
+        }
+        response_deferred_ = false;
+        close = close_after_response_;
+    }
+    last_activity_ = ClockMonotonicUsec();
+    if (close) {
+        EnqueueClose(TcpSession::CLOSE);
+    } else {
+        StartRequestHandler();
+    }
+}
+
+bool HttpSession::IsResponseDeferred() {
+    tbb::mutex::scoped_lock lock(response_mutex_);
+    return response_deferred_;
+}
+
+// Close the session once the response to the current request is sent, for
+// requests which do not keep the connection open.
+void HttpSession::CloseAfterResponse() {
+    {
+        tbb::mutex::scoped_lock lock(response_mutex_);
+        if (response_deferred_) {
+            close_after_response_ = true;
+            return;
+        }
+    }
+    EnqueueClose(TcpSession::CLOSE);
+}
+
+// Remove the session from the context map and queue the request closing it
+// after the requests already queued, which are dropped. Called when the
+// connection is closed by the client, and to close it on the server side.
+void HttpSession::EnqueueClose(enum TcpSession::Event event) {
+    if (closing_.fetch_and_store(true)) {
+        return;
+    }
+    {
+        // The deferred response is dropped with the session
+        tbb::mutex::scoped_lock lock(response_mutex_);
+        response_deferred_ = false;
+    }
+    if (context_map_->erase(context_str_)) {
+        HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
+            "Removed Session " + context_str_);
+    } else {
+        HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
+            "Not Removed Session " + context_str_);
+    }
+    HttpRequest *request = new HttpRequest();
+    string nourl = "";
+    request->SetUrl(&nourl);
+    request->SetEvent(event);
+    request_queue_.push(request);
+    // The request handler may be waiting for the deferred response
+    StartRequestHandler();
+}
+
+// Close the session when no request was received and no response was sent
+// during the keepalive timeout. A pending response keeps the session open
+// until the response timeout, if any.
+bool HttpSession::KeepaliveTimerExpired() {
+    HttpServer *server = static_cast<HttpServer *>(this->server());
+    uint64_t now = ClockMonotonicUsec();
+    int timeout = server->keepalive_timeout();
+    int idle = (now - last_activity_) / 1000;
+    if (IsResponseDeferred()) {
+        if (server->response_timeout() == 0) {
+            keepalive_timer_->Reschedule(timeout);
+            return true;
+        }
+        timeout = server->response_timeout();
+        idle = (now - response_start_) / 1000;
+    }
+    if (idle < timeout) {
+        keepalive_timer_->Reschedule(timeout - idle);
+        return true;
+    }
+    HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
+        "Keepalive timeout " + context_str_);
+    EnqueueClose(TcpSession::CLOSE);
+    return false;
+}
+
+void HttpSession::DeleteKeepaliveTimer() {
+    if (keepalive_timer_) {
+        TimerManager::DeleteTimer(keepalive_timer_);
+        keepalive_timer_ = NULL;
+    }
 }
 
 void HttpSession::RegisterEventCb(SessionEventCb cb) {
@@ -256,30 +424,7 @@ void HttpSession::OnSessionEvent(TcpSession *session,
 
     switch (event) {
     case TcpSession::CLOSE:
-        {
-            tbb::mutex::scoped_lock lock(map_mutex_);
-            if (GetMap()->erase(h_session->context_str_)) {
-                HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
-                    "Removed Session " + h_session->context_str_);
-            } else {
-                HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
-                    "Not Removed Session " + h_session->context_str_);                
-            }
-            lock.release();
-            h_session->context_str_ = "";
-            HttpRequest *request = new HttpRequest();
-            string nourl = "";
-            request->SetUrl(&nourl);
-            request->SetEvent(event);
-            request_queue_.push(request);
-            // Enqueue new RequestHandler task if needed
-            if (req_queue_empty_) {
-                TaskScheduler *scheduler = TaskScheduler::GetInstance();
-                RequestHandler *task = new RequestHandler(this);
-                HttpSession::task_count_++;
-                scheduler->Enqueue(task);
-            }
-        }
+        h_session->EnqueueClose(event);
         break;
     default:
         break;
@@ -295,27 +440,33 @@ void HttpSession::OnRead(Buffer buffer) {
     HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_DEBUG, msg.str());
 
     // No need to proceed if size is 0 which can be the case with ssl
-    if (size == 0 || context_str_.size() == 0) {
+    if (size == 0 || context_str_.size() == 0 || closing_) {
         ReleaseBuffer(buffer);
         return;
     }
+    last_activity_ = ClockMonotonicUsec();
     if (request_builder_.get() == NULL) {
         request_builder_.reset(new RequestBuilder());
     }
-    request_builder_->Parse(data, size);
-    if (request_builder_->complete()) {
-        HttpRequest *request = request_builder_->GetRequest();
-        HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_DEBUG, request->ToString());
-        request_queue_.push(request);
-        // Enqueue new RequestHandler task if needed
-        if (req_queue_empty_) {
-            TaskScheduler *scheduler = TaskScheduler::GetInstance();
-            RequestHandler *task = new RequestHandler(this);
-            HttpSession::task_count_++;
-            scheduler->Enqueue(task);
+    // The buffer may hold several pipelined requests, queued in order
+    while (size > 0) {
+        size_t nparsed = request_builder_->Parse(data, size);
+        data += nparsed;
+        size -= nparsed;
+        if (request_builder_->complete()) {
+            HttpRequest *request = request_builder_->GetRequest();
+            HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_DEBUG,
+                         request->ToString());
+            EnqueueRequest(request);
+            request_builder_->Clear();
+        } else if (request_builder_->error()) {
+            HTTP_SYS_LOG("HttpSession", SandeshLevel::UT_INFO,
+                "Invalid request " + context_str_);
+            EnqueueClose(TcpSession::CLOSE);
+            break;
+        } else {
+            break;
         }
-        request_builder_->Clear();
     }
-    // TODO: error handling
     ReleaseBuffer(buffer);
 }
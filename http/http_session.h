@@ -6,42 +6,72 @@
 #define __HTTP_SESSION_H__
 
 #include <boost/scoped_ptr.hpp>
+#include <tbb/concurrent_hash_map.h>
 #include <tbb/concurrent_queue.h>
 #include <tbb/atomic.h>
+#include <tbb/mutex.h>
 
 #include "base/util.h"
+#include "http/http_compressor.h"
 #include "io/ssl_session.h"
 
 class HttpRequest;
 class HttpServer;
+class Timer;
 
 class HttpSession: public SslSession {
   public:
     typedef boost::function<void(HttpSession *session,
                                  enum TcpSession::Event event)> SessionEventCb;
+    typedef boost::intrusive_ptr<HttpSession> HttpSessionPtr;
+
+    // Representation of the responses to a request.
+    struct ResponseFormat {
+        ResponseFormat() : json(false), encoding(HttpCompressor::IDENTITY) {}
+        bool json;
+        HttpCompressor::Encoding encoding;
+    };
 
     HttpSession(HttpServer *server, SslSocket *sock, bool async_ready = true);
     virtual ~HttpSession();
     const std::string get_context() { return context_str_; }
 
-    static bool SendSession(std::string const& s,
-            const uint8_t *data, size_t size, size_t *sent) {
-        HttpSessionPtr hs = GetSession(s);
-        if (!hs) return false;
-        return hs->Send(data, size, sent);
-    }
-    static std::string get_client_context(std::string const& s) {
-        HttpSessionPtr hs = GetSession(s);
-        if (!hs) return "";
-        return hs->get_client_context();
+    // Session of the context of a request, NULL once the session is closed.
+    static HttpSessionPtr GetSession(std::string const& s) {
+        map_type::const_accessor accessor;
+        if (!context_map_->find(accessor, s)) {
+            return NULL;
+        }
+        return accessor->second;
     }
-    static bool set_client_context(std::string const& s,
-            const std::string& ctx) {
-        HttpSessionPtr hs = GetSession(s);
-        if (!hs) return false;
-        hs->set_client_context(ctx);
-        return true;
-    }    
+
+    // Serializes the chunks of the responses sent on the session.
+    tbb::mutex &response_mutex() { return response_mutex_; }
+    // Name of the response being sent in chunks, empty between responses.
+    // Accessed with the response mutex held.
+    const std::string &client_context() const { return client_context_str_; }
+    void set_client_context(const std::string& client_ctx)
+      { client_context_str_ = client_ctx; }
+    // Format requested by the last request, and format and compressor of
+    // the response being sent. Accessed with the response mutex held.
+    const ResponseFormat &requested_format() const { return requested_format_; }
+    void set_requested_format(const ResponseFormat &format)
+      { requested_format_ = format; }
+    const ResponseFormat &response_format() const { return response_format_; }
+    void set_response_format(const ResponseFormat &format)
+      { response_format_ = format; }
+    HttpCompressor *compressor() { return compressor_.get(); }
+    void set_compressor(HttpCompressor *compressor)
+      { compressor_.reset(compressor); }
+
+    // Called by a handler which sends its response after returning. The
+    // next requests of the session are handled once the response is
+    // complete, so that pipelined requests are answered in order.
+    void DeferResponse();
+    void ResponseComplete();
+    // Sends a 404 response to the request, and deletes it.
+    void SendNotFound(const HttpRequest *request);
+
     static tbb::atomic<long> GetPendingTaskCount() {
         return task_count_;
     }
@@ -55,39 +85,43 @@ class HttpSession: public SslSession {
   private:
     class RequestBuilder;
     class RequestHandler;
-    typedef boost::intrusive_ptr<HttpSession> HttpSessionPtr;
-    typedef std::map<std::string, HttpSessionPtr> map_type;
+    typedef tbb::concurrent_hash_map<std::string, HttpSessionPtr> map_type;
 
     void OnSessionEvent(TcpSession *session,
             enum TcpSession::Event event);
+    void EnqueueRequest(HttpRequest *request);
+    void StartRequestHandler();
+    bool IsResponseDeferred();
+    void CloseAfterResponse();
+    void EnqueueClose(enum TcpSession::Event event);
+    bool KeepaliveTimerExpired();
+    void DeleteKeepaliveTimer();
 
-    static map_type* GetMap() {
-        if (!context_map_) {
-            context_map_ = new map_type();
-        }
-        return context_map_;
-    }
-    static HttpSessionPtr GetSession(std::string const& s) {
-        tbb::mutex::scoped_lock lock(map_mutex_);
-        map_type::iterator it = GetMap()->find(s);
-        if (it == GetMap()->end()) {
-            return 0;
-        }
-        return it->second;
-    }
-    const std::string get_client_context() { return client_context_str_; }
-    void set_client_context(const std::string& client_ctx)
-      { client_context_str_ = client_ctx; }
     boost::scoped_ptr<RequestBuilder> request_builder_;
     tbb::concurrent_queue<HttpRequest *> request_queue_;
-    tbb::atomic<bool> req_queue_empty_;
+    // Whether a RequestHandler task is running. A single task consumes the
+    // queue, so that the requests are handled in order.
+    tbb::atomic<bool> handler_running_;
     std::string context_str_;
+    tbb::mutex response_mutex_;
     std::string client_context_str_;
+    ResponseFormat requested_format_;
+    ResponseFormat response_format_;
+    boost::scoped_ptr<HttpCompressor> compressor_;
+    // Whether a handler is sending its response, and whether to close the
+    // session once it is sent. Accessed with the response mutex held.
+    bool response_deferred_;
+    bool close_after_response_;
+    tbb::atomic<bool> closing_;
+    // Time of the last request or response, and time the response being
+    // sent was deferred, for the keepalive timer.
+    tbb::atomic<uint64_t> last_activity_;
+    tbb::atomic<uint64_t> response_start_;
+    Timer *keepalive_timer_;
     SessionEventCb event_cb_;
 
     static int req_handler_task_id_;
-    static map_type* context_map_;
-    static tbb::mutex map_mutex_;
+    static map_type *context_map_;
     static tbb::atomic<long> task_count_;
 
     DISALLOW_COPY_AND_ASSIGN(HttpSession);
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "http/http_router.h"
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "testing/gunit.h"
+
+using std::map;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+class HttpRouterTest : public ::testing::Test {
+protected:
+    HttpRouterTest() : called_(-1) {
+    }
+
+    void Handler(int id, HttpSession *session, const HttpRequest *request) {
+        called_ = id;
+    }
+
+    HttpRouter::Handler MakeHandler(int id) {
+        return boost::bind(&HttpRouterTest::Handler, this, id, _1, _2);
+    }
+
+    // Id of the handler of the route matching the path, -1 if none.
+    int Dispatch(const string &path) {
+        called_ = -1;
+        const HttpRouter::Handler *handler = router_.Match(path, &params_);
+        if (handler) {
+            (*handler)(NULL, NULL);
+        }
+        return called_;
+    }
+
+    // Add the routes of an introspect server registering 2k requests, the
+    // handler of a path is its index. The handlers are also added to the
+    // map given, if any.
+    void AddIntrospectRoutes(vector<string> *paths,
+                             map<string, HttpRouter::Handler> *handlers) {
+        static const int kRoutes = 2000;
+        static const char *kNames[] = {
+            "Sandesh", "Bgp", "Xmpp", "Route", "Ifmap", "Config", "Agent",
+            "Vn",
+        };
+        for (int i = 0; i < kRoutes; i++) {
+            ostringstream path;
+            path << "/Snh_" << kNames[i % 8] << "Show" << i << "Request";
+            paths->push_back(path.str());
+            EXPECT_TRUE(router_.Add(path.str(), MakeHandler(i)));
+            if (handlers) {
+                handlers->insert(make_pair(path.str(), MakeHandler(i)));
+            }
+        }
+    }
+
+    string Param(const string &path, const string &name) {
+        for (size_t i = 0; i < params_.count; i++) {
+            if (*params_.params[i].name == name) {
+                return path.substr(params_.params[i].offset,
+                                   params_.params[i].length);
+            }
+        }
+        return "";
+    }
+
+    HttpRouter router_;
+    HttpRouter::Params params_;
+    int called_;
+};
+
+TEST_F(HttpRouterTest, Static) {
+    EXPECT_TRUE(router_.Add("/", MakeHandler(1)));
+    EXPECT_TRUE(router_.Add("/index.html", MakeHandler(2)));
+    EXPECT_TRUE(router_.Add("/Snh_SandeshTraceRequest", MakeHandler(3)));
+    EXPECT_TRUE(router_.Add("/Snh_SandeshTraceBufferListRequest",
+                            MakeHandler(4)));
+    EXPECT_TRUE(router_.Add("/Snh_Sandesh", MakeHandler(5)));
+    EXPECT_FALSE(router_.Add("/index.html", MakeHandler(6)));
+    EXPECT_EQ(5U, router_.size());
+
+    EXPECT_EQ(1, Dispatch("/"));
+    EXPECT_EQ(2, Dispatch("/index.html"));
+    EXPECT_EQ(3, Dispatch("/Snh_SandeshTraceRequest"));
+    EXPECT_EQ(4, Dispatch("/Snh_SandeshTraceBufferListRequest"));
+    EXPECT_EQ(5, Dispatch("/Snh_Sandesh"));
+    EXPECT_EQ(-1, Dispatch("/Snh_SandeshTrace"));
+    EXPECT_EQ(-1, Dispatch("/Snh_SandeshTraceRequests"));
+    EXPECT_EQ(-1, Dispatch("/index"));
+    EXPECT_EQ(-1, Dispatch(""));
+    EXPECT_EQ(0U, params_.count);
+}
+
+TEST_F(HttpRouterTest, Params) {
+    EXPECT_TRUE(router_.Add("/vn/:name", MakeHandler(1)));
+    EXPECT_TRUE(router_.Add("/vn/:name/routes/:prefix", MakeHandler(2)));
+    EXPECT_TRUE(router_.Add("/vn/default/routes", MakeHandler(3)));
+    EXPECT_FALSE(router_.Add("/vn/:id/acl", MakeHandler(4)));
+    EXPECT_FALSE(router_.Add("/vn/:/acl", MakeHandler(4)));
+    EXPECT_TRUE(router_.Add("/a/:p1/:p2/:p3/:p4/:p5/:p6/:p7/:p8",
+                            MakeHandler(5)));
+    EXPECT_FALSE(router_.Add("/b/:p1/:p2/:p3/:p4/:p5/:p6/:p7/:p8/:p9",
+                             MakeHandler(6)));
+
+    EXPECT_EQ(1, Dispatch("/vn/red"));
+    EXPECT_EQ("red", Param("/vn/red", "name"));
+    EXPECT_EQ(2, Dispatch("/vn/blue/routes/10.1.1.0"));
+    EXPECT_EQ(2U, params_.count);
+    EXPECT_EQ("blue", Param("/vn/blue/routes/10.1.1.0", "name"));
+    EXPECT_EQ("10.1.1.0", Param("/vn/blue/routes/10.1.1.0", "prefix"));
+
+    // Static text takes precedence, and the parameter is tried when the
+    // static text does not lead to a route
+    EXPECT_EQ(3, Dispatch("/vn/default/routes"));
+    EXPECT_EQ(1, Dispatch("/vn/default"));
+    EXPECT_EQ("default", Param("/vn/default", "name"));
+
+    EXPECT_EQ(5, Dispatch("/a/1/2/3/4/5/6/7/8"));
+    EXPECT_EQ("8", Param("/a/1/2/3/4/5/6/7/8", "p8"));
+
+    EXPECT_EQ(-1, Dispatch("/vn/"));
+    EXPECT_EQ(-1, Dispatch("/vn/red/routes"));
+    EXPECT_EQ(-1, Dispatch("/vn/red/acl"));
+}
+
+TEST_F(HttpRouterTest, Prefix) {
+    EXPECT_TRUE(router_.Add("/css/*", MakeHandler(1)));
+    EXPECT_TRUE(router_.Add("/css/style.css", MakeHandler(2)));
+    EXPECT_TRUE(router_.Add("/*", MakeHandler(3)));
+    EXPECT_FALSE(router_.Add("/css/*", MakeHandler(4)));
+
+    EXPECT_EQ(1, Dispatch("/css/images/sort_asc.png"));
+    EXPECT_EQ(1, Dispatch("/css/"));
+    EXPECT_EQ(2, Dispatch("/css/style.css"));
+    EXPECT_EQ(3, Dispatch("/css"));
+    EXPECT_EQ(3, Dispatch("/js/util.js"));
+    EXPECT_EQ(-1, Dispatch("css"));
+}
+
+TEST_F(HttpRouterTest, Clear) {
+    EXPECT_TRUE(router_.Add("/index.html", MakeHandler(1)));
+    router_.Clear();
+    EXPECT_EQ(0U, router_.size());
+    EXPECT_EQ(-1, Dispatch("/index.html"));
+    EXPECT_TRUE(router_.Add("/index.html", MakeHandler(2)));
+    EXPECT_EQ(2, Dispatch("/index.html"));
+}
+
+// Dispatch with the routes of an introspect server registering 2k requests,
+// which share long prefixes.
+TEST_F(HttpRouterTest, IntrospectRoutes) {
+    vector<string> paths;
+    AddIntrospectRoutes(&paths, NULL);
+    for (size_t i = 0; i < paths.size(); i++) {
+        EXPECT_EQ(static_cast<int>(i), Dispatch(paths[i]));
+    }
+    EXPECT_EQ(-1, Dispatch("/Snh_SandeshShowRequest"));
+}
+
+// Dispatch cost with the introspect routes, compared to the lookup in a map
+// of the paths.
+TEST_F(HttpRouterTest, DISABLED_Benchmark) {
+    static const int kLookups = 1000000;
+
+    vector<string> paths;
+    map<string, HttpRouter::Handler> handlers;
+    AddIntrospectRoutes(&paths, &handlers);
+    int routes = paths.size();
+
+    uint64_t start = ClockMonotonicUsec();
+    int matched = 0;
+    for (int i = 0; i < kLookups; i++) {
+        matched += (router_.Match(paths[i % routes], &params_) != NULL);
+    }
+    uint64_t router_usecs = ClockMonotonicUsec() - start;
+    EXPECT_EQ(kLookups, matched);
+
+    start = ClockMonotonicUsec();
+    matched = 0;
+    for (int i = 0; i < kLookups; i++) {
+        matched += (handlers.find(paths[i % routes]) != handlers.end());
+    }
+    uint64_t map_usecs = ClockMonotonicUsec() - start;
+    EXPECT_EQ(kLookups, matched);
+
+    LOG(DEBUG, kLookups << " lookups in " << routes << " routes: router "
+        << router_usecs * 1000 / kLookups << " ns, map "
+        << map_usecs * 1000 / kLookups << " ns per lookup");
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,253 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#include "io/buffer_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "base/sharded_counter.h"
+#include "io/io_types.h"
+
+using std::vector;
+
+namespace io {
+
+namespace {
+
+// Prepended to every buffer to find its size class when it is freed.
+struct BufferHeader {
+    uint32_t magic;
+    uint32_t size_class;
+    uint64_t reserved;
+};
+
+const uint32_t kBufferMagic = 0xb0ffe125;
+const size_t kHeaderSize = sizeof(BufferHeader);
+
+}  // namespace
+
+struct BufferPool::ThreadCache {
+    ThreadCache() {
+        for (size_t i = 0; i < kNumClasses; ++i) {
+            count[i] = 0;
+        }
+    }
+
+    size_t count[kNumClasses];
+    uint8_t *buffers[kNumClasses][kMaxThreadCacheCount];
+};
+
+struct BufferPool::SizeClassInfo {
+    SizeClassInfo() : thread_cache_limit(0), central_limit(0) {
+    }
+
+    size_t thread_cache_limit;
+    size_t central_limit;
+
+    // Protects central.
+    tbb::spin_mutex mutex;
+    vector<uint8_t *> central;
+
+    ShardedCounter allocs;
+    ShardedCounter frees;
+    ShardedCounter thread_cache_hits;
+    ShardedCounter system_allocs;
+};
+
+const size_t BufferPool::kMinClassShift;
+const size_t BufferPool::kMaxClassShift;
+const size_t BufferPool::kNumClasses;
+const size_t BufferPool::kThreadCacheBytes;
+const size_t BufferPool::kCentralCacheBytes;
+const size_t BufferPool::kMaxThreadCacheCount;
+__thread BufferPool::ThreadCache *BufferPool::thread_cache_;
+
+// The pool is intentionally never destroyed, buffers may be freed by
+// objects with static storage duration at exit.
+BufferPool *BufferPool::GetInstance() {
+    static BufferPool *pool = new BufferPool();
+    return pool;
+}
+
+BufferPool::BufferPool() : classes_(new SizeClassInfo[kNumClasses + 1]) {
+    pthread_key_create(&thread_cache_key_, &BufferPool::DestroyThreadCache);
+
+    CounterRegistry *registry = CounterRegistry::GetInstance();
+    for (size_t i = 0; i <= kNumClasses; ++i) {
+        SizeClassInfo *info = &classes_[i];
+        std::ostringstream prefix;
+        prefix << "io.buffer_pool.";
+        if (i < kNumClasses) {
+            size_t size = ClassSize(i);
+            info->thread_cache_limit = std::max(size_t(4),
+                std::min(kMaxThreadCacheCount, kThreadCacheBytes / size));
+            info->central_limit = kCentralCacheBytes / size;
+            prefix << size << ".";
+        } else {
+            prefix << "large.";
+        }
+        registry->Register(prefix.str() + "allocs", &info->allocs);
+        registry->Register(prefix.str() + "frees", &info->frees);
+        registry->Register(prefix.str() + "system_allocs",
+                           &info->system_allocs);
+    }
+}
+
+BufferPool::~BufferPool() {
+    CounterRegistry::GetInstance()->UnregisterPrefix("io.buffer_pool.");
+    for (size_t i = 0; i < kNumClasses; ++i) {
+        for (vector<uint8_t *>::iterator it = classes_[i].central.begin();
+             it != classes_[i].central.end(); ++it) {
+            free(*it);
+        }
+    }
+    delete [] classes_;
+    pthread_key_delete(thread_cache_key_);
+}
+
+size_t BufferPool::SizeClass(size_t size) {
+    if (size <= ClassSize(0))
+        return 0;
+    if (size > ClassSize(kNumClasses - 1))
+        return kNumClasses;
+    // Position of the highest bit of (size - 1), i.e. ceil(log2(size)).
+    size_t shift = sizeof(unsigned long) * 8 - __builtin_clzl(size - 1);
+    return shift - kMinClassShift;
+}
+
+BufferPool::ThreadCache *BufferPool::GetThreadCache() {
+    ThreadCache *cache = thread_cache_;
+    if (cache == NULL) {
+        cache = new ThreadCache();
+        thread_cache_ = cache;
+        pthread_setspecific(thread_cache_key_, cache);
+    }
+    return cache;
+}
+
+// Invoked on thread exit, return the cached buffers to the central lists.
+void BufferPool::DestroyThreadCache(void *arg) {
+    ThreadCache *cache = static_cast<ThreadCache *>(arg);
+    BufferPool *pool = GetInstance();
+    for (size_t i = 0; i < kNumClasses; ++i) {
+        pool->Release(cache, i, cache->count[i]);
+    }
+    thread_cache_ = NULL;
+    delete cache;
+}
+
+// Move up to half the thread cache limit from the central list to the
+// thread cache.
+void BufferPool::Refill(ThreadCache *cache, size_t size_class) {
+    SizeClassInfo *info = &classes_[size_class];
+    tbb::spin_mutex::scoped_lock lock(info->mutex);
+    size_t count = std::min(info->central.size(),
+                            info->thread_cache_limit / 2);
+    for (size_t i = 0; i < count; ++i) {
+        cache->buffers[size_class][cache->count[size_class]++] =
+            info->central.back();
+        info->central.pop_back();
+    }
+}
+
+// Move count buffers from the thread cache to the central list, freeing
+// the ones that do not fit.
+void BufferPool::Release(ThreadCache *cache, size_t size_class,
+                         size_t count) {
+    SizeClassInfo *info = &classes_[size_class];
+    tbb::spin_mutex::scoped_lock lock(info->mutex);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t *block = cache->buffers[size_class][--cache->count[size_class]];
+        if (info->central.size() < info->central_limit) {
+            info->central.push_back(block);
+        } else {
+            free(block);
+        }
+    }
+}
+
+uint8_t *BufferPool::Allocate(size_t size) {
+    size_t size_class = SizeClass(size);
+    SizeClassInfo *info = &classes_[size_class];
+    info->allocs++;
+
+    uint8_t *block = NULL;
+    if (size_class < kNumClasses) {
+        ThreadCache *cache = GetThreadCache();
+        if (cache->count[size_class] == 0)
+            Refill(cache, size_class);
+        if (cache->count[size_class] != 0) {
+            block = cache->buffers[size_class][--cache->count[size_class]];
+            info->thread_cache_hits++;
+        }
+        size = ClassSize(size_class);
+    }
+    if (block == NULL) {
+        block = static_cast<uint8_t *>(malloc(kHeaderSize + size));
+        assert(block != NULL);
+        info->system_allocs++;
+    }
+
+    BufferHeader *header = reinterpret_cast<BufferHeader *>(block);
+    header->magic = kBufferMagic;
+    header->size_class = size_class;
+    return block + kHeaderSize;
+}
+
+void BufferPool::Free(const uint8_t *data) {
+    if (data == NULL)
+        return;
+    uint8_t *block = const_cast<uint8_t *>(data) - kHeaderSize;
+    BufferHeader *header = reinterpret_cast<BufferHeader *>(block);
+    assert(header->magic == kBufferMagic);
+    size_t size_class = header->size_class;
+    SizeClassInfo *info = &classes_[size_class];
+    info->frees++;
+
+    if (size_class == kNumClasses) {
+        free(block);
+        return;
+    }
+
+    ThreadCache *cache = GetThreadCache();
+    if (cache->count[size_class] == info->thread_cache_limit)
+        Release(cache, size_class, info->thread_cache_limit / 2);
+    cache->buffers[size_class][cache->count[size_class]++] = block;
+}
+
+void BufferPool::GetSandeshData(vector<BufferPoolClassStats> *class_list) const {
+    for (size_t i = 0; i <= kNumClasses; ++i) {
+        SizeClassInfo *info = &classes_[i];
+        BufferPoolClassStats stats;
+        if (i < kNumClasses) {
+            stats.set_size(ClassSize(i));
+            tbb::spin_mutex::scoped_lock lock(info->mutex);
+            stats.set_central_free(info->central.size());
+        }
+        uint64_t allocs = info->allocs;
+        uint64_t frees = info->frees;
+        stats.set_allocs(allocs);
+        stats.set_frees(frees);
+        stats.set_in_use(allocs > frees ? allocs - frees : 0);
+        stats.set_thread_cache_hits(info->thread_cache_hits);
+        stats.set_system_allocs(info->system_allocs);
+        class_list->push_back(stats);
+    }
+}
+
+}  // namespace io
+
+void BufferPoolStatsReq::HandleRequest() const {
+    BufferPoolStatsResp *resp = new BufferPoolStatsResp;
+    vector<BufferPoolClassStats> class_list;
+    io::BufferPool::GetInstance()->GetSandeshData(&class_list);
+    resp->set_class_list(class_list);
+    resp->set_context(context());
+    resp->set_more(false);
+    resp->Response();
+}
@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#ifndef SRC_IO_BUFFER_POOL_H_
+#define SRC_IO_BUFFER_POOL_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <tbb/spin_mutex.h>
+
+#include "base/sharded_counter.h"
+#include "base/util.h"
+
+class BufferPoolClassStats;
+
+namespace io {
+
+//
+// Pool of io buffers shared by all sessions and servers.
+//
+// Buffers are grouped in power of 2 size classes. Each thread keeps a small
+// cache of free buffers per size class, so that allocating and freeing a
+// buffer normally does not take any lock. A thread that frees more buffers
+// than it allocates (e.g. the task reading the data off a TcpSession) moves
+// batches of buffers to a central free list per size class, from which the
+// threads allocating buffers (e.g. the io thread) refill their cache.
+//
+// Requests larger than the largest size class are not pooled.
+//
+class BufferPool {
+public:
+    static const size_t kMinClassShift = 8;     // 256 bytes
+    static const size_t kMaxClassShift = 16;    // 64 Kbytes
+    static const size_t kNumClasses = kMaxClassShift - kMinClassShift + 1;
+    // Bytes cached per size class, per thread and in the central list.
+    static const size_t kThreadCacheBytes = 256 * 1024;
+    static const size_t kCentralCacheBytes = 4 * 1024 * 1024;
+    static const size_t kMaxThreadCacheCount = 64;
+
+    static BufferPool *GetInstance();
+
+    // Returns a buffer of at least size bytes.
+    uint8_t *Allocate(size_t size);
+    // Free a buffer returned by Allocate, from any thread.
+    void Free(const uint8_t *data);
+
+    static size_t ClassSize(size_t size_class) {
+        return 1 << (size_class + kMinClassShift);
+    }
+    // Returns kNumClasses for buffers that are not pooled.
+    static size_t SizeClass(size_t size);
+
+    void GetSandeshData(std::vector<BufferPoolClassStats> *class_list) const;
+
+private:
+    struct ThreadCache;
+    struct SizeClassInfo;
+
+    BufferPool();
+    ~BufferPool();
+
+    ThreadCache *GetThreadCache();
+    static void DestroyThreadCache(void *cache);
+    void Refill(ThreadCache *cache, size_t size_class);
+    void Release(ThreadCache *cache, size_t size_class, size_t count);
+
+    static __thread ThreadCache *thread_cache_;
+    pthread_key_t thread_cache_key_;
+    // One entry per size class, plus one for the buffers not pooled.
+    SizeClassInfo *classes_;
+
+    DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+//
+// Buffer from the BufferPool, freed when going out of scope.
+//
+class ScopedPoolBuffer {
+public:
+    explicit ScopedPoolBuffer(size_t size)
+        : data_(BufferPool::GetInstance()->Allocate(size)) {
+    }
+    ~ScopedPoolBuffer() {
+        BufferPool::GetInstance()->Free(data_);
+    }
+    uint8_t *get() const { return data_; }
+
+private:
+    uint8_t *data_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedPoolBuffer);
+};
+
+}  // namespace io
+
+#endif  // SRC_IO_BUFFER_POOL_H_
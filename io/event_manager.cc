@@ -4,6 +4,9 @@
 
 #include <string>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 #include "io/event_manager.h"
 #include "base/logging.h"
 #include "io/io_log.h"
@@ -12,22 +15,50 @@ using boost::asio::io_service;
 
 SandeshTraceBufferPtr IOTraceBuf(SandeshTraceBufferCreate(IO_TRACE_BUF, 1000));
 
-EventManager::EventManager() : shutdown_(false), running_(false) {
+EventManager::EventManager(size_t io_service_count)
+    : shutdown_(false), running_(false) {
+    for (size_t i = 1; i < io_service_count; ++i) {
+        pool_.push_back(new boost::asio::io_service());
+    }
+    next_io_service_ = 0;
 }
 
 void EventManager::Shutdown() {
     shutdown_ = true;
     io_service_.stop();
+    for (size_t i = 0; i < pool_.size(); ++i) {
+        pool_[i].stop();
+    }
+}
+
+io_service *EventManager::PickIoService(size_t hash) {
+    size_t index = hash % io_service_count();
+    return index == 0 ? &io_service_ : &pool_[index - 1];
+}
+
+io_service *EventManager::NextIoService() {
+    return PickIoService(next_io_service_.fetch_and_increment());
 }
 
 void EventManager::Run() {
     Lock();
-    io_service::work work(io_service_);
+    boost::thread_group pool_threads;
+    for (size_t i = 0; i < pool_.size(); ++i) {
+        pool_threads.create_thread(
+            boost::bind(&EventManager::RunIoService, this, &pool_[i]));
+    }
+    RunIoService(&io_service_);
+    pool_threads.join_all();
+    Unlock();
+}
+
+void EventManager::RunIoService(boost::asio::io_service *service) {
+    boost::asio::io_service::work work(*service);
     do {
         if (shutdown_) break;
         boost::system::error_code ec;
         try {
-            io_service_.run(ec);
+            service->run(ec);
             if (ec) {
                 EVENT_MANAGER_LOG_ERROR("io_service run failed: " <<
                                         ec.message());
@@ -44,7 +75,6 @@ void EventManager::Run() {
             assert(false);
         }
     } while (true);
-    Unlock();
 }
 
 size_t EventManager::RunOnce() {
@@ -75,6 +105,32 @@ size_t EventManager::Poll() {
     return res;
 }
 
+bool EventManager::EnableIoUring(unsigned entries) {
+    if (!io_urings_.empty()) {
+        return true;
+    }
+    for (size_t i = 0; i < io_service_count(); ++i) {
+        io::IoUring *ring = io::IoUring::Create(PickIoService(i), entries);
+        if (ring == NULL) {
+            EVENT_MANAGER_LOG_ERROR("io_uring not supported, using the "
+                                    "boost::asio reactor");
+            io_urings_.clear();
+            return false;
+        }
+        io_urings_.push_back(ring);
+    }
+    return true;
+}
+
+io::IoUring *EventManager::GetIoUring(boost::asio::io_service *service) {
+    for (size_t i = 0; i < io_urings_.size(); ++i) {
+        if (io_urings_[i].io_service() == service) {
+            return &io_urings_[i];
+        }
+    }
+    return NULL;
+}
+
 bool EventManager::IsRunning() const {
     return running_;
 }
@@ -7,10 +7,14 @@
 
 #pragma once
 
+#include <tbb/atomic.h>
 #include <tbb/spin_mutex.h>
 #include <boost/asio/io_service.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/version.hpp>
 
 #include "base/util.h"
+#include "io/io_uring.h"
 
 //
 // Wrapper around boost::io_service.
@@ -21,9 +25,20 @@
 // Poll directly or indirectly after having started a ServerThread (which
 // calls Run).
 //
+// An EventManager can also run a pool of io_services, to spread the sockets
+// and timers over several reactors. The primary io_service, returned by
+// io_service(), is run by the thread calling Run, which starts a thread for
+// each of the other io_services of the pool. Sockets and timers are
+// assigned to an io_service of the pool with PickIoService or
+// NextIoService. RunOnce and Poll only run the primary io_service.
+//
+// When enabled with EnableIoUring, each io_service of the pool also runs an
+// io_uring instance, which the sockets of the io_service use instead of the
+// reactor of boost::asio for their read, write and accept operations.
+//
 class EventManager {
 public:
-    EventManager();
+    explicit EventManager(size_t io_service_count = 1);
 
     // Run until shutdown.
     void Run();
@@ -41,7 +56,38 @@ public:
 
     boost::asio::io_service *io_service() { return &io_service_; }
 
+    size_t io_service_count() const { return pool_.size() + 1; }
+
+    // Returns the io_service of the pool for the given hash, e.g. of an
+    // endpoint or a name. Hash 0 selects the primary io_service.
+    boost::asio::io_service *PickIoService(size_t hash);
+
+    // Returns the io_services of the pool in turn.
+    boost::asio::io_service *NextIoService();
+
+    // Create an io_uring instance for every io_service of the pool. Returns
+    // false, leaving the sockets on the reactor of boost::asio, if io_uring
+    // is not supported. Must be called before any socket is created.
+    bool EnableIoUring(unsigned entries = io::IoUring::kDefaultEntries);
+
+    // Returns the io_uring instance of the io_service, or NULL if io_uring
+    // is not enabled.
+    io::IoUring *GetIoUring(boost::asio::io_service *service);
+
+    // Returns the io_service of an io object, e.g. a socket.
+    template <typename IoObject>
+    static boost::asio::io_service *GetIoService(IoObject *object) {
+#if BOOST_VERSION >= 106600
+        return &static_cast<boost::asio::io_service &>(
+            object->get_executor().context());
+#else
+        return &object->get_io_service();
+#endif
+    }
+
 private:
+    void RunIoService(boost::asio::io_service *io_service);
+
     // Atomic mutex lock operation and changing the running_ flag
     void Lock();
 
@@ -49,6 +95,11 @@ private:
     void Unlock();
 
     boost::asio::io_service io_service_;
+    // The io_services other than io_service_.
+    boost::ptr_vector<boost::asio::io_service> pool_;
+    tbb::atomic<size_t> next_io_service_;
+    // One per io_service, primary first, if io_uring is enabled.
+    boost::ptr_vector<io::IoUring> io_urings_;
     bool shutdown_;
     tbb::spin_mutex io_mutex_;
     bool running_;
@@ -0,0 +1,434 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#include "io/io_uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/asio/placeholders.hpp>
+#include <boost/bind.hpp>
+
+#include "io/io_log.h"
+
+using boost::asio::null_buffers;
+using boost::system::error_code;
+using std::vector;
+
+namespace io {
+
+struct IoUring::Operation {
+    explicit Operation(Handler handler) : handler(handler) {
+    }
+    Handler handler;
+};
+
+__thread IoUring *IoUring::reaping_;
+
+#if defined(HAVE_IO_URING)
+
+struct IoUring::Sqe : public io_uring_sqe {
+};
+
+namespace {
+
+int SysSetup(unsigned entries, struct io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int SysEnter(int fd, unsigned to_submit) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, 0, 0, NULL, 0);
+}
+
+int SysRegister(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Check that the kernel implements the operations used.
+bool ProbeOperations(int fd) {
+    static const uint8_t kOperations[] = {
+        IORING_OP_ACCEPT, IORING_OP_ASYNC_CANCEL, IORING_OP_RECV,
+        IORING_OP_RECVMSG, IORING_OP_SENDMSG,
+    };
+    static const size_t kProbeOps = 256;
+    size_t size = sizeof(struct io_uring_probe) +
+        kProbeOps * sizeof(struct io_uring_probe_op);
+    vector<uint8_t> buffer(size);
+    struct io_uring_probe *probe =
+        reinterpret_cast<struct io_uring_probe *>(&buffer[0]);
+    if (SysRegister(fd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(kOperations); ++i) {
+        uint8_t op = kOperations[i];
+        if (op > probe->last_op ||
+            !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+bool IoUring::Setup(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = SysSetup(entries, &params);
+    if (ring_fd_ < 0) {
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_NODROP) ||
+        !ProbeOperations(ring_fd_)) {
+        return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    void *ptr = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    sq_ring_ = static_cast<uint8_t *>(ptr);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ = sq_ring_;
+    } else {
+        ptr = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        cq_ring_ = static_cast<uint8_t *>(ptr);
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<Sqe *>(ptr);
+
+    sq_head_ = reinterpret_cast<unsigned *>(sq_ring_ + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq_ring_ + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned *>(
+        sq_ring_ + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    // The submission queue entries are used in order.
+    unsigned *sq_array =
+        reinterpret_cast<unsigned *>(sq_ring_ + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i) {
+        sq_array[i] = i;
+    }
+    cq_head_ = reinterpret_cast<unsigned *>(cq_ring_ + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq_ring_ + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(
+        cq_ring_ + params.cq_off.ring_mask);
+    cqes_ = cq_ring_ + params.cq_off.cqes;
+
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) {
+        return false;
+    }
+    if (SysRegister(ring_fd_, IORING_REGISTER_EVENTFD, &event_fd_, 1) < 0) {
+        return false;
+    }
+    event_.reset(new boost::asio::posix::stream_descriptor(*io_service_,
+                                                           event_fd_));
+    return true;
+}
+
+// Returns NULL if the submission queue is still full after submitting the
+// pending entries.
+IoUring::Sqe *IoUring::GetSqeLocked() {
+    unsigned tail = *sq_tail_ + sq_pending_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        SubmitLocked();
+        tail = *sq_tail_ + sq_pending_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >=
+            sq_entries_) {
+            return NULL;
+        }
+    }
+    Sqe *sqe = &sqes_[tail & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_pending_++;
+    return sqe;
+}
+
+// Submit the entries not consumed by the kernel yet, including the ones
+// left by a failed submission.
+void IoUring::SubmitLocked() {
+    unsigned tail = *sq_tail_ + sq_pending_;
+    if (sq_pending_ != 0) {
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+        sq_pending_ = 0;
+    }
+    unsigned count = tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (count == 0) {
+        return;
+    }
+    int result;
+    do {
+        system_calls_++;
+        result = SysEnter(ring_fd_, count);
+    } while (result < 0 && errno == EINTR);
+
+    // EBUSY and EAGAIN are returned when the completion queue overflows or
+    // the kernel is short of memory, the submission is retried once the
+    // completions are reaped.
+    if (result < 0) {
+        submit_errors_++;
+        EVENT_MANAGER_LOG_ERROR("io_uring submission of " << count <<
+                                " operations failed: " << strerror(errno));
+    }
+}
+
+IoUring::OpId IoUring::Queue(uint8_t opcode, int fd, const void *addr,
+                             uint32_t len, int flags, Handler handler) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return QueueLocked(opcode, fd, addr, len, flags, handler);
+}
+
+IoUring::OpId IoUring::QueueLocked(uint8_t opcode, int fd, const void *addr,
+                                   uint32_t len, int flags, Handler handler) {
+    Sqe *sqe = GetSqeLocked();
+    if (sqe == NULL) {
+        return 0;
+    }
+    OpId id = 0;
+    if (handler) {
+        id = ++next_id_;
+        pending_.insert(std::make_pair(id, new Operation(handler)));
+    }
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(addr);
+    sqe->len = len;
+    sqe->msg_flags = flags;
+    sqe->user_data = id;
+    operations_++;
+
+    // Operations are only submitted by the io thread: the kernel cancels
+    // the pending operations of a thread when it exits. The ones queued by
+    // the completion handlers are submitted once they have all run.
+    if (reaping_ != this && !submit_posted_) {
+        submit_posted_ = true;
+        io_service_->post(boost::bind(&IoUring::Submit, this));
+    }
+    return id;
+}
+
+IoUring::OpId IoUring::Recv(int fd, void *data, size_t size,
+                            Handler handler) {
+    return Queue(IORING_OP_RECV, fd, data, size, 0, handler);
+}
+
+IoUring::OpId IoUring::RecvMsg(int fd, struct msghdr *msg, Handler handler) {
+    return Queue(IORING_OP_RECVMSG, fd, msg, 1, 0, handler);
+}
+
+IoUring::OpId IoUring::SendMsg(int fd, const struct msghdr *msg, int flags,
+                               Handler handler) {
+    return Queue(IORING_OP_SENDMSG, fd, msg, 1, flags, handler);
+}
+
+IoUring::OpId IoUring::Accept(int fd, Handler handler) {
+    return Queue(IORING_OP_ACCEPT, fd, NULL, 0, 0, handler);
+}
+
+// The kernel finds the operation to cancel by its user data, the id.
+void IoUring::Cancel(OpId id) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (pending_.find(id) == pending_.end()) {
+        return;
+    }
+    QueueLocked(IORING_OP_ASYNC_CANCEL, -1,
+                reinterpret_cast<const void *>(static_cast<uintptr_t>(id)),
+                0, 0, Handler());
+}
+
+// Run the handlers of the completed operations, which may queue new
+// operations.
+void IoUring::Reap() {
+    typedef std::pair<Operation *, int> Completion;
+    vector<Completion> completions;
+    while (true) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            break;
+        }
+        {
+            tbb::mutex::scoped_lock lock(mutex_);
+            for (; head != tail; ++head) {
+                const struct io_uring_cqe *cqe =
+                    reinterpret_cast<const struct io_uring_cqe *>(cqes_) +
+                    (head & cq_mask_);
+                OperationMap::iterator it = pending_.find(cqe->user_data);
+                if (it != pending_.end()) {
+                    completions.push_back(std::make_pair(it->second,
+                                                         cqe->res));
+                    pending_.erase(it);
+                }
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+        reaping_ = this;
+        for (vector<Completion>::iterator it = completions.begin();
+             it != completions.end(); ++it) {
+            it->first->handler(it->second);
+            delete it->first;
+        }
+        reaping_ = NULL;
+        completions.clear();
+    }
+}
+
+void IoUring::EventHandler(const error_code &error) {
+    if (error == boost::asio::error::operation_aborted) {
+        return;
+    }
+    uint64_t value;
+    system_calls_++;
+    ssize_t ret = read(event_fd_, &value, sizeof(value));
+    (void) ret;
+    Reap();
+    Submit();
+    AsyncWaitEvent();
+}
+
+#else
+
+struct IoUring::Sqe {
+};
+
+bool IoUring::Setup(unsigned entries) {
+    return false;
+}
+
+IoUring::Sqe *IoUring::GetSqeLocked() {
+    return NULL;
+}
+
+void IoUring::SubmitLocked() {
+}
+
+IoUring::OpId IoUring::Queue(uint8_t opcode, int fd, const void *addr,
+                             uint32_t len, int flags, Handler handler) {
+    return 0;
+}
+
+IoUring::OpId IoUring::QueueLocked(uint8_t opcode, int fd, const void *addr,
+                                   uint32_t len, int flags, Handler handler) {
+    return 0;
+}
+
+IoUring::OpId IoUring::Recv(int fd, void *data, size_t size,
+                            Handler handler) {
+    return 0;
+}
+
+IoUring::OpId IoUring::RecvMsg(int fd, struct msghdr *msg, Handler handler) {
+    return 0;
+}
+
+IoUring::OpId IoUring::SendMsg(int fd, const struct msghdr *msg, int flags,
+                               Handler handler) {
+    return 0;
+}
+
+IoUring::OpId IoUring::Accept(int fd, Handler handler) {
+    return 0;
+}
+
+void IoUring::Cancel(OpId id) {
+}
+
+void IoUring::Reap() {
+}
+
+void IoUring::EventHandler(const error_code &error) {
+}
+
+#endif
+
+const unsigned IoUring::kDefaultEntries;
+
+IoUring::IoUring(boost::asio::io_service *io_service)
+    : io_service_(io_service), ring_fd_(-1), event_fd_(-1),
+      sq_ring_(NULL), sq_ring_size_(0), cq_ring_(NULL), cq_ring_size_(0),
+      sqes_(NULL), sqes_size_(0), sq_head_(NULL), sq_tail_(NULL),
+      sq_mask_(0), sq_entries_(0), cq_head_(NULL), cq_tail_(NULL),
+      cq_mask_(0), cqes_(NULL), sq_pending_(0), submit_posted_(false),
+      next_id_(0) {
+    system_calls_ = 0;
+    operations_ = 0;
+    submit_errors_ = 0;
+}
+
+IoUring *IoUring::Create(boost::asio::io_service *io_service,
+                         unsigned entries) {
+    IoUring *ring = new IoUring(io_service);
+    if (!ring->Setup(entries)) {
+        delete ring;
+        return NULL;
+    }
+    ring->AsyncWaitEvent();
+    return ring;
+}
+
+// The pending operations are cancelled when the ring is closed. Their
+// handlers are not invoked, as they may queue new operations, but they are
+// released along with the references they hold.
+IoUring::~IoUring() {
+    if (event_) {
+        error_code ec;
+        event_->close(ec);
+    } else if (event_fd_ >= 0) {
+        close(event_fd_);
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+    }
+    STLDeleteElements(&pending_);
+}
+
+void IoUring::Submit() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    submit_posted_ = false;
+    SubmitLocked();
+}
+
+void IoUring::AsyncWaitEvent() {
+    event_->async_read_some(null_buffers(),
+        boost::bind(&IoUring::EventHandler, this,
+                    boost::asio::placeholders::error));
+}
+
+}  // namespace io
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#ifndef SRC_IO_IO_URING_H_
+#define SRC_IO_IO_URING_H_
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "base/util.h"
+
+namespace io {
+
+//
+// Socket operations through io_uring, serving the sockets of an io_service.
+//
+// Operations are queued in the submission queue by any thread and submitted
+// by the io thread, with a single system call for all the operations queued
+// since the previous submission, in particular the ones queued by the
+// completion handlers. Completions are signalled through an eventfd watched
+// by the io_service, the handlers run on the io_service.
+//
+// io_uring is only used when built with HAVE_IO_URING and supported by the
+// running kernel, Create returns NULL otherwise.
+//
+class IoUring {
+public:
+    static const unsigned kDefaultEntries = 1024;
+
+    // Invoked with the bytes transferred or the accepted descriptor, or a
+    // negated errno value.
+    typedef boost::function<void(int result)> Handler;
+    // Identifies a pending operation, to cancel it. Identifiers are not
+    // reused.
+    typedef uint64_t OpId;
+
+    static IoUring *Create(boost::asio::io_service *io_service,
+                           unsigned entries = kDefaultEntries);
+    ~IoUring();
+
+    // The buffers, message headers and addresses must remain valid until
+    // the handler is invoked. Return 0 without invoking the handler when the
+    // submission queue is full, the caller falls back to the boost::asio
+    // reactor.
+    OpId Recv(int fd, void *data, size_t size, Handler handler);
+    OpId RecvMsg(int fd, struct msghdr *msg, Handler handler);
+    OpId SendMsg(int fd, const struct msghdr *msg, int flags,
+                 Handler handler);
+    OpId Accept(int fd, Handler handler);
+
+    // Request the cancellation of a pending operation. Its handler is
+    // invoked with -ECANCELED, unless the operation completed already.
+    void Cancel(OpId id);
+
+    // Convert a negative result to an error code.
+    static boost::system::error_code ResultError(int result) {
+        return boost::system::error_code(-result,
+                                         boost::system::system_category());
+    }
+
+    boost::asio::io_service *io_service() const { return io_service_; }
+    // Number of system calls made to submit operations and reap their
+    // completions.
+    uint64_t system_calls() const { return system_calls_; }
+    uint64_t operations() const { return operations_; }
+    // Number of failed submissions, the entries are submitted again with
+    // the next ones.
+    uint64_t submit_errors() const { return submit_errors_; }
+
+private:
+    struct Operation;
+    struct Sqe;
+    typedef boost::unordered_map<OpId, Operation *> OperationMap;
+
+    explicit IoUring(boost::asio::io_service *io_service);
+    bool Setup(unsigned entries);
+    OpId Queue(uint8_t opcode, int fd, const void *addr, uint32_t len,
+               int flags, Handler handler);
+    OpId QueueLocked(uint8_t opcode, int fd, const void *addr, uint32_t len,
+                     int flags, Handler handler);
+    Sqe *GetSqeLocked();
+    void SubmitLocked();
+    void Submit();
+    void AsyncWaitEvent();
+    void EventHandler(const boost::system::error_code &error);
+    void Reap();
+
+    static __thread IoUring *reaping_;
+
+    boost::asio::io_service *io_service_;
+    int ring_fd_;
+    int event_fd_;
+    boost::scoped_ptr<boost::asio::posix::stream_descriptor> event_;
+
+    // Mappings of the rings and of the submission queue entries.
+    uint8_t *sq_ring_;
+    size_t sq_ring_size_;
+    uint8_t *cq_ring_;
+    size_t cq_ring_size_;
+    Sqe *sqes_;
+    size_t sqes_size_;
+
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    uint8_t *cqes_;
+
+    // Protects the submission queue and the pending operations.
+    tbb::mutex mutex_;
+    unsigned sq_pending_;
+    bool submit_posted_;
+    OpId next_id_;
+    OperationMap pending_;
+
+    tbb::atomic<uint64_t> system_calls_;
+    tbb::atomic<uint64_t> operations_;
+    tbb::atomic<uint64_t> submit_errors_;
+
+    DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+}  // namespace io
+
+#endif  // SRC_IO_IO_URING_H_
@@ -8,9 +8,12 @@
 #include "io/io_types.h"
 #include "io/io_utils.h"
 
+using std::string;
+
 namespace io {
 
-SocketStats::SocketStats() {
+template <typename CounterT>
+SocketStatsT<CounterT>::SocketStatsT() {
     read_calls = 0;
     read_bytes = 0;
     read_errors = 0;
@@ -25,42 +28,72 @@ SocketStats::SocketStats() {
     read_blocked_duration_usecs = 0;
 }
 
-void SocketStats::GetRxStats(SocketIOStats *socket_stats) const {
-    socket_stats->calls = read_calls;
-    socket_stats->bytes = read_bytes;
-    if (read_calls) {
-        socket_stats->average_bytes =
-            static_cast<double>(read_bytes / read_calls);
+// Read every counter only once, reading a ShardedCounter is not cheap.
+template <typename CounterT>
+void SocketStatsT<CounterT>::GetRxStats(SocketIOStats *socket_stats) const {
+    uint64_t calls = read_calls;
+    uint64_t bytes = read_bytes;
+    uint64_t blocked = read_blocked;
+    uint64_t blocked_duration_usecs = read_blocked_duration_usecs;
+    socket_stats->calls = calls;
+    socket_stats->bytes = bytes;
+    if (calls) {
+        socket_stats->average_bytes = static_cast<double>(bytes / calls);
     }
-    socket_stats->blocked_count = read_blocked;
+    socket_stats->blocked_count = blocked;
     socket_stats->blocked_duration = duration_usecs_to_string(
-        read_blocked_duration_usecs);
-    if (read_blocked) {
+        blocked_duration_usecs);
+    if (blocked) {
         socket_stats->average_blocked_duration =
-                 duration_usecs_to_string(
-                     read_blocked_duration_usecs/
-                     read_blocked);
+                 duration_usecs_to_string(blocked_duration_usecs / blocked);
     }
     socket_stats->errors = read_errors;
 }
 
-void SocketStats::GetTxStats(SocketIOStats *socket_stats) const {
-    socket_stats->calls = write_calls;
-    socket_stats->bytes = write_bytes;
-    if (write_calls) {
-        socket_stats->average_bytes =
-            static_cast<double>(write_bytes / write_calls);
+template <typename CounterT>
+void SocketStatsT<CounterT>::GetTxStats(SocketIOStats *socket_stats) const {
+    uint64_t calls = write_calls;
+    uint64_t bytes = write_bytes;
+    uint64_t blocked = write_blocked;
+    uint64_t blocked_duration_usecs = write_blocked_duration_usecs;
+    socket_stats->calls = calls;
+    socket_stats->bytes = bytes;
+    if (calls) {
+        socket_stats->average_bytes = static_cast<double>(bytes / calls);
     }
-    socket_stats->blocked_count = write_blocked;
+    socket_stats->blocked_count = blocked;
     socket_stats->blocked_duration = duration_usecs_to_string(
-        write_blocked_duration_usecs);
-    if (write_blocked) {
+        blocked_duration_usecs);
+    if (blocked) {
         socket_stats->average_blocked_duration =
-                 duration_usecs_to_string(
-                     write_blocked_duration_usecs/
-                     write_blocked);
+                 duration_usecs_to_string(blocked_duration_usecs / blocked);
     }
     socket_stats->errors = write_errors;
 }
 
+template <typename CounterT>
+void SocketStatsT<CounterT>::RegisterCounters(const string &prefix) const {
+    CounterRegistry *registry = CounterRegistry::GetInstance();
+    registry->Register(prefix + "read_calls", &read_calls);
+    registry->Register(prefix + "read_bytes", &read_bytes);
+    registry->Register(prefix + "read_errors", &read_errors);
+    registry->Register(prefix + "read_blocked", &read_blocked);
+    registry->Register(prefix + "read_blocked_duration_usecs",
+                       &read_blocked_duration_usecs);
+    registry->Register(prefix + "write_calls", &write_calls);
+    registry->Register(prefix + "write_bytes", &write_bytes);
+    registry->Register(prefix + "write_errors", &write_errors);
+    registry->Register(prefix + "write_blocked", &write_blocked);
+    registry->Register(prefix + "write_blocked_duration_usecs",
+                       &write_blocked_duration_usecs);
+}
+
+template <typename CounterT>
+void SocketStatsT<CounterT>::UnregisterCounters(const string &prefix) const {
+    CounterRegistry::GetInstance()->UnregisterPrefix(prefix);
+}
+
+template struct SocketStatsT<tbb::atomic<uint64_t> >;
+template struct SocketStatsT<ShardedCounter>;
+
 }  // namespace io
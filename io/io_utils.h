@@ -5,32 +5,51 @@
 #ifndef SRC_IO_IO_UTILS_H_
 #define SRC_IO_IO_UTILS_H_
 
+#include <string>
+
 #include <tbb/atomic.h>
 
+#include "base/sharded_counter.h"
+
 class SocketIOStats;
 
 namespace io {
 
-struct SocketStats {
-    SocketStats();
+//
+// Socket statistics of a session or a server. The statistics of a server
+// are updated by all of its sessions, so they use ShardedCounter to avoid
+// contention on the counters.
+//
+template <typename CounterT>
+struct SocketStatsT {
+    SocketStatsT();
 
     void GetRxStats(SocketIOStats *socket_stats) const;
     void GetTxStats(SocketIOStats *socket_stats) const;
 
-    tbb::atomic<uint64_t> read_calls;
-    tbb::atomic<uint64_t> read_bytes;
-    tbb::atomic<uint64_t> read_errors;
-    tbb::atomic<uint64_t> write_calls;
-    tbb::atomic<uint64_t> write_bytes;
-    tbb::atomic<uint64_t> write_errors;
+    // Register the counters with the CounterRegistry, using prefix for the
+    // counter names.
+    void RegisterCounters(const std::string &prefix) const;
+    void UnregisterCounters(const std::string &prefix) const;
+
+    CounterT read_calls;
+    CounterT read_bytes;
+    CounterT read_errors;
+    CounterT write_calls;
+    CounterT write_bytes;
+    CounterT write_errors;
+    // Timestamps, not sums.
     tbb::atomic<uint64_t> write_block_start_time;
-    tbb::atomic<uint64_t> write_blocked;
-    tbb::atomic<uint64_t> write_blocked_duration_usecs;
+    CounterT write_blocked;
+    CounterT write_blocked_duration_usecs;
     tbb::atomic<uint64_t> read_block_start_time;
-    tbb::atomic<uint64_t> read_blocked;
-    tbb::atomic<uint64_t> read_blocked_duration_usecs;
+    CounterT read_blocked;
+    CounterT read_blocked_duration_usecs;
 };
 
+typedef SocketStatsT<tbb::atomic<uint64_t> > SocketStats;
+typedef SocketStatsT<ShardedCounter> ServerSocketStats;
+
 }  // namespace io
 
 #endif  // SRC_IO_IO_UTILS_H_
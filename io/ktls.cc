@@ -0,0 +1,338 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#include "io/ktls.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#if defined(HAVE_KTLS) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define KTLS_SUPPORTED
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+using std::string;
+using std::vector;
+
+namespace io {
+
+#ifdef KTLS_SUPPORTED
+
+namespace {
+
+// Key, salt and initial nonce of AES-GCM records.
+struct RecordKeys {
+    RecordKeys() : key_size(0) {
+    }
+
+    size_t key_size;
+    uint8_t key[32];
+    uint8_t iv[12];
+};
+
+bool HexDecode(const char *hex, size_t len, vector<uint8_t> *data) {
+    if (len % 2 != 0) {
+        return false;
+    }
+    data->clear();
+    for (size_t i = 0; i < len; i += 2) {
+        unsigned int byte;
+        if (sscanf(hex + i, "%2x", &byte) != 1) {
+            return false;
+        }
+        data->push_back(byte);
+    }
+    return true;
+}
+
+// HKDF-Expand-Label of RFC 8446, with an empty context.
+bool HkdfExpandLabel(const EVP_MD *md, const vector<uint8_t> &secret,
+                     const string &label, uint8_t *out, size_t len) {
+    string full_label = "tls13 " + label;
+    vector<uint8_t> info;
+    info.push_back(len >> 8);
+    info.push_back(len & 0xff);
+    info.push_back(full_label.size());
+    info.insert(info.end(), full_label.begin(), full_label.end());
+    info.push_back(0);
+
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+    bool success = pctx != NULL &&
+        EVP_PKEY_derive_init(pctx) > 0 &&
+        EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+        EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+        EVP_PKEY_CTX_set1_hkdf_key(pctx, &secret[0], secret.size()) > 0 &&
+        EVP_PKEY_CTX_add1_hkdf_info(pctx, &info[0], info.size()) > 0 &&
+        EVP_PKEY_derive(pctx, out, &len) > 0;
+    EVP_PKEY_CTX_free(pctx);
+    return success;
+}
+
+// Key block of TLS 1.2, the client and server keys followed by the client
+// and server implicit nonces of AES-GCM.
+bool Tls12KeyBlock(const EVP_MD *md, SSL *ssl, uint8_t *out, size_t len) {
+    uint8_t master[SSL_MAX_MASTER_KEY_LENGTH];
+    size_t master_len = SSL_SESSION_get_master_key(SSL_get_session(ssl),
+                                                   master, sizeof(master));
+    uint8_t client_random[SSL3_RANDOM_SIZE];
+    uint8_t server_random[SSL3_RANDOM_SIZE];
+    SSL_get_client_random(ssl, client_random, sizeof(client_random));
+    SSL_get_server_random(ssl, server_random, sizeof(server_random));
+    static const unsigned char kLabel[] = "key expansion";
+
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, NULL);
+    bool success = pctx != NULL &&
+        EVP_PKEY_derive_init(pctx) > 0 &&
+        EVP_PKEY_CTX_set_tls1_prf_md(pctx, md) > 0 &&
+        EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, master, master_len) > 0 &&
+        EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, kLabel,
+                                        sizeof(kLabel) - 1) > 0 &&
+        EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, server_random,
+                                        sizeof(server_random)) > 0 &&
+        EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, client_random,
+                                        sizeof(client_random)) > 0 &&
+        EVP_PKEY_derive(pctx, out, &len) > 0;
+    EVP_PKEY_CTX_free(pctx);
+    OPENSSL_cleanse(master, sizeof(master));
+    return success;
+}
+
+template <typename CryptoInfo>
+bool SetSocketCryptoInfo(int fd, int optname, int version, int cipher_type,
+                         const RecordKeys &keys, uint64_t sequence) {
+    CryptoInfo info;
+    memset(&info, 0, sizeof(info));
+    info.info.version = version;
+    info.info.cipher_type = cipher_type;
+    memcpy(info.key, keys.key, sizeof(info.key));
+    memcpy(info.salt, keys.iv, sizeof(info.salt));
+    for (size_t i = 0; i < sizeof(info.rec_seq); ++i) {
+        info.rec_seq[i] = sequence >> (8 * (sizeof(info.rec_seq) - 1 - i));
+    }
+    if (version == TLS_1_2_VERSION) {
+        // The explicit nonce of the records, starting with the sequence
+        // number like OpenSSL.
+        memcpy(info.iv, info.rec_seq, sizeof(info.iv));
+    } else {
+        memcpy(info.iv, keys.iv + sizeof(info.salt), sizeof(info.iv));
+    }
+    int result = setsockopt(fd, SOL_TLS, optname, &info, sizeof(info));
+    OPENSSL_cleanse(&info, sizeof(info));
+    return result == 0;
+}
+
+}  // namespace
+
+#endif  // KTLS_SUPPORTED
+
+int Ktls::ktls_index_ = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+
+Ktls::Ktls(SSL *ssl) : ssl_(ssl) {
+    sequence_[READ] = 0;
+    sequence_[WRITE] = 0;
+#ifdef KTLS_SUPPORTED
+    SSL_set_ex_data(ssl_, ktls_index_, this);
+    SSL_set_msg_callback(ssl_, &Ktls::MessageCallback);
+    SSL_set_msg_callback_arg(ssl_, this);
+#endif
+}
+
+Ktls::~Ktls() {
+    if (!client_secret_.empty()) {
+        OPENSSL_cleanse(&client_secret_[0], client_secret_.size());
+    }
+    if (!server_secret_.empty()) {
+        OPENSSL_cleanse(&server_secret_[0], server_secret_.size());
+    }
+}
+
+void Ktls::EnableContext(SSL_CTX *ctx) {
+#ifdef KTLS_SUPPORTED
+    // Renegotiation would change the keys of the offloaded connection.
+    SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION);
+    SSL_CTX_set_keylog_callback(ctx, &Ktls::KeyLogCallback);
+#endif
+}
+
+const char *Ktls::ModeName(Mode mode) {
+    switch (mode) {
+    case TX:
+        return "tx";
+    case TX_RX:
+        return "tx-rx";
+    default:
+        return "none";
+    }
+}
+
+#ifdef KTLS_SUPPORTED
+
+// Keep the TLS 1.3 application traffic secrets, the lines are
+// "<label> <client random> <secret>" in hex.
+void Ktls::KeyLogCallback(const SSL *ssl, const char *line) {
+    Ktls *ktls = static_cast<Ktls *>(SSL_get_ex_data(ssl, ktls_index_));
+    if (ktls == NULL) {
+        return;
+    }
+    static const char kClientSecret[] = "CLIENT_TRAFFIC_SECRET_0 ";
+    static const char kServerSecret[] = "SERVER_TRAFFIC_SECRET_0 ";
+    vector<uint8_t> *secret;
+    if (strncmp(line, kClientSecret, sizeof(kClientSecret) - 1) == 0) {
+        secret = &ktls->client_secret_;
+    } else if (strncmp(line, kServerSecret, sizeof(kServerSecret) - 1) == 0) {
+        secret = &ktls->server_secret_;
+    } else {
+        return;
+    }
+    const char *hex = strrchr(line, ' ');
+    if (!HexDecode(hex + 1, strlen(hex + 1), secret)) {
+        secret->clear();
+    }
+}
+
+//
+// Count the records of each direction, restarting from 0 when the keys
+// change: after the ChangeCipherSpec record with TLS 1.2, and after the
+// Finished message with TLS 1.3. The record header is reported before the
+// messages it carries, OpenSSL does not report the ChangeCipherSpec
+// messages it reads.
+//
+void Ktls::MessageCallback(int write_p, int version, int content_type,
+                           const void *buf, size_t len, SSL *ssl,
+                           void *arg) {
+    Ktls *ktls = static_cast<Ktls *>(arg);
+    Direction direction = write_p ? WRITE : READ;
+    const uint8_t *data = static_cast<const uint8_t *>(buf);
+    switch (content_type) {
+    case SSL3_RT_HEADER:
+        if (data[0] == SSL3_RT_CHANGE_CIPHER_SPEC &&
+            SSL_version(ssl) != TLS1_3_VERSION) {
+            ktls->sequence_[direction] = 0;
+        } else {
+            ktls->sequence_[direction]++;
+        }
+        break;
+    case SSL3_RT_HANDSHAKE:
+        if (SSL_version(ssl) == TLS1_3_VERSION && len > 0 &&
+            data[0] == SSL3_MT_FINISHED) {
+            ktls->sequence_[direction] = 0;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+bool Ktls::SetCryptoInfo(int fd, Direction direction) {
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl_);
+    const EVP_MD *md = SSL_CIPHER_get_handshake_digest(cipher);
+    int cipher_type;
+    RecordKeys keys;
+    switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+    case NID_aes_128_gcm:
+        cipher_type = TLS_CIPHER_AES_GCM_128;
+        keys.key_size = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+        break;
+    case NID_aes_256_gcm:
+        cipher_type = TLS_CIPHER_AES_GCM_256;
+        keys.key_size = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+        break;
+    default:
+        return false;
+    }
+    if (md == NULL) {
+        return false;
+    }
+
+    // Keys of the data written by this end or by the peer.
+    bool client_keys = (direction == WRITE) == !SSL_is_server(ssl_);
+    int version;
+    if (SSL_version(ssl_) == TLS1_2_VERSION) {
+        version = TLS_1_2_VERSION;
+        static const size_t kFixedIvSize = 4;
+        uint8_t key_block[2 * (32 + kFixedIvSize)];
+        size_t key_block_size = 2 * (keys.key_size + kFixedIvSize);
+        if (!Tls12KeyBlock(md, ssl_, key_block, key_block_size)) {
+            return false;
+        }
+        size_t key_offset = client_keys ? 0 : keys.key_size;
+        size_t iv_offset = 2 * keys.key_size +
+            (client_keys ? 0 : kFixedIvSize);
+        memcpy(keys.key, key_block + key_offset, keys.key_size);
+        memcpy(keys.iv, key_block + iv_offset, kFixedIvSize);
+        OPENSSL_cleanse(key_block, sizeof(key_block));
+#ifdef TLS_1_3_VERSION
+    } else if (SSL_version(ssl_) == TLS1_3_VERSION) {
+        version = TLS_1_3_VERSION;
+        const vector<uint8_t> &secret =
+            client_keys ? client_secret_ : server_secret_;
+        if (secret.empty() ||
+            !HkdfExpandLabel(md, secret, "key", keys.key, keys.key_size) ||
+            !HkdfExpandLabel(md, secret, "iv", keys.iv, sizeof(keys.iv))) {
+            return false;
+        }
+#endif
+    } else {
+        return false;
+    }
+
+    int optname = direction == WRITE ? TLS_TX : TLS_RX;
+    bool success;
+    if (cipher_type == TLS_CIPHER_AES_GCM_128) {
+        success = SetSocketCryptoInfo<tls12_crypto_info_aes_gcm_128>(fd,
+            optname, version, cipher_type, keys, sequence_[direction]);
+    } else {
+        success = SetSocketCryptoInfo<tls12_crypto_info_aes_gcm_256>(fd,
+            optname, version, cipher_type, keys, sequence_[direction]);
+    }
+    OPENSSL_cleanse(&keys, sizeof(keys));
+    return success;
+}
+
+Ktls::Mode Ktls::Enable(int fd) {
+    // All the handshake data must have been written to the socket.
+    if (BIO_wpending(SSL_get_wbio(ssl_)) != 0) {
+        return NONE;
+    }
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+        return NONE;
+    }
+    if (!SetCryptoInfo(fd, WRITE)) {
+        // The socket is left with the tls ULP and without keys, in which
+        // state it keeps working as a plain TCP socket.
+        return NONE;
+    }
+    bool receive = SSL_pending(ssl_) == 0 &&
+        BIO_pending(SSL_get_rbio(ssl_)) == 0 &&
+        (SSL_is_server(ssl_) || SSL_version(ssl_) != TLS1_3_VERSION);
+    if (!receive || !SetCryptoInfo(fd, READ)) {
+        return TX;
+    }
+    return TX_RX;
+}
+
+#else  // KTLS_SUPPORTED
+
+bool Ktls::SetCryptoInfo(int fd, Direction direction) {
+    return false;
+}
+
+Ktls::Mode Ktls::Enable(int fd) {
+    return NONE;
+}
+
+#endif  // KTLS_SUPPORTED
+
+}  // namespace io
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+//
+
+#ifndef SRC_IO_KTLS_H_
+#define SRC_IO_KTLS_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include "base/util.h"
+
+namespace io {
+
+//
+// Switch an established TLS connection to kernel TLS, so that the socket
+// encrypts the data written and decrypts the data read in place of OpenSSL.
+//
+// The record keys are derived from the secrets of the handshake, captured
+// through the key log callback of the context with TLS 1.3, and the record
+// sequence numbers are tracked by counting the records of the handshake.
+// Only AES-GCM cipher suites are offloaded.
+//
+// kTLS is only used when built with HAVE_KTLS and supported by the running
+// kernel, Enable returns NONE otherwise and the connection stays on OpenSSL.
+//
+class Ktls {
+public:
+    enum Mode {
+        NONE,
+        TX,
+        TX_RX,
+    };
+
+    // Install the callbacks tracking the handshake of the ssl connection,
+    // before the handshake.
+    explicit Ktls(SSL *ssl);
+    ~Ktls();
+
+    // Set up the context of the connections for kTLS.
+    static void EnableContext(SSL_CTX *ctx);
+
+    // Switch the socket to kTLS once the handshake is complete, for the
+    // directions that can be offloaded. The receive direction is kept on
+    // OpenSSL when it holds data read from the socket, and on TLS 1.3
+    // clients, which receive session tickets after the handshake.
+    Mode Enable(int fd);
+
+    static const char *ModeName(Mode mode);
+
+private:
+    enum Direction {
+        READ,
+        WRITE,
+    };
+
+    static void KeyLogCallback(const SSL *ssl, const char *line);
+    static void MessageCallback(int write_p, int version, int content_type,
+                                const void *buf, size_t len, SSL *ssl,
+                                void *arg);
+    bool SetCryptoInfo(int fd, Direction direction);
+
+    static int ktls_index_;
+
+    SSL *ssl_;
+    // Number of records in each direction since the last key change.
+    uint64_t sequence_[2];
+    // TLS 1.3 application traffic secrets of the client and the server.
+    std::vector<uint8_t> client_secret_;
+    std::vector<uint8_t> server_secret_;
+
+    DISALLOW_COPY_AND_ASSIGN(Ktls);
+};
+
+}  // namespace io
+
+#endif  // SRC_IO_KTLS_H_
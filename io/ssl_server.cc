@@ -2,6 +2,8 @@
  * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <sstream>
+
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 
@@ -11,11 +13,32 @@
 #include "io/event_manager.h"
 #include "io/io_utils.h"
 #include "io/io_log.h"
+#include "io/ktls.h"
+
+namespace {
+
+// The remote endpoint of the session is only set once it is established.
+std::string SessionCacheKey(SslSession *session) {
+    boost::system::error_code ec;
+    std::ostringstream key;
+    key << session->socket()->remote_endpoint(ec);
+    return key.str();
+}
+
+}  // namespace
+
+const size_t SslServer::kDefaultSessionCacheSize;
+const long SslServer::kDefaultSessionLifetime;
+int SslServer::ssl_session_index_ =
+    SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
 
 SslServer::SslServer(EventManager *evm, boost::asio::ssl::context::method m,
                      bool ssl_enabled, bool ssl_handshake_delayed)
     : TcpServer(evm), context_(*evm->io_service(), m),
-      ssl_enabled_(ssl_enabled), ssl_handshake_delayed_(ssl_handshake_delayed) {
+      ssl_enabled_(ssl_enabled), ssl_handshake_delayed_(ssl_handshake_delayed),
+      ktls_enabled_(false), session_cache_size_(0) {
+    handshakes_ = 0;
+    resumed_handshakes_ = 0;
     boost::system::error_code ec;
     // By default set verify mode to none, to be set by derived class later.
     context_.set_verify_mode(boost::asio::ssl::context::verify_none, ec);
@@ -35,23 +58,125 @@ SslServer::SslServer(EventManager *evm, boost::asio::ssl::context::method m,
 }
 
 SslServer::~SslServer() {
+    STLDeleteValues(&so_ssl_accept_);
+    for (ClientSessionMap::iterator it = client_sessions_.begin();
+         it != client_sessions_.end(); ++it) {
+        SSL_SESSION_free(it->second.ssl_session);
+    }
+}
+
+void SslServer::EnableSessionCache(size_t size, long lifetime) {
+    SSL_CTX *ctx = context_.native_handle();
+    // Resumption is refused without a session id context when the peer
+    // certificate is verified.
+    static const unsigned char kSessionIdContext[] = "contrail";
+    SSL_CTX_set_session_id_context(ctx, kSessionIdContext,
+                                   sizeof(kSessionIdContext) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+    SSL_CTX_sess_set_cache_size(ctx, size);
+    SSL_CTX_set_timeout(ctx, lifetime);
+    SSL_CTX_sess_set_new_cb(ctx, &SslServer::NewSessionCallback);
+    tbb::mutex::scoped_lock lock(session_cache_mutex_);
+    session_cache_size_ = size;
+}
+
+void SslServer::EnableKtls() {
+    io::Ktls::EnableContext(context_.native_handle());
+    ktls_enabled_ = true;
+}
+
+void SslServer::SetClientSession(SslSession *session) {
+    SSL *ssl = session->ssl_socket_->native_handle();
+    SSL_set_ex_data(ssl, ssl_session_index_, session);
+    tbb::mutex::scoped_lock lock(session_cache_mutex_);
+    if (session_cache_size_ == 0) {
+        return;
+    }
+    ClientSessionMap::iterator it =
+        client_sessions_.find(SessionCacheKey(session));
+    if (it != client_sessions_.end()) {
+        SSL_set_session(ssl, it->second.ssl_session);
+    }
+}
+
+// Invoked by OpenSSL when a client receives a new session, which is kept to
+// be resumed by the next connection to the same remote endpoint. With TLS
+// 1.3 the sessions are only received after the handshake.
+//
+// OpenSSL no longer resumes the session of a connection closed without a
+// TLS shutdown, which is how the sessions are closed. A copy of the session
+// is cached when supported. The oldest session is evicted when the cache is
+// full.
+int SslServer::NewSessionCallback(SSL *ssl, SSL_SESSION *ssl_session) {
+    SslSession *session =
+        static_cast<SslSession *>(SSL_get_ex_data(ssl, ssl_session_index_));
+    if (SSL_is_server(ssl) || session == NULL) {
+        return 0;
+    }
+    SslServer *server = static_cast<SslServer *>(session->server());
+    std::string key = SessionCacheKey(session);
+    tbb::mutex::scoped_lock lock(server->session_cache_mutex_);
+    if (server->session_cache_size_ == 0) {
+        return 0;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    SSL_SESSION *cached = SSL_SESSION_dup(ssl_session);
+    int owned = 0;
+    if (cached == NULL) {
+        return 0;
+    }
+#else
+    SSL_SESSION *cached = ssl_session;
+    int owned = 1;
+#endif
+    ClientSessionMap::iterator it = server->client_sessions_.find(key);
+    if (it != server->client_sessions_.end()) {
+        SSL_SESSION_free(it->second.ssl_session);
+        it->second.ssl_session = cached;
+        server->client_session_order_.splice(
+            server->client_session_order_.end(),
+            server->client_session_order_, it->second.order);
+        return owned;
+    }
+    if (server->client_sessions_.size() >= server->session_cache_size_) {
+        ClientSessionMap::iterator oldest =
+            server->client_sessions_.find(
+                server->client_session_order_.front());
+        SSL_SESSION_free(oldest->second.ssl_session);
+        server->client_sessions_.erase(oldest);
+        server->client_session_order_.pop_front();
+    }
+    CachedSession entry;
+    entry.ssl_session = cached;
+    entry.order = server->client_session_order_.insert(
+        server->client_session_order_.end(), key);
+    server->client_sessions_.insert(std::make_pair(key, entry));
+    return owned;
+}
+
+void SslServer::HandshakeComplete(SslSession *session) {
+    session->EnableKtls();
+    handshakes_++;
+    if (SSL_session_reused(session->ssl_socket_->native_handle())) {
+        resumed_handshakes_++;
+    }
 }
 
 boost::asio::ssl::context *SslServer::context() {
     return &context_;
 }
 
-TcpSession *SslServer::AllocSession(bool server_session) {
+TcpSession *SslServer::AllocSession(bool server_session, size_t index) {
     SslSession *session;
     if (server_session) {
-        session = AllocSession(so_ssl_accept_.get());
+        session = AllocSession(so_ssl_accept_[index]);
 
         // if session allocate succeeds release ownership to so_accept.
         if (session != NULL) {
-            so_ssl_accept_.release();
+            so_ssl_accept_[index] = NULL;
         }
     } else {
-        SslSocket *socket = new SslSocket(*event_manager()->io_service(),
+        SslSocket *socket = new SslSocket(*event_manager()->NextIoService(),
                                           context_);
         session = AllocSession(socket);
     }
@@ -83,6 +208,7 @@ void SslServer::AcceptHandShakeHandler(TcpServerPtr server,
     ssl_session->ssl_handshake_in_progress_ = false;
     if (!error) {
         // on successful handshake continue with tcp server state machine.
+        ssl_server->HandshakeComplete(ssl_session);
         ssl_session->SetSslHandShakeSuccess();
         ssl_server->TcpServer::AcceptHandlerComplete(session);
     } else {
@@ -105,6 +231,7 @@ void SslServer::ConnectHandlerComplete(TcpSessionPtr session) {
         // trigger ssl client handshake
         std::srand(static_cast<unsigned>(std::time(0)));
         ssl->ssl_handshake_in_progress_ = true;
+        SetClientSession(ssl);
         ssl->ssl_socket_->async_handshake
             (boost::asio::ssl::stream_base::client,
              boost::bind(&SslServer::ConnectHandShakeHandler,
@@ -120,6 +247,7 @@ void SslServer::ConnectHandShakeHandler(TcpServerPtr server,
     ssl_session->ssl_handshake_in_progress_ = false;
     if (!error) {
         // on successful handshake continue with tcp server state machine.
+        ssl_server->HandshakeComplete(ssl_session);
         ssl_session->SetSslHandShakeSuccess();
         ssl_server->TcpServer::ConnectHandlerComplete(session);
     } else {
@@ -135,12 +263,16 @@ void SslServer::ConnectHandShakeHandler(TcpServerPtr server,
     }
 }
 
-TcpServer::Socket *SslServer::accept_socket() const {
+TcpServer::Socket *SslServer::accept_socket(size_t index) const {
     // return tcp socket
-    return &(so_ssl_accept_->next_layer());
+    return &(so_ssl_accept_[index]->next_layer());
 }
 
-void SslServer::set_accept_socket() {
-    so_ssl_accept_.reset(new SslSocket(*event_manager()->io_service(),
-                                       context_));
+void SslServer::set_accept_socket(size_t index) {
+    if (index >= so_ssl_accept_.size()) {
+        so_ssl_accept_.resize(index + 1);
+    }
+    delete so_ssl_accept_[index];
+    so_ssl_accept_[index] = new SslSocket(*event_manager()->NextIoService(),
+                                          context_);
 }
@@ -5,6 +5,13 @@
 #ifndef SRC_IO_SSL_SERVER_H_
 #define SRC_IO_SSL_SERVER_H_
 
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
 #include <boost/asio/ssl.hpp>
 
 #include "io/tcp_server.h"
@@ -20,6 +27,25 @@ public:
                        bool ssl_handshake_delayed = false);
     virtual ~SslServer();
 
+    static const size_t kDefaultSessionCacheSize = 1024;
+    static const long kDefaultSessionLifetime = 3600;
+
+    // Cache the TLS sessions for lifetime seconds, so that peers reconnecting
+    // in the meantime resume them with an abbreviated handshake. Accepted
+    // sessions are resumed by session id or ticket, the sessions of the
+    // connections made by the server are kept per remote endpoint.
+    void EnableSessionCache(size_t size = kDefaultSessionCacheSize,
+                            long lifetime = kDefaultSessionLifetime);
+
+    // Switch the established sessions to kernel TLS when supported by the
+    // kernel and the negotiated cipher, the sessions otherwise stay on
+    // OpenSSL. Applies to the sessions created afterwards.
+    void EnableKtls();
+
+    // Number of successful handshakes, and of those resuming a session.
+    uint64_t handshakes() const { return handshakes_; }
+    uint64_t resumed_handshakes() const { return resumed_handshakes_; }
+
 protected:
     // given SSL socket, Create a session object.
     virtual SslSession *AllocSession(SslSocket *socket) = 0;
@@ -41,7 +67,7 @@ private:
     // ssl server.
     TcpSession *AllocSession(Socket *socket) { return NULL; }
 
-    TcpSession *AllocSession(bool server_session);
+    TcpSession *AllocSession(bool server_session, size_t index);
 
     // override accept complete handler to trigger handshake
     virtual void AcceptHandlerComplete(TcpSessionPtr session);
@@ -49,13 +75,40 @@ private:
     // override connect complete handler to trigger handshake
     void ConnectHandlerComplete(TcpSessionPtr session);
 
-    Socket *accept_socket() const;
-    void set_accept_socket();
+    Socket *accept_socket(size_t index) const;
+    void set_accept_socket(size_t index);
+
+    // The cached sessions are evicted in the order they were received.
+    typedef std::list<std::string> ClientSessionList;
+    struct CachedSession {
+        SSL_SESSION *ssl_session;
+        ClientSessionList::iterator order;
+    };
+    typedef std::map<std::string, CachedSession> ClientSessionMap;
+
+    // Offer the cached session of the remote endpoint in the client
+    // handshake of the session.
+    void SetClientSession(SslSession *session);
+    static int NewSessionCallback(SSL *ssl, SSL_SESSION *ssl_session);
+    void HandshakeComplete(SslSession *session);
 
     boost::asio::ssl::context context_;
-    std::auto_ptr<SslSocket> so_ssl_accept_;  // SSL socket used in async_accept
+    // SSL sockets used in async_accept
+    std::vector<SslSocket *> so_ssl_accept_;
     bool ssl_enabled_;
     bool ssl_handshake_delayed_;
+    bool ktls_enabled_;
+
+    // Index of the SslSession in the ex data of the SSL of the connections.
+    static int ssl_session_index_;
+    // Maximum number of cached client sessions, 0 if the cache is disabled.
+    size_t session_cache_size_;
+    tbb::mutex session_cache_mutex_;
+    ClientSessionMap client_sessions_;
+    ClientSessionList client_session_order_;
+    tbb::atomic<uint64_t> handshakes_;
+    tbb::atomic<uint64_t> resumed_handshakes_;
+
     DISALLOW_COPY_AND_ASSIGN(SslServer);
 };
 
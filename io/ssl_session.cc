@@ -4,7 +4,10 @@
 
 #include "io/ssl_session.h"
 
+#include <string.h>
+
 #include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
@@ -16,6 +19,8 @@
 using boost::asio::async_write;
 using boost::asio::buffer;
 using boost::asio::buffer_cast;
+using boost::asio::buffer_size;
+using boost::asio::const_buffer;
 using boost::asio::mutable_buffer;
 using boost::asio::mutable_buffers_1;
 using boost::asio::null_buffers;
@@ -30,6 +35,8 @@ using std::srand;
 using std::string;
 using std::time;
 
+const size_t SslSession::kMaxRecordSize;
+
 class SslSession::SslReader : public Task {
 public:
     typedef function<void(Buffer)> ReadHandler;
@@ -72,13 +79,22 @@ SslSession::SslSession(SslServer *server, SslSocket *ssl_socket,
       ssl_socket_(ssl_socket),
       ssl_handshake_in_progress_(false),
       ssl_handshake_success_(false),
+      ktls_mode_(io::Ktls::NONE),
       ssl_enabled_(true),
       ssl_handshake_delayed_(false),
+      coalesce_writes_(true),
       ssl_last_read_len_(0) {
 
     if (server) {
         ssl_enabled_ = server->ssl_enabled_;
         ssl_handshake_delayed_ = server->ssl_handshake_delayed_;
+        if (ssl_socket) {
+            io_strand_.reset(
+                new Strand(*EventManager::GetIoService(ssl_socket)));
+            if (server->ktls_enabled_) {
+                ktls_.reset(new io::Ktls(ssl_socket->native_handle()));
+            }
+        }
     }
 }
 
@@ -106,7 +122,7 @@ TcpSession::Socket *SslSession::socket() const {
 // socket, as appropriate.
 void SslSession::AsyncReadSome() {
     if (established()) {
-        if (ssl_last_read_len_ == 0) {
+        if (ssl_last_read_len_ == 0 || ktls_mode_ == io::Ktls::TX_RX) {
             // we have drained the read buffer of the socket
             // register for a read notification from the tcp socket
             TcpSession::AsyncReadSome();
@@ -143,19 +159,74 @@ bool SslSession::IsSocketErrorHard(const error_code &ec) {
 size_t SslSession::ReadSome(mutable_buffer buffer, error_code *error) {
     // Read data from the tcp socket or from the ssl socket, as appropriate.
     assert(!ssl_handshake_in_progress_);
-    if (!IsSslHandShakeSuccessLocked())
+    if (!IsSslHandShakeSuccessLocked() || ktls_mode_ == io::Ktls::TX_RX)
         return TcpSession::ReadSome(buffer, error);
 
     return ssl_socket_->read_some(mutable_buffers_1(buffer), *error);
 }
 
-void SslSession::AsyncWrite(const uint8_t *data, size_t size) {
-    if (IsSslHandShakeSuccessLocked()) {
-        async_write(*ssl_socket_.get(), buffer(data, size),
+void SslSession::AsyncWrite(const std::vector<const_buffer> &buffers) {
+    // The kernel encrypts the data written to the socket with kTLS, which
+    // keeps the scatter-gather writes.
+    if (!IsSslHandShakeSuccessLocked() || ktls_mode_ != io::Ktls::NONE) {
+        return (TcpSession::AsyncWrite(buffers));
+    }
+    if (coalesce_writes_ && buffers.size() > 1) {
+        CoalesceBuffers(buffers);
+        async_write(*ssl_socket_.get(), record_buffers_,
             bind(&TcpSession::AsyncWriteHandler,
                  TcpSessionPtr(this), error, bytes_transferred));
     } else {
-        return (TcpSession::AsyncWrite(data, size));
+        async_write(*ssl_socket_.get(), buffers,
+            bind(&TcpSession::AsyncWriteHandler,
+                 TcpSessionPtr(this), error, bytes_transferred));
+    }
+}
+
+//
+// Copy the consecutive buffers smaller than a record into record_data_, the
+// larger ones are written in place. The ssl stream splits the coalesced
+// data into full size records.
+//
+void SslSession::CoalesceBuffers(const std::vector<const_buffer> &buffers) {
+    size_t copy_size = 0;
+    for (std::vector<const_buffer>::const_iterator it = buffers.begin();
+         it != buffers.end(); ++it) {
+        if (buffer_size(*it) < kMaxRecordSize) {
+            copy_size += buffer_size(*it);
+        }
+    }
+    record_data_.resize(copy_size);
+    record_buffers_.clear();
+
+    size_t start = 0, offset = 0;
+    for (std::vector<const_buffer>::const_iterator it = buffers.begin();
+         it != buffers.end(); ++it) {
+        size_t size = buffer_size(*it);
+        if (size >= kMaxRecordSize) {
+            if (offset > start) {
+                record_buffers_.push_back(
+                    const_buffer(&record_data_[start], offset - start));
+                start = offset;
+            }
+            record_buffers_.push_back(*it);
+            continue;
+        }
+        memcpy(&record_data_[offset], buffer_cast<const uint8_t *>(*it), size);
+        offset += size;
+    }
+    if (offset > start) {
+        record_buffers_.push_back(
+            const_buffer(&record_data_[start], offset - start));
+    }
+}
+
+// Switch the socket to kernel TLS, before the session is marked as
+// successfully handshaked and uses the socket for the data.
+void SslSession::EnableKtls() {
+    if (ktls_) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        ktls_mode_ = ktls_->Enable(socket()->native_handle());
     }
 }
 
@@ -164,6 +235,10 @@ void SslSession::SslHandShakeCallback(SslHandShakeCallbackHandler cb,
                                       const error_code &error) {
     session->ssl_handshake_in_progress_ = false;
     if (!error) {
+        if (session->server()) {
+            static_cast<SslServer *>(session->server())->HandshakeComplete(
+                session.get());
+        }
         session->SetSslHandShakeSuccess();
     } else {
         session->SetSslHandShakeFailure();
@@ -184,6 +259,10 @@ void SslSession::TriggerSslHandShakeInternal(
             bind(&SslSession::SslHandShakeCallback, cb, session,
             error));
     } else {
+        if (session->server()) {
+            static_cast<SslServer *>(session->server())->SetClientSession(
+                session.get());
+        }
         session->ssl_socket_->async_handshake(stream_base::client,
             bind(&SslSession::SslHandShakeCallback, cb, session,
                  error));
@@ -191,6 +270,6 @@ void SslSession::TriggerSslHandShakeInternal(
 }
 
 void SslSession::TriggerSslHandShake(SslHandShakeCallbackHandler cb) {
-    server()->event_manager()->io_service()->post(
+    EventManager::GetIoService(ssl_socket_.get())->post(
         bind(&TriggerSslHandShakeInternal, SslSessionPtr(this), cb));
 }
@@ -5,6 +5,7 @@
 #ifndef SRC_IO_SSL_SESSION_H_
 #define SRC_IO_SSL_SESSION_H_
 
+#include "io/ktls.h"
 #include "io/tcp_session.h"
 #include "io/ssl_server.h"
 
@@ -17,6 +18,9 @@ class SslSession : public TcpSession {
 public:
     typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> SslSocket;
 
+    // Maximum size of the data of a TLS record.
+    static const size_t kMaxRecordSize = 16 * 1024;
+
     // SslSession constructor takes ownership of socket.
     SslSession(SslServer *server, SslSocket *socket,
                bool async_read_ready = true);
@@ -54,6 +58,19 @@ public:
        ssl_handshake_in_progress_ = state;
     }
 
+    // The ssl stream writes every buffer with at least one TLS record.
+    // When enabled, the default, the queued messages smaller than a record
+    // are copied together and written with full size records.
+    void set_coalesce_writes(bool coalesce) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        coalesce_writes_ = coalesce;
+    }
+
+    // Directions offloaded to kernel TLS, "none", "tx" or "tx-rx".
+    const char *ktls_mode() const {
+        return io::Ktls::ModeName(ktls_mode_);
+    }
+
     static bool IsSocketErrorHard(const boost::system::error_code &ec);
 protected:
     virtual ~SslSession();
@@ -67,7 +84,10 @@ private:
     // on same socket.
     size_t ReadSome(boost::asio::mutable_buffer buffer,
                     boost::system::error_code *error);
-    void AsyncWrite(const uint8_t *data, std::size_t size);
+    void AsyncWrite(const std::vector<boost::asio::const_buffer> &buffers);
+    void CoalesceBuffers(
+        const std::vector<boost::asio::const_buffer> &buffers);
+    void EnableKtls();
 
     static void TriggerSslHandShakeInternal(SslSessionPtr ptr,
                                             SslHandShakeCallbackHandler cb);
@@ -94,15 +114,24 @@ private:
     /**************** protected by mutex_ *************************/
     bool ssl_handshake_in_progress_;  // ssl handshake ongoing
     bool ssl_handshake_success_;      // ssl handshake success
+    io::Ktls::Mode ktls_mode_;        // directions offloaded to the kernel
     /**************** end protected by mutex_ *********************/
 
     /**************** config knobs ********************************/
     bool ssl_enabled_;               // default true
     bool ssl_handshake_delayed_;     // default false
+    bool coalesce_writes_;           // default true
     /**************************************************************/
 
     size_t ssl_last_read_len_;       // data len of the last read done
 
+    // Coalesced data and buffers of the write in progress.
+    std::vector<uint8_t> record_data_;
+    std::vector<boost::asio::const_buffer> record_buffers_;
+
+    // Tracks the handshake when kernel TLS is enabled on the server.
+    boost::scoped_ptr<io::Ktls> ktls_;
+
     DISALLOW_COPY_AND_ASSIGN(SslSession);
 };
 
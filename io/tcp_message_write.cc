@@ -6,12 +6,11 @@
 
 #include "base/util.h"
 #include "base/logging.h"
+#include "io/buffer_pool.h"
 #include "io/tcp_session.h"
 #include "io/io_log.h"
 
-using boost::asio::buffer;
-using boost::asio::buffer_cast;
-using boost::asio::mutable_buffer;
+using boost::asio::const_buffer;
 using boost::system::error_code;
 using tbb::mutex;
 using std::min;
@@ -19,11 +18,12 @@ using std::min;
 const int TcpMessageWriter::kDefaultWriteBufferSize;
 const int TcpMessageWriter::kMaxPendingBufferSize;
 const int TcpMessageWriter::kMinPendingBufferSize;
+const size_t TcpMessageWriter::kMaxWriteSegments;
 
 TcpMessageWriter::TcpMessageWriter(TcpSession *session,
                                    size_t buffer_send_size) :
-    offset_(0), last_write_(0), buffer_send_size_(buffer_send_size),
-    session_(session) {
+    queue_bytes_(0), offset_(0), last_write_(0),
+    buffer_send_size_(buffer_send_size), session_(session) {
 }
 
 TcpMessageWriter::~TcpMessageWriter() {
@@ -35,20 +35,31 @@ TcpMessageWriter::~TcpMessageWriter() {
 }
 
 int TcpMessageWriter::AsyncSend(const uint8_t *data, size_t len, error_code *ec) {
+    uint8_t *copy = io::BufferPool::GetInstance()->Allocate(len);
+    memcpy(copy, data, len);
+    return Enqueue(Segment(copy, len, BufferOwner()));
+}
 
-    int write = len;
+int TcpMessageWriter::AsyncSend(const uint8_t *data, size_t len,
+                                const BufferOwner &owner, error_code *ec) {
+    if (!owner)
+        return AsyncSend(data, len, ec);
+    return Enqueue(Segment(data, len, owner));
+}
 
-    if (buffer_queue_.empty()) {
-        BufferAppend(data, len);
-        if (session_->io_strand_) {
-            session_->io_strand_->post(bind(&TcpSession::AsyncWriteInternal,
-                                       session_, TcpSessionPtr(session_)));
-        }
-    } else {
-        BufferAppend(data, len);
+int TcpMessageWriter::Enqueue(const Segment &segment) {
+
+    int write = segment.size;
+
+    bool trigger_write = buffer_queue_.empty();
+    buffer_queue_.push_back(segment);
+    queue_bytes_ += segment.size;
+    if (trigger_write && session_->io_strand_) {
+        session_->io_strand_->post(bind(&TcpSession::AsyncWriteInternal,
+                                   session_, TcpSessionPtr(session_)));
     }
 
-    if ((GetBufferQueueSize() - offset_) > TcpMessageWriter::kMaxPendingBufferSize) {
+    if ((queue_bytes_ - offset_) > TcpMessageWriter::kMaxPendingBufferSize) {
         if (!session_->write_blocked_) {
             /* throttle the sender */
             session_->stats_.write_blocked++;
@@ -68,37 +79,46 @@ void TcpMessageWriter::TriggerAsyncWrite() {
     assert(last_write_ == 0);
     assert(!buffer_queue_.empty());
 
-    boost::asio::mutable_buffer head = buffer_queue_.front();
-    size_t remaining = buffer_size(head) - offset_;
-    last_write_  = min(buffer_send_size_, remaining);
+    // Gather up to buffer_send_size_ bytes from the head of the queue.
+    write_buffers_.clear();
+    size_t offset = offset_;
+    for (BufferQueue::const_iterator it = buffer_queue_.begin();
+         it != buffer_queue_.end() && last_write_ < buffer_send_size_ &&
+         write_buffers_.size() < kMaxWriteSegments; ++it) {
+        size_t size = min(it->size - offset, buffer_send_size_ - last_write_);
+        write_buffers_.push_back(const_buffer(it->data + offset, size));
+        last_write_ += size;
+        offset = 0;
+    }
 
     // Update socket write call statistics.
     session_->stats_.write_calls++;
     session_->server_->stats_.write_calls++;
 
-    const uint8_t *data = buffer_cast<const uint8_t *>(head) + offset_;
-    session_->AsyncWrite(data, last_write_);
+    session_->AsyncWrite(write_buffers_);
 }
 
 bool TcpMessageWriter::UpdateBufferQueue(size_t wrote, bool *send_ready) {
 
-    assert(last_write_ == wrote);
+    // The write may be partial.
+    assert(wrote <= last_write_);
     assert(!buffer_queue_.empty());
 
     bool more_write = true;
     last_write_ = 0;
     *send_ready = false;
 
-    boost::asio::mutable_buffer head = buffer_queue_.front();
-    if ((offset_ + wrote) == buffer_size(head)) {
-        offset_ = 0;
+    // Release the buffers written completely.
+    offset_ += wrote;
+    while (!buffer_queue_.empty() && offset_ >= buffer_queue_.front().size) {
+        const Segment &head = buffer_queue_.front();
+        offset_ -= head.size;
+        queue_bytes_ -= head.size;
         DeleteBuffer(head);
         buffer_queue_.pop_front();
-    } else {
-        offset_ += wrote;
     }
 
-    if (session_->write_blocked_ && ((GetBufferQueueSize() - offset_)  <
+    if (session_->write_blocked_ && ((queue_bytes_ - offset_)  <
                                      TcpMessageWriter::kMinPendingBufferSize)) {
         uint64_t blocked_usecs =  UTCTimestampUsec() -
                 session_->stats_.write_block_start_time;
@@ -109,23 +129,16 @@ bool TcpMessageWriter::UpdateBufferQueue(size_t wrote, bool *send_ready) {
     }
 
     if (buffer_queue_.empty()) {
-        buffer_queue_.clear();
         more_write = false;
     }
 
     return more_write;
 }
 
-void TcpMessageWriter::BufferAppend(const uint8_t *src, int bytes) {
-    uint8_t *data = new uint8_t[bytes];
-    memcpy(data, src, bytes);
-    mutable_buffer buffer = mutable_buffer(data, bytes);
-    buffer_queue_.push_back(buffer);
-}
-
-void TcpMessageWriter::DeleteBuffer(mutable_buffer buffer) {
-    const uint8_t *data = buffer_cast<const uint8_t *>(buffer);
-    delete[] data;
-    return;
+// The buffers queued by reference are released along with their owner.
+void TcpMessageWriter::DeleteBuffer(const Segment &segment) {
+    if (!segment.owner) {
+        io::BufferPool::GetInstance()->Free(segment.data);
+    }
 }
 
@@ -7,22 +7,37 @@
 
 #include <tbb/mutex.h>
 
-#include <list>
+#include <deque>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/asio/buffer.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/system/error_code.hpp>
 #include "base/util.h"
 
 class TcpSession;
 
+//
+// Queue of the data sent on a TcpSession, written to the socket with
+// vectored writes of up to kMaxWriteSegments buffers.
+//
+// The data is either copied into a buffer of the io::BufferPool, or queued
+// by reference along with a reference counted owner, which is released
+// once the data has been written.
+//
 class TcpMessageWriter {
 public:
     static const int kDefaultBufferSize = 4 * 1024;
     static const int kDefaultWriteBufferSize = 32 * 1024;
     static const int kMaxPendingBufferSize = 256 * 1024;
     static const int kMinPendingBufferSize = 64 * 1024;
+    // IOV_MAX on linux.
+    static const size_t kMaxWriteSegments = 1024;
+
+    typedef boost::shared_ptr<const void> BufferOwner;
+    typedef std::vector<boost::asio::const_buffer> WriteBuffers;
 
     TcpMessageWriter(TcpSession *session, size_t buffer_send_size);
     ~TcpMessageWriter();
@@ -34,35 +49,49 @@ public:
     int AsyncSend(const uint8_t *msg, size_t len,
                   boost::system::error_code *ec);
 
+    // Queue msg without copying it, owner keeps msg valid until written.
+    int AsyncSend(const uint8_t *msg, size_t len, const BufferOwner &owner,
+                  boost::system::error_code *ec);
+
     // caller needs to take a lock.
     bool IsWritePending() const {
         return (buffer_queue_.size() != 0);
     }
 
     size_t GetBufferQueueSize() const {
-        size_t total = 0;
-        BufferQueue::const_iterator it = buffer_queue_.begin();
-        for (; it != buffer_queue_.end(); ++it) {
-            boost::asio::mutable_buffer buffer = *it;
-            total += buffer_size(buffer);
-        }
-        return total;
+        return queue_bytes_;
     }
 
 private:
     friend class TcpSession;
     typedef boost::intrusive_ptr<TcpSession> TcpSessionPtr;
-    typedef std::list<boost::asio::mutable_buffer> BufferQueue;
-    void BufferAppend(const uint8_t *data, int len);
-    void DeleteBuffer(boost::asio::mutable_buffer buffer);
+
+    struct Segment {
+        Segment(const uint8_t *data, size_t size, const BufferOwner &owner)
+            : data(data), size(size), owner(owner) {
+        }
+
+        const uint8_t *data;
+        size_t size;
+        // NULL for the buffers allocated from the io::BufferPool.
+        BufferOwner owner;
+    };
+    typedef std::deque<Segment> BufferQueue;
+
+    int Enqueue(const Segment &segment);
+    void DeleteBuffer(const Segment &segment);
     /* DeleteBuffer and Update Buffer Queue */
     bool UpdateBufferQueue(size_t wrote, bool *send_ready);
     void TriggerAsyncWrite();
 
     BufferQueue buffer_queue_;
+    // Sum of the sizes of the buffers in buffer_queue_.
+    size_t queue_bytes_;
     size_t offset_;
     size_t last_write_;
     size_t buffer_send_size_;
+    // Buffers of the write in progress.
+    WriteBuffers write_buffers_;
     TcpSession *session_;
 };
 
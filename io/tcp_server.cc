@@ -5,8 +5,12 @@
 #include "io/tcp_server.h"
 
 #include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include <boost/asio/connect.hpp>
+#include <boost/asio/detail/socket_option.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/bind.hpp>
 #include <netinet/tcp.h>
@@ -15,6 +19,7 @@
 #include "io/event_manager.h"
 #include "io/tcp_session.h"
 #include "io/io_log.h"
+#include "io/io_uring.h"
 #include "io/io_utils.h"
 
 using boost::asio::ip::address;
@@ -28,8 +33,12 @@ using boost::asio::socket_base;
 using std::ostringstream;
 using std::string;
 
+const size_t TcpServer::kMaxListenSocketCount;
+
 TcpServer::TcpServer(EventManager *evm)
-    : evm_(evm), socket_open_failure_(false) {
+    : evm_(evm), listen_socket_count_(1),
+      counter_instance_(CounterRegistry::GetInstance()->NewInstanceId()),
+      socket_open_failure_(false) {
     refcount_ = 0;
     TcpServerManager::AddServer(this);
 }
@@ -40,22 +49,39 @@ TcpServer::TcpServer(EventManager *evm)
 // 3. Optionally: WaitForEmpty().
 // 4. Destroy TcpServer.
 TcpServer::~TcpServer() {
-    assert(acceptor_ == NULL);
+    assert(acceptors_.empty());
     assert(session_ref_.empty());
     assert(session_map_.empty());
+    STLDeleteValues(&so_accept_);
+}
+
+void TcpServer::SetListenSocketCount(size_t count) {
+#ifdef SO_REUSEPORT
+    listen_socket_count_ =
+        std::max(size_t(1), std::min(count, kMaxListenSocketCount));
+#endif
 }
 
 void TcpServer::SetName(Endpoint local_endpoint) {
     ostringstream out;
     out << local_endpoint;
     name_ = out.str();
+    stats_.RegisterCounters(CounterPrefix());
 }
 
 void TcpServer::ResetAcceptor() {
-    acceptor_.reset();
+    acceptors_.clear();
+    if (!name_.empty())
+        stats_.UnregisterCounters(CounterPrefix());
     name_ = "";
 }
 
+string TcpServer::CounterPrefix() const {
+    ostringstream out;
+    out << "io.tcp_server." << name_ << "#" << counter_instance_ << ".";
+    return out.str();
+}
+
 bool TcpServer::Initialize(unsigned short port) {
     tcp::endpoint localaddr(tcp::v4(), port);
     return InitializeInternal(localaddr);
@@ -67,21 +93,60 @@ bool TcpServer::Initialize(unsigned short port, const IpAddress &host_ip) {
 }
 
 bool TcpServer::InitializeInternal(tcp::endpoint localaddr) {
-    acceptor_.reset(new tcp::acceptor(*evm_->io_service()));
-    if (!acceptor_) {
-        TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "Cannot create acceptor");
-        return false;
+    for (size_t i = 0; i < listen_socket_count_; ++i) {
+        if (!OpenAcceptor(localaddr)) {
+            return false;
+        }
+        if (i != 0) {
+            continue;
+        }
+
+        error_code ec;
+        tcp::endpoint local_endpoint = acceptors_.front().local_endpoint(ec);
+        if (ec) {
+            TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA,
+                                 "Cannot retrieve acceptor local-endpont");
+            ResetAcceptor();
+            return false;
+        }
+
+        //
+        // Server name can be set after local-endpoint information is
+        // available. The other listening sockets are bound to the port
+        // picked by the first one.
+        //
+        SetName(local_endpoint);
+        localaddr.port(local_endpoint.port());
     }
 
+    TCP_SERVER_LOG_DEBUG(this, TCP_DIR_NA, "Initialization complete");
+    for (size_t i = 0; i < acceptors_.size(); ++i) {
+        AsyncAccept(i);
+    }
+
+    return true;
+}
+
+//
+// Open a listening socket bound to localaddr and add it to the acceptors.
+// Resets all the acceptors on failure.
+//
+bool TcpServer::OpenAcceptor(tcp::endpoint localaddr) {
+    // Spread the listening sockets over the io_services of the event
+    // manager.
+    tcp::acceptor *acceptor =
+        new tcp::acceptor(*evm_->PickIoService(acceptors_.size()));
+    acceptors_.push_back(acceptor);
+
     error_code ec;
-    acceptor_->open(tcp::v4(), ec);
+    acceptor->open(tcp::v4(), ec);
     if (ec) {
         TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "TCP open: " << ec.message());
         ResetAcceptor();
         return false;
     }
 
-    acceptor_->set_option(socket_base::reuse_address(true), ec);
+    acceptor->set_option(socket_base::reuse_address(true), ec);
     if (ec) {
         TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "TCP reuse_address: "
                                                    << ec.message());
@@ -89,28 +154,29 @@ bool TcpServer::InitializeInternal(tcp::endpoint localaddr) {
         return false;
     }
 
-    acceptor_->bind(localaddr, ec);
-    if (ec) {
-        TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "TCP bind(" << localaddr.address() <<
-                             ":" << localaddr.port() << "): " << ec.message());
-        ResetAcceptor();
-        return false;
+#ifdef SO_REUSEPORT
+    if (listen_socket_count_ > 1) {
+        typedef boost::asio::detail::socket_option::boolean<
+            SOL_SOCKET, SO_REUSEPORT> reuse_port_t;
+        acceptor->set_option(reuse_port_t(true), ec);
+        if (ec) {
+            TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "TCP reuse_port: "
+                                                       << ec.message());
+            ResetAcceptor();
+            return false;
+        }
     }
+#endif
 
-    tcp::endpoint local_endpoint = acceptor_->local_endpoint(ec);
+    acceptor->bind(localaddr, ec);
     if (ec) {
-        TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA,
-                             "Cannot retrieve acceptor local-endpont");
+        TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "TCP bind(" << localaddr.address() <<
+                             ":" << localaddr.port() << "): " << ec.message());
         ResetAcceptor();
         return false;
     }
 
-    //
-    // Server name can be set after local-endpoint information is available.
-    //
-    SetName(local_endpoint);
-
-    acceptor_->listen(socket_base::max_connections, ec);
+    acceptor->listen(socket_base::max_connections, ec);
     if (ec) {
         TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "TCP listen(" << localaddr.port() <<
                              "): " << ec.message());
@@ -118,9 +184,6 @@ bool TcpServer::InitializeInternal(tcp::endpoint localaddr) {
         return false;
     }
 
-    TCP_SERVER_LOG_DEBUG(this, TCP_DIR_NA, "Initialization complete");
-    AsyncAccept();
-
     return true;
 }
 
@@ -128,11 +191,18 @@ void TcpServer::Shutdown() {
     tbb::mutex::scoped_lock lock(mutex_);
     error_code ec;
 
-    if (acceptor_) {
-        acceptor_->close(ec);
-        if (ec) {
-            TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "Error during shutdown: "
-                                                       << ec.message());
+    if (!acceptors_.empty()) {
+        for (size_t i = 0; i < acceptors_.size(); ++i) {
+            // Closing the socket does not complete an io_uring accept.
+            if (i < accept_ops_.size() && accept_ops_[i]) {
+                evm_->GetIoUring(EventManager::GetIoService(&acceptors_[i]))
+                    ->Cancel(accept_ops_[i]);
+            }
+            acceptors_[i].close(ec);
+            if (ec) {
+                TCP_SERVER_LOG_ERROR(this, TCP_DIR_NA, "Error during shutdown: "
+                                                           << ec.message());
+            }
         }
         ResetAcceptor();
     }
@@ -170,7 +240,7 @@ void TcpServer::UpdateSessionsDscp(uint8_t dscp) {
 }
 
 TcpSession *TcpServer::CreateSession() {
-    TcpSession *session = AllocSession(false);
+    TcpSession *session = AllocSession(false, 0);
     {
         tbb::mutex::scoped_lock lock(mutex_);
         session_ref_.insert(TcpSessionPtr(session));
@@ -242,24 +312,57 @@ void TcpServer::WaitForEmpty() {
     }
 }
 
-void TcpServer::AsyncAccept() {
+void TcpServer::AsyncAccept(size_t index) {
     tbb::mutex::scoped_lock lock(mutex_);
-    if (acceptor_ == NULL) {
+    if (index >= acceptors_.size()) {
         return;
     }
-    set_accept_socket();
-    acceptor_->async_accept(*accept_socket(),
+    set_accept_socket(index);
+    io::IoUring *uring =
+        evm_->GetIoUring(EventManager::GetIoService(&acceptors_[index]));
+    if (uring) {
+        if (index >= accept_ops_.size()) {
+            accept_ops_.resize(index + 1);
+        }
+        accept_ops_[index] = uring->Accept(acceptors_[index].native_handle(),
+            bind(&TcpServer::AcceptRingHandler, this, TcpServerPtr(this),
+                 index, _1));
+        // Accept through the reactor if the submission queue is full.
+        if (accept_ops_[index] != 0) {
+            return;
+        }
+    }
+    acceptors_[index].async_accept(*accept_socket(index),
         bind(&TcpServer::AcceptHandlerInternal, this,
-            TcpServerPtr(this), error));
+            TcpServerPtr(this), index, error));
+}
+
+// Hand the descriptor accepted through io_uring over to the accept socket.
+void TcpServer::AcceptRingHandler(TcpServerPtr server, size_t index,
+                                  int result) {
+    error_code ec;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        accept_ops_[index] = 0;
+        if (result < 0) {
+            ec = io::IoUring::ResultError(result);
+        } else {
+            accept_socket(index)->assign(tcp::v4(), result, ec);
+            if (ec) {
+                close(result);
+            }
+        }
+    }
+    AcceptHandlerInternal(server, index, ec);
 }
 
 int TcpServer::GetPort() const {
     tbb::mutex::scoped_lock lock(mutex_);
-    if (acceptor_.get() == NULL) {
+    if (acceptors_.empty()) {
         return -1;
     }
     error_code ec;
-    tcp::endpoint ep = acceptor_->local_endpoint(ec);
+    tcp::endpoint ep = acceptors_.front().local_endpoint(ec);
     if (ec) {
         return -1;
     }
@@ -274,8 +377,10 @@ bool TcpServer::HasSessions() const {
 bool TcpServer::HasSessionReadAvailable() const {
     tbb::mutex::scoped_lock lock(mutex_);
     error_code error;
-    if (accept_socket()->available(error) > 0) {
-        return  true;
+    for (size_t i = 0; i < acceptors_.size(); ++i) {
+        if (accept_socket(i)->available(error) > 0) {
+            return  true;
+        }
     }
     for (SessionMap::const_iterator iter = session_map_.begin();
          iter != session_map_.end();
@@ -289,40 +394,44 @@ bool TcpServer::HasSessionReadAvailable() const {
 
 TcpServer::Endpoint TcpServer::LocalEndpoint() const {
     tbb::mutex::scoped_lock lock(mutex_);
-    if (acceptor_.get() == NULL) {
+    if (acceptors_.empty()) {
         return Endpoint();
     }
     error_code ec;
-    Endpoint local = acceptor_->local_endpoint(ec);
+    Endpoint local = acceptors_.front().local_endpoint(ec);
     if (ec) {
         return Endpoint();
     }
     return local;
 }
 
-TcpSession *TcpServer::AllocSession(bool server_session) {
+TcpSession *TcpServer::AllocSession(bool server_session, size_t index) {
     TcpSession *session;
     if (server_session) {
-        session = AllocSession(so_accept_.get());
+        session = AllocSession(so_accept_[index]);
 
         // if session allocate succeeds release ownership to so_accept.
         if (session != NULL) {
-            so_accept_.release();
+            so_accept_[index] = NULL;
         }
     } else {
-        Socket *socket = new Socket(*evm_->io_service());
+        Socket *socket = new Socket(*evm_->NextIoService());
         session = AllocSession(socket);
     }
 
     return session;
 }
 
-TcpServer::Socket *TcpServer::accept_socket() const {
-    return so_accept_.get();
+TcpServer::Socket *TcpServer::accept_socket(size_t index) const {
+    return index < so_accept_.size() ? so_accept_[index] : NULL;
 }
 
-void TcpServer::set_accept_socket() {
-    so_accept_.reset(new Socket(*evm_->io_service()));
+void TcpServer::set_accept_socket(size_t index) {
+    if (index >= so_accept_.size()) {
+        so_accept_.resize(index + 1);
+    }
+    delete so_accept_[index];
+    so_accept_[index] = new Socket(*evm_->NextIoService());
 }
 
 bool TcpServer::AcceptSession(TcpSession *session) {
@@ -332,10 +441,11 @@ bool TcpServer::AcceptSession(TcpSession *session) {
 //
 // concurrency: called from the event_manager thread.
 //
-// accept() tcp connections. Once done, must register with boost again
-// via AsyncAccept() in order to process future accept calls
+// accept() tcp connections on the listening socket index. Once done, must
+// register with boost again via AsyncAccept() in order to process future
+// accept calls
 //
-void TcpServer::AcceptHandlerInternal(TcpServerPtr server,
+void TcpServer::AcceptHandlerInternal(TcpServerPtr server, size_t index,
         const error_code& error) {
     tcp::endpoint remote;
     error_code ec;
@@ -346,23 +456,23 @@ void TcpServer::AcceptHandlerInternal(TcpServerPtr server,
         goto done;
     }
 
-    remote = accept_socket()->remote_endpoint(ec);
+    remote = accept_socket(index)->remote_endpoint(ec);
     if (ec) {
         TCP_SERVER_LOG_ERROR(this, TCP_DIR_IN,
                              "Accept: No remote endpoint: " << ec.message());
         goto done;
     }
 
-    if (acceptor_ == NULL) {
+    if (acceptors_.empty()) {
         TCP_SESSION_LOG_DEBUG(session, TCP_DIR_IN,
                               "Session accepted after server shutdown: "
                                   << remote.address().to_string()
                                   << ":" << remote.port());
-        accept_socket()->close(ec);
+        accept_socket(index)->close(ec);
         goto done;
     }
 
-    session.reset(AllocSession(true));
+    session.reset(AllocSession(true, index));
     if (session == NULL) {
         TCP_SERVER_LOG_DEBUG(this, TCP_DIR_IN, "Session not created");
         goto done;
@@ -383,7 +493,7 @@ done:
     if (need_close) {
         session->CloseInternal(ec, false, false);
     }
-    AsyncAccept();
+    AsyncAccept(index);
 }
 
 void TcpServer::AcceptHandlerComplete(TcpSessionPtr session) {
@@ -501,8 +611,8 @@ int TcpServer::SetMd5SocketOption(NativeSocketType fd, uint32_t peer_ip,
 int TcpServer::SetListenSocketMd5Option(uint32_t peer_ip,
                                         const string &md5_password) {
     int retval = 0;
-    if (acceptor_) {
-        retval = SetMd5SocketOption(acceptor_->native_handle(), peer_ip,
+    for (size_t i = 0; i < acceptors_.size() && retval == 0; ++i) {
+        retval = SetMd5SocketOption(acceptors_[i].native_handle(), peer_ip,
                                     md5_password);
     }
     return retval;
@@ -510,8 +620,8 @@ int TcpServer::SetListenSocketMd5Option(uint32_t peer_ip,
 
 int TcpServer::SetListenSocketDscp(uint8_t value) {
     int retval = 0;
-    if (acceptor_) {
-        retval = SetDscpSocketOption(acceptor_->native_handle(), value);
+    for (size_t i = 0; i < acceptors_.size() && retval == 0; ++i) {
+        retval = SetDscpSocketOption(acceptors_[i].native_handle(), value);
     }
     return retval;
 }
@@ -549,8 +659,12 @@ uint8_t TcpServer::GetDscpValue(NativeSocketType fd) const {
 
 int TcpServer::SetSocketOptions(const SandeshConfig &sandesh_config) {
     int retval = 0;
-    if (acceptor_ && sandesh_config.tcp_keepalive_enable) {
-        retval = SetKeepAliveSocketOption(acceptor_->native_handle(), sandesh_config);
+    if (!sandesh_config.tcp_keepalive_enable) {
+        return retval;
+    }
+    for (size_t i = 0; i < acceptors_.size() && retval == 0; ++i) {
+        retval = SetKeepAliveSocketOption(acceptors_[i].native_handle(),
+                                          sandesh_config);
     }
     return retval;
 }
@@ -11,8 +11,10 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include "base/util.h"
@@ -30,10 +32,18 @@ public:
     typedef boost::asio::ip::tcp::endpoint Endpoint;
     typedef boost::asio::ip::tcp::socket Socket;
     typedef boost::asio::ip::tcp::socket::native_handle_type NativeSocketType;
+    static const size_t kMaxListenSocketCount = 64;
 
     explicit TcpServer(EventManager *evm);
     virtual ~TcpServer();
 
+    // Open count listening sockets bound to the same endpoint with
+    // SO_REUSEPORT, so that the kernel spreads the incoming connections
+    // between their accept queues. Must be called before Initialize.
+    // Ignored on platforms without SO_REUSEPORT.
+    void SetListenSocketCount(size_t count);
+    size_t listen_socket_count() const { return listen_socket_count_; }
+
     // Bind a listening socket and register it with the event manager.
     virtual bool Initialize(unsigned short port);
     virtual bool Initialize(unsigned short port, const IpAddress &host_ip);
@@ -63,7 +73,7 @@ public:
     virtual bool DisableSandeshLogMessages() const { return false; }
 
     int GetPort() const;
-    const io::SocketStats &GetSocketStats() const { return stats_; }
+    const io::ServerSocketStats &GetSocketStats() const { return stats_; }
 
     //
     // Return the number of tcp sessions in the map
@@ -114,10 +124,13 @@ protected:
 
     // Only SslServer overrides this method, to manage server with SSL
     // socket instead of TCP socket
-    virtual TcpSession *AllocSession(bool server_session);
+    // The index identifies the listening socket on which a server session
+    // was accepted, it is not used for client sessions.
+    virtual TcpSession *AllocSession(bool server_session, size_t index);
 
-    virtual Socket *accept_socket() const;
-    virtual void set_accept_socket();
+    // Socket used in async_accept on the listening socket index.
+    virtual Socket *accept_socket(size_t index) const;
+    virtual void set_accept_socket(size_t index);
 
     //
     // Passively accepted a new session. Returns true if the session is
@@ -158,29 +171,37 @@ private:
     bool RemoveSessionFromMap(Endpoint remote, TcpSession *session);
 
     // Called by the asio service.
-    void AcceptHandlerInternal(TcpServerPtr server,
+    void AcceptHandlerInternal(TcpServerPtr server, size_t index,
              const boost::system::error_code &error);
+    // Called by the io_uring instance of the listening socket.
+    void AcceptRingHandler(TcpServerPtr server, size_t index, int result);
 
     void ConnectHandler(TcpServerPtr server, TcpSessionPtr session,
                         const boost::system::error_code &error);
 
-    // Trigger the async accept operation.
-    void AsyncAccept();
+    // Trigger the async accept operation on the listening socket index.
+    void AsyncAccept(size_t index);
+    bool OpenAcceptor(boost::asio::ip::tcp::endpoint localaddr);
 
     void OnSessionClose(TcpSession *session);
     void SetName(Endpoint local_endpoint);
+    std::string CounterPrefix() const;
 
-    io::SocketStats stats_;
+    io::ServerSocketStats stats_;
     EventManager *evm_;
     // mutex protects the session maps
     mutable tbb::mutex mutex_;
     tbb::interface5::condition_variable cond_var_;
     SessionSet session_ref_;
     SessionMap session_map_;
-    std::auto_ptr<Socket> so_accept_;      // socket used in async_accept
-    boost::scoped_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
+    std::vector<Socket *> so_accept_;      // sockets used in async_accept
+    boost::ptr_vector<boost::asio::ip::tcp::acceptor> acceptors_;
+    std::vector<uint64_t> accept_ops_;     // pending io_uring accepts
+    size_t listen_socket_count_;
     tbb::atomic<int> refcount_;
     std::string name_;
+    // Makes the counter names unique among the servers of an endpoint.
+    uint32_t counter_instance_;
     bool socket_open_failure_;
 
     DISALLOW_COPY_AND_ASSIGN(TcpServer);
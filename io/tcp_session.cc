@@ -4,23 +4,32 @@
 
 #include "io/tcp_session.h"
 
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
 #include <algorithm>
 #include <string>
 
 #include <boost/asio.hpp>
 #include <boost/asio/detail/socket_option.hpp>
 #include <boost/bind.hpp>
-#include <boost/scoped_array.hpp>
 
 #include "base/logging.h"
 #include "base/address_util.h"
+#include "io/buffer_pool.h"
 #include "io/event_manager.h"
 #include "io/io_log.h"
+#include "io/io_uring.h"
 #include "io/io_utils.h"
 #include "io/tcp_message_write.h"
 #include "io/tcp_server.h"
 
-using boost::asio::async_write;
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 using boost::asio::buffer;
 using boost::asio::buffer_cast;
 using boost::asio::detail::socket_option::integer;
@@ -31,11 +40,11 @@ using boost::asio::null_buffers;
 using boost::asio::socket_base;
 using boost::bind;
 using boost::function;
-using boost::scoped_array;
 using boost::system::error_code;
 using std::min;
 using std::ostringstream;
 using std::string;
+using std::vector;
 
 using boost::asio::error::try_again;
 using boost::asio::error::would_block;
@@ -81,15 +90,140 @@ private:
     Buffer buffer_;
 };
 
+//
+// Reads the socket until it would block when the session drains reads,
+// instead of a Reader task per read.
+//
+class TcpSession::Drainer : public Task {
+public:
+    explicit Drainer(TcpSessionPtr session)
+        : Task(session->reader_task_id(), session->GetSessionInstance()),
+          session_(session) {
+    }
+    virtual bool Run() {
+        session_->DrainSocket();
+        return true;
+    }
+    string Description() const { return "TcpSession::Drainer"; }
+
+private:
+    TcpSessionPtr session_;
+};
+
+//
+// Receive ring of a session. Each read reserves the free space following
+// the previous read, or at the start of the ring when there is not enough
+// space left at the end, and keeps the part actually read. The space of
+// the buffers released is reclaimed from the oldest one.
+//
+// Protected by the session mutex.
+//
+class TcpSession::ReceiveRing {
+public:
+    // Smallest reservation at the end of the ring before wrapping around.
+    static const size_t kMinReserveSize = 2 * 1024;
+
+    explicit ReceiveRing(size_t size)
+        : data_(io::BufferPool::GetInstance()->Allocate(size)),
+          size_(size), head_(0) {
+    }
+
+    ~ReceiveRing() {
+        io::BufferPool::GetInstance()->Free(data_);
+    }
+
+    // Returns up to size bytes of free space, or an empty buffer if the
+    // ring is full.
+    mutable_buffer Reserve(size_t size) {
+        size_t min_size = min(size, kMinReserveSize);
+        size_t offset = head_;
+        size_t avail;
+        if (segments_.empty()) {
+            offset = 0;
+            avail = size_;
+        } else {
+            size_t tail = segments_.front().offset;
+            if (head_ > tail) {
+                avail = size_ - head_;
+                if (avail < min_size) {
+                    offset = 0;
+                    avail = tail;
+                }
+            } else {
+                avail = tail - head_;
+            }
+        }
+        if (avail < min_size) {
+            return mutable_buffer();
+        }
+        avail = min(avail, size);
+        segments_.push_back(Segment(offset, avail));
+        head_ = offset + avail;
+        return mutable_buffer(data_ + offset, avail);
+    }
+
+    // Keep the first size bytes of the last reservation.
+    void Commit(size_t size) {
+        Segment &segment = segments_.back();
+        assert(size <= segment.size);
+        segment.size = size;
+        head_ = segment.offset + size;
+    }
+
+    bool Contains(const Buffer &buffer) const {
+        const uint8_t *data = buffer_cast<const uint8_t *>(buffer);
+        return data >= data_ && data < data_ + size_;
+    }
+
+    void Release(const Buffer &buffer) {
+        size_t offset = buffer_cast<const uint8_t *>(buffer) - data_;
+        size_t size = buffer_size(buffer);
+        for (SegmentQueue::iterator it = segments_.begin();
+             it != segments_.end(); ++it) {
+            if (!it->released && it->offset == offset && it->size == size) {
+                it->released = true;
+                break;
+            }
+        }
+        while (!segments_.empty() && segments_.front().released) {
+            segments_.pop_front();
+        }
+    }
+
+private:
+    struct Segment {
+        Segment(size_t offset, size_t size)
+            : offset(offset), size(size), released(false) {
+        }
+        size_t offset;
+        size_t size;
+        bool released;
+    };
+    typedef std::deque<Segment> SegmentQueue;
+
+    uint8_t *data_;
+    size_t size_;
+    // Offset following the last reservation.
+    size_t head_;
+    SegmentQueue segments_;
+
+    DISALLOW_COPY_AND_ASSIGN(ReceiveRing);
+};
+
+const size_t TcpSession::ReceiveRing::kMinReserveSize;
+
 TcpSession::TcpSession(
     TcpServer *server, Socket *socket, bool async_read_ready,
     size_t buffer_send_size)
     : server_(server),
       socket_(socket),
       read_on_connect_(async_read_ready),
+      drain_reads_(false),
       established_(false),
       closed_(false),
       direction_(ACTIVE),
+      uring_(NULL),
+      recv_op_(0),
       writer_(new TcpMessageWriter(this, buffer_send_size)),
       name_("-") {
     refcount_ = 0;
@@ -98,7 +232,14 @@ TcpSession::TcpSession(
         reader_task_id_ = scheduler->GetTaskId("io::ReaderTask");
     }
     if (server_) {
-        io_strand_.reset(new Strand(*server->event_manager()->io_service()));
+        // Run the handlers on the io_service of the socket.
+        io_strand_.reset(new Strand(socket ?
+            *EventManager::GetIoService(socket) :
+            *server->event_manager()->io_service()));
+        if (socket) {
+            uring_ = server->event_manager()->GetIoUring(
+                EventManager::GetIoService(socket));
+        }
     }
     defer_reader_ = false;
     write_blocked_ = false;
@@ -115,7 +256,7 @@ TcpSession::~TcpSession() {
 }
 
 mutable_buffer TcpSession::AllocateBuffer(size_t buffer_size) {
-    uint8_t *data = new uint8_t[buffer_size];
+    uint8_t *data = io::BufferPool::GetInstance()->Allocate(buffer_size);
     mutable_buffer buffer = mutable_buffer(data, buffer_size);
     buffer_queue_.push_back(buffer);
     return buffer;
@@ -123,7 +264,7 @@ mutable_buffer TcpSession::AllocateBuffer(size_t buffer_size) {
 
 void TcpSession::DeleteBuffer(mutable_buffer buffer) {
     uint8_t *data = buffer_cast<uint8_t *>(buffer);
-    delete[] data;
+    io::BufferPool::GetInstance()->Free(data);
 }
 
 static int BufferCmp(const mutable_buffer &lhs, const const_buffer &rhs) {
@@ -144,6 +285,10 @@ void TcpSession::ReleaseBuffer(Buffer buffer) {
 }
 
 void TcpSession::ReleaseBufferLocked(Buffer buffer) {
+    if (receive_ring_ && receive_ring_->Contains(buffer)) {
+        receive_ring_->Release(buffer);
+        return;
+    }
     for (BufferQueue::iterator iter = buffer_queue_.begin();
          iter != buffer_queue_.end(); ++iter) {
         if (BufferCmp(*iter, buffer) == 0) {
@@ -155,6 +300,13 @@ void TcpSession::ReleaseBufferLocked(Buffer buffer) {
     assert(false);
 }
 
+void TcpSession::EnableReceiveRing(size_t size) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (!receive_ring_) {
+        receive_ring_.reset(new ReceiveRing(size));
+    }
+}
+
 void TcpSession::AsyncReadStartInternal(TcpSessionPtr session) {
     // Update socket read block time.
     if (stats_.read_block_start_time) {
@@ -188,15 +340,64 @@ void TcpSession::SetDeferReader(bool defer_reader) {
 
 void TcpSession::AsyncReadSome() {
     if (IsEstablishedLocked()) {
+        if (uring_ && !drain_reads_ && AsyncRecv()) {
+            return;
+        }
         socket()->async_read_some(null_buffers(),
             bind(&TcpSession::AsyncReadHandler, TcpSessionPtr(this)));
     }
 }
 
-void TcpSession::AsyncWrite(const uint8_t *data, std::size_t size) {
-    async_write(*socket(), buffer(data, size),
-        bind(&TcpSession::AsyncWriteHandler, TcpSessionPtr(this),
-             error, bytes_transferred));
+//
+// Write as much as possible right away, and wait for the socket to become
+// writable if it would block. The handler is always posted, as the caller
+// holds the mutex.
+//
+void TcpSession::AsyncWrite(const vector<const_buffer> &buffers) {
+    if (uring_ && AsyncSendMsg(buffers)) {
+        return;
+    }
+    error_code error;
+    size_t wrote = WriteSome(buffers, &error);
+    if (error == would_block) {
+        socket()->async_write_some(null_buffers(),
+            bind(&TcpSession::AsyncWriteReadyHandler, TcpSessionPtr(this),
+                 boost::asio::placeholders::error));
+        return;
+    }
+    EventManager::GetIoService(socket())->post(
+        bind(&TcpSession::AsyncWriteHandler, TcpSessionPtr(this), error,
+             wrote));
+}
+
+//
+// Write the buffers with a single sendmsg, which takes up to IOV_MAX
+// buffers where the asio write operations stop at 64.
+//
+size_t TcpSession::WriteSome(const vector<const_buffer> &buffers,
+                             error_code *error) {
+    struct iovec iov[TcpMessageWriter::kMaxWriteSegments];
+    size_t count = min(buffers.size(), TcpMessageWriter::kMaxWriteSegments);
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void *>(
+            buffer_cast<const void *>(buffers[i]));
+        iov[i].iov_len = buffer_size(buffers[i]);
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    ssize_t wrote;
+    do {
+        wrote = sendmsg(socket()->native_handle(), &msg, MSG_NOSIGNAL);
+    } while (wrote < 0 && errno == EINTR);
+    if (wrote < 0) {
+        *error = error_code(errno, boost::system::system_category());
+        return 0;
+    }
+    *error = error_code();
+    return wrote;
 }
 
 TcpSession::Endpoint TcpSession::local_endpoint() const {
@@ -306,6 +507,9 @@ void TcpSession::CloseInternal(const error_code &ec,
                 "Shutdown failed due to error: " << error.message());
         }
         socket()->close(error);
+        if (recv_op_) {
+            uring_->Cancel(recv_op_);
+        }
     }
     closed_ = true;
     tcp_close_in_progress_ = false;
@@ -405,6 +609,28 @@ void TcpSession::AsyncWriteHandler(TcpSessionPtr session,
     return;
 }
 
+void TcpSession::AsyncWriteReadyHandler(TcpSessionPtr session,
+                                        const error_code &error) {
+    if (error) {
+        AsyncWriteHandler(session, error, 0);
+        return;
+    }
+
+    tbb::mutex::scoped_lock lock(session->mutex_);
+    if (session->IsClosedLocked()) return;
+
+    error_code ec;
+    size_t wrote = session->WriteSome(session->writer_->write_buffers_, &ec);
+    if (ec == would_block) {
+        session->socket()->async_write_some(null_buffers(),
+            bind(&TcpSession::AsyncWriteReadyHandler, session,
+                 boost::asio::placeholders::error));
+        return;
+    }
+    lock.release();
+    AsyncWriteHandler(session, ec, wrote);
+}
+
 void TcpSession::AsyncWriteInternal(TcpSessionPtr session) {
 
     tbb::mutex::scoped_lock lock(session->mutex_);
@@ -417,6 +643,18 @@ void TcpSession::AsyncWriteInternal(TcpSessionPtr session) {
 }
 
 bool TcpSession::Send(const uint8_t *data, size_t size, size_t *sent) {
+    return SendInternal(data, size, boost::shared_ptr<const void>(), sent);
+}
+
+bool TcpSession::SendShared(const uint8_t *data, size_t size,
+                            const boost::shared_ptr<const void> &owner,
+                            size_t *sent) {
+    return SendInternal(data, size, owner, sent);
+}
+
+bool TcpSession::SendInternal(const uint8_t *data, size_t size,
+                              const boost::shared_ptr<const void> &owner,
+                              size_t *sent) {
     bool ret = true;
     tbb::mutex::scoped_lock lock(mutex_);
 
@@ -431,7 +669,7 @@ bool TcpSession::Send(const uint8_t *data, size_t size, size_t *sent) {
 
     if (socket()->non_blocking()) {
         error_code error;
-        int len = writer_->AsyncSend(data, size, &error);
+        int len = writer_->AsyncSend(data, size, owner, &error);
         lock.release();
         if (len < 0) {
             TCP_SESSION_LOG_ERROR(this, TCP_DIR_OUT,
@@ -471,17 +709,61 @@ size_t TcpSession::GetReadBufferSize() const {
     return size;
 }
 
+// Reserve a buffer in the receive ring if there is room, so that the data
+// follows the data of the previous read, or else allocate a new buffer.
+mutable_buffer TcpSession::ReserveBufferLocked(size_t size) {
+    mutable_buffer buffer;
+    if (receive_ring_) {
+        buffer = receive_ring_->Reserve(size);
+    }
+    if (buffer_size(buffer) == 0) {
+        buffer = AllocateBuffer(size);
+    }
+    return buffer;
+}
+
+// Trim a buffer of the receive ring to the bytes read.
+mutable_buffer TcpSession::CommitBufferLocked(mutable_buffer buffer,
+                                              size_t bytes_transferred) {
+    if (receive_ring_ && receive_ring_->Contains(buffer)) {
+        receive_ring_->Commit(bytes_transferred);
+        buffer = mutable_buffer(buffer_cast<uint8_t *>(buffer),
+                                bytes_transferred);
+    }
+    return buffer;
+}
+
+// Read the socket into a new buffer, which must be released by the caller.
+size_t TcpSession::ReadLocked(mutable_buffer *buffer, error_code *error) {
+    *buffer = ReserveBufferLocked(GetReadBufferSize());
+    size_t bytes_transferred = ReadSome(*buffer, error);
+    *buffer = CommitBufferLocked(*buffer, bytes_transferred);
+
+    if (!IsSocketErrorHard(*error)) {
+        // Update read statistics.
+        stats_.read_calls++;
+        stats_.read_bytes += bytes_transferred;
+        server_->stats_.read_calls++;
+        server_->stats_.read_bytes += bytes_transferred;
+    }
+    return bytes_transferred;
+}
+
 void TcpSession::AsyncReadHandler(TcpSessionPtr session) {
     tbb::mutex::scoped_lock lock(session->mutex_);
     if (session->closed_) {
         return;
     }
 
-    mutable_buffer buffer =
-        session->AllocateBuffer(session->GetReadBufferSize());
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    if (session->drain_reads_) {
+        scheduler->Enqueue(new Drainer(session));
+        return;
+    }
 
+    mutable_buffer buffer;
     error_code error;
-    size_t bytes_transferred = session->ReadSome(buffer, &error);
+    size_t bytes_transferred = session->ReadLocked(&buffer, &error);
     if (session->IsSocketErrorHard(error)) {
         session->ReleaseBufferLocked(buffer);
         // eof is returned when the peer closed the socket, no need to log error
@@ -498,6 +780,125 @@ void TcpSession::AsyncReadHandler(TcpSessionPtr session) {
         return;
     }
 
+    Task *task = session->CreateReaderTask(buffer, bytes_transferred);
+    // Starting a new task for the session
+    scheduler->Enqueue(task);
+}
+
+//
+// Hand the data to OnRead as it is read, until the socket would block, the
+// reader is deferred or the budget of the task is exhausted. In the latter
+// case, a new task picks up where this one left off, so that other tasks
+// get to run.
+//
+void TcpSession::DrainSocket() {
+    uint64_t start = UTCTimestampUsec();
+    size_t total = 0;
+    while (true) {
+        mutable_buffer buffer;
+        error_code error;
+        size_t bytes_transferred;
+        {
+            tbb::mutex::scoped_lock lock(mutex_);
+            if (!IsEstablishedLocked()) {
+                return;
+            }
+            bytes_transferred = ReadLocked(&buffer, &error);
+            if (IsSocketErrorHard(error)) {
+                ReleaseBufferLocked(buffer);
+                if (error != boost::asio::error::eof) {
+                    TCP_SESSION_LOG_ERROR(this, TCP_DIR_IN,
+                            "Read failed due to error "
+                            << error.category().name() << " "
+                            << error.value()
+                            << " : " << error.message());
+                }
+                lock.release();
+                CloseInternal(error, true);
+                return;
+            }
+            if (bytes_transferred == 0) {
+                // Drained, wait for the socket to become readable.
+                ReleaseBufferLocked(buffer);
+                AsyncReadSome();
+                return;
+            }
+        }
+
+        OnRead(Buffer(buffer_cast<const uint8_t *>(buffer),
+                      bytes_transferred));
+        total += bytes_transferred;
+
+        if (IsReaderDeferred()) {
+            // Update socket read block count.
+            stats_.read_block_start_time = UTCTimestampUsec();
+            stats_.read_blocked++;
+            server_->stats_.read_blocked++;
+            return;
+        }
+        if (total >= kMaxDrainBytes ||
+            UTCTimestampUsec() - start >= kMaxDrainUsecs) {
+            TaskScheduler::GetInstance()->Enqueue(
+                new Drainer(TcpSessionPtr(this)));
+            return;
+        }
+    }
+}
+
+//
+// Receive into a buffer through io_uring, which waits for the socket to be
+// readable. Return false if the submission queue is full, the caller then
+// waits through the reactor. Called with the mutex held.
+//
+bool TcpSession::AsyncRecv() {
+    mutable_buffer buffer = ReserveBufferLocked(kDefaultBufferSize);
+    recv_op_ = uring_->Recv(socket()->native_handle(),
+        buffer_cast<void *>(buffer), buffer_size(buffer),
+        bind(&TcpSession::AsyncRecvHandler, TcpSessionPtr(this), buffer, _1));
+    if (recv_op_ == 0) {
+        ReleaseBufferLocked(CommitBufferLocked(buffer, 0));
+        return false;
+    }
+    return true;
+}
+
+void TcpSession::AsyncRecvHandler(TcpSessionPtr session,
+                                  mutable_buffer buffer, int result) {
+    tbb::mutex::scoped_lock lock(session->mutex_);
+    session->recv_op_ = 0;
+    size_t bytes_transferred = result > 0 ? result : 0;
+    buffer = session->CommitBufferLocked(buffer, bytes_transferred);
+    if (session->closed_) {
+        session->ReleaseBufferLocked(buffer);
+        return;
+    }
+
+    error_code error;
+    if (result == 0) {
+        error = boost::asio::error::eof;
+    } else if (result < 0) {
+        error = io::IoUring::ResultError(result);
+    }
+    if (session->IsSocketErrorHard(error)) {
+        session->ReleaseBufferLocked(buffer);
+        if (error != boost::asio::error::eof) {
+            TCP_SESSION_LOG_ERROR(session, TCP_DIR_IN,
+                    "Read failed due to error "
+                    << error.category().name() << " "
+                    << error.value()
+                    << " : " << error.message());
+        }
+
+        lock.release();
+        session->CloseInternal(error, true);
+        return;
+    }
+    if (error) {
+        session->ReleaseBufferLocked(buffer);
+        session->AsyncReadSome();
+        return;
+    }
+
     // Update read statistics.
     session->stats_.read_calls++;
     session->stats_.read_bytes += bytes_transferred;
@@ -505,9 +906,37 @@ void TcpSession::AsyncReadHandler(TcpSessionPtr session) {
     session->server_->stats_.read_bytes += bytes_transferred;
 
     Task *task = session->CreateReaderTask(buffer, bytes_transferred);
-    // Starting a new task for the session
-    TaskScheduler *scheduler = TaskScheduler::GetInstance();
-    scheduler->Enqueue(task);
+    TaskScheduler::GetInstance()->Enqueue(task);
+}
+
+//
+// Send the buffers through io_uring, which waits for the socket to be
+// writable. The buffers are held by the writer until AsyncWriteHandler
+// runs. Return false if the submission queue is full. Called with the mutex
+// held.
+//
+bool TcpSession::AsyncSendMsg(const vector<const_buffer> &buffers) {
+    size_t count = min(buffers.size(), TcpMessageWriter::kMaxWriteSegments);
+    send_iov_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        send_iov_[i].iov_base = const_cast<void *>(
+            buffer_cast<const void *>(buffers[i]));
+        send_iov_[i].iov_len = buffer_size(buffers[i]);
+    }
+    memset(&send_msg_, 0, sizeof(send_msg_));
+    send_msg_.msg_iov = &send_iov_[0];
+    send_msg_.msg_iovlen = count;
+    return uring_->SendMsg(socket()->native_handle(), &send_msg_,
+        MSG_NOSIGNAL,
+        bind(&TcpSession::AsyncSendMsgHandler, TcpSessionPtr(this), _1)) != 0;
+}
+
+void TcpSession::AsyncSendMsgHandler(TcpSessionPtr session, int result) {
+    if (result < 0) {
+        AsyncWriteHandler(session, io::IoUring::ResultError(result), 0);
+    } else {
+        AsyncWriteHandler(session, error_code(), result);
+    }
 }
 
 int TcpSession::GetSessionInstance() const {
@@ -559,7 +988,11 @@ uint8_t TcpSession::GetDscpValue() const {
 
 TcpMessageReader::TcpMessageReader(TcpSession *session,
                                    ReceiveCallback callback)
-    : session_(session), callback_(callback), offset_(0), remain_(-1) {
+    : session_(session), callback_(callback), contiguous_(true), offset_(0),
+      remain_(-1), bytes_copied_(0) {
+    if (session_) {
+        session_->EnableReceiveRing();
+    }
 }
 
 TcpMessageReader::~TcpMessageReader() {
@@ -598,6 +1031,7 @@ uint8_t *TcpMessageReader::BufferConcat(uint8_t *data, Buffer buffer,
     assert((dst - data) + count <= msglength);
     memcpy(dst, TcpSession::BufferData(buffer), count);
     offset_ = count;
+    bytes_copied_ += msglength;
 
     return data;
 }
@@ -616,7 +1050,7 @@ int TcpMessageReader::QueueByteLength() const {
 }
 
 TcpMessageReader::Buffer TcpMessageReader::PullUp(
-               uint8_t *data, Buffer buffer, size_t size) const {
+               uint8_t *data, Buffer buffer, size_t size) {
     size_t offset = 0;
 
     for (BufferQueue::const_iterator iter = queue_.begin();
@@ -643,6 +1077,7 @@ TcpMessageReader::Buffer TcpMessageReader::PullUp(
     assert(offset + avail <= size);
     memcpy(data + offset, TcpSession::BufferData(buffer), avail);
     offset += avail;
+    bytes_copied_ += offset;
 
     if (offset < size) {
         return Buffer();
@@ -650,21 +1085,68 @@ TcpMessageReader::Buffer TcpMessageReader::PullUp(
     return Buffer(data, size);
 }
 
+void TcpMessageReader::ReceiveContiguous() {
+    const uint8_t *data = TcpSession::BufferData(queue_.front()) + offset_;
+    int avail = QueueByteLength();
+    Buffer pending(data, avail);
+    int offset = 0;
+    remain_ = -1;
+    while (offset < avail) {
+        int msglength = MsgLength(pending, offset);
+        if (msglength < 0) {
+            break;
+        }
+        if (msglength > avail - offset) {
+            remain_ = msglength - (avail - offset);
+            break;
+        }
+        // Receive the message
+        bool success = callback_(data + offset, msglength);
+        offset += msglength;
+        if (!success)
+            return;
+    }
+
+    // Release the buffers consumed.
+    offset_ += offset;
+    while (!queue_.empty()) {
+        int size = TcpSession::BufferSize(queue_.front());
+        if (offset_ < size) {
+            break;
+        }
+        session_->ReleaseBuffer(queue_.front());
+        queue_.pop_front();
+        offset_ -= size;
+    }
+}
+
 // Read the socket stream and send messages to the peer object.
 void TcpMessageReader::OnRead(Buffer buffer) {
     const int kHeaderLenSize = GetHeaderLenSize();
     size_t size = TcpSession::BufferSize(buffer);
     TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_IN, "Read " << size << " bytes");
 
+    // The buffer follows the queued data in memory when both were read into
+    // the receive ring of the session, receive the messages in place.
+    if (!queue_.empty() && contiguous_ &&
+        TcpSession::BufferData(queue_.back()) +
+        TcpSession::BufferSize(queue_.back()) ==
+        TcpSession::BufferData(buffer)) {
+        queue_.push_back(buffer);
+        ReceiveContiguous();
+        return;
+    }
+
     if (!queue_.empty()) {
         int msglength = MsgLength(queue_.front(), offset_);
         if (msglength < 0) {
             int queuelen = QueueByteLength();
             if (queuelen + static_cast<int>(size) < kHeaderLenSize) {
                 queue_.push_back(buffer);
+                contiguous_ = false;
                 return;
             }
-            scoped_array<uint8_t> data(new uint8_t[kHeaderLenSize]);
+            io::ScopedPoolBuffer data(kHeaderLenSize);
             Buffer header = PullUp(data.get(), buffer, kHeaderLenSize);
             assert(TcpSession::BufferSize(header) == (size_t) kHeaderLenSize);
 
@@ -675,12 +1157,13 @@ void TcpMessageReader::OnRead(Buffer buffer) {
         assert(remain_ > 0);
         if (size < (size_t) remain_) {
             queue_.push_back(buffer);
+            contiguous_ = false;
             remain_ -= size;
             return;
         }
 
         // concat the buffers into a contiguous message.
-        scoped_array<uint8_t> data(new uint8_t[AllocBufferSize(msglength)]);
+        io::ScopedPoolBuffer data(AllocBufferSize(msglength));
         BufferConcat(data.get(), buffer, msglength);
         assert(remain_ == -1);
         // Receive the message
@@ -710,6 +1193,7 @@ void TcpMessageReader::OnRead(Buffer buffer) {
 
     if (avail > 0) {
         queue_.push_back(buffer);
+        contiguous_ = true;
     } else {
         session_->ReleaseBuffer(buffer);
         offset_ = 0;
@@ -5,12 +5,15 @@
 #ifndef SRC_IO_TCP_SESSION_H_
 #define SRC_IO_TCP_SESSION_H_
 
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <tbb/mutex.h>
 #include <tbb/task.h>
 
 #include <deque>
 #include <list>
 #include <string>
+#include <vector>
 
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
@@ -19,6 +22,7 @@
 #include <boost/intrusive_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #ifndef _LIBCPP_VERSION
 #include <tbb/compat/condition_variable>
@@ -31,6 +35,7 @@ class EventManager;
 class TcpServer;
 class TcpSession;
 class TcpMessageWriter;
+namespace io { class IoUring; }
 
 // TcpSession
 //
@@ -41,6 +46,10 @@ class TcpSession {
 public:
     static const int kDefaultBufferSize = 16 * 1024;
     static const int kDefaultWriteBufferSize = 32 * 1024;
+    static const int kDefaultReceiveRingSize = 64 * 1024;
+    // Budget of a reader task draining the socket, see set_drain_reads.
+    static const int kMaxDrainBytes = 256 * 1024;
+    static const int kMaxDrainUsecs = 5000;
 
     enum Event {
         EVENT_NONE,
@@ -68,6 +77,13 @@ public:
     // Performs a non-blocking send operation.
     virtual bool Send(const uint8_t *data, size_t size, size_t *sent);
 
+    // Same as Send, but queues the data without copying it. The caller
+    // passes a reference to the owner of the data, which is released once
+    // the data has been written.
+    virtual bool SendShared(const uint8_t *data, size_t size,
+                            const boost::shared_ptr<const void> &owner,
+                            size_t *sent);
+
     // Called by TcpServer to trigger async read.
     virtual bool Connected(Endpoint remote);
 
@@ -96,6 +112,18 @@ public:
     // Buffers must be freed in arrival order.
     virtual void ReleaseBuffer(Buffer buffer);
 
+    // Read the socket into a ring of the given size rather than into a
+    // new buffer for each read. The data of consecutive reads is then
+    // contiguous in memory, unless the ring wraps around.
+    void EnableReceiveRing(size_t size = kDefaultReceiveRingSize);
+
+    // Read the socket from a single reader task until it would block, up
+    // to kMaxDrainBytes or kMaxDrainUsecs, rather than reading once per
+    // readiness notification and creating a reader task per read. Must be
+    // set before the session is established. Not supported by SslSession,
+    // which reads the ssl stream from the io strand only.
+    void set_drain_reads(bool drain) { drain_reads_ = drain; }
+
     // This function returns the instance to run SessionTask.
     // Returning Task::kTaskInstanceAny would allow multiple session tasks to
     // run in parallel.
@@ -184,6 +212,8 @@ protected:
     static void AsyncWriteHandler(TcpSessionPtr session,
                                   const boost::system::error_code &error,
                                   std::size_t bytes_transferred);
+    static void AsyncWriteReadyHandler(TcpSessionPtr session,
+                                       const boost::system::error_code &error);
 
     void AsyncReadStartInternal(TcpSessionPtr session);
     virtual Task* CreateReaderTask(boost::asio::mutable_buffer, size_t);
@@ -201,7 +231,11 @@ protected:
     virtual size_t GetReadBufferSize() const;
     virtual size_t ReadSome(boost::asio::mutable_buffer buffer,
                             boost::system::error_code *error);
-    virtual void AsyncWrite(const uint8_t *data, std::size_t size);
+    // Write the buffers, invoking AsyncWriteHandler with the number of
+    // bytes written, which may be less than the size of the buffers.
+    // Called with the mutex held.
+    virtual void AsyncWrite(
+        const std::vector<boost::asio::const_buffer> &buffers);
 
     virtual int reader_task_id() const {
         return reader_task_id_;
@@ -229,6 +263,8 @@ protected:
 
 private:
     class Reader;
+    class Drainer;
+    class ReceiveRing;
     friend class TcpServer;
     friend class TcpMessageWriter;
     friend void intrusive_ptr_add_ref(TcpSession *session);
@@ -239,7 +275,27 @@ private:
                                    const boost::system::error_code &error,
                                    uint64_t block_start_time);
     void ReleaseBufferLocked(Buffer buffer);
+    boost::asio::mutable_buffer ReserveBufferLocked(size_t size);
+    boost::asio::mutable_buffer CommitBufferLocked(
+        boost::asio::mutable_buffer buffer, size_t bytes_transferred);
+    size_t ReadLocked(boost::asio::mutable_buffer *buffer,
+                      boost::system::error_code *error);
+    void DrainSocket();
+
+    // io_uring counterparts of the asio read and write operations, used
+    // when the io_service of the socket runs an io_uring instance.
+    bool AsyncRecv();
+    static void AsyncRecvHandler(TcpSessionPtr session,
+                                 boost::asio::mutable_buffer buffer,
+                                 int result);
+    bool AsyncSendMsg(const std::vector<boost::asio::const_buffer> &buffers);
+    static void AsyncSendMsgHandler(TcpSessionPtr session, int result);
     void SetEstablished(Endpoint remote, Direction dir);
+    bool SendInternal(const uint8_t *data, size_t size,
+                      const boost::shared_ptr<const void> &owner,
+                      size_t *sent);
+    size_t WriteSome(const std::vector<boost::asio::const_buffer> &buffers,
+                     boost::system::error_code *error);
 
     bool IsClosedLocked() const {
         return closed_;
@@ -259,6 +315,7 @@ private:
     TcpServerPtr server_;
     boost::scoped_ptr<Socket> socket_;
     bool read_on_connect_;
+    bool drain_reads_;
 
     /**************** protected by mutex_ ****************/
     bool established_;             // In TCP ESTABLISHED state.
@@ -267,6 +324,11 @@ private:
     std::string remote_addr_str_;  // Remote end-point address string
     Direction direction_;          // direction (active, passive)
     BufferQueue buffer_queue_;
+    boost::scoped_ptr<ReceiveRing> receive_ring_;
+    io::IoUring *uring_;
+    uint64_t recv_op_;             // Pending io_uring receive
+    std::vector<struct iovec> send_iov_;
+    struct msghdr send_msg_;
     boost::system::error_code close_reason_;
     /**************** end protected by mutex_ ****************/
 
@@ -312,6 +374,9 @@ public:
     virtual ~TcpMessageReader();
     virtual void OnRead(Buffer buffer);
 
+    // Number of bytes copied to assemble messages split across reads.
+    uint64_t bytes_copied() const { return bytes_copied_; }
+
 protected:
     virtual int MsgLength(Buffer buffer, int offset) = 0;
     virtual const int GetHeaderLenSize() = 0;
@@ -325,15 +390,21 @@ private:
 
     int QueueByteLength() const;
 
-    Buffer PullUp(uint8_t *data, Buffer buffer, size_t size) const;
+    Buffer PullUp(uint8_t *data, Buffer buffer, size_t size);
+
+    // Receive the messages from the queue when its buffers are contiguous.
+    void ReceiveContiguous();
 
     int AllocBufferSize(int length);
 
     TcpSession *session_;
     ReceiveCallback callback_;
     BufferQueue queue_;
+    // The buffers in queue_ follow each other in memory.
+    bool contiguous_;
     int offset_;
     int remain_;
+    uint64_t bytes_copied_;
 
     DISALLOW_COPY_AND_ASSIGN(TcpMessageReader);
 };
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "io/buffer_pool.h"
+
+#include <string.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "io/io_types.h"
+#include "testing/gunit.h"
+
+using io::BufferPool;
+using std::vector;
+
+class BufferPoolTest : public ::testing::Test {
+protected:
+    BufferPoolTest() : pool_(BufferPool::GetInstance()) {
+    }
+
+    static void AllocateBuffers(vector<uint8_t *> *buffers, size_t count,
+                                size_t size) {
+        BufferPool *pool = BufferPool::GetInstance();
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t *data = pool->Allocate(size);
+            memset(data, 0xa5, size);
+            buffers->push_back(data);
+        }
+    }
+
+    static void FreeBuffers(vector<uint8_t *> *buffers) {
+        BufferPool *pool = BufferPool::GetInstance();
+        for (size_t i = 0; i < buffers->size(); ++i) {
+            pool->Free((*buffers)[i]);
+        }
+        buffers->clear();
+    }
+
+    BufferPoolClassStats GetClassStats(size_t size) {
+        vector<BufferPoolClassStats> class_list;
+        pool_->GetSandeshData(&class_list);
+        return class_list[BufferPool::SizeClass(size)];
+    }
+
+    BufferPool *pool_;
+};
+
+TEST_F(BufferPoolTest, SizeClass) {
+    EXPECT_EQ(0U, BufferPool::SizeClass(1));
+    EXPECT_EQ(0U, BufferPool::SizeClass(256));
+    EXPECT_EQ(1U, BufferPool::SizeClass(257));
+    EXPECT_EQ(4U, BufferPool::SizeClass(4 * 1024));
+    EXPECT_EQ(6U, BufferPool::SizeClass(16 * 1024));
+    EXPECT_EQ(BufferPool::kNumClasses - 1,
+              BufferPool::SizeClass(64 * 1024));
+    EXPECT_EQ(BufferPool::kNumClasses, BufferPool::SizeClass(64 * 1024 + 1));
+    EXPECT_EQ(16U * 1024, BufferPool::ClassSize(6));
+}
+
+TEST_F(BufferPoolTest, Reuse) {
+    BufferPoolClassStats before = GetClassStats(1000);
+    uint8_t *data = pool_->Allocate(1000);
+    memset(data, 0, 1000);
+    pool_->Free(data);
+    uint8_t *data2 = pool_->Allocate(1024);
+    EXPECT_EQ(data, data2);
+    pool_->Free(data2);
+
+    BufferPoolClassStats after = GetClassStats(1000);
+    EXPECT_EQ(1024U, after.get_size());
+    EXPECT_EQ(before.get_allocs() + 2, after.get_allocs());
+    EXPECT_EQ(before.get_frees() + 2, after.get_frees());
+    EXPECT_EQ(before.get_in_use(), after.get_in_use());
+    EXPECT_GE(after.get_thread_cache_hits(),
+              before.get_thread_cache_hits() + 1);
+}
+
+TEST_F(BufferPoolTest, Large) {
+    BufferPoolClassStats before = GetClassStats(1024 * 1024);
+    uint8_t *data = pool_->Allocate(1024 * 1024);
+    memset(data, 0, 1024 * 1024);
+    pool_->Free(data);
+    BufferPoolClassStats after = GetClassStats(1024 * 1024);
+    EXPECT_EQ(0U, after.get_size());
+    EXPECT_EQ(before.get_system_allocs() + 1, after.get_system_allocs());
+    EXPECT_EQ(before.get_frees() + 1, after.get_frees());
+}
+
+// Buffers allocated on one thread and freed on another go through the
+// central free list and get reused by the allocating thread.
+TEST_F(BufferPoolTest, CrossThread) {
+    static const size_t kSize = 16 * 1024;
+    static const size_t kCount = 1000;
+    BufferPoolClassStats before = GetClassStats(kSize);
+
+    for (int round = 0; round < 10; ++round) {
+        vector<uint8_t *> buffers;
+        boost::thread producer(boost::bind(&BufferPoolTest::AllocateBuffers,
+                                           &buffers, kCount, kSize));
+        producer.join();
+        boost::thread consumer(boost::bind(&BufferPoolTest::FreeBuffers,
+                                           &buffers));
+        consumer.join();
+    }
+
+    BufferPoolClassStats after = GetClassStats(kSize);
+    EXPECT_EQ(before.get_in_use(), after.get_in_use());
+    EXPECT_EQ(before.get_allocs() + 10 * kCount, after.get_allocs());
+    EXPECT_LT(after.get_system_allocs() - before.get_system_allocs(),
+              10 * kCount);
+    EXPECT_GT(after.get_central_free(), 0U);
+}
+
+TEST_F(BufferPoolTest, ScopedBuffer) {
+    BufferPoolClassStats before = GetClassStats(100);
+    {
+        io::ScopedPoolBuffer buffer(100);
+        memset(buffer.get(), 0, 100);
+        EXPECT_EQ(before.get_in_use() + 1, GetClassStats(100).get_in_use());
+    }
+    EXPECT_EQ(before.get_in_use(), GetClassStats(100).get_in_use());
+}
+
+// Compare the cost with new/delete for the allocation pattern of a
+// TcpSession: allocated on the io thread and released by a reader task.
+TEST_F(BufferPoolTest, DISABLED_Performance) {
+    static const size_t kSize = 16 * 1024;
+    static const size_t kCount = 100000;
+
+    uint64_t start = ClockMonotonicUsec();
+    for (size_t i = 0; i < kCount; ++i) {
+        uint8_t *data = new uint8_t[kSize];
+        data[0] = 0;
+        delete [] data;
+    }
+    uint64_t new_usecs = ClockMonotonicUsec() - start;
+
+    start = ClockMonotonicUsec();
+    for (size_t i = 0; i < kCount; ++i) {
+        uint8_t *data = pool_->Allocate(kSize);
+        data[0] = 0;
+        pool_->Free(data);
+    }
+    uint64_t pool_usecs = ClockMonotonicUsec() - start;
+
+    LOG(DEBUG, "BufferPool: " << kCount << " allocations of " << kSize
+        << " bytes, new/delete " << new_usecs << " usecs, pool "
+        << pool_usecs << " usecs");
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2017 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "io/io_uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <tbb/atomic.h>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "io/event_manager.h"
+#include "io/tcp_server.h"
+#include "io/tcp_session.h"
+#include "io/udp_server.h"
+#include "io/test/event_manager_test.h"
+
+using boost::asio::buffer_cast;
+using boost::asio::const_buffer;
+using boost::asio::mutable_buffer;
+using boost::asio::ip::udp;
+using boost::system::error_code;
+using io::IoUring;
+using std::auto_ptr;
+using std::string;
+
+namespace {
+
+class IoUringTest : public ::testing::Test {
+protected:
+    IoUringTest() : thread_(&evm_), ring_(NULL) {
+        result_ = 0;
+        completions_ = 0;
+    }
+
+    virtual void SetUp() {
+        if (evm_.EnableIoUring()) {
+            ring_ = evm_.GetIoUring(evm_.io_service());
+        }
+        thread_.Start();
+    }
+
+    virtual void TearDown() {
+        evm_.Shutdown();
+        thread_.Join();
+    }
+
+    IoUring::Handler CompletionHandler() {
+        return boost::bind(&IoUringTest::Completion, this, _1);
+    }
+
+    void Completion(int result) {
+        result_ = result;
+        completions_++;
+    }
+
+    EventManager evm_;
+    ServerThread thread_;
+    IoUring *ring_;
+    tbb::atomic<int> result_;
+    tbb::atomic<int> completions_;
+};
+
+TEST_F(IoUringTest, Recv) {
+    if (ring_ == NULL) {
+        LOG(DEBUG, "io_uring not supported, skipping");
+        return;
+    }
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    char data[64];
+    ring_->Recv(fds[0], data, sizeof(data), CompletionHandler());
+    EXPECT_EQ(5, write(fds[1], "hello", 5));
+    TASK_UTIL_EXPECT_EQ(1, completions_);
+    EXPECT_EQ(5, result_);
+    EXPECT_EQ(0, memcmp(data, "hello", 5));
+    EXPECT_GE(ring_->operations(), 1U);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_F(IoUringTest, Cancel) {
+    if (ring_ == NULL) {
+        LOG(DEBUG, "io_uring not supported, skipping");
+        return;
+    }
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    char data[64];
+    IoUring::OpId id =
+        ring_->Recv(fds[0], data, sizeof(data), CompletionHandler());
+    EXPECT_NE(0U, id);
+    ring_->Cancel(id);
+    TASK_UTIL_EXPECT_EQ(1, completions_);
+    EXPECT_EQ(-ECANCELED, result_);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// The id of a completed operation does not cancel a later one.
+TEST_F(IoUringTest, CancelCompleted) {
+    if (ring_ == NULL) {
+        LOG(DEBUG, "io_uring not supported, skipping");
+        return;
+    }
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    char data[64];
+    IoUring::OpId id1 =
+        ring_->Recv(fds[0], data, sizeof(data), CompletionHandler());
+    EXPECT_EQ(5, write(fds[1], "hello", 5));
+    TASK_UTIL_EXPECT_EQ(1, completions_);
+
+    IoUring::OpId id2 =
+        ring_->Recv(fds[0], data, sizeof(data), CompletionHandler());
+    EXPECT_NE(id1, id2);
+    ring_->Cancel(id1);
+    EXPECT_EQ(5, write(fds[1], "world", 5));
+    TASK_UTIL_EXPECT_EQ(2, completions_);
+    EXPECT_EQ(5, result_);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void HoldReference(boost::shared_ptr<int> ref, int result) {
+}
+
+// The handlers of the pending operations are released with the ring.
+TEST(IoUringDestroyTest, PendingOperations) {
+    boost::asio::io_service io_service;
+    auto_ptr<IoUring> ring(IoUring::Create(&io_service));
+    if (ring.get() == NULL) {
+        LOG(DEBUG, "io_uring not supported, skipping");
+        return;
+    }
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    char data[64];
+    boost::shared_ptr<int> ref(new int(0));
+    EXPECT_NE(0U, ring->Recv(fds[0], data, sizeof(data),
+                             boost::bind(&HoldReference, ref, _1)));
+    EXPECT_EQ(2, ref.use_count());
+    ring.reset();
+    EXPECT_EQ(1, ref.use_count());
+    close(fds[0]);
+    close(fds[1]);
+}
+
+class EchoSession : public TcpSession {
+public:
+    EchoSession(TcpServer *server, Socket *socket)
+        : TcpSession(server, socket) {
+    }
+
+protected:
+    virtual void OnRead(Buffer buffer) {
+        Send(BufferData(buffer), BufferSize(buffer), NULL);
+        ReleaseBuffer(buffer);
+    }
+};
+
+class EchoServer : public TcpServer {
+public:
+    explicit EchoServer(EventManager *evm) : TcpServer(evm), session_(NULL) {
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        session_ = new EchoSession(this, socket);
+        return session_;
+    }
+
+    TcpSession *session() const { return session_; }
+
+private:
+    TcpSession *session_;
+};
+
+int ConnectLocal(unsigned short port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return fd;
+}
+
+bool ReadFully(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t len = read(fd, data, size);
+        if (len <= 0) {
+            return false;
+        }
+        data += len;
+        size -= len;
+    }
+    return true;
+}
+
+// Send messages to an echo session and read them back one at a time.
+// Returns the number of system calls made by the session, counting the ring
+// submissions when io_uring is used.
+uint64_t EchoMessages(bool use_uring, int messages, size_t size) {
+    auto_ptr<EventManager> evm(new EventManager());
+    if (use_uring && !evm->EnableIoUring()) {
+        return 0;
+    }
+    ServerThread thread(evm.get());
+    EchoServer *server = new EchoServer(evm.get());
+    server->Initialize(0);
+    thread.Start();
+
+    int fd = ConnectLocal(server->GetPort());
+    EXPECT_GE(fd, 0);
+    TASK_UTIL_EXPECT_TRUE(server->session() != NULL);
+
+    string msg(size, 'x');
+    std::vector<char> reply(size);
+    uint64_t start = ClockMonotonicUsec();
+    for (int i = 0; i < messages; ++i) {
+        EXPECT_EQ(static_cast<ssize_t>(size), write(fd, msg.data(), size));
+        EXPECT_TRUE(ReadFully(fd, &reply[0], size));
+    }
+    uint64_t usecs = ClockMonotonicUsec() - start;
+    EXPECT_EQ(0, memcmp(msg.data(), &reply[0], size));
+
+    const io::SocketStats &stats = server->session()->GetSocketStats();
+    uint64_t system_calls;
+    if (use_uring) {
+        IoUring *ring = evm->GetIoUring(evm->io_service());
+        EXPECT_GE(ring->operations(), 2U * messages);
+        system_calls = ring->system_calls();
+    } else {
+        system_calls = stats.read_calls + stats.write_calls;
+    }
+    LOG(DEBUG, (use_uring ? "io_uring" : "asio") << ": " << messages
+        << " echoed messages of " << size << " bytes in " << usecs
+        << " usecs, " << system_calls << " system calls");
+
+    close(fd);
+    server->Shutdown();
+    server->ClearSessions();
+    task_util::WaitForIdle();
+    TcpServerManager::DeleteServer(server);
+    evm->Shutdown();
+    thread.Join();
+    task_util::WaitForIdle();
+    return system_calls;
+}
+
+TEST(IoUringTcpTest, Echo) {
+    EchoMessages(false, 100, 100);
+    EchoMessages(true, 100, 100);
+}
+
+TEST(IoUringTcpTest, DISABLED_Performance) {
+    EchoMessages(false, 10000, 100);
+    EchoMessages(true, 10000, 100);
+}
+
+class UdpEchoServer : public UdpServer {
+public:
+    explicit UdpEchoServer(EventManager *evm) : UdpServer(evm) {
+        rx_count_ = 0;
+    }
+
+    virtual void OnRead(const const_buffer &recv_buffer,
+                        const udp::endpoint &remote_endpoint) {
+        size_t size = boost::asio::buffer_size(recv_buffer);
+        mutable_buffer send = AllocateBuffer(size);
+        memcpy(buffer_cast<uint8_t *>(send),
+               buffer_cast<const uint8_t *>(recv_buffer), size);
+        DeallocateBuffer(recv_buffer);
+        rx_count_++;
+        StartSend(remote_endpoint, size, send);
+    }
+
+    int rx_count() const { return rx_count_; }
+
+private:
+    tbb::atomic<int> rx_count_;
+};
+
+TEST(IoUringUdpTest, Echo) {
+    static const int kMessages = 1000;
+    auto_ptr<EventManager> evm(new EventManager());
+    if (!evm->EnableIoUring()) {
+        LOG(DEBUG, "io_uring not supported, skipping");
+        return;
+    }
+    ServerThread thread(evm.get());
+    UdpEchoServer *server = new UdpEchoServer(evm.get());
+    ASSERT_TRUE(server->Initialize(0));
+    server->StartReceive();
+    thread.Start();
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server->GetLocalEndpointPort());
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(0, connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                         sizeof(addr)));
+    for (int i = 0; i < kMessages; ++i) {
+        char msg[32], reply[32];
+        int len = snprintf(msg, sizeof(msg), "message %d", i);
+        EXPECT_EQ(len, write(fd, msg, len));
+        EXPECT_EQ(len, read(fd, reply, sizeof(reply)));
+        EXPECT_EQ(0, memcmp(msg, reply, len));
+    }
+    EXPECT_EQ(kMessages, server->rx_count());
+    EXPECT_GE(evm->GetIoUring(evm->io_service())->operations(),
+              2U * kMessages);
+    close(fd);
+
+    server->Shutdown();
+    task_util::WaitForIdle();
+    UdpServerManager::DeleteServer(server);
+    evm->Shutdown();
+    thread.Join();
+    task_util::WaitForIdle();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
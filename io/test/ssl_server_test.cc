@@ -19,6 +19,7 @@
 
 #include "base/logging.h"
 #include "base/parse_object.h"
+#include "base/time_util.h"
 #include "base/test/task_test_util.h"
 #include "io/event_manager.h"
 #include "io/ssl_server.h"
@@ -342,6 +343,169 @@ protected:
             boost::bind(&SslEchoServerTest::DummyTimerHandler, this, session,
                         boost::asio::placeholders::error));
     }
+    boost::asio::ip::tcp::endpoint LocalEndpoint(int port) {
+        boost::asio::ip::tcp::endpoint endpoint;
+        boost::system::error_code ec;
+        endpoint.address(
+            boost::asio::ip::address::from_string("127.0.0.1", ec));
+        endpoint.port(port);
+        return endpoint;
+    }
+
+    // Connect a session of the client, wait for the echo of its greeting
+    // and close it.
+    void ConnectEcho(SslClient *client,
+                     const boost::asio::ip::tcp::endpoint &endpoint) {
+        int connected = connect_success_;
+        ClientSession *session =
+            static_cast<ClientSession *>(client->CreateSession());
+        session->set_observer(
+            boost::bind(&SslEchoServerTest::OnEvent, this, _1, _2));
+        client->Connect(session, endpoint);
+        TASK_UTIL_EXPECT_EQ(connected + 1, connect_success_);
+        // The TLS 1.3 sessions are received along with the echo.
+        TASK_UTIL_EXPECT_EQ(sent_data_size, session->len());
+        session->Close();
+        client->DeleteSession(session);
+    }
+
+    // Reconnect a client without and then with a session cache.
+    void ResumeSessions(int connections) {
+        SetUpImmedidate();
+        server_->EnableSessionCache();
+        SslClient *client = new SslClient(evm_.get());
+        SslClient *resuming_client = new SslClient(evm_.get());
+        resuming_client->EnableSessionCache();
+
+        task_util::WaitForIdle();
+        server_->Initialize(0);
+        task_util::WaitForIdle();
+        thread_->Start();		// Must be called after initialization
+
+        boost::asio::ip::tcp::endpoint endpoint =
+            LocalEndpoint(server_->GetPort());
+        SslClient *clients[] = { client, resuming_client };
+        for (int i = 0; i < 2; i++) {
+            connect_success_ = connect_fail_ = connect_abort_ = 0;
+            uint64_t start = ClockMonotonicUsec();
+            for (int j = 0; j < connections; j++) {
+                ConnectEcho(clients[i], endpoint);
+            }
+            uint64_t usecs = ClockMonotonicUsec() - start;
+            LOG(DEBUG, "Session cache " << (i ? "enabled" : "disabled")
+                << ": " << connections << " connections in " << usecs
+                << " usecs, " << clients[i]->resumed_handshakes()
+                << " resumed");
+            EXPECT_EQ(0, connect_fail_);
+        }
+        EXPECT_EQ(connections, client->handshakes());
+        EXPECT_EQ(0, client->resumed_handshakes());
+        EXPECT_EQ(connections, resuming_client->handshakes());
+        EXPECT_EQ(connections - 1, resuming_client->resumed_handshakes());
+        EXPECT_EQ(connections - 1, server_->resumed_handshakes());
+
+        client->Shutdown();
+        resuming_client->Shutdown();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(client);
+        TcpServerManager::DeleteServer(resuming_client);
+    }
+
+    // Echo a stream of small messages, without and then with coalesced
+    // writes.
+    void CoalesceWrites(int messages) {
+        static const size_t kMessageSize = 100;
+
+        SetUpImmedidate();
+        SslClient *client = new SslClient(evm_.get());
+
+        task_util::WaitForIdle();
+        server_->Initialize(0);
+        task_util::WaitForIdle();
+        thread_->Start();		// Must be called after initialization
+
+        boost::asio::ip::tcp::endpoint endpoint =
+            LocalEndpoint(server_->GetPort());
+        u_int8_t msg[kMessageSize];
+        memset(msg, 'x', sizeof(msg));
+        for (int coalesce = 0; coalesce < 2; coalesce++) {
+            connect_success_ = connect_fail_ = connect_abort_ = 0;
+            ClientSession *session =
+                static_cast<ClientSession *>(client->CreateSession());
+            session->set_observer(
+                boost::bind(&SslEchoServerTest::OnEvent, this, _1, _2));
+            session->set_coalesce_writes(coalesce);
+            client->Connect(session, endpoint);
+            TASK_UTIL_EXPECT_EQ(1, connect_success_);
+            TASK_UTIL_EXPECT_EQ(sent_data_size, session->len());
+
+            uint64_t start = ClockMonotonicUsec();
+            for (int i = 0; i < messages; i++) {
+                session->Send(msg, sizeof(msg), NULL);
+            }
+            TASK_UTIL_EXPECT_EQ(sent_data_size + messages * kMessageSize,
+                                session->len());
+            uint64_t usecs = ClockMonotonicUsec() - start;
+            LOG(DEBUG, "Coalescing " << (coalesce ? "enabled" : "disabled")
+                << ": " << messages << " messages of " << kMessageSize
+                << " bytes echoed in " << usecs << " usecs, "
+                << session->GetSocketStats().write_calls << " writes");
+
+            session->Close();
+            client->DeleteSession(session);
+            task_util::WaitForIdle();
+        }
+
+        client->Shutdown();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(client);
+    }
+
+    // Echo a stream of small messages with kernel TLS enabled on both ends.
+    void EchoKtls(int messages) {
+        static const size_t kMessageSize = 100;
+
+        SetUpImmedidate();
+        server_->EnableKtls();
+        SslClient *client = new SslClient(evm_.get());
+        client->EnableKtls();
+
+        task_util::WaitForIdle();
+        server_->Initialize(0);
+        task_util::WaitForIdle();
+        thread_->Start();		// Must be called after initialization
+
+        connect_success_ = connect_fail_ = connect_abort_ = 0;
+        ClientSession *session =
+            static_cast<ClientSession *>(client->CreateSession());
+        session->set_observer(
+            boost::bind(&SslEchoServerTest::OnEvent, this, _1, _2));
+        client->Connect(session, LocalEndpoint(server_->GetPort()));
+        TASK_UTIL_EXPECT_EQ(1, connect_success_);
+        TASK_UTIL_EXPECT_EQ(sent_data_size, session->len());
+        TASK_UTIL_EXPECT_TRUE(server_->GetSession() != NULL);
+
+        u_int8_t msg[kMessageSize];
+        memset(msg, 'x', sizeof(msg));
+        uint64_t start = ClockMonotonicUsec();
+        for (int i = 0; i < messages; i++) {
+            session->Send(msg, sizeof(msg), NULL);
+        }
+        TASK_UTIL_EXPECT_EQ(sent_data_size + messages * kMessageSize,
+                            session->len());
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        LOG(DEBUG, "kTLS client " << session->ktls_mode() << ", server "
+            << server_->GetSession()->ktls_mode() << ": " << messages
+            << " messages of " << kMessageSize << " bytes echoed in "
+            << usecs << " usecs");
+
+        session->Close();
+        client->DeleteSession(session);
+        client->Shutdown();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(client);
+    }
+
     auto_ptr<ServerThread> thread_;
     auto_ptr<EventManager> evm_;
     EchoServer *server_;
@@ -484,6 +648,76 @@ TEST_F(SslEchoServerTest, HandshakeFailure) {
     client = NULL;
 }
 
+// Reconnect storm of clients, with and without resuming their sessions.
+TEST_F(SslEchoServerTest, SessionResumption) {
+    ResumeSessions(20);
+}
+
+TEST_F(SslEchoServerTest, DISABLED_SessionResumptionPerformance) {
+    ResumeSessions(200);
+}
+
+// The oldest cached session is evicted when the cache of the client is full.
+TEST_F(SslEchoServerTest, SessionCacheEviction) {
+    SetUpImmedidate();
+    EchoServer *servers[] = {
+        server_, new EchoServer(evm_.get()), new EchoServer(evm_.get())
+    };
+    SslClient *client = new SslClient(evm_.get());
+    client->EnableSessionCache(2);
+
+    task_util::WaitForIdle();
+    for (int i = 0; i < 3; i++) {
+        servers[i]->EnableSessionCache();
+        servers[i]->Initialize(0);
+    }
+    task_util::WaitForIdle();
+    thread_->Start();		// Must be called after initialization
+
+    for (int i = 0; i < 3; i++) {
+        ConnectEcho(client, LocalEndpoint(servers[i]->GetPort()));
+    }
+    EXPECT_EQ(0, client->resumed_handshakes());
+    ConnectEcho(client, LocalEndpoint(servers[2]->GetPort()));
+    EXPECT_EQ(1, client->resumed_handshakes());
+    ConnectEcho(client, LocalEndpoint(servers[1]->GetPort()));
+    EXPECT_EQ(2, client->resumed_handshakes());
+    ConnectEcho(client, LocalEndpoint(servers[0]->GetPort()));
+    EXPECT_EQ(2, client->resumed_handshakes());
+    EXPECT_EQ(0, connect_fail_);
+
+    client->Shutdown();
+    for (int i = 1; i < 3; i++) {
+        servers[i]->Shutdown();
+        servers[i]->ClearSessions();
+    }
+    task_util::WaitForIdle();
+    TcpServerManager::DeleteServer(client);
+    for (int i = 1; i < 3; i++) {
+        TcpServerManager::DeleteServer(servers[i]);
+    }
+}
+
+// Encrypted throughput of a stream of small messages, written with a TLS
+// record per message or with coalesced records.
+TEST_F(SslEchoServerTest, WriteCoalescing) {
+    CoalesceWrites(200);
+}
+
+TEST_F(SslEchoServerTest, DISABLED_WriteCoalescingPerformance) {
+    CoalesceWrites(20000);
+}
+
+// Echo with kernel TLS enabled on both ends, the sessions stay on OpenSSL
+// when the kernel does not support it.
+TEST_F(SslEchoServerTest, Ktls) {
+    EchoKtls(200);
+}
+
+TEST_F(SslEchoServerTest, DISABLED_KtlsPerformance) {
+    EchoKtls(20000);
+}
+
 TEST_F(SslEchoServerTest, DISABLED_test_delayed_ssl_handshake) {
 
     SetUpDelayedHandShake();
@@ -10,6 +10,8 @@
 #include <netinet/in.h>
 
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <tbb/atomic.h>
 #include <tbb/recursive_mutex.h>
 
 #include "testing/gunit.h"
@@ -373,6 +375,52 @@ TEST_F(EchoServerTest, DeferRead) {
     EXPECT_NE("00:00:00", rx_stats1.blocked_duration);
 }
 
+struct SharedMessage {
+    static tbb::atomic<int> count;
+    SharedMessage() {
+        memset(data, 0xab, sizeof(data));
+        count++;
+    }
+    ~SharedMessage() { count--; }
+    uint8_t data[64];
+};
+tbb::atomic<int> SharedMessage::count;
+
+// Messages sent with SendShared are not copied, and are released once
+// written. Small messages are gathered into a few vectored writes.
+TEST_F(EchoServerTest, SendShared) {
+    static const int kMessages = 1000;
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+
+    client_->CreateSession();
+    client_->EchoServer::ConnectTest(port);
+    client_->SetSocketOptions();
+    TASK_UTIL_ASSERT_TRUE((server_->GetSession() != NULL));
+    TASK_UTIL_ASSERT_TRUE(client_->GetSession()->IsEstablished());
+
+    SharedMessage::count = 0;
+    size_t total = 0;
+    for (int i = 0; i < kMessages; i++) {
+        boost::shared_ptr<SharedMessage> message(new SharedMessage);
+        size_t sent = 0;
+        client_->GetSession()->SendShared(message->data,
+            sizeof(message->data), message, &sent);
+        EXPECT_EQ(sizeof(message->data), sent);
+        total += sizeof(message->data);
+    }
+    TASK_UTIL_ASSERT_EQ(total, server_->GetSession()->GetTotal());
+    TASK_UTIL_EXPECT_EQ(0, SharedMessage::count);
+
+    SocketIOStats tx_stats;
+    client_->GetSession()->GetTxSocketStats(&tx_stats);
+    EXPECT_EQ(total, tx_stats.bytes);
+    EXPECT_LT(tx_stats.calls, static_cast<uint64_t>(kMessages));
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -3,6 +3,7 @@
  */
 
 #include <memory>
+#include <sstream>
 
 #include <pthread.h>
 #include <sys/types.h>
@@ -12,11 +13,14 @@
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/bind.hpp>
+#include <tbb/atomic.h>
 
 #include "testing/gunit.h"
 
 #include "base/logging.h"
 #include "base/parse_object.h"
+#include "base/sharded_counter.h"
+#include "base/time_util.h"
 #include "base/test/task_test_util.h"
 #include "io/event_manager.h"
 #include "io/tcp_server.h"
@@ -244,6 +248,36 @@ TEST_F(EchoServerTest, Basic_InterfaceIp) {
     client.Close();
 }
 
+#ifdef SO_REUSEPORT
+// Servers sharing an endpoint with SO_REUSEPORT register their counters
+// under distinct names, shutting one down keeps the counters of the other.
+TEST_F(EchoServerTest, ReusePortCounters) {
+    server_->SetListenSocketCount(2);
+    ASSERT_TRUE(server_->Initialize(0));
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+    EchoServer *other = new EchoServer(evm_.get());
+    other->SetListenSocketCount(2);
+    ASSERT_TRUE(other->Initialize(port));
+    task_util::WaitForIdle();
+
+    std::ostringstream out;
+    out << "io.tcp_server." << server_->ToString() << "#";
+    std::vector<CounterStats> counters;
+    CounterRegistry::GetInstance()->GetSandeshData(out.str(), &counters);
+    size_t server_counters = counters.size() / 2;
+    EXPECT_LT(0U, server_counters);
+    EXPECT_EQ(2 * server_counters, counters.size());
+
+    other->Shutdown();
+    task_util::WaitForIdle();
+    TcpServerManager::DeleteServer(other);
+    counters.clear();
+    CounterRegistry::GetInstance()->GetSandeshData(out.str(), &counters);
+    EXPECT_EQ(server_counters, counters.size());
+}
+#endif
+
 TEST_F(EchoServerTest, Connect) {
     EchoServer *client = new EchoServer(evm_.get());
 
@@ -361,6 +395,8 @@ class ReaderTestSession : public TcpSession {
     }
 
     int release_count() const { return release_count_; }
+    const ReaderTest *reader() const { return reader_.get(); }
+    void ClearSizes() { sizes.clear(); }
 
   protected:
     virtual void OnRead(Buffer buffer) {
@@ -441,6 +477,117 @@ TEST_F(ReaderUnitTest, StreamRead) {
     }
     TASK_UTIL_EXPECT_EQ(ARRAYLEN(sizes), i);
     TASK_UTIL_EXPECT_EQ(buf_list.size(), (size_t) session_.release_count());
+    // The segments are contiguous, the messages are received in place.
+    EXPECT_EQ(0U, session_.reader()->bytes_copied());
+}
+
+// Same as StreamRead, with each segment in a separate buffer, as when the
+// receive ring wraps around.
+TEST_F(ReaderUnitTest, StreamReadCopy) {
+    uint8_t stream[4096];
+    int sizes[] = { 100, 400, 80, 110, 40, 60 };
+    uint8_t *data = stream;
+    for (size_t i = 0; i < ARRAYLEN(sizes); i++) {
+        CreateFakeMessage(data, sizes[i], sizes[i]);
+        data += sizes[i];
+    }
+    int segments[] = { 100 + 20, 200, 180 + 80 + 10, 7, 10, 83, 40, 60 };
+    vector<uint8_t *> copies;
+    data = stream;
+    for (size_t i = 0; i < ARRAYLEN(segments); i++) {
+        // Leave a gap between the copies.
+        uint8_t *copy = new uint8_t[segments[i] + 1];
+        memcpy(copy, data, segments[i]);
+        copies.push_back(copy);
+        session_.Read(mutable_buffer(copy, segments[i]));
+        data += segments[i];
+    }
+
+    int i = 0;
+    for (vector<int>::const_iterator iter = session_.begin();
+         iter != session_.end(); ++iter) {
+        EXPECT_EQ(sizes[i], *iter);
+        i++;
+    }
+    EXPECT_EQ(ARRAYLEN(sizes), i);
+    EXPECT_EQ(ARRAYLEN(segments), (size_t) session_.release_count());
+    EXPECT_LT(0U, session_.reader()->bytes_copied());
+    for (size_t i = 0; i < copies.size(); i++) {
+        delete [] copies[i];
+    }
+}
+
+// Receive a stream of messages from contiguous segments, as read into the
+// receive ring, or from separate buffers. Returns the time taken.
+static uint64_t ReadStream(size_t msglen, bool contiguous, size_t stream_size,
+                           uint64_t *bytes_copied) {
+    static const size_t kSegmentSize = 16 * 1024;
+    ReaderTestSession session(NULL, NULL);
+    size_t count = stream_size / msglen;
+    size_t length = count * msglen;
+    vector<uint8_t> stream(stream_size);
+    for (size_t i = 0; i < count; i++) {
+        CreateFakeMessage(&stream[i * msglen], msglen, msglen);
+    }
+
+    // Leave a gap after each segment, so that they are not adjacent.
+    vector<uint8_t> copy;
+    if (!contiguous) {
+        copy.resize(length + length / kSegmentSize + 1);
+        for (size_t offset = 0; offset < length; offset += kSegmentSize) {
+            size_t size = min(kSegmentSize, length - offset);
+            memcpy(&copy[offset + offset / kSegmentSize], &stream[offset],
+                   size);
+        }
+    }
+
+    uint64_t start = ClockMonotonicUsec();
+    for (size_t offset = 0; offset < length; offset += kSegmentSize) {
+        size_t size = min(kSegmentSize, length - offset);
+        uint8_t *data = contiguous ? &stream[offset] :
+            &copy[offset + offset / kSegmentSize];
+        session.Read(mutable_buffer(data, size));
+    }
+    uint64_t usecs = ClockMonotonicUsec() - start;
+
+    EXPECT_EQ(count, static_cast<size_t>(session.end() - session.begin()));
+    *bytes_copied = session.reader()->bytes_copied();
+    return usecs;
+}
+
+// Messages split over contiguous segments are not copied.
+TEST_F(ReaderUnitTest, StreamSegments) {
+    static const size_t kStreamSize = 256 * 1024;
+    uint64_t bytes_copied;
+    ReadStream(100, true, kStreamSize, &bytes_copied);
+    EXPECT_EQ(0U, bytes_copied);
+    ReadStream(100, false, kStreamSize, &bytes_copied);
+    EXPECT_LT(0U, bytes_copied);
+    ReadStream(4000, true, kStreamSize, &bytes_copied);
+    EXPECT_EQ(0U, bytes_copied);
+    ReadStream(4000, false, kStreamSize, &bytes_copied);
+    EXPECT_LT(0U, bytes_copied);
+}
+
+static void ReaderPerformance(size_t msglen, bool contiguous) {
+    static const size_t kStreamSize = 16 * 1024 * 1024;
+    uint64_t bytes_copied;
+    uint64_t usecs = ReadStream(msglen, contiguous, kStreamSize,
+                                &bytes_copied);
+    LOG(DEBUG, "Reader " << (contiguous ? "contiguous" : "copied")
+        << ": " << kStreamSize / msglen << " messages of " << msglen
+        << " bytes in " << usecs << " usecs, " << bytes_copied
+        << " bytes copied");
+}
+
+TEST_F(ReaderUnitTest, DISABLED_PerformanceSmall) {
+    ReaderPerformance(100, true);
+    ReaderPerformance(100, false);
+}
+
+TEST_F(ReaderUnitTest, DISABLED_PerformanceLarge) {
+    ReaderPerformance(4000, true);
+    ReaderPerformance(4000, false);
 }
 
 TEST_F(ReaderUnitTest, ZeroMsgLengthRead) {
@@ -452,6 +599,206 @@ TEST_F(ReaderUnitTest, ZeroMsgLengthRead) {
     TASK_UTIL_EXPECT_TRUE(session_.begin() == session_.end());
 }
 
+class FramedSession : public TcpSession {
+  public:
+    FramedSession(TcpServer *server, Socket *socket, bool drain_reads)
+        : TcpSession(server, socket),
+          reader_(new ReaderTest(this,
+                  boost::bind(&FramedSession::ReceiveMsg, this, _1, _2))) {
+        count_ = 0;
+        reads_ = 0;
+        set_drain_reads(drain_reads);
+    }
+
+    int count() const { return count_; }
+    // Reads which returned data.
+    int reads() const { return reads_; }
+    const ReaderTest *reader() const { return reader_.get(); }
+    // Called after the data of each read is handled.
+    void set_read_cb(boost::function<void()> cb) { read_cb_ = cb; }
+
+  protected:
+    virtual void OnRead(Buffer buffer) {
+        reader_->OnRead(buffer);
+        reads_++;
+        if (!read_cb_.empty()) {
+            read_cb_();
+        }
+    }
+
+  private:
+    bool ReceiveMsg(const u_int8_t *msg, size_t size) {
+        count_++;
+        return true;
+    }
+
+    std::auto_ptr<ReaderTest> reader_;
+    tbb::atomic<int> count_;
+    tbb::atomic<int> reads_;
+    boost::function<void()> read_cb_;
+};
+
+class FramedServer : public TcpServer {
+  public:
+    explicit FramedServer(EventManager *evm, bool drain_reads = false)
+        : TcpServer(evm), session_(NULL), drain_reads_(drain_reads) {
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        session_ = new FramedSession(this, socket, drain_reads_);
+        return session_;
+    }
+
+    FramedSession *session() const { return session_; }
+
+  private:
+    FramedSession *session_;
+    bool drain_reads_;
+};
+
+// Messages read through the receive ring of the session are only copied
+// when they wrap around the ring.
+TEST(ReceiveRingTest, StreamRead) {
+    static const int kMessages = 2000;
+    static const int kMessageSize = 1000;
+    static const int kBurst = 10;
+    auto_ptr<EventManager> evm(new EventManager());
+    ServerThread thread(evm.get());
+    FramedServer *server = new FramedServer(evm.get());
+    server->Initialize(0);
+    thread.Start();
+
+    TcpLocalClient client(server->GetPort());
+    client.Connect();
+    TASK_UTIL_ASSERT_TRUE(server->session() != NULL);
+
+    char burst[kBurst * kMessageSize];
+    for (int i = 0; i < kBurst; i++) {
+        CreateFakeMessage(reinterpret_cast<uint8_t *>(burst) +
+                          i * kMessageSize, kMessageSize, kMessageSize);
+    }
+    for (int i = 0; i < kMessages / kBurst; i++) {
+        client.Send(burst, sizeof(burst));
+    }
+    TASK_UTIL_EXPECT_EQ(kMessages, server->session()->count());
+    task_util::WaitForIdle();
+    EXPECT_LT(server->session()->reader()->bytes_copied(),
+              static_cast<uint64_t>(kMessages * kMessageSize / 2));
+
+    client.Close();
+    server->Shutdown();
+    server->ClearSessions();
+    task_util::WaitForIdle();
+    TcpServerManager::DeleteServer(server);
+    evm->Shutdown();
+    thread.Join();
+    task_util::WaitForIdle();
+}
+
+// Sends the chunks of a stream one at a time, the next one once the session
+// has read the previous one. The chunk is readable by the time the read of
+// the previous one is handled, so a session draining its reads reads it in
+// the same task.
+class ChunkSender {
+  public:
+    ChunkSender(TcpLocalClient *client, FramedSession *session,
+                const char *chunk, size_t size, int chunks)
+        : client_(client), session_(session), chunk_(chunk), size_(size),
+          chunks_(chunks), sent_(0) {
+    }
+
+    void Start() {
+        client_->Send(chunk_, size_);
+        sent_++;
+    }
+
+    // Called by the session once a read is handled, before the socket is
+    // read again.
+    void SendNext() {
+        if (sent_ == chunks_) {
+            return;
+        }
+        client_->Send(chunk_, size_);
+        sent_++;
+        boost::system::error_code error;
+        while (session_->socket()->available(error) < size_ && !error) {
+            usleep(10);
+        }
+    }
+
+  private:
+    TcpLocalClient *client_;
+    FramedSession *session_;
+    const char *chunk_;
+    size_t size_;
+    int chunks_;
+    int sent_;
+};
+
+// Receive a stream in chunks and return the number of reader tasks and of
+// reads which returned data.
+static void DrainReads(bool drain_reads, uint64_t *tasks, uint64_t *reads) {
+    static const int kChunks = 10;
+    static const int kMessageSize = 100;
+    static const int kBurst = 10;
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    TaskStats *stats =
+        scheduler->GetTaskStats(scheduler->GetTaskId("io::ReaderTask"));
+    auto_ptr<EventManager> evm(new EventManager());
+    ServerThread thread(evm.get());
+    FramedServer *server = new FramedServer(evm.get(), drain_reads);
+    server->Initialize(0);
+    thread.Start();
+
+    TcpLocalClient client(server->GetPort());
+    client.Connect();
+    TASK_UTIL_ASSERT_TRUE(server->session() != NULL);
+    uint64_t start_tasks = stats ? stats->enqueue_count_ : 0;
+
+    char burst[kBurst * kMessageSize];
+    for (int i = 0; i < kBurst; i++) {
+        CreateFakeMessage(reinterpret_cast<uint8_t *>(burst) +
+                          i * kMessageSize, kMessageSize, kMessageSize);
+    }
+    ChunkSender sender(&client, server->session(), burst, sizeof(burst),
+                       kChunks);
+    server->session()->set_read_cb(
+        boost::bind(&ChunkSender::SendNext, &sender));
+    sender.Start();
+    TASK_UTIL_EXPECT_EQ(kChunks * kBurst, server->session()->count());
+    task_util::WaitForIdle();
+    *tasks = stats ? stats->enqueue_count_ - start_tasks : 0;
+    *reads = server->session()->reads();
+    LOG(DEBUG, (drain_reads ? "Drained" : "Notified") << " reads: "
+        << kChunks << " chunks, " << *tasks << " reader tasks, "
+        << *reads << " reads, "
+        << server->session()->GetSocketStats().read_calls << " read calls");
+
+    server->session()->set_read_cb(boost::function<void()>());
+    client.Close();
+    server->Shutdown();
+    server->ClearSessions();
+    task_util::WaitForIdle();
+    TcpServerManager::DeleteServer(server);
+    evm->Shutdown();
+    thread.Join();
+    task_util::WaitForIdle();
+}
+
+// A session notified of its reads runs a reader task per chunk of the
+// stream. A session draining its reads reads all the chunks in a single
+// task, as each is readable before the socket would block.
+TEST(DrainReadsTest, StreamRead) {
+    static const uint64_t kChunks = 10;
+    uint64_t tasks, reads;
+    DrainReads(false, &tasks, &reads);
+    EXPECT_EQ(kChunks, reads);
+    EXPECT_EQ(kChunks, tasks);
+    DrainReads(true, &tasks, &reads);
+    EXPECT_EQ(kChunks, reads);
+    EXPECT_EQ(1U, tasks);
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
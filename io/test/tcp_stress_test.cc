@@ -7,6 +7,8 @@
 #include <sstream>
 
 #include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -17,6 +19,7 @@
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/program_options.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <tbb/mutex.h>
 
 #include <algorithm> 
@@ -26,11 +29,13 @@
 #include "base/logging.h"
 #include "base/parse_object.h"
 #include "base/task.h"
+#include "base/time_util.h"
 #include "base/timer.h"
 #include "base/test/task_test_util.h"
 #include "io/event_manager.h"
 #include "io/tcp_server.h"
 #include "io/tcp_session.h"
+#include "io/udp_server.h"
 #include "io/test/event_manager_test.h"
 #include "io/io_log.h"
 
@@ -555,6 +560,341 @@ TEST_P(EchoServerTest, ClientDisconnect) {
     }
     task_util::WaitForIdle();
 }
+
+class AcceptSession : public TcpSession {
+public:
+    AcceptSession(TcpServer *server, Socket *socket)
+        : TcpSession(server, socket) {
+    }
+
+protected:
+    virtual void OnRead(Buffer buffer) {
+    }
+};
+
+class AcceptServer : public TcpServer {
+public:
+    explicit AcceptServer(EventManager *evm) : TcpServer(evm) {
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new AcceptSession(this, socket);
+    }
+};
+
+class DatagramCountServer : public UdpServer {
+public:
+    explicit DatagramCountServer(EventManager *evm) : UdpServer(evm) {
+        count_ = 0;
+    }
+
+    virtual void OnRead(const boost::asio::const_buffer &recv_buffer,
+                        const boost::asio::ip::udp::endpoint &remote_endpoint) {
+        count_++;
+    }
+
+    int count() const { return count_; }
+
+private:
+    tbb::atomic<int> count_;
+};
+
+//
+// Servers with one or more listening sockets bound with SO_REUSEPORT. The
+// parameter is the number of sockets.
+//
+class ReusePortTest : public ::testing::TestWithParam<int> {
+protected:
+    ReusePortTest() : evm_(new EventManager()) {
+    }
+
+    virtual void SetUp() {
+        thread_.reset(new ServerThread(evm_.get()));
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        evm_->Shutdown();
+        task_util::WaitForIdle();
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+    }
+
+    // Returns the time taken to accept the connections.
+    uint64_t Accept(size_t connections) {
+        AcceptServer *server = new AcceptServer(evm_.get());
+        server->SetListenSocketCount(GetParam());
+        EXPECT_TRUE(server->Initialize(0));
+        thread_->Start();
+
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::endpoint endpoint(
+            boost::asio::ip::address::from_string("127.0.0.1", ec),
+            server->GetPort());
+        boost::asio::io_service io_service;
+        boost::ptr_vector<boost::asio::ip::tcp::socket> clients;
+        uint64_t start = ClockMonotonicUsec();
+        for (size_t i = 0; i < connections; ++i) {
+            boost::asio::ip::tcp::socket *socket =
+                new boost::asio::ip::tcp::socket(io_service);
+            clients.push_back(socket);
+            socket->connect(endpoint, ec);
+            EXPECT_FALSE(ec);
+        }
+        TASK_UTIL_EXPECT_EQ(connections, server->GetSessionCount());
+        uint64_t usecs = ClockMonotonicUsec() - start;
+
+        clients.clear();
+        server->Shutdown();
+        server->ClearSessions();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(server);
+        return usecs;
+    }
+
+    // Returns the time taken by the server to receive the datagrams.
+    uint64_t Receive(int datagrams) {
+        static const int kClients = 8;
+        static const int kWindow = 128;
+        DatagramCountServer *server = new DatagramCountServer(evm_.get());
+        server->SetSocketCount(GetParam());
+        EXPECT_TRUE(server->Initialize("127.0.0.1", 0));
+        server->StartReceive();
+        task_util::WaitForIdle();
+        thread_->Start();
+
+        // The kernel picks the socket from the source address and port, use
+        // several clients to spread the datagrams.
+        boost::system::error_code ec;
+        boost::asio::ip::udp::endpoint endpoint =
+            server->GetLocalEndpoint(&ec);
+        boost::asio::io_service io_service;
+        boost::ptr_vector<boost::asio::ip::udp::socket> clients;
+        for (int i = 0; i < kClients; ++i) {
+            boost::asio::ip::udp::socket *socket =
+                new boost::asio::ip::udp::socket(io_service);
+            clients.push_back(socket);
+            socket->open(boost::asio::ip::udp::v4(), ec);
+            EXPECT_FALSE(ec);
+        }
+
+        uint64_t start = ClockMonotonicUsec();
+        uint64_t deadline = start + 30 * 1000 * 1000;
+        for (int sent = 0; sent < datagrams; ) {
+            for (int i = 0; i < kWindow && sent < datagrams; ++i, ++sent) {
+                clients[sent % kClients].send_to(
+                    boost::asio::buffer(msg, 64), endpoint, 0, ec);
+            }
+            while (server->count() < sent &&
+                   ClockMonotonicUsec() < deadline) {
+                sched_yield();
+            }
+        }
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ(datagrams, server->count());
+
+        clients.clear();
+        server->Shutdown();
+        task_util::WaitForIdle();
+        UdpServerManager::DeleteServer(server);
+        return usecs;
+    }
+
+    auto_ptr<ServerThread> thread_;
+    auto_ptr<EventManager> evm_;
+};
+
+TEST_P(ReusePortTest, Accept) {
+    Accept(40);
+}
+
+TEST_P(ReusePortTest, Receive) {
+    Receive(1000);
+}
+
+// Accept rate and UDP throughput with one or more sockets.
+TEST_P(ReusePortTest, DISABLED_AcceptRate) {
+    static const size_t kConnections = 400;
+    uint64_t usecs = Accept(kConnections);
+    LOG(DEBUG, "Listen sockets " << GetParam() << ": accepted "
+        << kConnections << " connections in " << usecs << " usecs");
+}
+
+TEST_P(ReusePortTest, DISABLED_UdpThroughput) {
+    static const int kDatagrams = 50000;
+    uint64_t usecs = Receive(kDatagrams);
+    LOG(DEBUG, "UDP sockets " << GetParam() << ": received " << kDatagrams
+        << " datagrams in " << usecs << " usecs");
+}
+
+INSTANTIATE_TEST_CASE_P(ReusePort, ReusePortTest, ::testing::Values(1, 4));
+
+class EchoReplySession : public TcpSession {
+public:
+    EchoReplySession(TcpServer *server, Socket *socket)
+        : TcpSession(server, socket) {
+    }
+
+protected:
+    virtual void OnRead(Buffer buffer) {
+        Send(BufferData(buffer), BufferSize(buffer), NULL);
+    }
+};
+
+class EchoReplyServer : public TcpServer {
+public:
+    explicit EchoReplyServer(EventManager *evm) : TcpServer(evm) {
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new EchoReplySession(this, socket);
+    }
+};
+
+class EchoCountClient;
+class EchoCountSession : public TcpSession {
+public:
+    EchoCountSession(EchoCountClient *client, Socket *socket);
+
+protected:
+    virtual void OnRead(Buffer buffer);
+
+private:
+    EchoCountClient *client_;
+};
+
+class EchoCountClient : public TcpServer {
+public:
+    explicit EchoCountClient(EventManager *evm) : TcpServer(evm) {
+        rx_bytes_ = 0;
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new EchoCountSession(this, socket);
+    }
+
+    void AddRxBytes(size_t bytes) { rx_bytes_ += bytes; }
+    size_t rx_bytes() const { return rx_bytes_; }
+
+private:
+    tbb::atomic<size_t> rx_bytes_;
+};
+
+EchoCountSession::EchoCountSession(EchoCountClient *client, Socket *socket)
+    : TcpSession(client, socket), client_(client) {
+}
+
+void EchoCountSession::OnRead(Buffer buffer) {
+    client_->AddRxBytes(BufferSize(buffer));
+}
+
+//
+// Echo messages over concurrent sessions, with the sockets
+// spread over one or more io_services of the EventManager. The parameter
+// is the number of io_services.
+//
+class EventManagerPoolTest : public ::testing::TestWithParam<int> {
+protected:
+    EventManagerPoolTest() : evm_(new EventManager(GetParam())) {
+    }
+
+    virtual void SetUp() {
+        thread_.reset(new ServerThread(evm_.get()));
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        evm_->Shutdown();
+        task_util::WaitForIdle();
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+    }
+
+    // Returns the time taken to echo the messages over the sessions.
+    uint64_t Echo(size_t session_count, size_t messages) {
+        static const size_t kMessageSize = 256;
+
+        // Each session uses a socket on both ends.
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+            limit.rlim_cur < 2 * session_count + 256) {
+            limit.rlim_cur = std::min(limit.rlim_max,
+                                      rlim_t(2 * session_count + 256));
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+
+        EchoReplyServer *server = new EchoReplyServer(evm_.get());
+        EchoCountClient *client = new EchoCountClient(evm_.get());
+        EXPECT_TRUE(server->Initialize(0));
+        thread_->Start();
+        EXPECT_EQ(static_cast<size_t>(GetParam()), evm_->io_service_count());
+
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::endpoint endpoint(
+            boost::asio::ip::address::from_string("127.0.0.1", ec),
+            server->GetPort());
+        vector<TcpSession *> sessions;
+        for (size_t i = 0; i < session_count; ++i) {
+            TcpSession *session = client->CreateSession();
+            client->Connect(session, endpoint);
+            sessions.push_back(session);
+        }
+        TASK_UTIL_EXPECT_EQ(session_count, server->GetSessionCount());
+        for (size_t i = 0; i < session_count; ++i) {
+            TASK_UTIL_EXPECT_TRUE(sessions[i]->IsEstablished());
+        }
+
+        const size_t total = session_count * messages * kMessageSize;
+        uint64_t start = ClockMonotonicUsec();
+        uint64_t deadline = start + 60 * 1000 * 1000;
+        for (size_t m = 0; m < messages; ++m) {
+            for (size_t i = 0; i < session_count; ++i) {
+                sessions[i]->Send(reinterpret_cast<const uint8_t *>(msg),
+                                  kMessageSize, NULL);
+            }
+        }
+        while (client->rx_bytes() < total &&
+               ClockMonotonicUsec() < deadline) {
+            sched_yield();
+        }
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ(total, client->rx_bytes());
+
+        for (size_t i = 0; i < session_count; ++i) {
+            client->DeleteSession(sessions[i]);
+        }
+        client->Shutdown();
+        client->ClearSessions();
+        server->Shutdown();
+        server->ClearSessions();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(client);
+        TcpServerManager::DeleteServer(server);
+        return usecs;
+    }
+
+    auto_ptr<ServerThread> thread_;
+    auto_ptr<EventManager> evm_;
+};
+
+TEST_P(EventManagerPoolTest, EchoSessions) {
+    Echo(50, 5);
+}
+
+// Echo throughput with one or more io_services.
+TEST_P(EventManagerPoolTest, DISABLED_Throughput) {
+    static const size_t kSessions = 2000;
+    static const size_t kMessages = 20;
+    uint64_t usecs = Echo(kSessions, kMessages);
+    LOG(DEBUG, "io_services " << evm_->io_service_count() << ": echoed "
+        << kSessions * kMessages << " messages over " << kSessions
+        << " sessions in " << usecs << " usecs");
+}
+
+INSTANTIATE_TEST_CASE_P(EventManagerPool, EventManagerPoolTest,
+                        ::testing::Values(1, 4));
 }  // namespace
 
 static vector<int> n_servers = boost::assign::list_of(64);
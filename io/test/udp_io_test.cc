@@ -2,11 +2,15 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <sched.h>
+#include <string.h>
+
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 
 #include "testing/gunit.h"
 #include "base/task.h"
+#include "base/time_util.h"
 #include "base/test/task_test_util.h"
 #include "io/event_manager.h"
 #include "io/udp_server.h"
@@ -366,6 +370,138 @@ TEST_F(UdpRecvTest, Basic) {
     task_util::WaitForIdle();
 }
 
+TEST_F(UdpRecvTest, Batched) {
+    server_->SetBatchSize(16);
+    server_->Initialize(0);
+    server_->StartReceive();
+    task_util::WaitForIdle();
+    thread_->Start();  // Must be called after initialization
+    error_code ec;
+    udp::endpoint ep = server_->GetLocalEndpoint(&ec);
+    EXPECT_TRUE(!ec);
+    UdpLocalClient client(evm_.get()->io_service(), ep.port());
+    TASK_UTIL_EXPECT_TRUE(client.Connect());
+    string msg = "Test Message";
+    size_t len = 0;
+    for (int i = 0; i < 50; ++i) {
+        len += client.Send(msg.c_str(), msg.length());
+    }
+    TASK_UTIL_EXPECT_EQ(50, server_->GetNumRecvMsg());
+    SocketIOStats rx_stats;
+    server_->GetRxSocketStats(&rx_stats);
+    EXPECT_EQ(50, rx_stats.calls);
+    EXPECT_EQ(len, rx_stats.bytes);
+    client.Close();
+    task_util::WaitForIdle();
+}
+
+class UdpBatchTest : public ::testing::Test {
+protected:
+    UdpBatchTest() {
+    }
+
+    virtual void SetUp() {
+        evm_.reset(new EventManager());
+        server_ = new UdpRecvServerTest(evm_.get());
+        client_ = new UdpServer(evm_.get());
+        thread_.reset(new ServerThread(evm_.get()));
+    }
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        evm_->Shutdown();
+        task_util::WaitForIdle();
+        client_->Shutdown();
+        server_->Shutdown();
+        task_util::WaitForIdle();
+        UdpServerManager::DeleteServer(client_);
+        UdpServerManager::DeleteServer(server_);
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+        task_util::WaitForIdle();
+    }
+
+    void Start(size_t batch_size) {
+        server_->SetBatchSize(batch_size);
+        client_->SetBatchSize(batch_size);
+        server_->Initialize("127.0.0.1", 0);
+        client_->Initialize("127.0.0.1", 0);
+        server_->StartReceive();
+        task_util::WaitForIdle();
+        thread_->Start();
+    }
+
+    // Send count datagrams to the server, keeping at most window datagrams
+    // in flight to avoid drops in the socket receive buffer. Returns the
+    // number of datagrams received by the server.
+    int Send(int count, int window, size_t size) {
+        error_code ec;
+        udp::endpoint ep = server_->GetLocalEndpoint(&ec);
+        int received = server_->GetNumRecvMsg();
+        int expected = received + count;
+        uint64_t deadline = ClockMonotonicUsec() + 30 * 1000 * 1000;
+        for (int sent = 0; sent < count; ) {
+            for (int i = 0; i < window && sent < count; ++i, ++sent) {
+                mutable_buffer send = client_->AllocateBuffer(size);
+                memset(buffer_cast<uint8_t *>(send), 'x', size);
+                client_->StartSend(ep, size, send);
+            }
+            while (server_->GetNumRecvMsg() < expected - (count - sent) &&
+                   ClockMonotonicUsec() < deadline) {
+                sched_yield();
+            }
+        }
+        return server_->GetNumRecvMsg() - received;
+    }
+
+    std::auto_ptr<ServerThread> thread_;
+    std::auto_ptr<EventManager> evm_;
+    UdpRecvServerTest *server_;
+    UdpServer *client_;
+};
+
+TEST_F(UdpBatchTest, SendReceive) {
+    Start(8);
+    EXPECT_EQ(8U, client_->batch_size());
+    EXPECT_EQ(100, Send(100, 20, 100));
+    SocketIOStats tx_stats;
+    client_->GetTxSocketStats(&tx_stats);
+    EXPECT_EQ(100, tx_stats.calls);
+    EXPECT_EQ(100 * 100, tx_stats.bytes);
+    EXPECT_EQ(0, tx_stats.errors);
+    SocketIOStats rx_stats;
+    server_->GetRxSocketStats(&rx_stats);
+    EXPECT_EQ(100, rx_stats.calls);
+    EXPECT_EQ(100 * 100, rx_stats.bytes);
+}
+
+TEST_F(UdpBatchTest, MaxBatchSize) {
+    Start(1000);
+    EXPECT_EQ(UdpServer::kMaxBatchSize, server_->batch_size());
+    EXPECT_EQ(10, Send(10, 10, 10));
+}
+
+// Packets per second over loopback, with and without batching.
+TEST_F(UdpBatchTest, DISABLED_Performance) {
+    static const int kCount = 100000;
+    static const size_t kBatchSizes[] = { 1, 32 };
+    for (size_t i = 0; i < sizeof(kBatchSizes) / sizeof(kBatchSizes[0]);
+         ++i) {
+        if (i > 0) {
+            TearDown();
+            SetUp();
+        }
+        Start(kBatchSizes[i]);
+        uint64_t start = ClockMonotonicUsec();
+        int received = Send(kCount, 128, 64);
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ(kCount, received);
+        LOG(DEBUG, "UdpServer batch size " << kBatchSizes[i] << ": "
+            << received << " datagrams in " << usecs << " usecs, "
+            << (received * 1000000ULL) / (usecs ? usecs : 1) << " pps");
+    }
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
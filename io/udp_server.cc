@@ -4,11 +4,24 @@
 
 #include "io/udp_server.h"
 
+#include <errno.h>
+#include <string.h>
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include <boost/asio/detail/socket_option.hpp>
 #include <boost/bind.hpp>
 
 #include "base/logging.h"
 #include "base/address_util.h"
+#include "io/buffer_pool.h"
 #include "io/io_log.h"
+#include "io/io_uring.h"
 #include "io/io_utils.h"
 
 using boost::asio::buffer_cast;
@@ -16,25 +29,53 @@ using boost::asio::mutable_buffer;
 using boost::asio::mutable_buffers_1;
 using boost::asio::const_buffer;
 using boost::asio::ip::udp;
+using boost::asio::null_buffers;
 
 int UdpServer::reader_task_id_ = -1;
 
+#ifdef SO_REUSEPORT
+typedef boost::asio::detail::socket_option::boolean<
+    SOL_SOCKET, SO_REUSEPORT> reuse_port_t;
+#endif
+
+const size_t UdpServer::kMaxBatchSize;
+const size_t UdpServer::kMaxSocketCount;
+
+// Message header of a datagram sent through io_uring.
+struct UdpServer::RingSend {
+    RingSend(const udp::endpoint &remote_endpoint, const const_buffer &buffer)
+        : remote_endpoint(remote_endpoint), buffer(buffer) {
+        iov.iov_base = const_cast<uint8_t *>(
+            buffer_cast<const uint8_t *>(buffer));
+        iov.iov_len = buffer_size(buffer);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = this->remote_endpoint.data();
+        msg.msg_namelen = this->remote_endpoint.size();
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+    }
+    udp::endpoint remote_endpoint;
+    const_buffer buffer;
+    struct iovec iov;
+    struct msghdr msg;
+};
+
 class UdpServer::Reader : public Task {
 public:
-    Reader(UdpServerPtr server, const udp::endpoint &remote_endpoint,
-        const const_buffer &buffer)
-        : Task(server->reader_task_id(),
-               server->reader_task_instance(remote_endpoint)),
-        server_(server),
-        remote_endpoint_(remote_endpoint),
-        buffer_(buffer) {
+    Reader(UdpServerPtr server, int instance, DatagramList *datagrams)
+        : Task(server->reader_task_id(), instance),
+        server_(server) {
+        datagrams_.swap(*datagrams);
     }
 
     virtual bool Run() {
         tbb::mutex::scoped_lock lock(server_->state_guard_);
         if (server_->state_ == OK) {
-            server_->OnRead(buffer_, remote_endpoint_);
-            server_->DeallocateBuffer(buffer_);
+            for (DatagramList::const_iterator it = datagrams_.begin();
+                 it != datagrams_.end(); ++it) {
+                server_->OnRead(it->buffer, it->remote_endpoint);
+                server_->DeallocateBuffer(it->buffer);
+            }
         }
         return true;
     }
@@ -42,15 +83,21 @@ public:
 
 private:
     UdpServerPtr server_;
-    udp::endpoint remote_endpoint_;
-    const_buffer buffer_;
+    DatagramList datagrams_;
 };
 
 UdpServer::UdpServer(boost::asio::io_service *io_service, int buffer_size):
     socket_(*io_service),
+    io_service_(io_service),
     buffer_size_(buffer_size),
     state_(Uninitialized),
-    evm_(NULL) {
+    evm_(NULL),
+    counter_instance_(CounterRegistry::GetInstance()->NewInstanceId()),
+    socket_count_(1),
+    receive_index_(0),
+    batch_size_(1),
+    send_uring_(NULL),
+    send_pending_(false) {
     if (reader_task_id_ == -1) {
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
         reader_task_id_ = scheduler->GetTaskId("io::udp::ReaderTask");
@@ -61,9 +108,16 @@ UdpServer::UdpServer(boost::asio::io_service *io_service, int buffer_size):
 
 UdpServer::UdpServer(EventManager *evm, int buffer_size):
     socket_(*(evm->io_service())),
+    io_service_(evm->io_service()),
     buffer_size_(buffer_size),
     state_(Uninitialized),
-    evm_(evm) {
+    evm_(evm),
+    counter_instance_(CounterRegistry::GetInstance()->NewInstanceId()),
+    socket_count_(1),
+    receive_index_(0),
+    batch_size_(1),
+    send_uring_(NULL),
+    send_pending_(false) {
     if (reader_task_id_ == -1) {
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
         reader_task_id_ = scheduler->GetTaskId("io::udp::ReaderTask");
@@ -76,11 +130,40 @@ int UdpServer::reader_task_instance(const udp::endpoint &rep) const {
     return Task::kTaskInstanceAny;
 }
 
+// With several sockets, the datagrams of each socket are read by a task
+// instance of their own, unless the derived class picks the instance.
+int UdpServer::ReaderTaskInstance(const udp::endpoint &remote_endpoint) const {
+    int instance = reader_task_instance(remote_endpoint);
+    if (instance == Task::kTaskInstanceAny && socket_count_ > 1) {
+        instance = receive_index_;
+    }
+    return instance;
+}
+
 void UdpServer::SetName(udp::endpoint ep) {
     std::ostringstream s;
     boost::system::error_code ec;
     s << "Udpsocket@" << ep;
     name_ = s.str();
+    stats_.RegisterCounters(CounterPrefix());
+}
+
+std::string UdpServer::CounterPrefix() const {
+    std::ostringstream out;
+    out << "io.udp_server." << name_ << "#" << counter_instance_ << ".";
+    return out.str();
+}
+
+void UdpServer::SetSocketCount(size_t count) {
+#ifdef SO_REUSEPORT
+    socket_count_ = std::max(size_t(1), std::min(count, kMaxSocketCount));
+#endif
+}
+
+void UdpServer::SetBatchSize(size_t batch_size) {
+#if defined(__linux__)
+    batch_size_ = std::max(size_t(1), std::min(batch_size, kMaxBatchSize));
+#endif
 }
 
 UdpServer::~UdpServer() {
@@ -100,10 +183,22 @@ void UdpServer::Shutdown() {
     {
         tbb::mutex::scoped_lock lock_pbuf(pbuf_guard_);
         while (!pbuf_.empty()) {
-            delete[] pbuf_.back();
+            io::BufferPool::GetInstance()->Free(pbuf_.back());
             pbuf_.pop_back();
         }
     }
+    for (size_t i = 0; i < receivers_.size(); ++i) {
+        receivers_[i].batch.clear();
+        // Closing the socket does not complete an io_uring receive.
+        if (receivers_[i].recv_op) {
+            receivers_[i].uring->Cancel(receivers_[i].recv_op);
+        }
+    }
+    {
+        tbb::mutex::scoped_lock lock_send(send_guard_);
+        send_queue_.clear();
+        send_pending_ = false;
+    }
     if (socket_.is_open()) {
         boost::system::error_code ec;
         socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
@@ -117,6 +212,13 @@ void UdpServer::Shutdown() {
                 "ERROR closing UDP socket: " << ec);
         }
     }
+    for (size_t i = 0; i < reuse_port_sockets_.size(); ++i) {
+        boost::system::error_code ec;
+        reuse_port_sockets_[i].close(ec);
+    }
+    reuse_port_sockets_.clear();
+    if (!name_.empty())
+        stats_.UnregisterCounters(CounterPrefix());
     state_ = Uninitialized;
 }
 
@@ -152,7 +254,14 @@ bool UdpServer::Initialize(udp::endpoint local_endpoint) {
         state_ = SocketOpenFailed;
         return false;
     }
-    socket_.bind(local_endpoint, error);
+#ifdef SO_REUSEPORT
+    if (socket_count_ > 1) {
+        socket_.set_option(reuse_port_t(true), error);
+    }
+#endif
+    if (!error) {
+        socket_.bind(local_endpoint, error);
+    }
     if (error) {
         boost::system::error_code ec;
         UDP_SERVER_LOG_ERROR(this, UDP_DIR_NA, "UDP socket bind FAILED: "
@@ -161,13 +270,62 @@ bool UdpServer::Initialize(udp::endpoint local_endpoint) {
         socket_.close(ec);
         return false;
     }
+    // The other sockets are bound to the port picked by socket_.
+    local_endpoint.port(socket_.local_endpoint(error).port());
+    if (!OpenReusePortSockets(local_endpoint)) {
+        boost::system::error_code ec;
+        state_ = SocketBindFailed;
+        socket_.close(ec);
+        return false;
+    }
+    receivers_.resize(socket_count_);
+    receivers_[0].socket = &socket_;
+    for (size_t i = 1; i < socket_count_; ++i) {
+        receivers_[i].socket = &reuse_port_sockets_[i - 1];
+    }
+    if (evm_) {
+        send_uring_ = evm_->GetIoUring(io_service_);
+        for (size_t i = 0; i < socket_count_; ++i) {
+            receivers_[i].uring = evm_->GetIoUring(
+                EventManager::GetIoService(receivers_[i].socket));
+        }
+    }
     SetName(local_endpoint);
     state_ = OK;
     return true;
 }
 
+bool UdpServer::OpenReusePortSockets(const udp::endpoint &local_endpoint) {
+#ifdef SO_REUSEPORT
+    for (size_t i = 1; i < socket_count_; ++i) {
+        Socket *socket =
+            new Socket(evm_ ? *evm_->PickIoService(i) : *io_service_);
+        reuse_port_sockets_.push_back(socket);
+        boost::system::error_code error;
+        socket->open(udp::v4(), error);
+        if (!error) {
+            socket->set_option(reuse_port_t(true), error);
+        }
+        if (!error) {
+            socket->bind(local_endpoint, error);
+        }
+        if (error) {
+            UDP_SERVER_LOG_ERROR(this, UDP_DIR_NA, "UDP socket bind FAILED: "
+                << error.message() << ":" << local_endpoint);
+            for (size_t j = 0; j < reuse_port_sockets_.size(); ++j) {
+                boost::system::error_code ec;
+                reuse_port_sockets_[j].close(ec);
+            }
+            reuse_port_sockets_.clear();
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
 mutable_buffer UdpServer::AllocateBuffer(std::size_t s) {
-    uint8_t *p = new uint8_t[s];
+    uint8_t *p = io::BufferPool::GetInstance()->Allocate(s);
     {
         tbb::mutex::scoped_lock lock(pbuf_guard_);
         pbuf_.push_back(p);
@@ -188,12 +346,17 @@ void UdpServer::DeallocateBuffer(const const_buffer &buffer) {
         if (f != pbuf_.end())
             pbuf_.erase(f);
     }
-    delete[] p;
+    io::BufferPool::GetInstance()->Free(p);
 }
 
 void UdpServer::StartSend(udp::endpoint ep, std::size_t bytes_to_send,
         const_buffer buffer) {
-    if (state_ == OK) {
+    if (state_ == OK && batch_size_ > 1) {
+        EnqueueSend(ep, buffer);
+    } else if (state_ == OK) {
+        if (send_uring_ && StartSendRing(ep, buffer)) {
+            return;
+        }
         socket_.async_send_to(boost::asio::buffer(buffer), ep,
             boost::bind(&UdpServer::HandleSendInternal, UdpServerPtr(this),
             buffer, ep,
@@ -232,13 +395,135 @@ void UdpServer::HandleSendInternal(const const_buffer send_buffer,
     HandleSend(send_buffer, remote_endpoint, bytes_transferred, error);
 }
 
+// Queue the datagram and wait for the socket to be writable, if not already
+// waiting. The datagrams queued in the meantime are sent together.
+void UdpServer::EnqueueSend(const udp::endpoint &ep, const const_buffer &buffer) {
+    tbb::mutex::scoped_lock lock(send_guard_);
+    send_queue_.push_back(Datagram(buffer, ep));
+    if (send_pending_)
+        return;
+    send_pending_ = true;
+    socket_.async_send(null_buffers(),
+        boost::bind(&UdpServer::HandleSendReady, UdpServerPtr(this),
+        boost::asio::placeholders::error));
+}
+
+void UdpServer::HandleSendReady(const boost::system::error_code &error) {
+    tbb::mutex::scoped_lock lock(state_guard_);
+    if (state_ != OK) {
+        stats_.write_errors++;
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_OUT,
+            "Send UDP server in WRONG state: " << state_);
+        DropSendQueue();
+        return;
+    }
+    if (error) {
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_OUT,
+            "Send FAILED due to error: " << error.value() << " : " <<
+            error.message());
+        DropSendQueue();
+        return;
+    }
+    SendBatch();
+}
+
+void UdpServer::DropSendQueue() {
+    tbb::mutex::scoped_lock lock(send_guard_);
+    while (!send_queue_.empty()) {
+        stats_.write_errors++;
+        DeallocateBuffer(send_queue_.front().buffer);
+        send_queue_.pop_front();
+    }
+    send_pending_ = false;
+}
+
+// Send up to batch_size_ queued datagrams with a single sendmmsg, and wait
+// for the socket to be writable again if datagrams are left in the queue.
+void UdpServer::SendBatch() {
+#if defined(__linux__)
+    DatagramList batch;
+    {
+        tbb::mutex::scoped_lock lock(send_guard_);
+        while (!send_queue_.empty() && batch.size() < batch_size_) {
+            batch.push_back(send_queue_.front());
+            send_queue_.pop_front();
+        }
+    }
+
+    struct mmsghdr msgs[kMaxBatchSize];
+    struct iovec iovecs[kMaxBatchSize];
+    memset(msgs, 0, sizeof(msgs[0]) * batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        iovecs[i].iov_base = const_cast<uint8_t *>(
+            buffer_cast<const uint8_t *>(batch[i].buffer));
+        iovecs[i].iov_len = buffer_size(batch[i].buffer);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = batch[i].remote_endpoint.data();
+        msgs[i].msg_hdr.msg_namelen = batch[i].remote_endpoint.size();
+    }
+
+    size_t sent = 0;
+    int count = sendmmsg(socket_.native_handle(), msgs, batch.size(),
+                         MSG_DONTWAIT);
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        // The first datagram failed, the others are retried.
+        stats_.write_errors++;
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_OUT,
+            "Send to " << batch[0].remote_endpoint <<
+            " FAILED due to error: " << errno << " : " << strerror(errno));
+        DeallocateBuffer(batch[0].buffer);
+        sent = 1;
+    }
+    for (int i = 0; i < count; ++i, ++sent) {
+        // Update write statistics.
+        stats_.write_calls++;
+        stats_.write_bytes += msgs[i].msg_len;
+        // Call the handler
+        HandleSend(batch[i].buffer, batch[i].remote_endpoint, msgs[i].msg_len,
+                   boost::system::error_code());
+    }
+
+    tbb::mutex::scoped_lock lock(send_guard_);
+    send_queue_.insert(send_queue_.begin(), batch.begin() + sent, batch.end());
+    if (send_queue_.empty()) {
+        send_pending_ = false;
+        return;
+    }
+    socket_.async_send(null_buffers(),
+        boost::bind(&UdpServer::HandleSendReady, UdpServerPtr(this),
+        boost::asio::placeholders::error));
+#endif
+}
+
 void UdpServer::StartReceive() {
-    if (state_ == OK) {
+    if (state_ != OK) {
+        stats_.read_errors++;
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_NA,
+            "StartReceive UDP server in WRONG state: " << state_);
+        return;
+    }
+    for (size_t i = 0; i < receivers_.size(); ++i) {
+        StartReceive(i);
+    }
+}
+
+void UdpServer::StartReceive(size_t index) {
+    Receiver *receiver = &receivers_[index];
+    if (state_ == OK && batch_size_ > 1) {
+        receiver->socket->async_receive(null_buffers(),
+            boost::bind(&UdpServer::HandleReceiveReady, UdpServerPtr(this),
+            index, boost::asio::placeholders::error));
+    } else if (state_ == OK) {
+        if (receiver->uring && StartReceiveRing(index)) {
+            return;
+        }
         mutable_buffer b(AllocateBuffer());
         const_buffer buffer(buffer_cast<const uint8_t*>(b), buffer_size(b));
-        socket_.async_receive_from(mutable_buffers_1(b),
-            remote_endpoint_, boost::bind(&UdpServer::HandleReceiveInternal,
-            UdpServerPtr(this), buffer,
+        receiver->socket->async_receive_from(mutable_buffers_1(b),
+            receiver->remote_endpoint,
+            boost::bind(&UdpServer::HandleReceiveInternal,
+            UdpServerPtr(this), index, buffer,
             boost::asio::placeholders::bytes_transferred,
             boost::asio::placeholders::error));
     } else {
@@ -248,9 +533,14 @@ void UdpServer::StartReceive() {
     }
 }
 
-void UdpServer::HandleReceiveInternal(const_buffer recv_buffer,
+void UdpServer::HandleReceiveInternal(size_t index, const_buffer recv_buffer,
     std::size_t bytes_transferred, const boost::system::error_code& error) {
     tbb::mutex::scoped_lock lock(state_guard_);
+    HandleReceiveLocked(index, recv_buffer, bytes_transferred, error);
+}
+
+void UdpServer::HandleReceiveLocked(size_t index, const_buffer recv_buffer,
+    std::size_t bytes_transferred, const boost::system::error_code& error) {
     if (state_ != OK) {
         stats_.read_errors++;
         UDP_SERVER_LOG_ERROR(this, UDP_DIR_IN,
@@ -268,9 +558,169 @@ void UdpServer::HandleReceiveInternal(const_buffer recv_buffer,
         stats_.read_calls++;
         stats_.read_bytes += bytes_transferred;
         // Call the handler
-        HandleReceive(recv_buffer, remote_endpoint_, bytes_transferred, error);
+        receive_index_ = index;
+        HandleReceive(recv_buffer, receivers_[index].remote_endpoint,
+                      bytes_transferred, error);
+    }
+    StartReceive(index);
+}
+
+// The buffer is owned by the operation until it completes, as the kernel
+// may still write into it after Shutdown. Return false if the submission
+// queue is full.
+bool UdpServer::StartReceiveRing(size_t index) {
+    Receiver *receiver = &receivers_[index];
+    uint8_t *data = io::BufferPool::GetInstance()->Allocate(buffer_size_);
+    receiver->iov.iov_base = data;
+    receiver->iov.iov_len = buffer_size_;
+    memset(&receiver->msg, 0, sizeof(receiver->msg));
+    receiver->msg.msg_name = receiver->remote_endpoint.data();
+    receiver->msg.msg_namelen = receiver->remote_endpoint.capacity();
+    receiver->msg.msg_iov = &receiver->iov;
+    receiver->msg.msg_iovlen = 1;
+    receiver->recv_op = receiver->uring->RecvMsg(
+        receiver->socket->native_handle(), &receiver->msg,
+        boost::bind(&UdpServer::HandleReceiveRing, UdpServerPtr(this),
+                    index, data, _1));
+    if (receiver->recv_op == 0) {
+        io::BufferPool::GetInstance()->Free(data);
+        return false;
+    }
+    return true;
+}
+
+void UdpServer::HandleReceiveRing(size_t index, uint8_t *data, int result) {
+    tbb::mutex::scoped_lock lock(state_guard_);
+    Receiver *receiver = &receivers_[index];
+    receiver->recv_op = 0;
+    if (state_ != OK) {
+        io::BufferPool::GetInstance()->Free(data);
+        return;
+    }
+    {
+        tbb::mutex::scoped_lock lock_pbuf(pbuf_guard_);
+        pbuf_.push_back(data);
+    }
+    boost::system::error_code error;
+    if (result < 0) {
+        error = io::IoUring::ResultError(result);
+    } else {
+        receiver->remote_endpoint.resize(receiver->msg.msg_namelen);
+    }
+    HandleReceiveLocked(index, const_buffer(data, buffer_size_),
+                        result < 0 ? 0 : result, error);
+}
+
+bool UdpServer::StartSendRing(const udp::endpoint &ep,
+                              const const_buffer &buffer) {
+    RingSend *send = new RingSend(ep, buffer);
+    if (send_uring_->SendMsg(socket_.native_handle(), &send->msg, 0,
+            boost::bind(&UdpServer::HandleSendRing, UdpServerPtr(this), send,
+                        _1)) == 0) {
+        delete send;
+        return false;
+    }
+    return true;
+}
+
+void UdpServer::HandleSendRing(RingSend *send, int result) {
+    boost::system::error_code error;
+    if (result < 0) {
+        error = io::IoUring::ResultError(result);
+    }
+    HandleSendInternal(send->buffer, send->remote_endpoint,
+                       result < 0 ? 0 : result, error);
+    delete send;
+}
+
+void UdpServer::HandleReceiveReady(size_t index,
+                                   const boost::system::error_code &error) {
+    tbb::mutex::scoped_lock lock(state_guard_);
+    if (state_ != OK) {
+        stats_.read_errors++;
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_IN,
+            "Receive UDP server in WRONG state: " << state_);
+        return;
+    }
+    if (error) {
+        stats_.read_errors++;
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_IN,
+            "Read FAILED due to error: " << error.value() << " : " <<
+            error.message());
+    } else {
+        ReceiveBatch(index);
+    }
+    StartReceive(index);
+}
+
+// Read up to batch_size_ datagrams with a single recvmmsg. The buffers
+// handed over to HandleReceiveBatch are replaced in the batch of the
+// receiver.
+void UdpServer::ReceiveBatch(size_t index) {
+#if defined(__linux__)
+    Receiver *receiver = &receivers_[index];
+    std::vector<uint8_t *> &recv_batch = receiver->batch;
+    recv_batch.resize(batch_size_);
+    struct mmsghdr msgs[kMaxBatchSize];
+    struct iovec iovecs[kMaxBatchSize];
+    struct sockaddr_storage addrs[kMaxBatchSize];
+    memset(msgs, 0, sizeof(msgs[0]) * batch_size_);
+    for (size_t i = 0; i < batch_size_; ++i) {
+        if (recv_batch[i] == NULL) {
+            recv_batch[i] = buffer_cast<uint8_t *>(AllocateBuffer());
+        }
+        iovecs[i].iov_base = recv_batch[i];
+        iovecs[i].iov_len = buffer_size_;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    int count = recvmmsg(receiver->socket->native_handle(), msgs, batch_size_,
+                         MSG_DONTWAIT, NULL);
+    if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return;
+        stats_.read_errors++;
+        UDP_SERVER_LOG_ERROR(this, UDP_DIR_IN,
+            "Read FAILED due to error: " << errno << " : " << strerror(errno));
+        return;
+    }
+
+    DatagramList datagrams;
+    for (int i = 0; i < count; ++i) {
+        udp::endpoint remote_endpoint;
+        memcpy(remote_endpoint.data(), &addrs[i], msgs[i].msg_hdr.msg_namelen);
+        remote_endpoint.resize(msgs[i].msg_hdr.msg_namelen);
+        // Update read statistics.
+        stats_.read_calls++;
+        stats_.read_bytes += msgs[i].msg_len;
+        datagrams.push_back(Datagram(
+            const_buffer(recv_batch[i], msgs[i].msg_len), remote_endpoint));
+        recv_batch[i] = NULL;
+    }
+    receive_index_ = index;
+    HandleReceiveBatch(&datagrams);
+#endif
+}
+
+void UdpServer::HandleReceiveBatch(DatagramList *datagrams) {
+    // Keep the datagrams of a reader task instance in the same task, as
+    // they would be with one task per datagram.
+    std::map<int, DatagramList> instance_map;
+    for (DatagramList::const_iterator it = datagrams->begin();
+         it != datagrams->end(); ++it) {
+        instance_map[ReaderTaskInstance(it->remote_endpoint)].push_back(*it);
+    }
+    datagrams->clear();
+
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    for (std::map<int, DatagramList>::iterator it = instance_map.begin();
+         it != instance_map.end(); ++it) {
+        scheduler->Enqueue(new Reader(UdpServerPtr(this), it->first,
+                                      &it->second));
     }
-    StartReceive();
 }
 
 void UdpServer::HandleReceive(const const_buffer &recv_buffer,
@@ -278,8 +728,10 @@ void UdpServer::HandleReceive(const const_buffer &recv_buffer,
     const boost::system::error_code& error) {
     const_buffer rdbuf(buffer_cast<const uint8_t *>(recv_buffer),
                        bytes_transferred);
-    Reader *task = new Reader(UdpServerPtr(this), remote_endpoint,
-                              rdbuf);
+    DatagramList datagrams(1, Datagram(rdbuf, remote_endpoint));
+    Reader *task = new Reader(UdpServerPtr(this),
+                              ReaderTaskInstance(remote_endpoint),
+                              &datagrams);
     // Starting a new task for the session
     TaskScheduler *scheduler = TaskScheduler::GetInstance();
     scheduler->Enqueue(task);
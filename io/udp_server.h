@@ -5,15 +5,21 @@
 #ifndef SRC_IO_UDP_SERVER_H_
 #define SRC_IO_UDP_SERVER_H_
 
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <deque>
 #include <string>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include "io/event_manager.h"
 #include "io/server_manager.h"
 #include "io/io_utils.h"
 
 class SocketIOStats;
+namespace io { class IoUring; }
 
 class UdpServer {
 public:
@@ -27,6 +33,19 @@ public:
         SocketBindFailed,
     };
     static const int kDefaultBufferSize = 4 * 1024;
+    static const size_t kMaxBatchSize = 64;
+    static const size_t kMaxSocketCount = 64;
+
+    // A received datagram, or a datagram queued for transmission.
+    struct Datagram {
+        Datagram(const boost::asio::const_buffer &buffer,
+                 const Endpoint &remote_endpoint)
+            : buffer(buffer), remote_endpoint(remote_endpoint) {
+        }
+        boost::asio::const_buffer buffer;
+        Endpoint remote_endpoint;
+    };
+    typedef std::vector<Datagram> DatagramList;
 
     explicit UdpServer(EventManager *evm, int buffer_size = kDefaultBufferSize);
     explicit UdpServer(boost::asio::io_service *io_service,
@@ -38,6 +57,22 @@ public:
     virtual bool Initialize(boost::asio::ip::udp::endpoint local_endpoint);
     virtual void Shutdown();
 
+    // Receive and send up to batch_size datagrams per system call, using
+    // recvmmsg and sendmmsg. Received datagrams are passed to
+    // HandleReceiveBatch instead of HandleReceive. Must be called before
+    // StartReceive. Ignored on platforms without recvmmsg.
+    void SetBatchSize(size_t batch_size);
+    size_t batch_size() const { return batch_size_; }
+
+    // Receive on count sockets bound to the same endpoint with SO_REUSEPORT,
+    // so that the kernel spreads the datagrams between them. Datagrams are
+    // sent on the first socket. Unless reader_task_instance is overridden,
+    // the datagrams of each socket are read by a ReaderTask instance of its
+    // own. Must be called before Initialize. Ignored on platforms without
+    // SO_REUSEPORT.
+    void SetSocketCount(size_t count);
+    size_t socket_count() const { return socket_count_; }
+
     // tx-rx
     // Assumes mutex is locked or called from the main thread
     void StartSend(boost::asio::ip::udp::endpoint ep, std::size_t bytes_to_send,
@@ -59,7 +94,7 @@ public:
     void DeallocateBuffer(const boost::asio::const_buffer &buffer);
 
     // statistics
-    const io::SocketStats &GetSocketStats() const { return stats_; }
+    const io::ServerSocketStats &GetSocketStats() const { return stats_; }
     void GetRxSocketStats(SocketIOStats *socket_stats) const;
     void GetTxSocketStats(SocketIOStats *socket_stats) const;
 
@@ -75,6 +110,11 @@ protected:
             std::size_t bytes_transferred,
             const boost::system::error_code& error);
 
+    // Batched mode equivalent of HandleReceive, takes ownership of the
+    // buffers. The default implementation runs OnRead for all the datagrams
+    // of the same reader task instance in a single ReaderTask.
+    virtual void HandleReceiveBatch(DatagramList *datagrams);
+
     virtual void OnRead(const boost::asio::const_buffer &recv_buffer,
         const boost::asio::ip::udp::endpoint &remote_endpoint);
 
@@ -104,12 +144,51 @@ private:
     friend void intrusive_ptr_add_ref(UdpServer *server);
     friend void intrusive_ptr_release(UdpServer *server);
     void SetName(boost::asio::ip::udp::endpoint ep);
+    std::string CounterPrefix() const;
+
+    // Receive state of a socket.
+    struct Receiver {
+        Receiver() : socket(NULL), uring(NULL), recv_op(0) {
+        }
+        Socket *socket;
+        Endpoint remote_endpoint;
+        // Buffers posted to recvmmsg, refilled as they get consumed.
+        std::vector<uint8_t *> batch;
+        // io_uring instance of the socket, and pending receive.
+        io::IoUring *uring;
+        uint64_t recv_op;
+        struct msghdr msg;
+        struct iovec iov;
+    };
+    struct RingSend;
+
+    bool OpenReusePortSockets(const Endpoint &local_endpoint);
+    void StartReceive(size_t index);
+    int ReaderTaskInstance(const Endpoint &remote_endpoint) const;
 
     // Locks the mutex
-    void HandleReceiveInternal(
+    void HandleReceiveInternal(size_t index,
             boost::asio::const_buffer recv_buffer,
             std::size_t bytes_transferred,
             const boost::system::error_code& error);
+    void HandleReceiveLocked(size_t index,
+            boost::asio::const_buffer recv_buffer,
+            std::size_t bytes_transferred,
+            const boost::system::error_code& error);
+
+    // io_uring counterparts of async_receive_from and async_send_to, used
+    // when the io_service of the socket runs an io_uring instance.
+    bool StartReceiveRing(size_t index);
+    // Locks the mutex
+    void HandleReceiveRing(size_t index, uint8_t *data, int result);
+    bool StartSendRing(const boost::asio::ip::udp::endpoint &ep,
+                       const boost::asio::const_buffer &buffer);
+    void HandleSendRing(RingSend *send, int result);
+
+    // Locks the mutex
+    void HandleReceiveReady(size_t index,
+                            const boost::system::error_code &error);
+    void ReceiveBatch(size_t index);
 
     // Locks the mutex
     void HandleSendInternal(boost::asio::const_buffer send_buffer,
@@ -117,18 +196,42 @@ private:
             std::size_t bytes_transferred,
             const boost::system::error_code& error);
 
+    void EnqueueSend(const boost::asio::ip::udp::endpoint &ep,
+                     const boost::asio::const_buffer &buffer);
+    // Locks the mutex
+    void HandleSendReady(const boost::system::error_code &error);
+    void SendBatch();
+    // Deallocates the datagrams left in the send queue, as write errors.
+    // Locks the send mutex
+    void DropSendQueue();
+
     static int reader_task_id_;
     boost::asio::ip::udp::socket socket_;
+    boost::asio::io_service *io_service_;
     int buffer_size_;
     ServerState state_;
     EventManager *evm_;
     std::string name_;
-    boost::asio::ip::udp::endpoint remote_endpoint_;
+    // Makes the counter names unique among the servers of an endpoint.
+    uint32_t counter_instance_;
+    size_t socket_count_;
+    // Sockets other than socket_ bound with SO_REUSEPORT.
+    boost::ptr_vector<Socket> reuse_port_sockets_;
+    // One per socket, socket_ first.
+    std::vector<Receiver> receivers_;
+    // Index of the socket whose datagrams are being handled, protected by
+    // state_guard_.
+    size_t receive_index_;
     tbb::mutex state_guard_;
     tbb::mutex pbuf_guard_;
     std::vector<uint8_t *> pbuf_;
+    size_t batch_size_;
+    io::IoUring *send_uring_;
+    tbb::mutex send_guard_;
+    std::deque<Datagram> send_queue_;
+    bool send_pending_;
     tbb::atomic<int> refcount_;
-    io::SocketStats stats_;
+    io::ServerSocketStats stats_;
 
     DISALLOW_COPY_AND_ASSIGN(UdpServer);
 };
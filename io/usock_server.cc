@@ -12,6 +12,8 @@
  */
 #include "io/usock_server.h"
 
+#include "io/buffer_pool.h"
+
 using boost::asio::buffer_cast;
 using boost::asio::buffer;
 using boost::asio::mutable_buffer;
@@ -68,7 +70,7 @@ void UnixDomainSocketSession::WriteToSocket() {
 }
 
 void UnixDomainSocketSession::AppendBuffer(const uint8_t *src, int bytes) {
-    u_int8_t *data = new u_int8_t[bytes];
+    u_int8_t *data = io::BufferPool::GetInstance()->Allocate(bytes);
     memcpy(data, src, bytes);
     boost::asio::mutable_buffer buffer =
         boost::asio::mutable_buffer(data, bytes);
@@ -77,7 +79,7 @@ void UnixDomainSocketSession::AppendBuffer(const uint8_t *src, int bytes) {
 
 void UnixDomainSocketSession::DeleteBuffer(boost::asio::mutable_buffer buffer) {
     const uint8_t *data = buffer_cast <const uint8_t *>(buffer);
-    delete []data;
+    io::BufferPool::GetInstance()->Free(data);
     return;
 }
 
@@ -40,6 +40,25 @@ using namespace std;
 using boost::tuple;
 using boost::tuples::make_tuple;
 
+#ifdef SANDESH
+/**
+ * Protocols for which the templated read and write functions of the sandesh
+ * types are instantiated. The first one is the generic protocol, used by the
+ * boost::shared_ptr functions, the others are the concrete protocols of the
+ * sandesh encoder and must match the Sandesh::Write() overloads.
+ */
+static const char* const sandesh_protocols[] = {
+  "::contrail::sandesh::protocol::TProtocol",
+  "::contrail::sandesh::protocol::TXMLProtocol",
+  "::contrail::sandesh::protocol::TBinaryProtocolT<"
+      " ::contrail::sandesh::transport::TMemoryBuffer >",
+  "::contrail::sandesh::protocol::TCompactProtocolT<"
+      " ::contrail::sandesh::transport::TMemoryBuffer >",
+};
+static const size_t sandesh_protocols_count =
+    sizeof(sandesh_protocols) / sizeof(sandesh_protocols[0]);
+#endif
+
 /**
  * C++ code generator. This is legitimacy incarnate.
  *
@@ -107,6 +126,8 @@ class t_cpp_generator : public t_oop_generator {
   void generate_sandesh_http_reader  (std::ofstream& out, t_sandesh* tsandesh);
   void generate_sandesh_reader       (std::ofstream& out, t_sandesh* tsandesh);
   void generate_sandesh_writer       (std::ofstream& out, t_sandesh* tsandesh);
+  void generate_protocol_delegates   (std::ofstream& out, std::string name, std::string read_fn, std::string write_fn);
+  void generate_protocol_instances   (std::ofstream& out, std::string name, std::string read_fn, std::string write_fn);
   void generate_sandesh_creator      (std::ofstream& out, t_sandesh* tsandesh);
   void generate_sandesh_member_init_list(std::ofstream& out, t_sandesh* tsandesh, bool init_dval = false);
   void generate_sandesh_base_init    (ofstream& out, t_sandesh* tsandesh, bool init_dval);
@@ -588,6 +609,10 @@ void t_cpp_generator::init_generator() {
     "#include <sandesh/sandesh_uve.h>" << endl <<
     "#include <sandesh/sandesh_http.h>" << endl <<
     "#include <sandesh/sandesh_trace.h>" << endl <<
+    "#include <sandesh/protocol/TXMLProtocol.h>" << endl <<
+    "#include <sandesh/protocol/TBinaryProtocol.h>" << endl <<
+    "#include <sandesh/protocol/TCompactProtocol.h>" << endl <<
+    "#include <sandesh/transport/TBufferTransports.h>" << endl <<
     "#include <curl/curl.h>" << endl <<
     "#include <boost/foreach.hpp>" << endl <<
     "#include <boost/assign/list_of.hpp>" << endl <<
@@ -1046,6 +1071,10 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
   generate_struct_reader(out, tstruct);
   generate_struct_writer(out, tstruct);
 #ifdef SANDESH
+  if (!gen_templates_) {
+    generate_protocol_delegates(out, tstruct->get_name(), "read", "write");
+    generate_protocol_instances(out, tstruct->get_name(), "read", "write");
+  }
   generate_struct_logger(out, tstruct->get_name(), tstruct->get_members());
   generate_struct_get_size(out, tstruct->get_name(), tstruct->get_members());
 #endif
@@ -1080,6 +1109,8 @@ void t_cpp_generator::generate_cpp_sandesh(t_sandesh* tsandesh) {
     generate_sandesh_creator(out, tsandesh);
     generate_sandesh_reader(out, tsandesh);
     generate_sandesh_writer(out, tsandesh);
+    generate_protocol_delegates(out, tsandesh->get_name(), "Read", "Write");
+    generate_protocol_instances(out, tsandesh->get_name(), "Read", "Write");
     generate_sandesh_loggers(out, tsandesh);
     generate_sandesh_get_size(out, tsandesh);
 
@@ -2378,6 +2409,18 @@ void t_cpp_generator::generate_sandesh_definition(ofstream& out,
     out << indent() << "int32_t Write(" <<
         "boost::shared_ptr<contrail::sandesh::protocol::TProtocol> oprot) const;" << endl;
 
+    out << indent() << "template <class Protocol_>" << endl <<
+        indent() << "int32_t Read(Protocol_* iprot);" << endl;
+
+    out << indent() << "template <class Protocol_>" << endl <<
+        indent() << "int32_t Write(Protocol_* oprot) const;" << endl;
+
+    // Overrides of the Sandesh writers of the concrete protocols
+    for (size_t i = 1; i < sandesh_protocols_count; i++) {
+        out << indent() << "int32_t Write(" << sandesh_protocols[i] <<
+            "* oprot) const;" << endl;
+    }
+
     if (((t_base_type *)t)->is_sandesh_system()) {
         out << indent() << "static bool do_rate_limit_drop_log_;" << endl;
 
@@ -3030,6 +3073,11 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
       out <<
         indent() << "int32_t read(" <<
         "boost::shared_ptr<contrail::sandesh::protocol::TProtocol> iprot);" << endl;
+#ifdef SANDESH
+      out <<
+        indent() << "template <class Protocol_>" << endl <<
+        indent() << "int32_t read(Protocol_* iprot);" << endl;
+#endif
     }
   }
   if (write) {
@@ -3041,6 +3089,11 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
       out <<
         indent() << "int32_t write(" <<
         "boost::shared_ptr<contrail::sandesh::protocol::TProtocol> oprot) const;" << endl;
+#ifdef SANDESH
+      out <<
+        indent() << "template <class Protocol_>" << endl <<
+        indent() << "int32_t write(Protocol_* oprot) const;" << endl;
+#endif
     }
   }
 #ifdef SANDESH
@@ -3397,7 +3450,13 @@ void t_cpp_generator::generate_local_reflection_pointer(std::ofstream& out,
 void t_cpp_generator::generate_struct_reader(ofstream& out,
                                              t_struct* tstruct,
                                              bool pointers) {
-  if (gen_templates_) {
+  // The sandesh types are always generated with the templated reader, see
+  // generate_protocol_delegates()
+  bool templates = gen_templates_;
+#ifdef SANDESH
+  templates = true;
+#endif
+  if (templates) {
     out <<
       indent() << "template <class Protocol_>" << endl <<
       indent() << "int32_t " << tstruct->get_name() <<
@@ -3423,7 +3482,13 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
 void t_cpp_generator::generate_struct_writer(ofstream& out,
                                              t_struct* tstruct,
                                              bool pointers) {
-  if (gen_templates_) {
+  // The sandesh types are always generated with the templated writer, see
+  // generate_protocol_delegates()
+  bool templates = gen_templates_;
+#ifdef SANDESH
+  templates = true;
+#endif
+  if (templates) {
     out <<
       indent() << "template <class Protocol_>" << endl <<
       indent() << "int32_t " << tstruct->get_name() <<
@@ -4059,10 +4124,10 @@ void t_cpp_generator::generate_sandesh_updater(ofstream& out,
  */
 void t_cpp_generator::generate_sandesh_reader(ofstream& out,
                                               t_sandesh* tsandesh) {
-  indent(out) <<
-    "int32_t " << tsandesh->get_name() <<
-    "::Read(boost::shared_ptr<contrail::sandesh::protocol::TProtocol> iprot) {"
-    << endl;
+  out <<
+    indent() << "template <class Protocol_>" << endl <<
+    indent() << "int32_t " << tsandesh->get_name() <<
+    "::Read(Protocol_* iprot) {" << endl;
 
   generate_common_struct_reader_body(out, tsandesh, false);
 
@@ -4078,16 +4143,87 @@ void t_cpp_generator::generate_sandesh_reader(ofstream& out,
  */
 void t_cpp_generator::generate_sandesh_writer(ofstream& out,
                                               t_sandesh* tsandesh) {
-  indent(out) <<
-    "int32_t " << tsandesh->get_name() <<
-    "::Write(boost::shared_ptr<contrail::sandesh::protocol::TProtocol> oprot) const {" <<
-    endl;
+  out <<
+    indent() << "template <class Protocol_>" << endl <<
+    indent() << "int32_t " << tsandesh->get_name() <<
+    "::Write(Protocol_* oprot) const {" << endl;
 
   generate_common_struct_writer_body(out, tsandesh, false);
 
   indent(out) <<
     "}" << endl <<
     endl;
+
+  // Overrides of the Sandesh writers of the concrete protocols, the
+  // template argument selects the templated writer
+  for (size_t i = 1; i < sandesh_protocols_count; i++) {
+    indent(out) <<
+      "int32_t " << tsandesh->get_name() << "::Write(" <<
+      sandesh_protocols[i] << "* oprot) const {" << endl;
+    indent(out) <<
+      "  return Write< " << sandesh_protocols[i] << " >(oprot);" << endl;
+    indent(out) <<
+      "}" << endl << endl;
+  }
+}
+
+/**
+ * Generates the boost::shared_ptr read and write functions, which delegate
+ * to the templated ones with the generic protocol.
+ *
+ * @param out Stream to write to
+ * @param name The struct or sandesh name
+ * @param read_fn The read function name
+ * @param write_fn The write function name
+ */
+void t_cpp_generator::generate_protocol_delegates(ofstream& out,
+                                                  string name,
+                                                  string read_fn,
+                                                  string write_fn) {
+  indent(out) <<
+    "int32_t " << name << "::" << read_fn <<
+    "(boost::shared_ptr<contrail::sandesh::protocol::TProtocol> iprot) {" <<
+    endl;
+  indent(out) <<
+    "  return " << read_fn << "(iprot.get());" << endl;
+  indent(out) <<
+    "}" << endl << endl;
+
+  indent(out) <<
+    "int32_t " << name << "::" << write_fn <<
+    "(boost::shared_ptr<contrail::sandesh::protocol::TProtocol> oprot) const {" <<
+    endl;
+  indent(out) <<
+    "  return " << write_fn << "(oprot.get());" << endl;
+  indent(out) <<
+    "}" << endl << endl;
+}
+
+/**
+ * Generates the explicit instantiations of the templated read and write
+ * functions, so that the types can be nested in the types of other sandesh
+ * files. Messages are only decoded through the generic protocol, so the
+ * concrete protocols are instantiated for write only.
+ *
+ * @param out Stream to write to
+ * @param name The struct or sandesh name
+ * @param read_fn The read function name
+ * @param write_fn The write function name
+ */
+void t_cpp_generator::generate_protocol_instances(ofstream& out,
+                                                  string name,
+                                                  string read_fn,
+                                                  string write_fn) {
+  indent(out) <<
+    "template int32_t " << name << "::" << read_fn << "< " <<
+    sandesh_protocols[0] << " >(" << sandesh_protocols[0] << "*);" << endl;
+  for (size_t i = 0; i < sandesh_protocols_count; i++) {
+    indent(out) <<
+      "template int32_t " << name << "::" << write_fn << "< " <<
+      sandesh_protocols[i] << " >(" << sandesh_protocols[i] << "*) const;" <<
+      endl;
+  }
+  out << endl;
 }
 
 /**
@@ -116,7 +116,7 @@ class TBinaryProtocolT
   inline int32_t writeFieldBegin(const char* name,
                                  const TType fieldType,
                                  const int16_t fieldId,
-                                 const std::map<std::string, std::string> *const amap);
+                                 const std::map<std::string, std::string> *const amap = NULL);
 
   inline int32_t writeFieldEnd();
 
@@ -0,0 +1,353 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ * Copyright 2006-2017 The Apache Software Foundation.
+ * https://github.com/apache/thrift
+ */
+
+#ifndef _SANDESH_PROTOCOL_TCOMPACTPROTOCOL_H_
+#define _SANDESH_PROTOCOL_TCOMPACTPROTOCOL_H_ 1
+
+#include "TProtocol.h"
+#include "TVirtualProtocol.h"
+
+#include <stack>
+#include <boost/shared_ptr.hpp>
+
+#include <base/logging.h>
+
+namespace contrail { namespace sandesh { namespace protocol {
+
+/**
+ * Compact protocol for sandesh, based on the thrift compact protocol.
+ *
+ * Field ids are encoded as a delta from the previous field id of the struct,
+ * packed with the field type in a single byte when the delta is small.
+ * Integers are encoded as varints, the signed ones after a zigzag encoding,
+ * and boolean fields are folded in the field header.
+ *
+ * The sandesh types that have no compact type (u16, xml, ipv4, uuid and
+ * ipaddr) use the extended compact type, followed by a byte with their TType.
+ */
+template <class Transport_>
+class TCompactProtocolT
+  : public TVirtualProtocol< TCompactProtocolT<Transport_> > {
+
+ protected:
+  static const int8_t  PROTOCOL_ID = (int8_t)0x82u;
+  static const int8_t  VERSION_N = 1;
+  static const int8_t  VERSION_MASK = 0x1f; // 0001 1111
+  static const int8_t  TYPE_MASK = (int8_t)0xE0u; // 1110 0000
+  static const int32_t TYPE_SHIFT_AMOUNT = 5;
+
+  Transport_* trans_;
+
+  /**
+   * (Writing) If we encounter a boolean field begin, save the field id
+   * here so it can have the value incorporated.
+   */
+  int16_t booleanFieldId_;
+  bool booleanFieldPending_;
+
+  /**
+   * (Reading) If we read a field header, and it's a boolean field, save
+   * the boolean value here so that readBool can use it.
+   */
+  bool boolValue_;
+  bool boolValuePending_;
+
+  /**
+   * Used to keep track of the last field for the current and previous
+   * structs, so we can do the delta stuff.
+   */
+  std::stack<int16_t> lastField_;
+  int16_t lastFieldId_;
+
+ public:
+  TCompactProtocolT(boost::shared_ptr<Transport_> trans) :
+    TVirtualProtocol< TCompactProtocolT<Transport_> >(trans),
+    trans_(trans.get()),
+    booleanFieldId_(0),
+    booleanFieldPending_(false),
+    boolValue_(false),
+    boolValuePending_(false),
+    lastFieldId_(0),
+    string_limit_(0),
+    string_buf_(NULL),
+    string_buf_size_(0),
+    container_limit_(0) {}
+
+  TCompactProtocolT(boost::shared_ptr<Transport_> trans,
+                    int32_t string_limit,
+                    int32_t container_limit) :
+    TVirtualProtocol< TCompactProtocolT<Transport_> >(trans),
+    trans_(trans.get()),
+    booleanFieldId_(0),
+    booleanFieldPending_(false),
+    boolValue_(false),
+    boolValuePending_(false),
+    lastFieldId_(0),
+    string_limit_(string_limit),
+    string_buf_(NULL),
+    string_buf_size_(0),
+    container_limit_(container_limit) {}
+
+  ~TCompactProtocolT() {
+    if (string_buf_ != NULL) {
+      std::free(string_buf_);
+      string_buf_size_ = 0;
+    }
+  }
+
+  void setStringSizeLimit(int32_t string_limit) {
+    string_limit_ = string_limit;
+  }
+
+  void setContainerSizeLimit(int32_t container_limit) {
+    container_limit_ = container_limit;
+  }
+
+  /**
+   * Writing functions
+   */
+
+  int32_t writeMessageBegin(const std::string& name,
+                            const TMessageType messageType,
+                            const int32_t seqid);
+
+  int32_t writeMessageEnd();
+
+  int32_t writeStructBegin(const char* name);
+
+  int32_t writeStructEnd();
+
+  int32_t writeSandeshBegin(const char* name);
+
+  int32_t writeSandeshEnd();
+
+  int32_t writeContainerElementBegin();
+
+  int32_t writeContainerElementEnd();
+
+  int32_t writeFieldBegin(const char* name,
+                          const TType fieldType,
+                          const int16_t fieldId,
+                          const std::map<std::string, std::string> *const amap = NULL);
+
+  int32_t writeFieldEnd();
+
+  int32_t writeFieldStop();
+
+  int32_t writeMapBegin(const TType keyType,
+                        const TType valType,
+                        const uint32_t size);
+
+  int32_t writeMapEnd();
+
+  int32_t writeListBegin(const TType elemType, const uint32_t size);
+
+  int32_t writeListEnd();
+
+  int32_t writeSetBegin(const TType elemType, const uint32_t size);
+
+  int32_t writeSetEnd();
+
+  int32_t writeBool(const bool value);
+
+  int32_t writeByte(const int8_t byte);
+
+  int32_t writeI16(const int16_t i16);
+
+  int32_t writeI32(const int32_t i32);
+
+  int32_t writeI64(const int64_t i64);
+
+  int32_t writeU16(const uint16_t u16);
+
+  int32_t writeU32(const uint32_t u32);
+
+  int32_t writeU64(const uint64_t u64);
+
+  int32_t writeIPV4(const uint32_t ip4);
+
+  int32_t writeIPADDR(const boost::asio::ip::address& ipaddress);
+
+  int32_t writeDouble(const double dub);
+
+  int32_t writeString(const std::string& str);
+
+  int32_t writeBinary(const std::string& str);
+
+  int32_t writeXML(const std::string& str);
+
+  int32_t writeUUID(const boost::uuids::uuid& uuid);
+
+ protected:
+  int32_t writeFieldBeginInternal(const TType fieldType,
+                                  const int16_t fieldId,
+                                  int8_t typeOverride);
+  int32_t writeCollectionBegin(const TType elemType, const uint32_t size);
+  int32_t writeTypeExtension(const TType type);
+  int32_t writeVarint32(uint32_t n);
+  int32_t writeVarint64(uint64_t n);
+  uint64_t i64ToZigzag(const int64_t l);
+  uint32_t i32ToZigzag(const int32_t n);
+  inline int8_t getCompactType(const TType ttype);
+
+ public:
+  int32_t readMessageBegin(std::string& name,
+                           TMessageType& messageType,
+                           int32_t& seqid);
+
+  int32_t readMessageEnd();
+
+  int32_t readStructBegin(std::string& name);
+
+  int32_t readStructEnd();
+
+  int32_t readSandeshBegin(std::string& name);
+
+  int32_t readSandeshEnd();
+
+  int32_t readContainerElementBegin();
+
+  int32_t readContainerElementEnd();
+
+  int32_t readFieldBegin(std::string& name,
+                         TType& fieldType,
+                         int16_t& fieldId);
+
+  int32_t readFieldEnd();
+
+  int32_t readMapBegin(TType& keyType,
+                       TType& valType,
+                       uint32_t& size);
+
+  int32_t readMapEnd();
+
+  int32_t readListBegin(TType& elemType, uint32_t& size);
+
+  int32_t readListEnd();
+
+  int32_t readSetBegin(TType& elemType, uint32_t& size);
+
+  int32_t readSetEnd();
+
+  int32_t readBool(bool& value);
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol< TCompactProtocolT<Transport_> >::readBool;
+
+  int32_t readByte(int8_t& byte);
+
+  int32_t readI16(int16_t& i16);
+
+  int32_t readI32(int32_t& i32);
+
+  int32_t readI64(int64_t& i64);
+
+  int32_t readU16(uint16_t& u16);
+
+  int32_t readU32(uint32_t& u32);
+
+  int32_t readU64(uint64_t& u64);
+
+  int32_t readIPV4(uint32_t& ip4);
+
+  int32_t readIPADDR(boost::asio::ip::address& ipaddress);
+
+  int32_t readDouble(double& dub);
+
+  int32_t readString(std::string& str);
+
+  int32_t readBinary(std::string& str);
+
+  int32_t readXML(std::string& str);
+
+  int32_t readUUID(boost::uuids::uuid& uuid);
+
+ protected:
+  int32_t readVarint32(int32_t& i32);
+  int32_t readVarint64(int64_t& i64);
+  int32_t readTypeExtension(TType& type);
+  int32_t readStringBody(std::string& str, int32_t size);
+  int32_t checkContainerSize(int32_t size);
+  int32_t zigzagToI32(uint32_t n);
+  int64_t zigzagToI64(uint64_t n);
+  TType getTType(int8_t type);
+
+  int32_t string_limit_;
+  // Buffer for reading strings, save for the lifetime of the protocol to
+  // avoid memory churn allocating memory on every string read
+  uint8_t* string_buf_;
+  int32_t string_buf_size_;
+  int32_t container_limit_;
+};
+
+typedef TCompactProtocolT<TTransport> TCompactProtocol;
+
+/**
+ * Constructs compact protocol handlers
+ */
+template <class Transport_>
+class TCompactProtocolFactoryT : public TProtocolFactory {
+ public:
+  TCompactProtocolFactoryT() :
+    string_limit_(0),
+    container_limit_(0) {}
+
+  TCompactProtocolFactoryT(int32_t string_limit, int32_t container_limit) :
+    string_limit_(string_limit),
+    container_limit_(container_limit) {}
+
+  virtual ~TCompactProtocolFactoryT() {}
+
+  void setStringSizeLimit(int32_t string_limit) {
+    string_limit_ = string_limit;
+  }
+
+  void setContainerSizeLimit(int32_t container_limit) {
+    container_limit_ = container_limit;
+  }
+
+  boost::shared_ptr<TProtocol> getProtocol(boost::shared_ptr<TTransport> trans) {
+    boost::shared_ptr<Transport_> specific_trans =
+      boost::dynamic_pointer_cast<Transport_>(trans);
+    TProtocol* prot;
+    if (specific_trans) {
+      prot = new TCompactProtocolT<Transport_>(specific_trans, string_limit_,
+                                               container_limit_);
+    } else {
+      prot = new TCompactProtocol(trans, string_limit_, container_limit_);
+    }
+
+    return boost::shared_ptr<TProtocol>(prot);
+  }
+
+ private:
+  int32_t string_limit_;
+  int32_t container_limit_;
+
+};
+
+typedef TCompactProtocolFactoryT<TTransport> TCompactProtocolFactory;
+
+}}} // contrail::sandesh::protocol
+
+#include "sandesh/library/cpp/protocol/TCompactProtocol.tcc"
+
+#endif // #ifndef _SANDESH_PROTOCOL_TCOMPACTPROTOCOL_H_
@@ -0,0 +1,1246 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ * Copyright 2006-2017 The Apache Software Foundation.
+ * https://github.com/apache/thrift
+ */
+
+#ifndef _SANDESH_PROTOCOL_TCOMPACTPROTOCOL_TCC_
+#define _SANDESH_PROTOCOL_TCOMPACTPROTOCOL_TCC_ 1
+
+#include "TCompactProtocol.h"
+
+#include <limits>
+
+
+namespace contrail { namespace sandesh { namespace protocol {
+
+namespace detail { namespace compact {
+
+enum Types {
+  CT_STOP           = 0x00,
+  CT_BOOLEAN_TRUE   = 0x01,
+  CT_BOOLEAN_FALSE  = 0x02,
+  CT_BYTE           = 0x03,
+  CT_I16            = 0x04,
+  CT_I32            = 0x05,
+  CT_I64            = 0x06,
+  CT_DOUBLE         = 0x07,
+  CT_BINARY         = 0x08,
+  CT_LIST           = 0x09,
+  CT_SET            = 0x0A,
+  CT_MAP            = 0x0B,
+  CT_STRUCT         = 0x0C,
+  CT_U32            = 0x0D,
+  CT_U64            = 0x0E,
+  // The TType follows in the next byte
+  CT_EXTENDED       = 0x0F
+};
+
+const int8_t TTypeToCType[T_IPADDR + 1] = {
+  CT_STOP, // T_STOP
+  CT_EXTENDED, // T_VOID
+  CT_BOOLEAN_TRUE, // T_BOOL
+  CT_BYTE, // T_BYTE
+  CT_DOUBLE, // T_DOUBLE
+  CT_EXTENDED, // unused
+  CT_I16, // T_I16
+  CT_EXTENDED, // unused
+  CT_I32, // T_I32
+  CT_U64, // T_U64
+  CT_I64, // T_I64
+  CT_BINARY, // T_STRING
+  CT_STRUCT, // T_STRUCT
+  CT_MAP, // T_MAP
+  CT_SET, // T_SET
+  CT_LIST, // T_LIST
+  CT_EXTENDED, // T_UTF8
+  CT_EXTENDED, // T_UTF16
+  CT_EXTENDED, // T_SANDESH
+  CT_EXTENDED, // T_U16
+  CT_U32, // T_U32
+  CT_EXTENDED, // T_XML
+  CT_EXTENDED, // T_IPV4
+  CT_EXTENDED, // T_UUID
+  CT_EXTENDED, // T_IPADDR
+};
+
+const TType CTypeToTType[CT_EXTENDED + 1] = {
+  T_STOP, // CT_STOP
+  T_BOOL, // CT_BOOLEAN_TRUE
+  T_BOOL, // CT_BOOLEAN_FALSE
+  T_BYTE, // CT_BYTE
+  T_I16, // CT_I16
+  T_I32, // CT_I32
+  T_I64, // CT_I64
+  T_DOUBLE, // CT_DOUBLE
+  T_STRING, // CT_BINARY
+  T_LIST, // CT_LIST
+  T_SET, // CT_SET
+  T_MAP, // CT_MAP
+  T_STRUCT, // CT_STRUCT
+  T_U32, // CT_U32
+  T_U64, // CT_U64
+  T_STOP, // CT_EXTENDED, the TType follows
+};
+
+}} // end detail::compact namespace
+
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeMessageBegin(
+    const std::string& name,
+    const TMessageType messageType,
+    const int32_t seqid) {
+  int32_t wsize = 0;
+  int32_t ret;
+  if ((ret = writeByte(PROTOCOL_ID)) < 0) {
+    return ret;
+  }
+  wsize += ret;
+  if ((ret = writeByte((VERSION_N & VERSION_MASK) |
+                       (((int32_t)messageType << TYPE_SHIFT_AMOUNT) &
+                        TYPE_MASK))) < 0) {
+    return ret;
+  }
+  wsize += ret;
+  if ((ret = writeVarint32(seqid)) < 0) {
+    return ret;
+  }
+  wsize += ret;
+  if ((ret = writeString(name)) < 0) {
+    return ret;
+  }
+  wsize += ret;
+  return wsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeMessageEnd() {
+  return 0;
+}
+
+/**
+ * Write a struct begin. This doesn't actually put anything on the wire. We
+ * use it as an opportunity to put special placeholder markers on the field
+ * stack so we can get the field id deltas correct.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeStructBegin(const char* name) {
+  (void) name;
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return 0;
+}
+
+/**
+ * Write a struct end. This doesn't actually put anything on the wire. We use
+ * this as an opportunity to pop the last field from the current struct off
+ * of the field stack.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeStructEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+/**
+ * The sandesh name is written as a string, and the fields of the sandesh
+ * are encoded as the fields of a struct.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeSandeshBegin(const char* name) {
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return writeString(name);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeSandeshEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeContainerElementBegin() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeContainerElementEnd() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeFieldBegin(const char* name,
+    const TType fieldType,
+    const int16_t fieldId,
+    const std::map<std::string, std::string> *const amap) {
+  (void) name;
+  (void) amap;
+  if (fieldType == T_BOOL) {
+    // The value is folded in the field header by writeBool()
+    booleanFieldId_ = fieldId;
+    booleanFieldPending_ = true;
+    return 0;
+  }
+  return writeFieldBeginInternal(fieldType, fieldId, -1);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeFieldEnd() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeFieldStop() {
+  return writeByte(detail::compact::CT_STOP);
+}
+
+/**
+ * Write a map header. If the map is empty, omit the key and value type
+ * headers, as we don't need any additional information to skip it.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeMapBegin(const TType keyType,
+                                                     const TType valType,
+                                                     const uint32_t size) {
+  if (size == 0) {
+    return writeByte(0);
+  }
+  int8_t keyCType = getCompactType(keyType);
+  int8_t valCType = getCompactType(valType);
+  if (keyCType < 0 || valCType < 0) {
+    LOG(ERROR, __func__ << ": Invalid map type " << keyType << ", " <<
+        valType);
+    return -1;
+  }
+  int32_t wsize = 0;
+  int32_t ret;
+  if ((ret = writeVarint32(size)) < 0) {
+    return ret;
+  }
+  wsize += ret;
+  if ((ret = writeByte((int8_t)((keyCType << 4) | valCType))) < 0) {
+    return ret;
+  }
+  wsize += ret;
+  if (keyCType == detail::compact::CT_EXTENDED) {
+    if ((ret = writeTypeExtension(keyType)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  }
+  if (valCType == detail::compact::CT_EXTENDED) {
+    if ((ret = writeTypeExtension(valType)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  }
+  return wsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeMapEnd() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeListBegin(const TType elemType,
+                                                      const uint32_t size) {
+  return writeCollectionBegin(elemType, size);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeListEnd() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeSetBegin(const TType elemType,
+                                                     const uint32_t size) {
+  return writeCollectionBegin(elemType, size);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeSetEnd() {
+  return 0;
+}
+
+/**
+ * Write a boolean value. Potentially, this could be a boolean field, in
+ * which case the field header info isn't written yet. If so, decide what the
+ * right type header is for the value and then write the field header.
+ * Otherwise, write a single byte.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeBool(const bool value) {
+  int8_t ctype = value ? detail::compact::CT_BOOLEAN_TRUE :
+                         detail::compact::CT_BOOLEAN_FALSE;
+  if (booleanFieldPending_) {
+    booleanFieldPending_ = false;
+    return writeFieldBeginInternal(T_BOOL, booleanFieldId_, ctype);
+  }
+  return writeByte(ctype);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeByte(const int8_t byte) {
+  trans_->write((uint8_t*)&byte, 1);
+  return 1;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeI16(const int16_t i16) {
+  return writeVarint32(i32ToZigzag(i16));
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeI32(const int32_t i32) {
+  return writeVarint32(i32ToZigzag(i32));
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeI64(const int64_t i64) {
+  return writeVarint64(i64ToZigzag(i64));
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeU16(const uint16_t u16) {
+  return writeVarint32(u16);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeU32(const uint32_t u32) {
+  return writeVarint32(u32);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeU64(const uint64_t u64) {
+  return writeVarint64(u64);
+}
+
+/**
+ * Addresses rarely have leading zero bytes, so they are not varint encoded.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeIPV4(const uint32_t ip4) {
+  uint32_t net = (uint32_t)htonl(ip4);
+  trans_->write((uint8_t*)&net, 4);
+  return 4;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeIPADDR(
+    const boost::asio::ip::address& ipaddress) {
+  int32_t ret;
+  if (ipaddress.is_v4()) {
+    // encode the ip version
+    if ((ret = writeByte(AF_INET)) < 0) {
+      return ret;
+    }
+    trans_->write(ipaddress.to_v4().to_bytes().data(), 4);
+    return ret+4;
+  } else if (ipaddress.is_v6()) {
+    // encode the ip version
+    if ((ret = writeByte(AF_INET6)) < 0) {
+      return ret;
+    }
+    trans_->write(ipaddress.to_v6().to_bytes().data(), 16);
+    return ret+16;
+  }
+  return -1;
+}
+
+/**
+ * Write a double to the wire as 8 bytes, in little endian order.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeDouble(const double dub) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t bits = bitwise_cast<uint64_t>(dub);
+  uint8_t buf[8];
+  for (int i = 0; i < 8; i++) {
+    buf[i] = (uint8_t)(bits >> (8 * i));
+  }
+  trans_->write(buf, 8);
+  return 8;
+}
+
+/**
+ * Write a string to the wire with a varint size preceding.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeString(const std::string& str) {
+  uint32_t size = str.size();
+  int32_t result;
+  if ((result = writeVarint32(size)) < 0) {
+    return result;
+  }
+  if (size > 0) {
+    trans_->write((uint8_t*)str.data(), size);
+  }
+  return result + size;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
+  return TCompactProtocolT<Transport_>::writeString(str);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeXML(const std::string& str) {
+  return TCompactProtocolT<Transport_>::writeString(str);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeUUID(
+    const boost::uuids::uuid& uuid) {
+  trans_->write((uint8_t*)&uuid, 16);
+  return 16;
+}
+
+//
+// Internal Writing methods
+//
+
+/**
+ * The workhorse of writeFieldBegin. It has the option of doing a 'type
+ * override' of the type header. This is used specifically in the boolean
+ * field case.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeFieldBeginInternal(
+    const TType fieldType,
+    const int16_t fieldId,
+    int8_t typeOverride) {
+  int8_t typeToWrite = (typeOverride == -1 ?
+                        getCompactType(fieldType) : typeOverride);
+  if (typeToWrite < 0) {
+    LOG(ERROR, __func__ << ": Invalid field type " << fieldType);
+    return -1;
+  }
+  int32_t wsize = 0;
+  int32_t ret;
+  // check if we can use delta encoding for the field id
+  if (fieldId > lastFieldId_ && fieldId - lastFieldId_ <= 15) {
+    // write them together
+    if ((ret = writeByte((int8_t)(((fieldId - lastFieldId_) << 4) |
+                                  typeToWrite))) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  } else {
+    // write them separate
+    if ((ret = writeByte(typeToWrite)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+    if ((ret = writeI16(fieldId)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  }
+  if (typeToWrite == detail::compact::CT_EXTENDED) {
+    if ((ret = writeTypeExtension(fieldType)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  }
+  lastFieldId_ = fieldId;
+  return wsize;
+}
+
+/**
+ * Abstract method for writing the start of lists and sets. List and sets on
+ * the wire differ only by the type indicator.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeCollectionBegin(
+    const TType elemType, const uint32_t size) {
+  int8_t elemCType = getCompactType(elemType);
+  if (elemCType < 0) {
+    LOG(ERROR, __func__ << ": Invalid element type " << elemType);
+    return -1;
+  }
+  int32_t wsize = 0;
+  int32_t ret;
+  if (size <= 14) {
+    if ((ret = writeByte((int8_t)((size << 4) | elemCType))) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  } else {
+    if ((ret = writeByte((int8_t)(0xf0 | elemCType))) < 0) {
+      return ret;
+    }
+    wsize += ret;
+    if ((ret = writeVarint32(size)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  }
+  if (elemCType == detail::compact::CT_EXTENDED) {
+    if ((ret = writeTypeExtension(elemType)) < 0) {
+      return ret;
+    }
+    wsize += ret;
+  }
+  return wsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeTypeExtension(const TType type) {
+  return writeByte((int8_t)type);
+}
+
+/**
+ * Write an i32 as a varint. Results in 1-5 bytes on the wire.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeVarint32(uint32_t n) {
+  uint8_t buf[5];
+  int32_t wsize = 0;
+
+  while (true) {
+    if ((n & ~0x7F) == 0) {
+      buf[wsize++] = (int8_t)n;
+      break;
+    } else {
+      buf[wsize++] = (int8_t)((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+  }
+  trans_->write(buf, wsize);
+  return wsize;
+}
+
+/**
+ * Write an i64 as a varint. Results in 1-10 bytes on the wire.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeVarint64(uint64_t n) {
+  uint8_t buf[10];
+  int32_t wsize = 0;
+
+  while (true) {
+    if ((n & ~0x7FL) == 0) {
+      buf[wsize++] = (int8_t)n;
+      break;
+    } else {
+      buf[wsize++] = (int8_t)((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+  }
+  trans_->write(buf, wsize);
+  return wsize;
+}
+
+/**
+ * Convert l into a zigzag long. This allows negative numbers to be
+ * represented compactly as a varint.
+ */
+template <class Transport_>
+uint64_t TCompactProtocolT<Transport_>::i64ToZigzag(const int64_t l) {
+  return (((uint64_t)l) << 1) ^ (l >> 63);
+}
+
+/**
+ * Convert n into a zigzag int. This allows negative numbers to be
+ * represented compactly as a varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::i32ToZigzag(const int32_t n) {
+  return (((uint32_t)n) << 1) ^ (n >> 31);
+}
+
+/**
+ * Given a TType value, find the appropriate detail::compact::Types value
+ */
+template <class Transport_>
+int8_t TCompactProtocolT<Transport_>::getCompactType(const TType ttype) {
+  if ((uint32_t)ttype > T_IPADDR) {
+    return -1;
+  }
+  return detail::compact::TTypeToCType[ttype];
+}
+
+//
+// Reading Methods
+//
+
+/**
+ * Read a message header.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readMessageBegin(
+    std::string& name,
+    TMessageType& messageType,
+    int32_t& seqid) {
+  int32_t rsize = 0;
+  int32_t ret;
+  int8_t protocolId;
+  int8_t versionAndType;
+  int8_t version;
+
+  if ((ret = readByte(protocolId)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  if (protocolId != PROTOCOL_ID) {
+    LOG(ERROR, __func__ << ": Bad protocol identifier");
+    return -1;
+  }
+
+  if ((ret = readByte(versionAndType)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  version = (int8_t)(versionAndType & VERSION_MASK);
+  if (version != VERSION_N) {
+    LOG(ERROR, __func__ << ": Bad protocol version");
+    return -1;
+  }
+
+  messageType = (TMessageType)((versionAndType >> TYPE_SHIFT_AMOUNT) & 0x07);
+  if ((ret = readVarint32(seqid)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  if ((ret = readString(name)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  return rsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readMessageEnd() {
+  return 0;
+}
+
+/**
+ * Read a struct begin. There's nothing on the wire for this, but it is our
+ * opportunity to push a new struct begin marker on the field stack.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readStructBegin(std::string& name) {
+  name = "";
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return 0;
+}
+
+/**
+ * Doesn't actually consume any wire data, just removes the last field for
+ * this struct from the field stack.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readStructEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readSandeshBegin(std::string& name) {
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return readString(name);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readSandeshEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readContainerElementBegin() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readContainerElementEnd() {
+  return 0;
+}
+
+/**
+ * Read a field header off the wire.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readFieldBegin(std::string& name,
+                                                      TType& fieldType,
+                                                      int16_t& fieldId) {
+  (void) name;
+  int32_t rsize = 0;
+  int32_t ret;
+  int8_t byte;
+  int8_t type;
+
+  if ((ret = readByte(byte)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  type = (byte & 0x0f);
+
+  // if it's a stop, then we can return immediately, as the struct is over.
+  if (type == detail::compact::CT_STOP) {
+    fieldType = T_STOP;
+    fieldId = 0;
+    return rsize;
+  }
+
+  // mask off the 4 MSB of the type header. it could contain a field id delta.
+  int16_t modifier = (int16_t)(((uint8_t)byte & 0xf0) >> 4);
+  if (modifier == 0) {
+    // not a delta, look ahead for the zigzag varint field id.
+    if ((ret = readI16(fieldId)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  } else {
+    fieldId = (int16_t)(lastFieldId_ + modifier);
+  }
+
+  if (type == detail::compact::CT_EXTENDED) {
+    if ((ret = readTypeExtension(fieldType)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  } else {
+    fieldType = getTType(type);
+  }
+
+  // if this happens to be a boolean field, the value is encoded in the type
+  if (type == detail::compact::CT_BOOLEAN_TRUE ||
+      type == detail::compact::CT_BOOLEAN_FALSE) {
+    // save the boolean value in a special instance variable.
+    boolValuePending_ = true;
+    boolValue_ = (type == detail::compact::CT_BOOLEAN_TRUE ? true : false);
+  }
+
+  // push the new field onto the field stack so we can keep the deltas going.
+  lastFieldId_ = fieldId;
+  return rsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readFieldEnd() {
+  return 0;
+}
+
+/**
+ * Read a map header off the wire. If the size is zero, skip the key and value
+ * type. This means that 0-length maps will yield maps without the "correct"
+ * types.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readMapBegin(TType& keyType,
+                                                    TType& valType,
+                                                    uint32_t& size) {
+  int32_t rsize = 0;
+  int32_t ret;
+  int8_t kvType = 0;
+  int32_t msize = 0;
+
+  if ((ret = readVarint32(msize)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  if (checkContainerSize(msize) < 0) {
+    return -1;
+  }
+  if (msize != 0) {
+    if ((ret = readByte(kvType)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  }
+
+  int8_t keyCType = (int8_t)(((uint8_t)kvType >> 4) & 0x0f);
+  int8_t valCType = (int8_t)(kvType & 0x0f);
+  if (keyCType == detail::compact::CT_EXTENDED) {
+    if ((ret = readTypeExtension(keyType)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  } else {
+    keyType = getTType(keyCType);
+  }
+  if (valCType == detail::compact::CT_EXTENDED) {
+    if ((ret = readTypeExtension(valType)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  } else {
+    valType = getTType(valCType);
+  }
+  size = (uint32_t)msize;
+  return rsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readMapEnd() {
+  return 0;
+}
+
+/**
+ * Read a list header off the wire. If the list size is 0-14, the size will
+ * be packed into the element type header. If it's a longer list, the 4 MSB
+ * of the element type header will be 0xF, and a varint will follow with the
+ * true size.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readListBegin(TType& elemType,
+                                                     uint32_t& size) {
+  int32_t rsize = 0;
+  int32_t ret;
+  int8_t sizeAndType;
+  int32_t lsize;
+
+  if ((ret = readByte(sizeAndType)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+
+  lsize = ((uint8_t)sizeAndType >> 4) & 0x0f;
+  if (lsize == 15) {
+    if ((ret = readVarint32(lsize)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  }
+  if (checkContainerSize(lsize) < 0) {
+    return -1;
+  }
+
+  int8_t elemCType = (int8_t)(sizeAndType & 0x0f);
+  if (elemCType == detail::compact::CT_EXTENDED) {
+    if ((ret = readTypeExtension(elemType)) < 0) {
+      return ret;
+    }
+    rsize += ret;
+  } else {
+    elemType = getTType(elemCType);
+  }
+  size = (uint32_t)lsize;
+  return rsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readListEnd() {
+  return 0;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readSetBegin(TType& elemType,
+                                                    uint32_t& size) {
+  return readListBegin(elemType, size);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readSetEnd() {
+  return 0;
+}
+
+/**
+ * Read a boolean off the wire. If this is a boolean field, the value should
+ * already have been read during readFieldBegin, so we'll just consume the
+ * pre-stored value. Otherwise, read a byte.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readBool(bool& value) {
+  if (boolValuePending_) {
+    value = boolValue_;
+    boolValuePending_ = false;
+    return 0;
+  }
+  int8_t val;
+  if (readByte(val) < 0) {
+    return -1;
+  }
+  value = (val == detail::compact::CT_BOOLEAN_TRUE);
+  return 1;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readByte(int8_t& byte) {
+  uint8_t b[1];
+  int32_t ret;
+  if ((ret = trans_->readAll(b, 1)) < 0) {
+    return ret;
+  }
+  byte = *(int8_t*)b;
+  return 1;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readI16(int16_t& i16) {
+  int32_t value;
+  int32_t ret;
+  if ((ret = readVarint32(value)) < 0) {
+    return ret;
+  }
+  i16 = (int16_t)zigzagToI32(value);
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readI32(int32_t& i32) {
+  int32_t value;
+  int32_t ret;
+  if ((ret = readVarint32(value)) < 0) {
+    return ret;
+  }
+  i32 = zigzagToI32(value);
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readI64(int64_t& i64) {
+  int64_t value;
+  int32_t ret;
+  if ((ret = readVarint64(value)) < 0) {
+    return ret;
+  }
+  i64 = zigzagToI64(value);
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readU16(uint16_t& u16) {
+  int32_t value;
+  int32_t ret;
+  if ((ret = readVarint32(value)) < 0) {
+    return ret;
+  }
+  u16 = (uint16_t)value;
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readU32(uint32_t& u32) {
+  int32_t value;
+  int32_t ret;
+  if ((ret = readVarint32(value)) < 0) {
+    return ret;
+  }
+  u32 = (uint32_t)value;
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readU64(uint64_t& u64) {
+  int64_t value;
+  int32_t ret;
+  if ((ret = readVarint64(value)) < 0) {
+    return ret;
+  }
+  u64 = (uint64_t)value;
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readIPV4(uint32_t& ip4) {
+  union bytes {
+    uint8_t b[4];
+    uint32_t all;
+  } theBytes;
+  int32_t ret;
+  if ((ret = trans_->readAll(theBytes.b, 4)) < 0) {
+    return ret;
+  }
+  ip4 = (uint32_t)ntohl(theBytes.all);
+  return 4;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readIPADDR(
+    boost::asio::ip::address& ipaddress) {
+  int32_t ret;
+  int32_t rsize;
+  int8_t version;
+  // decode the ip version
+  if ((ret = readByte(version)) < 0) {
+    return ret;
+  }
+  if (version == AF_INET) {
+    boost::asio::ip::address_v4::bytes_type ipv4;
+#ifdef BOOST_ASIO_HAS_STD_ARRAY
+    rsize = trans_->readAll(ipv4.data(), 4);
+#else
+    rsize = trans_->readAll(ipv4.c_array(), 4);
+#endif
+    if (rsize < 0) {
+      return rsize;
+    }
+    ipaddress = boost::asio::ip::address_v4(ipv4);
+    return ret+4;
+  } else if (version == AF_INET6) {
+    boost::asio::ip::address_v6::bytes_type ipv6;
+#ifdef BOOST_ASIO_HAS_STD_ARRAY
+    rsize = trans_->readAll(ipv6.data(), 16);
+#else
+    rsize = trans_->readAll(ipv6.c_array(), 16);
+#endif
+    if (rsize < 0) {
+      return rsize;
+    }
+    ipaddress = boost::asio::ip::address_v6(ipv6);
+    return ret+16;
+  }
+  return -1;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readDouble(double& dub) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint8_t buf[8];
+  int32_t ret;
+  if ((ret = trans_->readAll(buf, 8)) < 0) {
+    return ret;
+  }
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++) {
+    bits |= (uint64_t)buf[i] << (8 * i);
+  }
+  dub = bitwise_cast<double>(bits);
+  return 8;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readString(std::string& str) {
+  int32_t rsize = 0;
+  int32_t size;
+  int32_t ret;
+  if ((ret = readVarint32(size)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  if ((ret = readStringBody(str, size)) < 0) {
+    return ret;
+  }
+  rsize += ret;
+  return rsize;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
+  return TCompactProtocolT<Transport_>::readString(str);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readXML(std::string& str) {
+  return TCompactProtocolT<Transport_>::readString(str);
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readUUID(boost::uuids::uuid& uuid) {
+  int32_t ret;
+  if ((ret = trans_->readAll(uuid.data, 16)) < 0) {
+    return ret;
+  }
+  return 16;
+}
+
+//
+// Internal Reading methods
+//
+
+/**
+ * Read an i32 from the wire as a varint. The MSB of each byte is set
+ * if there is another byte to follow. This can read up to 5 bytes.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readVarint32(int32_t& i32) {
+  int64_t val;
+  int32_t ret;
+  if ((ret = readVarint64(val)) < 0) {
+    return ret;
+  }
+  i32 = (int32_t)val;
+  return ret;
+}
+
+/**
+ * Read an i64 from the wire as a proper varint. The MSB of each byte is set
+ * if there is another byte to follow. This can read up to 10 bytes.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readVarint64(int64_t& i64) {
+  int32_t rsize = 0;
+  uint64_t val = 0;
+  int shift = 0;
+  uint8_t buf[10];  // 64 bits / (7 bits/byte) = 10 bytes.
+  uint32_t buf_size = sizeof(buf);
+  const uint8_t* borrowed = trans_->borrow(buf, &buf_size);
+
+  // Fast path.
+  if (borrowed != NULL) {
+    while (true) {
+      uint8_t byte = borrowed[rsize];
+      rsize++;
+      val |= (uint64_t)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        i64 = val;
+        trans_->consume(rsize);
+        return rsize;
+      }
+      // Have to check for invalid data so we don't crash.
+      if (rsize == (int32_t)sizeof(buf)) {
+        LOG(ERROR, __func__ << ": Variable-length int over 10 bytes");
+        return -1;
+      }
+    }
+  }
+
+  // Slow path.
+  else {
+    while (true) {
+      uint8_t byte;
+      int32_t ret;
+      if ((ret = trans_->readAll(&byte, 1)) < 0) {
+        return ret;
+      }
+      rsize += ret;
+      val |= (uint64_t)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        i64 = val;
+        return rsize;
+      }
+      // Might as well check for invalid data on the slow path too.
+      if (rsize >= (int32_t)sizeof(buf)) {
+        LOG(ERROR, __func__ << ": Variable-length int over 10 bytes");
+        return -1;
+      }
+    }
+  }
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readTypeExtension(TType& type) {
+  int8_t byte;
+  int32_t ret;
+  if ((ret = readByte(byte)) < 0) {
+    return ret;
+  }
+  if (byte <= T_STOP || byte > T_IPADDR) {
+    LOG(ERROR, __func__ << ": Invalid extended type " << (int)byte);
+    return -1;
+  }
+  type = (TType)byte;
+  return ret;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::readStringBody(std::string& str,
+                                                      int32_t size) {
+  int32_t result = 0;
+
+  // Catch error cases
+  if (size < 0) {
+    LOG(ERROR, __func__ << ": Negative size " << size);
+    return -1;
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    LOG(ERROR, __func__ << ": Size " << size << " greater than limit " <<
+        string_limit_);
+    return -1;
+  }
+
+  // Catch empty string case
+  if (size == 0) {
+    str = "";
+    return result;
+  }
+
+  // Try to borrow first
+  const uint8_t* borrow_buf;
+  uint32_t got = size;
+  if ((borrow_buf = trans_->borrow(NULL, &got))) {
+    str.assign((const char*)borrow_buf, size);
+    trans_->consume(size);
+    return size;
+  }
+
+  // Use the heap here to prevent stack overflow for v. large strings
+  if (size > string_buf_size_ || string_buf_ == NULL) {
+    void* new_string_buf = std::realloc(string_buf_, (uint32_t)size);
+    if (new_string_buf == NULL) {
+      LOG(ERROR, __func__ << ": Realloc size " << (uint32_t)size <<
+          " FAILED");
+      return -1;
+    }
+    string_buf_ = (uint8_t*)new_string_buf;
+    string_buf_size_ = size;
+  }
+  int32_t ret;
+  if ((ret = trans_->readAll(string_buf_, size)) < 0) {
+    return ret;
+  }
+  str = std::string((char*)string_buf_, size);
+  return size;
+}
+
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::checkContainerSize(int32_t size) {
+  if (size < 0) {
+    LOG(ERROR, __func__ << ": Negative size " << size);
+    return -1;
+  } else if (container_limit_ && size > container_limit_) {
+    LOG(ERROR, __func__ << ": Size " << size << " greater than limit " <<
+        container_limit_);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Convert from zigzag int to int.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::zigzagToI32(uint32_t n) {
+  return (n >> 1) ^ -(n & 1);
+}
+
+/**
+ * Convert from zigzag long to long.
+ */
+template <class Transport_>
+int64_t TCompactProtocolT<Transport_>::zigzagToI64(uint64_t n) {
+  return (n >> 1) ^ -(n & 1);
+}
+
+template <class Transport_>
+TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
+  return detail::compact::CTypeToTType[type & 0x0f];
+}
+
+}}} // contrail::sandesh::protocol
+
+#endif // #ifndef _SANDESH_PROTOCOL_TCOMPACTPROTOCOL_TCC_
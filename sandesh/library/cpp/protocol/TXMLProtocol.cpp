@@ -6,6 +6,9 @@
 #include <cctype>
 #include <cstdio>
 #include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <boost/static_assert.hpp>
 #include <boost/algorithm/string/replace.hpp>
 
@@ -205,6 +208,139 @@ static inline void formXMLAttr(std::string &dest, const std::string& name,
   dest += "\"";
 }
 
+static const char kDigitPairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Appends the decimal representation of num to dest, two digits at a time
+static inline void appendUnsigned(std::string &dest, uint64_t num) {
+  char buf[20];
+  char *end = buf + sizeof(buf);
+  char *start = end;
+  while (num >= 100) {
+    const char *pair = kDigitPairs + (num % 100) * 2;
+    num /= 100;
+    *--start = pair[1];
+    *--start = pair[0];
+  }
+  if (num >= 10) {
+    const char *pair = kDigitPairs + num * 2;
+    *--start = pair[1];
+    *--start = pair[0];
+  } else {
+    *--start = '0' + num;
+  }
+  dest.append(start, end - start);
+}
+
+static inline void appendSigned(std::string &dest, int64_t num) {
+  if (num < 0) {
+    dest += '-';
+    appendUnsigned(dest, -static_cast<uint64_t>(num));
+  } else {
+    appendUnsigned(dest, num);
+  }
+}
+
+static inline bool isXMLControlChar(char ch) {
+  switch (ch) {
+  case '&':
+  case '\'':
+  case '<':
+  case '>':
+    return true;
+  }
+  return false;
+}
+
+// Returns the offset of the first XML control character in str, or length
+// if there is none. With SSE2, 16 characters are compared at a time.
+static inline size_t findXMLControlChar(const char *str, size_t length) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i apos = _mm_set1_epi8('\'');
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i gt = _mm_set1_epi8('>');
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+    __m128i match = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, apos)),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, lt), _mm_cmpeq_epi8(chunk, gt)));
+    int mask = _mm_movemask_epi8(match);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif // __SSE2__
+  for (; i < length; i++) {
+    if (isXMLControlChar(str[i])) {
+      return i;
+    }
+  }
+  return length;
+}
+
+// Appends str to dest, escaping the XML control characters. The double
+// quote is not escaped in the element text, as the readers do not expect it
+// escaped.
+static void appendXMLEscaped(std::string &dest, const std::string &str) {
+  const char *data = str.data();
+  size_t length = str.length();
+  size_t pos = findXMLControlChar(data, length);
+  if (pos == length) {
+    dest.append(data, length);
+    return;
+  }
+  dest.reserve(dest.length() + length + 16);
+  while (pos < length) {
+    dest.append(data, pos);
+    switch (data[pos]) {
+     case '&':  dest += "&amp;";  break;
+     case '\'': dest += "&apos;"; break;
+     case '<':  dest += "&lt;";   break;
+     case '>':  dest += "&gt;";   break;
+    }
+    data += pos + 1;
+    length -= pos + 1;
+    pos = findXMLControlChar(data, length);
+  }
+  dest.append(data, length);
+}
+
+// Forms the open tag of a field, <name type="..." identifier="..." ...>
+static void formFieldTag(std::string &dest, const char *name,
+                         const TType fieldType, const int16_t fieldId,
+                         const std::map<std::string, std::string> *const amap,
+                         const std::string &typeName) {
+  dest += kcXMLTagO;
+  dest += name;
+  dest += " ";
+  formXMLAttr(dest, kXMLType, typeName);
+  dest += " ";
+  dest += kXMLIdentifier;
+  dest += "=\"";
+  appendSigned(dest, fieldId);
+  dest += "\"";
+  if (amap != NULL) {
+    for (std::map<string, string>::const_iterator iter = amap->begin(); 
+         iter != amap->end(); iter++) {
+      dest += " ";
+      formXMLAttr(dest, (*iter).first, (*iter).second);
+    }
+  }
+  dest += kcXMLTagC;
+}
+
 void TXMLProtocol::indentUp() {
 #if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   indent_str_ += string(indent_inc, ' ');
@@ -223,29 +359,86 @@ void TXMLProtocol::indentDown() {
 #endif // !TXMLPROTOOL_DEBUG_PRETTY_PRINT
 }
 
+// Returns the number of bytes appended to the output since start. The
+// output is written to the transport when no element is open, returns -1
+// if that fails.
+int32_t TXMLProtocol::writeOutput(size_t start) {
+  int32_t size = output_.length() - start;
+  if (xml_depth_ == 0 && !output_.empty()) {
+    int ret = trans_->write((uint8_t*)output_.data(), output_.length());
+    output_.clear();
+    if (ret) {
+      LOG(ERROR, __func__ << ": Transport write FAILED");
+      return -1;
+    }
+  }
+  return size;
+}
+
 // Returns the number of bytes written on success, -1 otherwise
 int32_t TXMLProtocol::writePlain(const string& str) {
-  int ret = trans_->write((uint8_t*)str.data(), str.length());
-  if (ret) {
-    return -1;
-  }
-  return str.length();
+  size_t start = output_.length();
+  output_ += str;
+  return writeOutput(start);
 }
 
 // Returns the number of bytes written on success, -1 otherwise
 int32_t TXMLProtocol::writeIndented(const string& str) {
-  int ret;
+  size_t start = output_.length();
 #if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-  ret = trans_->write((uint8_t*)indent_str_.data(), indent_str_.length());
-  if (ret) {
-    return -1;
-  }
+  output_ += indent_str_;
 #endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-  ret = trans_->write((uint8_t*)str.data(), str.length());
-  if (ret) {
-    return -1;
+  output_ += str;
+  return writeOutput(start);
+}
+
+// Returns the tags of the field, formed on the first write of the field
+const TXMLProtocol::FieldTag& TXMLProtocol::fieldTag(const char* name,
+                                                     TType fieldType,
+                                                     int16_t fieldId) {
+  if (field_tags_.size() >= MAX_FIELD_TAGS) {
+    field_tags_.clear();
+  }
+  FieldTag &tag = field_tags_[name];
+  // The name is compared as well, in case the pointer was reused
+  if (tag.type != fieldType || tag.id != fieldId || tag.name != name) {
+    tag.name = name;
+    tag.type = fieldType;
+    tag.id = fieldId;
+    tag.open.clear();
+    formFieldTag(tag.open, name, fieldType, fieldId, NULL,
+                 fieldTypeName(fieldType));
+    tag.close.clear();
+    tag.close += kXMLEndTagO;
+    tag.close += tag.name;
+    tag.close += kXMLTagC;
+  }
+  return tag;
+}
+
+void TXMLProtocol::pushCloseTag(const std::string& etag) {
+  if (xml_depth_ == xml_state_.size()) {
+    xml_state_.push_back(etag);
+  } else {
+    xml_state_[xml_depth_] = etag;
   }
-  return indent_str_.length() + str.length();
+  xml_depth_++;
+}
+
+void TXMLProtocol::pushCloseTag(const char* name, size_t length) {
+  if (xml_depth_ == xml_state_.size()) {
+    xml_state_.push_back(string());
+  }
+  string &etag(xml_state_[xml_depth_++]);
+  etag.clear();
+  etag += kXMLEndTagO;
+  etag.append(name, length);
+  etag += kXMLTagC;
+}
+
+// The returned tag is valid until the next push
+const std::string& TXMLProtocol::popCloseTag() {
+  return xml_state_[--xml_depth_];
 }
 
 int32_t TXMLProtocol::writeMessageBegin(const std::string& name,
@@ -259,90 +452,69 @@ int32_t TXMLProtocol::writeMessageEnd() {
 }
 
 int32_t TXMLProtocol::writeStructBegin(const char* name) {
-  int32_t size = 0, ret;
-  string sname(name);
-  string xml;
-  xml.reserve(512);
+  size_t start = output_.length();
+  size_t length = strlen(name);
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   // Form the xml tag
-  xml += kXMLTagO;
-  xml += sname;
-  xml += kXMLTagC;
-  xml += endl;
-  // Write to transport
-  if ((ret = writeIndented(xml)) < 0) {
-    LOG(ERROR, __func__ << ": " << sname << " FAILED");
-    return ret;
-  }
-  size += ret;
-  xml_state_.push_back(sname);
+  output_ += kcXMLTagO;
+  output_.append(name, length);
+  output_ += kcXMLTagC;
+  output_ += endl;
+  pushCloseTag(name, length);
   indentUp(); 
-  return size;
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeStructEnd() {
   indentDown();
-  int32_t size = 0, ret;
-  string etag(xml_state_.back());
-  xml_state_.pop_back();
-  string xml;
-  xml.reserve(128);
-  // Form the xml tag
-  xml += kXMLEndTagO;
-  xml += etag;
-  xml += kXMLTagC;
-  xml += endl;
-  // Write to transport
-  if ((ret = writeIndented(xml)) < 0) {
+  const string &etag(popCloseTag());
+  size_t start = output_.length();
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += etag;
+  output_ += endl;
+  int32_t ret = writeOutput(start);
+  if (ret < 0) {
     LOG(ERROR, __func__ << ": " << etag << " FAILED");
-    return ret;
   }
-  size += ret;
-  return size;
+  return ret;
 }
 
 int32_t TXMLProtocol::writeSandeshBegin(const char* name) {
-  int32_t size = 0, ret;
-  string sname(name);
-  string xml;
-  xml.reserve(512);
+  size_t start = output_.length();
+  size_t length = strlen(name);
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   // Form the xml tag
-  xml += kXMLTagO;
-  xml += sname;
-  xml += " ";
-  xml += kAttrTypeSandesh;
-  xml += kXMLTagC;
-  xml += endl;
-  // Write to transport
-  ret = writeIndented(xml);
-  if (ret < 0) {
-    LOG(ERROR, __func__ << ": " << sname << " FAILED");
-    return ret;
-  }
-  size += ret;
-  xml_state_.push_back(sname);
+  output_ += kcXMLTagO;
+  output_.append(name, length);
+  output_ += " ";
+  output_ += kAttrTypeSandesh;
+  output_ += kcXMLTagC;
+  output_ += endl;
+  pushCloseTag(name, length);
   indentUp();
-  return size;
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeSandeshEnd() {
   indentDown();
-  int32_t size = 0, ret;
-  string etag(xml_state_.back());
-  xml_state_.pop_back();
-  string exml;
-  exml.reserve(128);
-  // Form the xml tag
-  exml += kXMLEndTagO;
-  exml += etag;
-  exml += kXMLTagC;
-  exml += endl;
-  // Write to transport
-  if ((ret = writeIndented(exml)) < 0) {
+  const string &etag(popCloseTag());
+  size_t start = output_.length();
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += etag;
+  output_ += endl;
+  int32_t ret = writeOutput(start);
+  if (ret < 0) {
     LOG(ERROR, __func__ << ": " << etag << " FAILED");
-    return ret;
   }
-  size += ret;
-  return size;
+  return ret;
 }
 
 int32_t TXMLProtocol::writeContainerElementBegin() {
@@ -357,121 +529,77 @@ int32_t TXMLProtocol::writeFieldBegin(const char *name,
                                       const TType fieldType,
                                       const int16_t fieldId,
                                       const std::map<std::string, std::string> *const amap) {
-  int32_t size = 0, ret;
-  string sname(name);
-  string xml;
-  xml.reserve(512);
-  // Form the xml tag
-  xml += kXMLTagO;
-  xml += sname;
-  xml += " ";
-  formXMLAttr(xml, kXMLType, fieldTypeName(fieldType));
-  xml += " ";
-  formXMLAttr(xml, kXMLIdentifier, integerToString(fieldId));
-  if (amap != NULL) {
-    for (std::map<string, string>::const_iterator iter = amap->begin(); 
-         iter != amap->end(); iter++) {
-      xml += " ";
-      formXMLAttr(xml, (*iter).first, (*iter).second);
-    }
-  }
-  xml += kXMLTagC;
-  // Write to transport
-  if ((ret = writeIndented(xml)) < 0) {
-    LOG(ERROR, __func__ << ": " << xml << " FAILED");
-    return ret;
+  size_t start = output_.length();
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  // Form the xml tag, the tags of the fields without annotations are
+  // formed once
+  if (amap == NULL) {
+    const FieldTag &tag(fieldTag(name, fieldType, fieldId));
+    output_ += tag.open;
+    pushCloseTag(tag.close);
+  } else {
+    formFieldTag(output_, name, fieldType, fieldId, amap,
+                 fieldTypeName(fieldType));
+    pushCloseTag(name, strlen(name));
   }
-  size += ret;
-  xml_state_.push_back(sname);
   if (fieldType == T_STRUCT) {
 	write_state_.push_back(STRUCT);
 #ifdef TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-	if ((ret = writePlain(endl)) < 0) {
-	  LOG(ERROR, __func__ << ": " << fieldTypeName(fieldType) << " FAILED");
-	  return ret;
-	}
-	size += ret;
+	output_ += endl;
 	indentUp();
 #endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   } else if (fieldType == T_SANDESH) {
 	write_state_.push_back(SNDESH);
 #ifdef TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-    if ((ret = writePlain(endl)) < 0) {
-      LOG(ERROR, __func__ << ": " << fieldTypeName(fieldType) << " FAILED");
-      return ret;
-    }
-    size += ret;
+    output_ += endl;
 #endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   } else if (fieldType == T_LIST) {
 	write_state_.push_back(LIST);
 #ifdef TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-    if ((ret = writePlain(endl)) < 0) {
-      LOG(ERROR, __func__ << ": " << fieldTypeName(fieldType) << " FAILED");
-      return ret;
-    }
-    size += ret;
+    output_ += endl;
 #endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   } else if (fieldType == T_MAP) {
 	write_state_.push_back(MAP);
 #ifdef TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-    if ((ret = writePlain(endl)) < 0) {
-      LOG(ERROR, __func__ << ": " << fieldTypeName(fieldType) << " FAILED");
-      return ret;
-    }
-    size += ret;
+    output_ += endl;
 #endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   } else if (fieldType == T_SET) {
 	write_state_.push_back(SET);
 #ifdef TXMLPROTOCOL_DEBUG_PRETTY_PRINT
-    if ((ret = writePlain(endl)) < 0) {
-      LOG(ERROR, __func__ << ": " << fieldTypeName(fieldType) << " FAILED");
-      return ret;
-    }
-    size += ret;
+    output_ += endl;
 #endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   } else {
     write_state_.push_back(UNINIT);
   }
-  return size; 
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeFieldEnd() {
-  int32_t size = 0, ret;
-  string etag(xml_state_.back());
-  xml_state_.pop_back();
-  string exml;
-  exml.reserve(128);
-  // Form the xml tag
-  exml += kXMLEndTagO;
-  exml += etag;
-  exml += kXMLTagC;
-  exml += endl;
-  // Write to transport
+  const string &etag(popCloseTag());
+  size_t start = output_.length();
   write_state_t state = write_state_.back();
-  if (state != STRUCT &&
-      state != SNDESH &&
-      state != LIST   &&
-      state != MAP    &&
-      state != SET) {
-    if ((ret = writePlain(exml)) < 0) {
-      LOG(ERROR, __func__ << ": " << etag << " " << state <<
-          " FAILED");
-      return ret;
-    }
-    size += ret;
-  } else {
+  if (state == STRUCT ||
+      state == SNDESH ||
+      state == LIST   ||
+      state == MAP    ||
+      state == SET) {
     if (state == STRUCT) {
       indentDown();
     }
-    if ((ret = writeIndented(exml)) < 0) {
-      LOG(ERROR, __func__ << ": " << etag << " " << state <<
-          " FAILED");
-      return ret;
-    }
-    size += ret;
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+    output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   }
+  output_ += etag;
+  output_ += endl;
   write_state_.pop_back();
-  return size;
+  int32_t ret = writeOutput(start);
+  if (ret < 0) {
+    LOG(ERROR, __func__ << ": " << etag << " " << state << " FAILED");
+  }
+  return ret;
 }
 
 int32_t TXMLProtocol::writeFieldStop() {
@@ -481,110 +609,79 @@ int32_t TXMLProtocol::writeFieldStop() {
 int32_t TXMLProtocol::writeMapBegin(const TType keyType,
                                     const TType valType,
                                     const uint32_t size) {
-  int32_t bsize = 0, ret;
-  string xml;
-  xml.reserve(256);
+  size_t start = output_.length();
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   // Form the xml tag
-  xml += kXMLMapTagO;
-  formXMLAttr(xml, kXMLKey, fieldTypeName(keyType));
-  xml += " ";
-  formXMLAttr(xml, kXMLValue, fieldTypeName(valType));
-  xml += " ";
-  formXMLAttr(xml, kXMLSize, integerToString(size));
-  xml += kXMLTagC;
-  xml += endl;
-  // Write to transport
-  ret = writeIndented(xml);
-  if (ret < 0) {
-    LOG(ERROR, __func__ << ": Key: " << fieldTypeName(keyType) <<
-        " Value: " << fieldTypeName(valType) << " FAILED");
-    return ret;
-  }
-  bsize += ret;
+  output_ += kXMLMapTagO;
+  formXMLAttr(output_, kXMLKey, fieldTypeName(keyType));
+  output_ += " ";
+  formXMLAttr(output_, kXMLValue, fieldTypeName(valType));
+  output_ += " ";
+  output_ += kXMLSize;
+  output_ += "=\"";
+  appendUnsigned(output_, size);
+  output_ += "\"";
+  output_ += kcXMLTagC;
+  output_ += endl;
   indentUp();
-  return bsize;
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeMapEnd() {
-  int32_t size = 0, ret;
   indentDown();
-  if ((ret = writeIndented(kXMLMapTagC)) < 0) {
-    LOG(ERROR, __func__ << " FAILED");
-    return ret;
-  }
-  size += ret;
-  return size;
+  return writeIndented(kXMLMapTagC);
 }
 
 int32_t TXMLProtocol::writeListBegin(const TType elemType,
                                      const uint32_t size) {
-  int32_t bsize = 0, ret;
-  string xml;
-  xml.reserve(256);
+  size_t start = output_.length();
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   // Form the xml tag
-  xml += kXMLListTagO;
-  formXMLAttr(xml, kXMLType, fieldTypeName(elemType));
-  xml += " ";
-  formXMLAttr(xml, kXMLSize, integerToString(size));
-  xml += kXMLTagC;
-  xml += endl;
-  // Write to transport
-  ret = writeIndented(xml);
-  if (ret < 0) {
-    LOG(ERROR, __func__ << ": " << fieldTypeName(elemType) <<
-        " FAILED");
-    return ret;
-  }
-  bsize += ret;
+  output_ += kXMLListTagO;
+  formXMLAttr(output_, kXMLType, fieldTypeName(elemType));
+  output_ += " ";
+  output_ += kXMLSize;
+  output_ += "=\"";
+  appendUnsigned(output_, size);
+  output_ += "\"";
+  output_ += kcXMLTagC;
+  output_ += endl;
   indentUp();
-  return bsize;
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeListEnd() {
-  int32_t size = 0, ret;
   indentDown();
-  ret = writeIndented(kXMLListTagC);
-  if (ret < 0) {
-    LOG(ERROR, __func__ << " FAILED");
-    return ret;
-  }
-  size += ret;
-  return size;
+  return writeIndented(kXMLListTagC);
 }
 
 int32_t TXMLProtocol::writeSetBegin(const TType elemType,
                                     const uint32_t size) {
-  int32_t bsize = 0, ret;
-  string xml;
-  xml.reserve(256);
+  size_t start = output_.length();
+#if TXMLPROTOCOL_DEBUG_PRETTY_PRINT
+  output_ += indent_str_;
+#endif // !TXMLPROTOCOL_DEBUG_PRETTY_PRINT
   // Form the xml tag
-  xml += kXMLSetTagO;
-  formXMLAttr(xml, kXMLType, fieldTypeName(elemType));
-  xml += " ";
-  formXMLAttr(xml, kXMLSize, integerToString(size));
-  xml += kXMLTagC;
-  xml += endl;
-  // Write to transport
-  ret = writeIndented(xml);
-  if (ret < 0) {
-    LOG(ERROR, __func__ << ": " << fieldTypeName(elemType) <<
-        " FAILED");
-    return ret;
-  }
-  bsize += ret;
+  output_ += kXMLSetTagO;
+  formXMLAttr(output_, kXMLType, fieldTypeName(elemType));
+  output_ += " ";
+  output_ += kXMLSize;
+  output_ += "=\"";
+  appendUnsigned(output_, size);
+  output_ += "\"";
+  output_ += kcXMLTagC;
+  output_ += endl;
   indentUp();
-  return bsize;
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeSetEnd() {
-  int32_t size = 0, ret;
   indentDown();
-  if ((ret = writeIndented(kXMLSetTagC)) < 0) {
-    LOG(ERROR, __func__ << " FAILED");
-    return ret;
-  }
-  size += ret;
-  return size;
+  return writeIndented(kXMLSetTagC);
 }
 
 int32_t TXMLProtocol::writeBool(const bool value) {
@@ -592,35 +689,51 @@ int32_t TXMLProtocol::writeBool(const bool value) {
 }
 
 int32_t TXMLProtocol::writeByte(const int8_t byte) {
-  return writePlain(integerToString(byte));
+  size_t start = output_.length();
+  appendSigned(output_, byte);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeI16(const int16_t i16) {
-  return writePlain(integerToString(i16));
+  size_t start = output_.length();
+  appendSigned(output_, i16);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeI32(const int32_t i32) {
-  return writePlain(integerToString(i32));
+  size_t start = output_.length();
+  appendSigned(output_, i32);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeI64(const int64_t i64) {
-  return writePlain(integerToString(i64));
+  size_t start = output_.length();
+  appendSigned(output_, i64);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeU16(const uint16_t u16) {
-  return writePlain(integerToString(u16));
+  size_t start = output_.length();
+  appendUnsigned(output_, u16);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeU32(const uint32_t u32) {
-  return writePlain(integerToString(u32));
+  size_t start = output_.length();
+  appendUnsigned(output_, u32);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeU64(const uint64_t u64) {
-  return writePlain(integerToString(u64));
+  size_t start = output_.length();
+  appendUnsigned(output_, u64);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeIPV4(const uint32_t ip4) {
-  return writePlain(integerToString(ip4));
+  size_t start = output_.length();
+  appendUnsigned(output_, ip4);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeIPADDR(const boost::asio::ip::address& ipaddress) {
@@ -628,12 +741,19 @@ int32_t TXMLProtocol::writeIPADDR(const boost::asio::ip::address& ipaddress) {
 }
 
 int32_t TXMLProtocol::writeDouble(const double dub) {
-  return writePlain(integerToString(dub));
+  // Same as the default iostream formatting
+  char buf[32];
+  int length = snprintf(buf, sizeof(buf), "%g", dub);
+  size_t start = output_.length();
+  output_.append(buf, length);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeString(const string& str) {
   // Escape XML control characters in the string before writing
-  return writePlain(escapeXMLControlChars(str));
+  size_t start = output_.length();
+  appendXMLEscaped(output_, str);
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeBinary(const string& str) {
@@ -642,12 +762,11 @@ int32_t TXMLProtocol::writeBinary(const string& str) {
 }
 
 int32_t TXMLProtocol::writeXML(const string& str) {
-  std::string xmlstr;
-  xmlstr.reserve(str.length() + kXMLCDATAO.length() + kXMLCDATAC.length());
-  xmlstr += kXMLCDATAO;
-  xmlstr += str;
-  xmlstr += kXMLCDATAC;
-  return writePlain(xmlstr);
+  size_t start = output_.length();
+  output_ += kXMLCDATAO;
+  output_ += str;
+  output_ += kXMLCDATAC;
+  return writeOutput(start);
 }
 
 int32_t TXMLProtocol::writeUUID(const boost::uuids::uuid& uuid) {
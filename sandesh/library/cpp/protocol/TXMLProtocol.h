@@ -10,6 +10,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/tokenizer.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 
@@ -17,6 +18,10 @@ namespace contrail { namespace sandesh { namespace protocol {
 
 /**
  * Protocol that prints the payload in XML format.
+ *
+ * The writers append to an output buffer, which is written to the transport
+ * when the outermost element is closed. The field tags are formed once per
+ * field and the numbers and strings are formatted without iostreams.
  */
 class TXMLProtocol : public TVirtualProtocol<TXMLProtocol> {
  private:
@@ -35,13 +40,16 @@ class TXMLProtocol : public TVirtualProtocol<TXMLProtocol> {
     , trans_(trans.get())
     , string_limit_(DEFAULT_STRING_LIMIT)
     , string_prefix_size_(DEFAULT_STRING_PREFIX_SIZE)
+    , xml_depth_(0)
     , reader_(*trans)
   {
     write_state_.push_back(UNINIT);
+    output_.reserve(DEFAULT_OUTPUT_SIZE);
   }
 
   static const int32_t DEFAULT_STRING_LIMIT = 256;
   static const int32_t DEFAULT_STRING_PREFIX_SIZE = 16;
+  static const size_t DEFAULT_OUTPUT_SIZE = 4096;
 
   void setStringSizeLimit(int32_t string_limit) {
     string_limit_ = string_limit;
@@ -318,10 +326,26 @@ class TXMLProtocol : public TVirtualProtocol<TXMLProtocol> {
 
   int32_t readXMLUuid(boost::uuids::uuid &uuid);
 
+  // Open and close tags of a field, formed on the first write of the field
+  struct FieldTag {
+    FieldTag() : type(T_STOP), id(0) {}
+    std::string name;
+    TType type;
+    int16_t id;
+    std::string open;
+    std::string close;
+  };
+
   void indentUp();
   void indentDown();
   int32_t writePlain(const std::string& str);
   int32_t writeIndented(const std::string& str);
+  int32_t writeOutput(size_t start);
+  const FieldTag& fieldTag(const char* name, TType fieldType,
+                           int16_t fieldId);
+  void pushCloseTag(const std::string& etag);
+  void pushCloseTag(const char* name, size_t length);
+  const std::string& popCloseTag();
 
   static const std::string& fieldTypeName(TType type);
   static TType getTypeIDForTypeName(const std::string &name);
@@ -337,7 +361,17 @@ class TXMLProtocol : public TVirtualProtocol<TXMLProtocol> {
 
   std::vector<write_state_t> write_state_;
 
+  // Close tags of the open elements, the strings above xml_depth_ are kept
+  // for reuse
   std::vector<std::string> xml_state_;
+  size_t xml_depth_;
+
+  // The field names are the string literals of the generated code
+  typedef boost::unordered_map<const char*, FieldTag> FieldTagMap;
+  static const size_t MAX_FIELD_TAGS = 4096;
+  FieldTagMap field_tags_;
+
+  std::string output_;
   LookaheadReader reader_;
 };
 
@@ -24,7 +24,9 @@
 #include <sandesh/transport/TBufferTransports.h>
 #include <sandesh/transport/TSimpleFileTransport.h>
 #include <sandesh/protocol/TBinaryProtocol.h>
+#include <sandesh/protocol/TCompactProtocol.h>
 #include <sandesh/protocol/TProtocol.h>
+#include <sandesh/protocol/TXMLProtocol.h>
 
 #include <sandesh/sandesh_types.h>
 #include <sandesh/sandesh.h>
@@ -568,6 +570,28 @@ bool Sandesh::ProcessRecv(SandeshRequest *rsnh) {
 
 void SandeshRequest::Release() { self_.reset(); }
 
+// The protocols passed to the concrete protocol writers are owned by the
+// caller.
+struct SandeshProtocolNoDelete {
+    void operator()(TProtocol *prot) const {
+    }
+};
+
+int32_t Sandesh::Write(TXMLProtocol *oprot) const {
+    return Write(boost::shared_ptr<TProtocol>(oprot,
+                                              SandeshProtocolNoDelete()));
+}
+
+int32_t Sandesh::Write(TBinaryProtocolT<TMemoryBuffer> *oprot) const {
+    return Write(boost::shared_ptr<TProtocol>(oprot,
+                                              SandeshProtocolNoDelete()));
+}
+
+int32_t Sandesh::Write(TCompactProtocolT<TMemoryBuffer> *oprot) const {
+    return Write(boost::shared_ptr<TProtocol>(oprot,
+                                              SandeshProtocolNoDelete()));
+}
+
 int32_t Sandesh::WriteBinary(u_int8_t *buf, u_int32_t buf_len,
         int *error) {
     int32_t xfer;
@@ -102,6 +102,12 @@ class EventManager;
 class SandeshClient;
 class SandeshSession;
 
+namespace contrail { namespace sandesh { namespace protocol {
+class TXMLProtocol;
+template <class Transport_> class TBinaryProtocolT;
+template <class Transport_> class TCompactProtocolT;
+}}}
+
 // Sandesh Context
 class SandeshContext {
     // Abstract base class for users of sandesh library to
@@ -272,6 +278,17 @@ public:
              boost::shared_ptr<contrail::sandesh::protocol::TProtocol> iprot) = 0;
     virtual int32_t Write(
              boost::shared_ptr<contrail::sandesh::protocol::TProtocol> oprot) const = 0;
+    // Writers of the concrete protocols used by the SandeshEncoder, the
+    // generated sandeshs override them to inline the protocol calls. The
+    // default ones go through the generic protocol.
+    virtual int32_t Write(
+             contrail::sandesh::protocol::TXMLProtocol *oprot) const;
+    virtual int32_t Write(
+             contrail::sandesh::protocol::TBinaryProtocolT<
+                 contrail::sandesh::transport::TMemoryBuffer> *oprot) const;
+    virtual int32_t Write(
+             contrail::sandesh::protocol::TCompactProtocolT<
+                 contrail::sandesh::transport::TMemoryBuffer> *oprot) const;
     virtual const uint32_t seqnum() { return seqnum_; }
     virtual const int32_t versionsig() const = 0;
     virtual const char *Name() const { return name_.c_str(); }
@@ -73,6 +73,7 @@ SandeshClient::SandeshClient(EventManager *evm,
         dscp_value_(0),
         collectors_(collectors),
         stats_collector_(config.stats_collector),
+        binary_encoding_(config.sandesh_binary_encoding_enable),
         sm_(SandeshClientSM::CreateClientSM(evm, this, sm_task_instance_, sm_task_id_,
                                             periodicuve)),
         session_wm_info_(kSessionWaterMarkInfo),
@@ -131,6 +132,14 @@ SandeshClient::SandeshClient(EventManager *evm,
                         ec.message());
             exit(EINVAL);
         }
+        // Resume the sessions of reconnecting peers
+        if (config.sandesh_ssl_session_cache_size > 0) {
+            EnableSessionCache(config.sandesh_ssl_session_cache_size,
+                               config.sandesh_ssl_session_lifetime);
+        }
+        if (config.sandesh_ssl_ktls_enable) {
+            EnableKtls();
+        }
     }
     if (stats_collector_ != "") {
         UdpServer::Endpoint stats_server;
@@ -205,6 +214,21 @@ bool SandeshClient::ReceiveCtrlMsg(const std::string &msg,
     }
     SANDESH_LOG(DEBUG, "Received Ctrl Message with size " << snh->get_type_info().size());
 
+    // Encode the messages as selected by the collector, it only selects
+    // an encoding that was offered
+    SandeshEncoding::type encoding(SandeshEncoding::XML);
+    if (snh->__isset.encoding &&
+        !SandeshEncoding::FromString(snh->get_encoding(), &encoding)) {
+        SANDESH_LOG(ERROR, "Received Ctrl Message with unknown encoding " <<
+                    snh->get_encoding());
+        sandesh->Release();
+        return false;
+    }
+    SandeshSession *session(sm_->session());
+    if (session) {
+        session->set_encoding(encoding);
+    }
+
     map<string,uint32_t> sMap;
     const vector<UVETypeInfo> & vu = snh->get_type_info();
     for(uint32_t i = 0; i < vu.size(); i++) {
@@ -320,9 +344,17 @@ void SandeshClient::InitializeSMSession(int count) {
         Sandesh::module() << ":" << Sandesh::instance_id() << ":" <<
         Sandesh::node_type() << " count " << count);
 
+    std::vector<string> encodings;
+    if (binary_encoding_) {
+        encodings.push_back(
+            SandeshEncoding::ToString(SandeshEncoding::COMPACT));
+        encodings.push_back(
+            SandeshEncoding::ToString(SandeshEncoding::BINARY));
+    }
+
     SandeshCtrlClientToServer::Request(Sandesh::source(), Sandesh::module(),
             count, stv, getpid(), Sandesh::http_port(),
-            Sandesh::node_type(), Sandesh::instance_id(), "ctrl");
+            Sandesh::node_type(), Sandesh::instance_id(), encodings, "ctrl");
 
 }
 
@@ -132,6 +132,7 @@ private:
     uint8_t dscp_value_;
     std::vector<Endpoint> collectors_;
     std::string stats_collector_;
+    bool binary_encoding_;
     boost::scoped_ptr<SandeshClientSM> sm_;
     boost::scoped_ptr<StatsClient> stats_client_;
     std::vector<Sandesh::QueueWaterMarkInfo> session_wm_info_;
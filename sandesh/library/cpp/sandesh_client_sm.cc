@@ -995,6 +995,9 @@ bool SandeshClientSMImpl::StatisticsTimerExpired() {
         SocketIOStats tx_stats;
         session->GetTxSocketStats(tx_stats);
         mcs.set_session_tx_socket_stats(tx_stats);
+        mcs.set_session_ktls_mode(session->ktls_mode());
+        mcs.set_session_encoding(
+            SandeshEncoding::ToString(session->encoding()));
     }
     SandeshModuleClientTrace::Send(mcs);
     SendUVE();
@@ -16,6 +16,7 @@
 #include "http/http_server.h"
 #include <cstring>
 #include <cstdlib>
+#include <sstream>
 #include <boost/bind.hpp>
 #include <boost/tokenizer.hpp>
 
@@ -24,6 +25,7 @@
 #include <sandesh/sandesh_http.h>
 #include <sandesh/transport/TBufferTransports.h>
 #include <sandesh/protocol/TXMLProtocol.h>
+#include <sandesh/protocol/TJSONProtocol.h>
 #include "sandesh_client.h"
 #include <sandesh/sandesh_trace.h>
 #include <sandesh/sandesh_trace_types.h>
@@ -61,9 +63,6 @@ string SandeshHttp::index_str_;
 SandeshHttp::HtmlInfo *SandeshHttp::index_hti_ = NULL;
 
 
-#define SESSION_SEND(buf) \
-    HttpSession::SendSession(context,reinterpret_cast<const u_int8_t *>(buf), strlen(buf), NULL)
-
 enum HttpXMLState {
     HXMLInvalid,
     HXMLNew,
@@ -71,146 +70,182 @@ enum HttpXMLState {
     HXMLMax
 };
 
+static void
+HttpSendString(HttpSession *session, const std::string &str) {
+    if (!str.empty()) {
+        session->Send(reinterpret_cast<const u_int8_t *>(str.c_str()),
+                      str.size(), NULL);
+    }
+}
+
+// Send a chunk of a chunked response made of the payload between a prefix
+// and a suffix, nothing if it is empty since the empty chunk terminates the
+// response.
+static void
+HttpSendChunk(HttpSession *session, const std::string &prefix,
+              const u_int8_t *buf, uint32_t len, const std::string &suffix) {
+    size_t size = prefix.size() + len + suffix.size();
+    if (size == 0) {
+        return;
+    }
+    std::ostringstream head;
+    head << std::hex << size << "\r\n" << prefix;
+    HttpSendString(session, head.str());
+    if (len) {
+        session->Send(buf, len, NULL);
+    }
+    HttpSendString(session, suffix + "\r\n");
+}
+
 // Helper function for forming HTTP headers and sending a bytestream
-// for XML
+// of the XML or JSON representation of a response
+//
+// The chunks of the responses of a session are formatted and sent under the
+// response mutex of the session, the other sessions send their responses
+// independently.
+//
+// The body of a chunked response is the list of the sandeshes sent, an XML
+// list element or a JSON array, each sandesh is sent in a chunk with the
+// list delimiters around it. With a content encoding, the body is compressed
+// as one stream and each chunk carries the compressed output available.
 //
 // Arguments:
-//   context : handle to Session on which to send bytestream
-//   buf : Buffer that contains XML payload
+//   session : Session on which to send bytestream
+//   state : HXMLNew for the first chunk of the response
+//   buf : Buffer that contains XML or JSON payload
 //   len : length of buffer
-//   name : Name of Sandesh Module  
 //   more : This is true if there is more content coming for this response
 //
 static void
-HttpSendXML(const std::string& context, const u_int8_t * buf, uint32_t len,
-            const char * name, bool more) {
+HttpSendResponse(HttpSession *session, HttpXMLState state,
+                 const u_int8_t *buf, uint32_t len, bool more) {
 
-    char buffer_str[100];
-    char length_str[80];
-    static const char xsl_response[] =
-"HTTP/1.1 200 OK\r\n"
-"Content-Type: text/xml\r\n"
-;
-    static const char chunk_response[] =
-"HTTP/1.1 200 OK\r\n"
-"Content-Type: text/xml\r\n"
-"Transfer-Encoding: chunked\r\n\r\n"
+    static const char xsl_header[] =
+"<?xml-stylesheet type=\"text/xsl\" href=\"/universal_parse.xsl\"?>"
 ;
-    char resp_name[40];
-    int loc = strcspn(reinterpret_cast<const char *>(buf)," ");
-    strncpy(resp_name, reinterpret_cast<const char *>(buf + 1), loc - 1);
-    resp_name[loc - 1] = 0;
-
-    static tbb::mutex hmutex;
-    static int seq = 0;
-    tbb::mutex::scoped_lock lock(hmutex);
-    std::string client_ctx;
-    seq++;
-   
-    client_ctx = HttpSession::get_client_context(context);
-    HttpXMLState state;
 
-    // Calculate current state;
-    if (!client_ctx.empty()) {
-        state = HXMLIncomplete;
+    const HttpSession::ResponseFormat &format = session->response_format();
+    const std::string &client_ctx = session->client_context();
+    HttpCompressor *compressor = session->compressor();
+    const char *encoding = HttpCompressor::EncodingName(format.encoding);
+
+    // Body content before and after the payload
+    std::string prefix, suffix;
+    if ((HXMLNew == state) && (!more)) {
+        // This is the first and last chunk of this response
+        if (!format.json) {
+            prefix = xsl_header;
+        }
+    } else if (format.json) {
+        prefix = (HXMLNew == state) ? "[" : ",";
+        if (!more) {
+            suffix = "]";
+        }
     } else {
-        state = HXMLNew;
-        client_ctx = resp_name;
+        if (HXMLNew == state) {
+            prefix = xsl_header;
+            prefix += "<__" + client_ctx + "_list type=\"slist\">";
+        }
+        if (!more) {
+            suffix = "</__" + client_ctx + "_list>";
+        }
+    }
+
+    // HTTP headers sent with the first chunk
+    std::ostringstream head;
+    if (HXMLNew == state) {
+        head << "HTTP/1.1 200 OK\r\n" << "Content-Type: "
+             << (format.json ? "application/json" : "text/xml") << "\r\n";
+        if (encoding) {
+            head << "Content-Encoding: " << encoding << "\r\n";
+        }
+    }
 
-        // If the session is gone, we can stop processing.
-        if (!HttpSession::set_client_context(context, client_ctx))
+    if (!compressor) {
+        if ((HXMLNew == state) && (!more)) {
+            head << "Content-Length: " << len + prefix.size() << "\r\n\r\n"
+                 << prefix;
+            HttpSendString(session, head.str());
+            session->Send(buf, len, NULL);
             return;
+        }
+        if (HXMLNew == state) {
+            head << "Transfer-Encoding: chunked\r\n\r\n";
+            HttpSendString(session, head.str());
+        }
+        HttpSendChunk(session, prefix, buf, len, suffix);
+        if (!more) {
+            HttpSendString(session, "0\r\n\r\n");
+        }
+        return;
     }
-   
+
+    std::string body;
+    compressor->Compress(reinterpret_cast<const u_int8_t *>(prefix.c_str()),
+                         prefix.size(), false, &body);
+    compressor->Compress(buf, len, false, &body);
+    compressor->Compress(reinterpret_cast<const u_int8_t *>(suffix.c_str()),
+                         suffix.size(), !more, &body);
     if ((HXMLNew == state) && (!more)) {
-        // This is the first and last chunk of this response
+        head << "Content-Length: " << body.size() << "\r\n\r\n";
+        HttpSendString(session, head.str());
+        HttpSendString(session, body);
+        return;
+    }
+    if (HXMLNew == state) {
+        head << "Transfer-Encoding: chunked\r\n\r\n";
+        HttpSendString(session, head.str());
+    }
+    HttpSendChunk(session, "", reinterpret_cast<const u_int8_t *>(
+                  body.c_str()), body.size(), "");
+    if (!more) {
+        HttpSendString(session, "0\r\n\r\n");
+    }
+}
+
+// Format a sandesh of a response as XML or JSON and send it on the session,
+// under the response mutex of the session
+static void
+HttpSendSandesh(HttpSession *session, Sandesh *snh, bool more) {
+    tbb::mutex::scoped_lock lock(session->response_mutex());
+    HttpXMLState state;
 
-        SESSION_SEND(xsl_response);
-
-        size_t total_len = len;
-        sprintf(buffer_str,
-            "<?xml-stylesheet type=\"text/xsl\" href=\"/universal_parse.xsl\"?>"
-            );
-        sprintf(length_str,
-                "Content-Length: %zu\r\n\r\n", total_len + strlen(buffer_str));
-        SESSION_SEND(length_str);
-        SESSION_SEND(buffer_str);
-
-        HttpSession::SendSession(context, buf, len, NULL);
-
-    } else if ((HXMLNew == state) && more) {
-        // This is the first chunk of this response
-        SESSION_SEND(chunk_response);
-
-        // Calculation for Header
-        sprintf(buffer_str,
-            "<?xml-stylesheet type=\"text/xsl\" href=\"/universal_parse.xsl\"?>"
-            );
-        int hdr_len = strlen(buffer_str);
-        sprintf(buffer_str,
-            "<__%s_list type=\"slist\">\r\n", client_ctx.c_str());
-        hdr_len += (strlen(buffer_str) - 2);
-
-        sprintf(length_str, "%x\r\n", hdr_len);
-        SESSION_SEND(length_str);
-
-        sprintf(buffer_str,
-            "<?xml-stylesheet type=\"text/xsl\" href=\"/universal_parse.xsl\"?>"
-            );
-        SESSION_SEND(buffer_str);
-
-        sprintf(buffer_str,
-            "<__%s_list type=\"slist\">\r\n", client_ctx.c_str());
-        SESSION_SEND(buffer_str);
-
-       
-        // Calculation for Data
-        sprintf(length_str, "%x\r\n", len);
-        SESSION_SEND(length_str);
-
-        HttpSession::SendSession(context, buf, len, NULL);
-
-        sprintf(buffer_str,"\r\n");
-        SESSION_SEND(buffer_str);
-        
-    } else if ((HXMLIncomplete == state) && !more) {
-        // This is the last chunk of this response
-        
-        // Calculation for Data
-        sprintf(length_str, "%x\r\n", len);
-        SESSION_SEND(length_str);
-
-        HttpSession::SendSession(context, buf, len, NULL);
-
-        sprintf(buffer_str,"\r\n");
-        SESSION_SEND(buffer_str);
-
-        //Calculation for Footer
-        sprintf(buffer_str,"</__%s_list>\r\n", client_ctx.c_str());
-        sprintf(length_str, "%zx\r\n", strlen(buffer_str) - 2);
-        SESSION_SEND(length_str);
-        SESSION_SEND(buffer_str);
-
-        sprintf(length_str, "0\r\n\r\n");
-        SESSION_SEND(length_str);
-    } else if ((HXMLIncomplete == state) && more) {
-        // This is a middle chunk of the response
-       
-        // Calculation for Data
-        sprintf(length_str, "%x\r\n", len);
-        SESSION_SEND(length_str);
-
-        HttpSession::SendSession(context, buf, len, NULL);
-
-        sprintf(buffer_str,"\r\n");
-        SESSION_SEND(buffer_str);
+    // Calculate current state, the format of the response is the one
+    // requested when it starts
+    if (!session->client_context().empty()) {
+        state = HXMLIncomplete;
+    } else {
+        state = HXMLNew;
+        const HttpSession::ResponseFormat &format =
+            session->requested_format();
+        session->set_client_context(snh->Name());
+        session->set_response_format(format);
+        session->set_compressor(format.encoding == HttpCompressor::IDENTITY ?
+            NULL : new HttpCompressor(format.encoding));
     }
-    // Update context for other users
+
+    uint8_t *buffer;
+    uint32_t offset;
+    boost::shared_ptr<TMemoryBuffer> btrans =
+            boost::shared_ptr<TMemoryBuffer>(
+                    new TMemoryBuffer(kEncodeBufferSize));
+    boost::shared_ptr<TProtocol> prot;
+    if (session->response_format().json) {
+        prot.reset(new TJSONProtocol(btrans));
+    } else {
+        prot.reset(new TXMLProtocol(btrans));
+    }
+    // Write the sandesh
+    snh->Write(prot);
+    // Get the buffer
+    btrans->getBuffer(&buffer, &offset);
+    HttpSendResponse(session, state, buffer, offset, more);
+
+    // Update context for the next response
     if (!more) {
-        client_ctx = resp_name;
-        HttpSession::set_client_context(context,"");
+        session->set_client_context("");
+        session->set_compressor(NULL);
     }
-    
 }
 
 // Function for HTTP Server to call when HTTP Client Requests a .sandesh module
@@ -283,10 +318,26 @@ HttpSandeshRequestCallback(HttpServer *hs,
     if (sandesh == NULL) {
         SANDESH_LOG(DEBUG, __func__ << " Unknown sandesh:" <<
             snh_name << std::endl);
+        // The response is not deferred, the next pipelined request of the
+        // session is handled once the handler returns
+        session->SendNotFound(request);
         return;
     }
     SandeshRequest *rsnh = dynamic_cast<SandeshRequest *>(sandesh);
     assert(rsnh);
+    // Representation of the response, XML unless JSON is accepted
+    HttpSession::ResponseFormat format;
+    format.json = (request->Header("Accept").find("application/json") !=
+                   string::npos);
+    format.encoding =
+        HttpCompressor::Negotiate(request->Header("Accept-Encoding"));
+    {
+        tbb::mutex::scoped_lock lock(session->response_mutex());
+        session->set_requested_format(format);
+    }
+    // The response is sent by the sandesh, the next pipelined request of the
+    // session is handled once it is complete
+    session->DeferResponse();
     rsnh->RequestFromHttp(session->get_context(), request->UrlQuery());
     httpreqcb(rsnh);
     delete request;
@@ -295,8 +346,8 @@ HttpSandeshRequestCallback(HttpServer *hs,
 // This function is called by the Sandesh Response handling code
 // if the "context" of the Originating Sandesh Request indicates
 // that the Request came from the HTTP Server
-// We will form a HTTP/XML payload to send the contents of the Sandesh
-// response back to the HTTP Client
+// We will form a HTTP/XML payload, or JSON if the HTTP Client accepts it,
+// to send the contents of the Sandesh response back to the HTTP Client
 //
 // Arguments:
 //   snh : Sandesh Response to send to the HTTP Client (base class)
@@ -320,22 +371,18 @@ SandeshHttp::Response(Sandesh *snh, std::string context) {
             more = usnh->get_more();
         }
     }
-    std::stringstream ss;
-    uint8_t *buffer;
-    uint32_t xfer = 0, offset;
 
-    boost::shared_ptr<TMemoryBuffer> btrans =
-            boost::shared_ptr<TMemoryBuffer>(
-                    new TMemoryBuffer(kEncodeBufferSize));
-    boost::shared_ptr<TXMLProtocol> prot =
-            boost::shared_ptr<TXMLProtocol>(
-                    new TXMLProtocol(btrans));
-    // Write the sandesh
-    xfer += snh->Write(prot);
-    // Get the buffer
-    btrans->getBuffer(&buffer, &offset);
-    HttpSendXML(context, buffer, offset, snh->ModuleName().c_str(), more);
-    buffer[offset] = 0;
+    // If the session is gone, we can stop processing.
+    HttpSession::HttpSessionPtr session = HttpSession::GetSession(context);
+    if (!session) {
+        snh->Release();
+        return;
+    }
+
+    HttpSendSandesh(session.get(), snh, more);
+    if (!more) {
+        session->ResponseComplete();
+    }
     snh->Release();
 }
 
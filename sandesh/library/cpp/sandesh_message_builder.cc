@@ -4,8 +4,15 @@
 
 #include <sandesh/sandesh_message_builder.h>
 
+#include <sandesh/protocol/TBinaryProtocol.h>
+#include <sandesh/protocol/TCompactProtocol.h>
+#include <sandesh/protocol/TXMLProtocol.h>
+#include <sandesh/transport/TBufferTransports.h>
+
 using namespace pugi;
 using namespace std;
+using namespace contrail::sandesh::protocol;
+using namespace contrail::sandesh::transport;
 
 // SandeshMessage
 SandeshMessage::~SandeshMessage() {
@@ -154,6 +161,95 @@ bool SandeshSyslogMessage::Parse(const uint8_t *xml_msg, size_t size) {
     return true;
 }
 
+// SandeshBinaryMessage
+
+// The message starts with the field header of the Namespace, the first
+// header field: its type with TBinaryProtocol, its id delta and compact type
+// with TCompactProtocol
+static const uint8_t kCompactHeaderStart = 0x18;
+
+static boost::shared_ptr<TProtocol> CreateProtocol(
+    boost::shared_ptr<TMemoryBuffer> btrans, bool compact, size_t size) {
+    // Bound the string lengths read from a malformed message
+    if (compact) {
+        boost::shared_ptr<TCompactProtocol> prot(new TCompactProtocol(btrans));
+        prot->setStringSizeLimit(size);
+        return prot;
+    }
+    boost::shared_ptr<TBinaryProtocol> prot(new TBinaryProtocol(btrans));
+    prot->setStringSizeLimit(size);
+    return prot;
+}
+
+SandeshBinaryMessage::~SandeshBinaryMessage() {
+}
+
+bool SandeshBinaryMessage::Parse(const uint8_t *binary_msg, size_t size) {
+    // The message outlives the receive buffer
+    buffer_.assign(reinterpret_cast<const char *>(binary_msg), size);
+    compact_ = (size > 0 && binary_msg[0] == kCompactHeaderStart);
+    boost::shared_ptr<TMemoryBuffer> btrans(new TMemoryBuffer(
+        reinterpret_cast<uint8_t *>(const_cast<char *>(buffer_.data())),
+        buffer_.size()));
+    boost::shared_ptr<TProtocol> prot(CreateProtocol(btrans, compact_, size));
+    int32_t ret;
+    if ((ret = header_.read(prot)) <= 0) {
+        SANDESH_LOG(ERROR, __func__ << ": Sandesh header parse FAILED, " <<
+            "size " << size);
+        return false;
+    }
+    message_offset_ = ret;
+    if (message_offset_ >= size) {
+        SANDESH_LOG(ERROR, __func__ << ": Message NOT PRESENT, size " <<
+            size);
+        return false;
+    }
+    if (prot->readSandeshBegin(message_type_) <= 0 ||
+        message_type_.empty()) {
+        SANDESH_LOG(ERROR, __func__ << ": Message type NOT PRESENT, size " <<
+            size);
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+Sandesh *SandeshBinaryMessage::Decode() const {
+    Sandesh *sandesh = SandeshBaseFactory::CreateInstance(message_type_);
+    if (sandesh == NULL) {
+        return NULL;
+    }
+    boost::shared_ptr<TMemoryBuffer> btrans(new TMemoryBuffer(
+        const_cast<uint8_t *>(GetMessage()), GetMessageSize()));
+    boost::shared_ptr<TProtocol> prot(
+        CreateProtocol(btrans, compact_, GetMessageSize()));
+    if (sandesh->Read(prot) < 0) {
+        SANDESH_LOG(ERROR, __func__ << ": Decoding " << message_type_ <<
+            " FAILED");
+        sandesh->Release();
+        return NULL;
+    }
+    return sandesh;
+}
+
+const std::string SandeshBinaryMessage::ExtractMessage() const {
+    Sandesh *sandesh = Decode();
+    if (sandesh == NULL) {
+        return std::string();
+    }
+    boost::shared_ptr<TMemoryBuffer> btrans(new TMemoryBuffer(
+        GetMessageSize() * 2));
+    boost::shared_ptr<TXMLProtocol> prot(new TXMLProtocol(btrans));
+    int32_t ret = sandesh->Write(prot);
+    sandesh->Release();
+    if (ret < 0) {
+        SANDESH_LOG(ERROR, __func__ << ": Encoding " << message_type_ <<
+            " FAILED");
+        return std::string();
+    }
+    return btrans->getBufferAsString();
+}
+
 // SandeshMessageBuilder
 SandeshMessageBuilder *SandeshMessageBuilder::GetInstance(
     SandeshMessageBuilder::Type type) {
@@ -161,10 +257,22 @@ SandeshMessageBuilder *SandeshMessageBuilder::GetInstance(
         return SandeshXMLMessageBuilder::GetInstance();
     } else if (type == SandeshMessageBuilder::SYSLOG) {
         return SandeshSyslogMessageBuilder::GetInstance();
+    } else if (type == SandeshMessageBuilder::BINARY) {
+        return SandeshBinaryMessageBuilder::GetInstance();
     }
     return NULL;
 }
 
+SandeshMessageBuilder *SandeshMessageBuilder::GetInstance(
+    const uint8_t *data, size_t size) {
+    // An XML message starts with the header element, a binary or compact
+    // message with the field header of the first header field
+    if (size > 0 && data[0] != '<') {
+        return SandeshBinaryMessageBuilder::GetInstance();
+    }
+    return SandeshXMLMessageBuilder::GetInstance();
+}
+
 // SandeshXMLMessageBuilder
 SandeshMessage *SandeshXMLMessageBuilder::Create(
     const uint8_t *xml_msg, size_t size) const {
@@ -201,3 +309,23 @@ SandeshSyslogMessageBuilder::SandeshSyslogMessageBuilder() {
 SandeshSyslogMessageBuilder *SandeshSyslogMessageBuilder::GetInstance() {
     return &instance_;
 }
+
+// SandeshBinaryMessageBuilder
+SandeshMessage *SandeshBinaryMessageBuilder::Create(
+    const uint8_t *binary_msg, size_t size) const {
+    SandeshBinaryMessage *msg = new SandeshBinaryMessage;
+    if (!msg->Parse(binary_msg, size)) {
+        delete msg;
+        return NULL;
+    }
+    return msg;
+}
+
+SandeshBinaryMessageBuilder SandeshBinaryMessageBuilder::instance_;
+
+SandeshBinaryMessageBuilder::SandeshBinaryMessageBuilder() {
+}
+
+SandeshBinaryMessageBuilder *SandeshBinaryMessageBuilder::GetInstance() {
+    return &instance_;
+}
@@ -58,14 +58,50 @@ private:
     DISALLOW_COPY_AND_ASSIGN(SandeshSyslogMessage);
 };
 
+//
+// Message sent by a generator that negotiated the binary or the compact
+// encoding, the header and the sandesh are encoded with TBinaryProtocol or
+// TCompactProtocol.
+//
+class SandeshBinaryMessage : public SandeshMessage {
+public:
+    SandeshBinaryMessage() : message_offset_(0), compact_(false) {}
+    virtual ~SandeshBinaryMessage();
+    virtual bool Parse(const uint8_t *data, size_t size);
+    // XML encoding of the sandesh, empty if the message type is not
+    // registered in the SandeshBaseFactory
+    virtual const std::string ExtractMessage() const;
+    // Sandesh of the message type, NULL if the type is not registered in
+    // the SandeshBaseFactory or the decoding fails. The caller releases it.
+    Sandesh *Decode() const;
+    // Sandesh encoded with TBinaryProtocol, or TCompactProtocol if compact()
+    const uint8_t *GetMessage() const {
+        return reinterpret_cast<const uint8_t *>(buffer_.data()) +
+            message_offset_;
+    }
+    size_t GetMessageSize() const { return buffer_.size() - message_offset_; }
+    bool compact() const { return compact_; }
+
+private:
+    std::string buffer_;
+    size_t message_offset_;
+    bool compact_;
+
+    DISALLOW_COPY_AND_ASSIGN(SandeshBinaryMessage);
+};
+
 class SandeshMessageBuilder {
 public:
     enum Type {
         XML,
         SYSLOG,
+        BINARY,
     };
     virtual SandeshMessage *Create(const uint8_t *data, size_t size) const = 0;
     static SandeshMessageBuilder *GetInstance(Type type);
+    // Builder of a generator message, XML or binary encoded
+    static SandeshMessageBuilder *GetInstance(const uint8_t *data,
+                                              size_t size);
 };
 
 class SandeshXMLMessageBuilder : public SandeshMessageBuilder {
@@ -90,4 +126,15 @@ private:
     DISALLOW_COPY_AND_ASSIGN(SandeshSyslogMessageBuilder);
 };
 
+class SandeshBinaryMessageBuilder : public SandeshMessageBuilder {
+public:
+    SandeshBinaryMessageBuilder();
+    virtual SandeshMessage *Create(const uint8_t *data, size_t size) const;
+    static SandeshBinaryMessageBuilder *GetInstance();
+
+private:
+    static SandeshBinaryMessageBuilder instance_;
+    DISALLOW_COPY_AND_ASSIGN(SandeshBinaryMessageBuilder);
+};
+
 #endif // __SANDESH_MESSAGE_BUILDER_H__
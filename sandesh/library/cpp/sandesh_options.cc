@@ -28,6 +28,18 @@ void AddOptions(opt::options_description *sandesh_options,
         ("SANDESH.sandesh_ssl_enable",
          opt::bool_switch(&sandesh_config->sandesh_ssl_enable),
          "Enable SSL for sandesh connection")
+        ("SANDESH.sandesh_ssl_session_cache_size",
+         opt::value<int>(&sandesh_config->sandesh_ssl_session_cache_size),
+         "Number of cached sandesh SSL sessions, 0 to disable resumption")
+        ("SANDESH.sandesh_ssl_session_lifetime",
+         opt::value<int>(&sandesh_config->sandesh_ssl_session_lifetime),
+         "Lifetime of the cached sandesh SSL sessions in seconds")
+        ("SANDESH.sandesh_ssl_ktls_enable",
+         opt::bool_switch(&sandesh_config->sandesh_ssl_ktls_enable),
+         "Offload the encryption of sandesh SSL connections to the kernel")
+        ("SANDESH.sandesh_binary_encoding_enable",
+         opt::bool_switch(&sandesh_config->sandesh_binary_encoding_enable),
+         "Negotiate a binary or compact encoding of generator messages")
         ("SANDESH.introspect_ssl_enable",
          opt::bool_switch(&sandesh_config->introspect_ssl_enable),
          "Enable SSL for introspect connection")
@@ -73,6 +85,14 @@ void ProcessOptions(const opt::variables_map &var_map,
                         "SANDESH.sandesh_ca_cert");
     GetOptValue<bool>(var_map, sandesh_config->sandesh_ssl_enable,
                       "SANDESH.sandesh_ssl_enable");
+    GetOptValue<int>(var_map, sandesh_config->sandesh_ssl_session_cache_size,
+                     "SANDESH.sandesh_ssl_session_cache_size");
+    GetOptValue<int>(var_map, sandesh_config->sandesh_ssl_session_lifetime,
+                     "SANDESH.sandesh_ssl_session_lifetime");
+    GetOptValue<bool>(var_map, sandesh_config->sandesh_ssl_ktls_enable,
+                      "SANDESH.sandesh_ssl_ktls_enable");
+    GetOptValue<bool>(var_map, sandesh_config->sandesh_binary_encoding_enable,
+                      "SANDESH.sandesh_binary_encoding_enable");
     GetOptValue<bool>(var_map, sandesh_config->introspect_ssl_enable,
                       "SANDESH.introspect_ssl_enable");
     GetOptValue<bool>(var_map, sandesh_config->introspect_ssl_insecure,
@@ -24,6 +24,10 @@ struct SandeshConfig {
         tcp_keepalive_idle_time(7200),
         tcp_keepalive_probes(9),
         tcp_keepalive_interval(75),
+        sandesh_ssl_session_cache_size(1024),
+        sandesh_ssl_session_lifetime(3600),
+        sandesh_ssl_ktls_enable(false),
+        sandesh_binary_encoding_enable(false),
         system_logs_rate_limit(
             g_sandesh_constants.DEFAULT_SANDESH_SEND_RATELIMIT) {
     }
@@ -43,6 +47,10 @@ struct SandeshConfig {
     int tcp_keepalive_idle_time;
     int tcp_keepalive_probes;
     int tcp_keepalive_interval;
+    int sandesh_ssl_session_cache_size;
+    int sandesh_ssl_session_lifetime;
+    bool sandesh_ssl_ktls_enable;
+    bool sandesh_binary_encoding_enable;
     uint32_t system_logs_rate_limit;
 };
 
@@ -8,6 +8,8 @@
 // Sandesh server implementation
 //
 
+#include <algorithm>
+
 #include <boost/bind.hpp>
 #include <boost/assign.hpp>
 
@@ -51,6 +53,7 @@ SandeshServer::SandeshServer(EventManager *evm, const SandeshConfig &config)
       sm_task_id_(TaskScheduler::GetInstance()->GetTaskId(kStateMachineTask)),
       session_reader_task_id_(TaskScheduler::GetInstance()->GetTaskId(kSessionReaderTask)),
       lifetime_mgr_task_id_(TaskScheduler::GetInstance()->GetTaskId(kLifetimeMgrTask)),
+      binary_encoding_(config.sandesh_binary_encoding_enable),
       lifetime_manager_(new LifetimeManager(lifetime_mgr_task_id_)),
       deleter_(new DeleteActor(this)) {
     // Set task policy for exclusion between :
@@ -107,6 +110,14 @@ SandeshServer::SandeshServer(EventManager *evm, const SandeshConfig &config)
                         ec.message());
             exit(EINVAL);
         }
+        // Resume the sessions of reconnecting peers
+        if (config.sandesh_ssl_session_cache_size > 0) {
+            EnableSessionCache(config.sandesh_ssl_session_cache_size,
+                               config.sandesh_ssl_session_lifetime);
+        }
+        if (config.sandesh_ssl_ktls_enable) {
+            EnableKtls();
+        }
     }
 }
 
@@ -277,10 +288,32 @@ bool SandeshServer::ReceiveSandeshCtrlMsg(SandeshStateMachine *sm,
     }
     SANDESH_LOG(DEBUG, "Received Ctrl Message from " << snh->get_module_name());
     std::vector<UVETypeInfo> vu;
-    SandeshCtrlServerToClient::Request(vu, true, "ctrl", session->connection());
+    SandeshCtrlServerToClient::Request(vu, true,
+        NegotiateEncoding(snh->get_encodings()), "ctrl",
+        session->connection());
     return true;
 }
 
+std::string SandeshServer::NegotiateEncoding(
+        const std::vector<std::string> &encodings) const {
+    if (!binary_encoding_) {
+        return SandeshEncoding::ToString(SandeshEncoding::XML);
+    }
+    // Prefer the compact encoding, it is the smallest on the wire
+    static const SandeshEncoding::type kPreferred[] = {
+        SandeshEncoding::COMPACT,
+        SandeshEncoding::BINARY,
+    };
+    for (size_t i = 0; i < sizeof(kPreferred) / sizeof(kPreferred[0]); i++) {
+        const char *name(SandeshEncoding::ToString(kPreferred[i]));
+        if (std::find(encodings.begin(), encodings.end(), name) !=
+            encodings.end()) {
+            return name;
+        }
+    }
+    return SandeshEncoding::ToString(SandeshEncoding::XML);
+}
+
 LifetimeActor *SandeshServer::deleter() {
     return deleter_.get();
 }
@@ -53,6 +53,9 @@ public:
         const SandeshMessage *msg, bool resource) = 0;
     virtual bool ReceiveSandeshCtrlMsg(SandeshStateMachine *state_machine,
             SandeshSession *session, const Sandesh *sandesh);
+    // Encoding of the messages of a generator offering the encodings
+    std::string NegotiateEncoding(
+            const std::vector<std::string> &encodings) const;
     virtual void DisconnectSession(SandeshSession *session) {}
     size_t ConnectionsCount() { return connection_.size(); }
     int AllocConnectionIndex();
@@ -87,6 +90,7 @@ private:
     int sm_task_id_;
     int session_reader_task_id_;
     int lifetime_mgr_task_id_;
+    bool binary_encoding_;
     boost::scoped_ptr<LifetimeManager> lifetime_manager_;
     boost::scoped_ptr<DeleteActor> deleter_;
     // Protect connection map and bmap
@@ -17,6 +17,8 @@
 #include <sandesh/common/vns_types.h>
 #include <sandesh/common/vns_constants.h>
 #include <sandesh/transport/TBufferTransports.h>
+#include <sandesh/protocol/TBinaryProtocol.h>
+#include <sandesh/protocol/TCompactProtocol.h>
 #include <sandesh/protocol/TXMLProtocol.h>
 #include <sandesh/protocol/TJSONProtocol.h>
 #include "sandesh/sandesh_types.h"
@@ -38,6 +40,178 @@ const std::string SandeshWriter::sandesh_open_attr_length_ =
         sXML_SANDESH_OPEN_ATTR_LENGTH;
 const std::string SandeshWriter::sandesh_close_ = sXML_SANDESH_CLOSE;
 
+//
+// SandeshEncoding
+//
+const char *SandeshEncoding::ToString(type encoding) {
+    switch (encoding) {
+    case XML:
+        return "xml";
+    case BINARY:
+        return "binary";
+    case COMPACT:
+        return "compact";
+    default:
+        return "unknown";
+    }
+}
+
+bool SandeshEncoding::FromString(const std::string &name, type *encoding) {
+    if (name == "xml") {
+        *encoding = XML;
+        return true;
+    }
+    if (name == "binary") {
+        *encoding = BINARY;
+        return true;
+    }
+    if (name == "compact") {
+        *encoding = COMPACT;
+        return true;
+    }
+    return false;
+}
+
+//
+// SandeshEncoder
+//
+__thread SandeshEncoder *SandeshEncoder::thread_encoder_;
+pthread_key_t SandeshEncoder::thread_encoder_key_;
+pthread_once_t SandeshEncoder::thread_encoder_once_ = PTHREAD_ONCE_INIT;
+
+SandeshEncoder::SandeshEncoder()
+    : buffer_(new TMemoryBuffer(SandeshWriter::kEncodeBufferSize)) {
+    Reset();
+}
+
+SandeshEncoder::~SandeshEncoder() {
+}
+
+void SandeshEncoder::CreateThreadKey() {
+    pthread_key_create(&thread_encoder_key_,
+                       &SandeshEncoder::DestroyThreadEncoder);
+}
+
+// The encoder of the thread is deleted when the thread exits.
+void SandeshEncoder::DestroyThreadEncoder(void *encoder) {
+    delete static_cast<SandeshEncoder *>(encoder);
+    thread_encoder_ = NULL;
+}
+
+SandeshEncoder *SandeshEncoder::GetInstance() {
+    SandeshEncoder *encoder = thread_encoder_;
+    if (encoder == NULL) {
+        pthread_once(&thread_encoder_once_, &SandeshEncoder::CreateThreadKey);
+        encoder = new SandeshEncoder();
+        thread_encoder_ = encoder;
+        pthread_setspecific(thread_encoder_key_, encoder);
+    }
+    return encoder;
+}
+
+// The protocols keep the state of the message being written, they are
+// recreated after a failed write.
+void SandeshEncoder::Reset() {
+    buffer_->resetBuffer();
+    xml_protocol_.reset(new XMLProtocol(buffer_));
+    binary_protocol_.reset(new BinaryProtocol(buffer_));
+    compact_protocol_.reset(new CompactProtocol(buffer_));
+}
+
+void SandeshEncoder::PopulateHeader(Sandesh *sandesh, SandeshHeader *header) {
+    header->set_Namespace(sandesh->scope());
+    header->set_Timestamp(sandesh->timestamp());
+    header->set_Module(sandesh->module());
+    header->set_Source(sandesh->source());
+    header->set_Context(sandesh->context());
+    header->set_SequenceNum(sandesh->seqnum());
+    header->set_VersionSig(sandesh->versionsig());
+    header->set_Type(sandesh->type());
+    header->set_Hints(sandesh->hints());
+    header->set_Level(sandesh->level());
+    header->set_Category(sandesh->category());
+    header->set_NodeType(sandesh->node_type());
+    header->set_InstanceId(sandesh->instance_id());
+}
+
+template <class Protocol_>
+int32_t SandeshEncoder::Write(Protocol_ *prot, Sandesh *sandesh,
+                              SandeshTxDropReason::type *reason) {
+    SandeshHeader header;
+    int32_t xfer = 0, ret;
+    PopulateHeader(sandesh, &header);
+    // Write the sandesh header
+    if ((ret = header.write(prot)) < 0) {
+        SANDESH_LOG(ERROR, __func__ << ": Sandesh header write FAILED: " <<
+            sandesh->Name() << " : " << sandesh->source() << ":" <<
+            sandesh->module() << ":" << sandesh->instance_id() <<
+            " Sequence Number:" << sandesh->seqnum());
+        *reason = SandeshTxDropReason::HeaderWriteFailed;
+        return ret;
+    }
+    xfer += ret;
+    // Write the sandesh
+    if ((ret = sandesh->Write(prot)) < 0) {
+        SANDESH_LOG(ERROR, __func__ << ": Sandesh write FAILED: "<<
+            sandesh->Name() << " : " << sandesh->source() << ":" <<
+            sandesh->module() << ":" << sandesh->instance_id() <<
+            " Sequence Number:" << sandesh->seqnum());
+        *reason = SandeshTxDropReason::WriteFailed;
+        return ret;
+    }
+    xfer += ret;
+    return xfer;
+}
+
+boost::shared_ptr<TMemoryBuffer> SandeshEncoder::Encode(Sandesh *sandesh,
+        SandeshEncoding::type encoding, SandeshTxDropReason::type *reason) {
+    const std::string &sandesh_open(SandeshWriter::sandesh_open_);
+    const std::string &sandesh_close(SandeshWriter::sandesh_close_);
+    uint8_t *buffer;
+    uint32_t offset;
+    int32_t xfer;
+
+    buffer_->resetBuffer();
+    // Write the sandesh open envelope.
+    buffer = buffer_->getWritePtr(sandesh_open.length());
+    memcpy(buffer, sandesh_open.c_str(), sandesh_open.length());
+    buffer_->wroteBytes(sandesh_open.length());
+    // Write the sandesh header and the sandesh
+    if (encoding == SandeshEncoding::BINARY) {
+        xfer = Write(binary_protocol_.get(), sandesh, reason);
+    } else if (encoding == SandeshEncoding::COMPACT) {
+        xfer = Write(compact_protocol_.get(), sandesh, reason);
+    } else {
+        xfer = Write(xml_protocol_.get(), sandesh, reason);
+    }
+    if (xfer < 0) {
+        Reset();
+        return boost::shared_ptr<TMemoryBuffer>();
+    }
+    // Write the sandesh close envelope
+    buffer = buffer_->getWritePtr(sandesh_close.length());
+    memcpy(buffer, sandesh_close.c_str(), sandesh_close.length());
+    buffer_->wroteBytes(sandesh_close.length());
+    // Get the buffer
+    buffer_->getBuffer(&buffer, &offset);
+    // Sanity
+    assert(sandesh_open.length() + xfer + sandesh_close.length() == offset);
+    // Update the sandesh open envelope length, adjust for '">'
+    size_t attr_length(SandeshWriter::sandesh_open_attr_length_.length());
+    int width(sandesh_open.length() - attr_length - 2);
+    char length[16];
+    snprintf(length, sizeof(length), "%0*u", width, offset);
+    memcpy(buffer + attr_length, length, width);
+    // The sessions hold on to the buffers until they are sent, copy the
+    // message out of the encode buffer
+    boost::shared_ptr<TMemoryBuffer> btrans(
+        new TMemoryBuffer(buffer, offset, TMemoryBuffer::COPY));
+    if (offset + buffer_->available_write() > kMaxBufferSize) {
+        buffer_->resetBuffer(SandeshWriter::kEncodeBufferSize);
+    }
+    return btrans;
+}
+
 //
 // SandeshWriter
 //
@@ -71,77 +245,23 @@ void SandeshWriter::WriteReady(const boost::system::error_code &ec) {
 }
 
 void SandeshWriter::SendMsg(Sandesh *sandesh, bool more) {
-    SandeshHeader header;
-    std::stringstream ss;
-    uint8_t *buffer;
-    int32_t xfer = 0, ret;
-    uint32_t offset;
-    boost::shared_ptr<TMemoryBuffer> btrans(
-                    new TMemoryBuffer(kEncodeBufferSize));
-    boost::shared_ptr<TXMLProtocol> prot(
-                    new TXMLProtocol(btrans));
-    // Populate the header
-    header.set_Namespace(sandesh->scope());
-    header.set_Timestamp(sandesh->timestamp());
-    header.set_Module(sandesh->module());
-    header.set_Source(sandesh->source());
-    header.set_Context(sandesh->context());
-    header.set_SequenceNum(sandesh->seqnum());
-    header.set_VersionSig(sandesh->versionsig());
-    header.set_Type(sandesh->type());
-    header.set_Hints(sandesh->hints());
-    header.set_Level(sandesh->level());
-    header.set_Category(sandesh->category());
-    header.set_NodeType(sandesh->node_type());
-    header.set_InstanceId(sandesh->instance_id());
-
-    // Write the sandesh open envelope.
-    buffer = btrans->getWritePtr(sandesh_open_.length());
-    memcpy(buffer, sandesh_open_.c_str(), sandesh_open_.length());
-    btrans->wroteBytes(sandesh_open_.length());
-    // Write the sandesh header
-    if ((ret = header.write(prot)) < 0) {
-        SANDESH_LOG(ERROR, __func__ << ": Sandesh header write FAILED: " <<
-            sandesh->Name() << " : " << sandesh->source() << ":" <<
-            sandesh->module() << ":" << sandesh->instance_id() <<
-            " Sequence Number:" << sandesh->seqnum());
+    // Control messages are exchanged before the encoding is negotiated
+    SandeshEncoding::type encoding(session_->encoding());
+    if (sandesh->hints() & g_sandesh_constants.SANDESH_CONTROL_HINT) {
+        encoding = SandeshEncoding::XML;
+    }
+    SandeshTxDropReason::type reason;
+    boost::shared_ptr<TMemoryBuffer> btrans(Encode(sandesh, encoding,
+                                                   &reason));
+    if (!btrans) {
         session_->increment_send_msg_fail();
-        Sandesh::UpdateTxMsgFailStats(sandesh->Name(), 0,
-            SandeshTxDropReason::HeaderWriteFailed);
+        Sandesh::UpdateTxMsgFailStats(sandesh->Name(), 0, reason);
         sandesh->Release();
         return;
     }
-    xfer += ret;
-    // Write the sandesh
-    if ((ret = sandesh->Write(prot)) < 0) {
-        SANDESH_LOG(ERROR, __func__ << ": Sandesh write FAILED: "<<
-            sandesh->Name() << " : " << sandesh->source() << ":" <<
-            sandesh->module() << ":" << sandesh->instance_id() <<
-            " Sequence Number:" << sandesh->seqnum());
-        session_->increment_send_msg_fail();
-        Sandesh::UpdateTxMsgFailStats(sandesh->Name(), 0,
-            SandeshTxDropReason::WriteFailed);
-        sandesh->Release();
-        return;
-    }
-    xfer += ret;
-    // Write the sandesh close envelope
-    buffer = btrans->getWritePtr(sandesh_close_.length());
-    memcpy(buffer, sandesh_close_.c_str(), sandesh_close_.length());
-    btrans->wroteBytes(sandesh_close_.length());
-    // Get the buffer
+    uint8_t *buffer;
+    uint32_t offset;
     btrans->getBuffer(&buffer, &offset);
-    // Sanity
-    assert(sandesh_open_.length() + xfer + sandesh_close_.length() ==
-            offset);
-    // Update the sandesh open envelope length;
-    char prev = ss.fill('0');
-    // Adjust for '">'
-    ss.width(sandesh_open_.length() - sandesh_open_attr_length_.length() - 2);
-    ss << offset;
-    ss.fill(prev);
-    memcpy(buffer + sandesh_open_attr_length_.length(), ss.str().c_str(),
-            ss.str().length());
 
     // Update sandesh stats
     Sandesh::UpdateTxMsgStats(sandesh->Name(), offset);
@@ -272,7 +392,9 @@ void SandeshWriter::SendInternal(boost::shared_ptr<TMemoryBuffer> buf) {
     uint32_t len;
     buf->getBuffer(&buffer, &len);
     tbb::mutex::scoped_lock lock(send_mutex_);
-    ready_to_send_ = session_->Send((const uint8_t *)buffer, len, NULL);
+    // The buffer is not copied, it is held until written.
+    ready_to_send_ = session_->SendShared((const uint8_t *)buffer, len, buf,
+                                          NULL);
 }
 
 //
@@ -296,6 +418,7 @@ SandeshSession::SandeshSession(SslServer *client, SslSocket *socket,
     tcp_user_timeout_(kSessionTcpUserTimeout),
     reader_task_id_(reader_task_id),
     sending_level_(SandeshLevel::INVALID) {
+    encoding_ = SandeshEncoding::XML;
     if (Sandesh::role() == Sandesh::SandeshRole::Collector) {
         send_buffer_queue_.reset(new Sandesh::SandeshBufferQueue(writer_task_id,
                 task_instance,
@@ -11,10 +11,13 @@
 #ifndef __SANDESH_SESSION_H__
 #define __SANDESH_SESSION_H__
 
+#include <pthread.h>
+#include <tbb/atomic.h>
 #include <tbb/mutex.h>
 
 #include <boost/system/error_code.hpp>
 #include <boost/asio.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/tuple/tuple.hpp>
 
 #include <base/util.h>
@@ -31,6 +34,74 @@ using contrail::sandesh::transport::TMemoryBuffer;
 class SandeshSession;
 class Sandesh;
 
+namespace contrail { namespace sandesh { namespace protocol {
+class TXMLProtocol;
+template <class Transport_> class TBinaryProtocolT;
+template <class Transport_> class TCompactProtocolT;
+}}}
+
+//
+// Encoding of the messages sent by a generator on a session, negotiated in
+// the control message exchange. Control messages and the messages sent by
+// the collector are always encoded in XML.
+//
+struct SandeshEncoding {
+    enum type {
+        XML,
+        BINARY,
+        COMPACT,
+    };
+
+    static const char *ToString(type encoding);
+    static bool FromString(const std::string &name, type *encoding);
+};
+
+//
+// Encoder of the messages sent on the sessions, one per thread, so that the
+// encode buffer and the protocols are reused across the messages. The header
+// and the sandesh are written through the concrete protocol of the encoding,
+// which inlines the protocol calls of the generated writers.
+//
+class SandeshEncoder {
+public:
+    ~SandeshEncoder();
+    static SandeshEncoder *GetInstance();
+    // Encode the header and the sandesh in the sandesh envelope. Returns an
+    // empty buffer and the drop reason on failure.
+    boost::shared_ptr<TMemoryBuffer> Encode(Sandesh *sandesh,
+        SandeshEncoding::type encoding, SandeshTxDropReason::type *reason);
+    static void PopulateHeader(Sandesh *sandesh, SandeshHeader *header);
+
+private:
+    typedef contrail::sandesh::protocol::TXMLProtocol XMLProtocol;
+    typedef contrail::sandesh::protocol::TBinaryProtocolT<TMemoryBuffer>
+        BinaryProtocol;
+    typedef contrail::sandesh::protocol::TCompactProtocolT<TMemoryBuffer>
+        CompactProtocol;
+
+    // The encode buffer is shrunk back after a larger message.
+    static const uint32_t kMaxBufferSize = 65536;
+
+    SandeshEncoder();
+    void Reset();
+    template <class Protocol_>
+    int32_t Write(Protocol_ *prot, Sandesh *sandesh,
+                  SandeshTxDropReason::type *reason);
+    static void CreateThreadKey();
+    static void DestroyThreadEncoder(void *encoder);
+
+    boost::shared_ptr<TMemoryBuffer> buffer_;
+    boost::scoped_ptr<XMLProtocol> xml_protocol_;
+    boost::scoped_ptr<BinaryProtocol> binary_protocol_;
+    boost::scoped_ptr<CompactProtocol> compact_protocol_;
+
+    static __thread SandeshEncoder *thread_encoder_;
+    static pthread_key_t thread_encoder_key_;
+    static pthread_once_t thread_encoder_once_;
+
+    DISALLOW_COPY_AND_ASSIGN(SandeshEncoder);
+};
+
 class SandeshWriter {
 public:
     static const uint32_t kEncodeBufferSize = 2048;
@@ -39,6 +110,14 @@ public:
     SandeshWriter(SandeshSession *session);
     ~SandeshWriter();
     void SendMsg(Sandesh *sandesh, bool more);
+    // Encode the header and the sandesh in the sandesh envelope, the
+    // envelope is the same for all the encodings. Returns an empty buffer
+    // and the drop reason on failure. The encoder of the thread is used.
+    static boost::shared_ptr<TMemoryBuffer> Encode(Sandesh *sandesh,
+        SandeshEncoding::type encoding, SandeshTxDropReason::type *reason) {
+        return SandeshEncoder::GetInstance()->Encode(sandesh, encoding,
+                                                     reason);
+    }
     void SendBuffer(boost::shared_ptr<TMemoryBuffer> sbuffer,
             bool more = false) {
         SendInternal(sbuffer);
@@ -214,6 +293,10 @@ public:
     void SetSendQueueWaterMark(Sandesh::QueueWaterMarkInfo &wm_info);
     void ResetSendQueueWaterMark();
     SandeshLevel::type SendingLevel() const;
+    SandeshEncoding::type encoding() const { return encoding_; }
+    void set_encoding(SandeshEncoding::type encoding) {
+        encoding_ = encoding;
+    }
 
 protected:
     virtual int reader_task_id() const {
@@ -250,6 +333,7 @@ private:
     int tcp_user_timeout_;
     int reader_task_id_;
     SandeshLevel::type sending_level_;
+    tbb::atomic<SandeshEncoding::type> encoding_;
 
     // Session statistics
     SandeshSessionStats sstats_;
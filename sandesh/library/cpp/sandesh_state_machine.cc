@@ -394,7 +394,6 @@ SandeshStateMachine::SandeshStateMachine(const char *prefix, SandeshConnection *
       idle_hold_time_(0),
       deleted_(false),
       resource_(false),
-      builder_(SandeshMessageBuilder::GetInstance(SandeshMessageBuilder::XML)),
       message_drop_level_(SandeshLevel::INVALID) {
     state_ = ssm::IDLE;
     initiate();
@@ -670,9 +669,12 @@ void SandeshStateMachine::UpdateRxMsgFailStats(const std::string &msg_name,
 
 bool SandeshStateMachine::OnSandeshMessage(SandeshSession *session,
                                            const std::string &msg) {
-    // Demux based on Sandesh messkage type
-    SandeshMessage *xmessage = builder_->Create(
-        reinterpret_cast<const uint8_t *>(msg.c_str()), msg.size());
+    // Demux based on Sandesh messkage type, generators that negotiated the
+    // binary encoding still send the control messages in XML
+    const uint8_t *data(reinterpret_cast<const uint8_t *>(msg.c_str()));
+    SandeshMessageBuilder *builder(
+        SandeshMessageBuilder::GetInstance(data, msg.size()));
+    SandeshMessage *xmessage = builder->Create(data, msg.size());
     if (xmessage == NULL) {
         // Update message statistics
         UpdateRxMsgFailStats(std::string(), msg.size(),
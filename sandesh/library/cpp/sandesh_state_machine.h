@@ -50,7 +50,6 @@ class SandeshUVE;
 class SandeshStateMachineStats;
 class SandeshGeneratorStats;
 class SandeshMessageStatistics;
-class SandeshMessageBuilder;
 
 typedef boost::function<bool(SandeshStateMachine *)> EvValidate;
 
@@ -216,7 +215,6 @@ private:
     mutable tbb::mutex smutex_;
     SandeshEventStatistics event_stats_;
     SandeshMessageStatistics message_stats_;
-    SandeshMessageBuilder *builder_;
     SandeshLevel::type message_drop_level_;
 
     DISALLOW_COPY_AND_ASSIGN(SandeshStateMachine);
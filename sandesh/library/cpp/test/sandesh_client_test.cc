@@ -63,6 +63,12 @@ public:
         return true;
     }
 
+    virtual bool SendShared(const u_int8_t *data, size_t size,
+                            const boost::shared_ptr<const void> &owner,
+                            size_t *sent) {
+        return Send(data, size, sent);
+    }
+
     void Close() {
         state_ = SandeshSessionMock::CLOSE;
         SandeshSession::Close();
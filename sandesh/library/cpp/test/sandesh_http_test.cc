@@ -10,6 +10,9 @@
 
 #include "testing/gunit.h"
 #include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <tbb/atomic.h>
+#include <cctype>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -18,9 +21,11 @@
 #include <libxslt/xsltInternals.h>
 #include <libxslt/transform.h>
 #include <libxslt/xsltutils.h>
+#include <zlib.h>
 
 extern "C" {
     #include <curl/curl.h>
+    #include <sys/resource.h>
     #include <unistd.h>
 }
 
@@ -33,6 +38,7 @@ extern "C" {
 #include "sandesh_http.h"
 #include "test/sandesh_http_test_types.h"
 #include "base/task.h"
+#include "base/time_util.h"
 #include "base/test/task_test_util.h"
 
 using namespace std;
@@ -127,6 +133,30 @@ SandeshHttpTestRequest::HandleRequest() const{
         shtp->Response();
         break;
     }
+    case (8): {
+        // Response in param chunks
+        for (int i = 0; i < param; i++) {
+            VNSwitchRouteResp *vsrr = new VNSwitchRouteResp();
+            vsrr->set_vnId(i);
+            vector<VNSRoute> lval;
+            VNSRoute vsnr;
+            for (int j = 0; j < 10; j++) {
+                vsnr.prefix = j; vsnr.desc = "route";
+                lval.push_back(vsnr);
+            }
+            vsrr->set_vnRoutes(lval);
+            vsrr->set_vnMarkerRoute(vsnr);
+            vsrr->set_context(context());
+            vsrr->set_more(true);
+            vsrr->Response();
+        }
+        SandeshHttpTestResp *shtp = new SandeshHttpTestResp();
+        shtp->set_testId(testId);
+        shtp->set_param(param);
+        shtp->set_context(context());
+        shtp->Response();
+        break;
+    }
     }
     ASSERT_EQ(param, currentParam);
     ASSERT_EQ(testId, currentTestId);
@@ -217,12 +247,134 @@ CURLcode curl_fetch(const char* url, struct MemoryStruct *chk)
   return ret;
 }
 
+// Fetch a chunked response repeatedly, counting the complete ones.
+void ConcurrentFetch(const string &url, int requests,
+                     tbb::atomic<int> *responses) {
+    for (int i = 0; i < requests; i++) {
+        struct MemoryStruct mem;
+        mem.memory = reinterpret_cast<char *>(malloc(1));
+        mem.size = 0;
+        CURL *curl_handle = curl_easy_init();
+        curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION,
+                         WriteMemoryCallback);
+        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&mem);
+        curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1);
+        curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 30);
+        if (curl_easy_perform(curl_handle) == CURLE_OK &&
+            string(mem.memory).find("</__VNSwitchRouteResp_list>") !=
+            string::npos) {
+            (*responses)++;
+        }
+        curl_easy_cleanup(curl_handle);
+        free(mem.memory);
+    }
+}
+
+// Fetch a response with the Accept and Accept-Encoding headers given, the
+// body is returned as received.
+CURLcode FetchFormat(const string &url, const char *accept,
+                     const char *encoding, string *body) {
+    struct MemoryStruct mem;
+    mem.memory = reinterpret_cast<char *>(malloc(1));
+    mem.size = 0;
+    CURL *curl_handle = curl_easy_init();
+    struct curl_slist *headers = NULL;
+    if (accept) {
+        headers = curl_slist_append(headers, accept);
+    }
+    if (encoding) {
+        headers = curl_slist_append(headers, encoding);
+    }
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl_handle, CURLOPT_HTTP_CONTENT_DECODING, 0L);
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&mem);
+    curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1);
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 60);
+    CURLcode ret = curl_easy_perform(curl_handle);
+    body->assign(mem.memory, mem.size);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl_handle);
+    free(mem.memory);
+    return ret;
+}
+
+// Decompress a gzip or zlib body.
+bool Inflate(const string &body, string *out) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Detect the gzip or zlib header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(
+        body.data()));
+    stream.avail_in = body.size();
+    char buf[16 * 1024];
+    int ret;
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(buf);
+        stream.avail_out = sizeof(buf);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        out->append(buf, sizeof(buf) - stream.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+// Fetch a response repeatedly, on a persistent connection or on a new
+// connection for each request, and return the number of responses.
+int FetchRepeated(const string &url, int requests, bool keep_alive) {
+    int responses = 0;
+    struct MemoryStruct mem;
+    mem.memory = reinterpret_cast<char *>(malloc(1));
+    CURL *curl_handle = curl_easy_init();
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&mem);
+    curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1);
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 10);
+    curl_easy_setopt(curl_handle, CURLOPT_FORBID_REUSE, keep_alive ? 0L : 1L);
+    for (int i = 0; i < requests; i++) {
+        mem.size = 0;
+        if (curl_easy_perform(curl_handle) == CURLE_OK) {
+            responses++;
+        }
+    }
+    curl_easy_cleanup(curl_handle);
+    free(mem.memory);
+    return responses;
+}
+
+uint64_t RusageUsec(int who) {
+    struct rusage usage;
+    getrusage(who, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Handlers running at the same time, and the most seen. The handler delay
+// keeps a handler running after its response is complete.
+tbb::atomic<int> handlers_running;
+tbb::atomic<int> max_handlers_running;
+int handler_delay_usecs;
+
 class SandeshHttpTest;
 
 static int32_t CallbackFn(SandeshHttpTest* stest, Sandesh * sndh) {
+    int running = ++handlers_running;
+    if (running > max_handlers_running) {
+        max_handlers_running = running;
+    }
     SandeshHttpTestRequest * snh = static_cast<SandeshHttpTestRequest *>(sndh);
     snh->HandleRequest();
     snh->Release();
+    if (handler_delay_usecs) {
+        usleep(handler_delay_usecs);
+    }
+    handlers_running--;
 
     return 0;
 }
@@ -240,6 +392,7 @@ public:
         bool success(SandeshHttp::Init(evm_.get(), "sandesh_http_test", 0,
             boost::bind(&CallbackFn, this, _1), &port));
         ASSERT_TRUE(success);
+        port_ = port;
         host_url_ << "http://localhost:";
         host_url_ << port << "/";
         LOG(DEBUG, "Serving " << host_url_.str());
@@ -263,9 +416,131 @@ public:
         evm_.reset();
         host_url_.str("");
     }
+
+    // Clients fetching chunked responses at the same time, the responses of
+    // the sessions are sent independently of each other.
+    void FetchConcurrently(int clients, int requests, int chunks) {
+        currentTestId = 8; currentParam = chunks;
+        ostringstream url;
+        url << host_url_.str() << "Snh_SandeshHttpTestRequest?testId=8&param="
+            << chunks;
+        curl_global_init(CURL_GLOBAL_ALL);
+
+        tbb::atomic<int> responses;
+        responses = 0;
+        uint64_t start = ClockMonotonicUsec();
+        boost::thread_group threads;
+        for (int i = 0; i < clients; i++) {
+            threads.create_thread(
+                boost::bind(&ConcurrentFetch, url.str(), requests,
+                            &responses));
+        }
+        threads.join_all();
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ(clients * requests, responses);
+        LOG(DEBUG, clients << " clients fetched " << requests
+            << " responses of " << chunks << " chunks each in " << usecs
+            << " usecs");
+    }
+
+    // Fetch a response repeatedly on a persistent connection and on a
+    // connection per request, the requests per second are reported.
+    void FetchKeepAlive(int requests) {
+        currentTestId = 1; currentParam = 11;
+        const string url = host_url_.str() +
+            "Snh_SandeshHttpTestRequest?testId=1&param=11";
+        curl_global_init(CURL_GLOBAL_ALL);
+
+        for (int keep_alive = 1; keep_alive >= 0; keep_alive--) {
+            uint64_t start = ClockMonotonicUsec();
+            EXPECT_EQ(requests, FetchRepeated(url, requests, keep_alive));
+            uint64_t usecs = ClockMonotonicUsec() - start;
+            LOG(DEBUG, (keep_alive ? "keep-alive" : "connection per request")
+                << ": " << requests * 1000000ULL / usecs << " requests/s");
+        }
+    }
+
+    // Send requests in a single write and read the responses until the
+    // server closes the connection.
+    void FetchPipelined(const string &requests, string *responses) {
+        boost::asio::io_service io_service;
+        tcp::socket socket(io_service);
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(address::from_string("127.0.0.1"),
+                                     port_), ec);
+        ASSERT_FALSE(ec);
+        boost::asio::write(socket, boost::asio::buffer(requests), ec);
+        ASSERT_FALSE(ec);
+
+        char buf[4096];
+        while (true) {
+            size_t len = socket.read_some(boost::asio::buffer(buf), ec);
+            if (ec) {
+                break;
+            }
+            responses->append(buf, len);
+        }
+        EXPECT_EQ(boost::asio::error::eof, ec);
+    }
+
+    // Dump of the entries of the chunks given in each output mode, the bytes
+    // on the wire and the CPU time of the server are reported. The CPU time
+    // of the process is counted without the one of the client thread.
+    void FetchFormats(int chunks) {
+        static const struct {
+            const char *name;
+            const char *accept;
+            const char *encoding;
+            const char *list_end;
+        } kFormats[] = {
+            { "xml", NULL, NULL, "</__VNSwitchRouteResp_list>" },
+            { "json", "Accept: application/json", NULL, "]" },
+            { "xml+gzip", NULL, "Accept-Encoding: gzip",
+              "</__VNSwitchRouteResp_list>" },
+            { "json+gzip", "Accept: application/json",
+              "Accept-Encoding: gzip", "]" },
+            { "json+deflate", "Accept: application/json",
+              "Accept-Encoding: deflate", "]" },
+        };
+
+        currentTestId = 8; currentParam = chunks;
+        ostringstream url;
+        url << host_url_.str() << "Snh_SandeshHttpTestRequest?testId=8&param="
+            << chunks;
+        curl_global_init(CURL_GLOBAL_ALL);
+
+        for (size_t i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); i++) {
+            uint64_t process_start = RusageUsec(RUSAGE_SELF);
+            uint64_t client_start = RusageUsec(RUSAGE_THREAD);
+            string body;
+            ASSERT_EQ(CURLE_OK, FetchFormat(url.str(), kFormats[i].accept,
+                                            kFormats[i].encoding, &body));
+            task_util::WaitForIdle();
+            uint64_t server_usecs = RusageUsec(RUSAGE_SELF) - process_start -
+                (RusageUsec(RUSAGE_THREAD) - client_start);
+
+            string content = body;
+            if (kFormats[i].encoding) {
+                content.clear();
+                ASSERT_TRUE(Inflate(body, &content));
+            }
+            while (!content.empty() &&
+                   isspace(content[content.size() - 1])) {
+                content.erase(content.size() - 1);
+            }
+            EXPECT_NE(string::npos, content.rfind(kFormats[i].list_end));
+            if (kFormats[i].accept) {
+                EXPECT_EQ('[', content[0]);
+            }
+            LOG(DEBUG, kFormats[i].name << ": " << body.size() << " bytes ("
+                << content.size() << " uncompressed) in " << server_usecs
+                << " usecs of server CPU");
+        }
+    }
     std::auto_ptr<ServerThread> thread_;
     std::auto_ptr<EventManager> evm_;
     ostringstream host_url_;
+    int port_;
 
 };
 
@@ -388,6 +663,98 @@ TEST_F(SandeshHttpTest, XSLT) {
       free(style.memory);
 }
 
+// Clients fetching large chunked responses at the same time.
+TEST_F(SandeshHttpTest, ConcurrentClients) {
+    FetchConcurrently(4, 5, 100);
+}
+
+TEST_F(SandeshHttpTest, DISABLED_ConcurrentClientsPerformance) {
+    FetchConcurrently(8, 20, 100);
+}
+
+// Dump in each output mode, the body is checked after decompression.
+TEST_F(SandeshHttpTest, OutputFormats) {
+    FetchFormats(100);
+}
+
+TEST_F(SandeshHttpTest, DISABLED_OutputFormatsPerformance) {
+    FetchFormats(10000);
+}
+
+// Requests on persistent connections and on a connection per request.
+TEST_F(SandeshHttpTest, KeepAlive) {
+    FetchKeepAlive(20);
+}
+
+TEST_F(SandeshHttpTest, DISABLED_KeepAlivePerformance) {
+    FetchKeepAlive(1000);
+}
+
+// Pipelined requests sent in a single write are answered in order, and the
+// connection is closed after the response to the request asking for it.
+TEST_F(SandeshHttpTest, Pipelining) {
+    static const int kRequests = 3;
+
+    currentTestId = 8; currentParam = 20;
+    string request =
+        "GET /Snh_SandeshHttpTestRequest?testId=8&param=20 HTTP/1.1\r\n"
+        "Host: localhost\r\n";
+    string requests;
+    for (int i = 0; i < kRequests; i++) {
+        requests += request;
+        if (i == kRequests - 1) {
+            requests += "Connection: close\r\n";
+        }
+        requests += "\r\n";
+    }
+    string responses;
+    FetchPipelined(requests, &responses);
+
+    // Each response is complete before the next one starts
+    size_t pos = 0;
+    for (int i = 0; i < kRequests; i++) {
+        size_t start = responses.find("HTTP/1.1 200 OK", pos);
+        ASSERT_NE(string::npos, start);
+        size_t end = responses.find("</__VNSwitchRouteResp_list>", start);
+        ASSERT_NE(string::npos, end);
+        EXPECT_EQ(string::npos, responses.substr(start + 1, end - start)
+                  .find("HTTP/1.1 200 OK"));
+        pos = end;
+    }
+    EXPECT_EQ(string::npos, responses.find("HTTP/1.1 200 OK", pos));
+}
+
+// The responses complete before their handlers return. The next pipelined
+// request is only handled once the handler returns, by the same task.
+TEST_F(SandeshHttpTest, ResponseCompleteInHandler) {
+    static const int kRequests = 10;
+
+    currentTestId = 1; currentParam = 11;
+    string requests;
+    for (int i = 0; i < kRequests; i++) {
+        requests +=
+            "GET /Snh_SandeshHttpTestRequest?testId=1&param=11 HTTP/1.1\r\n"
+            "Host: localhost\r\n";
+        if (i == kRequests - 1) {
+            requests += "Connection: close\r\n";
+        }
+        requests += "\r\n";
+    }
+    max_handlers_running = 0;
+    handler_delay_usecs = 10000;
+    string responses;
+    FetchPipelined(requests, &responses);
+    handler_delay_usecs = 0;
+
+    int count = 0;
+    for (size_t pos = responses.find("HTTP/1.1 200 OK"); pos != string::npos;
+         pos = responses.find("HTTP/1.1 200 OK", pos + 1)) {
+        count++;
+    }
+    EXPECT_EQ(kRequests, count);
+    EXPECT_EQ(1, max_handlers_running);
+}
+
 TEST_F(SandeshHttpTest, ValidateUrlFieldsWithSpecialChar) {
     chunk.memory = reinterpret_cast<char *>(malloc(1));
     chunk.size = 0;
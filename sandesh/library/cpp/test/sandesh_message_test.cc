@@ -14,6 +14,7 @@
 #include <boost/assign/list_of.hpp>
 
 #include "base/logging.h"
+#include "base/time_util.h"
 #include "base/test/task_test_util.h"
 #include "io/tcp_session.h"
 #include "io/tcp_server.h"
@@ -1501,6 +1502,248 @@ TEST_F(SandeshBufferTest, ReadWrite) {
     EXPECT_EQ(num_encoded, context.num_decoded_);
 }
 
+class SandeshEncodingTest : public ::testing::Test {
+protected:
+    // Encoded message without the sandesh envelope, as received by the
+    // collector state machine
+    static std::string Encode(Sandesh *sandesh,
+                              SandeshEncoding::type encoding) {
+        SandeshTxDropReason::type reason;
+        boost::shared_ptr<TMemoryBuffer> btrans(
+            SandeshWriter::Encode(sandesh, encoding, &reason));
+        EXPECT_TRUE(btrans.get() != NULL);
+        if (!btrans) {
+            return std::string();
+        }
+        std::string msg(btrans->getBufferAsString());
+        return msg.substr(SandeshWriter::sandesh_open_.size(), msg.size() -
+            SandeshWriter::sandesh_open_.size() -
+            SandeshWriter::sandesh_close_.size());
+    }
+
+    static SandeshMessage *Create(const std::string &msg) {
+        const uint8_t *data(reinterpret_cast<const uint8_t *>(msg.data()));
+        return SandeshMessageBuilder::GetInstance(data, msg.size())->Create(
+            data, msg.size());
+    }
+
+    static SandeshRequestTest1 *CreateRequest() {
+        SandeshRequestTest1 *snh(new SandeshRequestTest1);
+        snh->set_xmldata(xmldata);
+        snh->set_i32Elem(test_i32);
+        return snh;
+    }
+};
+
+TEST_F(SandeshEncodingTest, Binary) {
+    SandeshRequestTest1 *snh(CreateRequest());
+    std::string xml(Encode(snh, SandeshEncoding::XML));
+    std::string binary(Encode(snh, SandeshEncoding::BINARY));
+    EXPECT_LT(binary.size(), xml.size());
+
+    boost::scoped_ptr<SandeshMessage> xml_msg(Create(xml));
+    ASSERT_TRUE(dynamic_cast<SandeshXMLMessage *>(xml_msg.get()) != NULL);
+    boost::scoped_ptr<SandeshMessage> binary_msg(Create(binary));
+    const SandeshBinaryMessage *bmsg(
+        dynamic_cast<SandeshBinaryMessage *>(binary_msg.get()));
+    ASSERT_TRUE(bmsg != NULL);
+    EXPECT_EQ(xml_msg->GetHeader(), bmsg->GetHeader());
+    EXPECT_EQ("SandeshRequestTest1", bmsg->GetMessageType());
+    EXPECT_EQ(binary.size(), bmsg->GetSize());
+    EXPECT_FALSE(bmsg->compact());
+
+    // Decode the sandesh
+    SandeshRequestTest1 *decoded(
+        dynamic_cast<SandeshRequestTest1 *>(bmsg->Decode()));
+    ASSERT_TRUE(decoded != NULL);
+    EXPECT_EQ(*snh, *decoded);
+    decoded->Release();
+
+    // Read back the XML of the sandesh
+    std::string extracted(bmsg->ExtractMessage());
+    boost::shared_ptr<TMemoryBuffer> rbuffer(new TMemoryBuffer(
+        reinterpret_cast<uint8_t *>(const_cast<char *>(extracted.data())),
+        extracted.size()));
+    boost::shared_ptr<TXMLProtocol> rprotocol(new TXMLProtocol(rbuffer));
+    SandeshRequestTest1 *parsed(new SandeshRequestTest1);
+    EXPECT_LT(0, parsed->Read(rprotocol));
+    EXPECT_EQ(*snh, *parsed);
+    parsed->Release();
+    snh->Release();
+}
+
+TEST_F(SandeshEncodingTest, Compact) {
+    SandeshRequestTest1 *snh(CreateRequest());
+    std::string xml(Encode(snh, SandeshEncoding::XML));
+    std::string binary(Encode(snh, SandeshEncoding::BINARY));
+    std::string compact(Encode(snh, SandeshEncoding::COMPACT));
+    EXPECT_LT(compact.size(), binary.size());
+
+    boost::scoped_ptr<SandeshMessage> xml_msg(Create(xml));
+    boost::scoped_ptr<SandeshMessage> compact_msg(Create(compact));
+    const SandeshBinaryMessage *cmsg(
+        dynamic_cast<SandeshBinaryMessage *>(compact_msg.get()));
+    ASSERT_TRUE(cmsg != NULL);
+    EXPECT_TRUE(cmsg->compact());
+    EXPECT_EQ(xml_msg->GetHeader(), cmsg->GetHeader());
+    EXPECT_EQ("SandeshRequestTest1", cmsg->GetMessageType());
+
+    SandeshRequestTest1 *decoded(
+        dynamic_cast<SandeshRequestTest1 *>(cmsg->Decode()));
+    ASSERT_TRUE(decoded != NULL);
+    EXPECT_EQ(*snh, *decoded);
+    decoded->Release();
+    snh->Release();
+}
+
+TEST_F(SandeshEncodingTest, Unregistered) {
+    // Responses are not registered in the SandeshBaseFactory
+    SandeshResponseTest *snh(new SandeshResponseTest);
+    std::vector<SandeshResponseElem> elems(4);
+    snh->set_listElem(elems);
+    std::string binary(Encode(snh, SandeshEncoding::BINARY));
+    boost::scoped_ptr<SandeshMessage> binary_msg(Create(binary));
+    const SandeshBinaryMessage *bmsg(
+        dynamic_cast<SandeshBinaryMessage *>(binary_msg.get()));
+    ASSERT_TRUE(bmsg != NULL);
+    EXPECT_EQ("SandeshResponseTest", bmsg->GetMessageType());
+    EXPECT_EQ(SandeshType::RESPONSE, bmsg->GetHeader().get_Type());
+    EXPECT_LT(0U, bmsg->GetMessageSize());
+    EXPECT_TRUE(bmsg->Decode() == NULL);
+    EXPECT_TRUE(bmsg->ExtractMessage().empty());
+    snh->Release();
+}
+
+// Messages per second and bytes per message of the generator to collector
+// encodings, encoding the sandesh and building the collector message.
+TEST_F(SandeshEncodingTest, DISABLED_Benchmark) {
+    static const int kMessages = 100000;
+    static const SandeshEncoding::type kEncodings[] = {
+        SandeshEncoding::XML, SandeshEncoding::BINARY,
+        SandeshEncoding::COMPACT,
+    };
+    static const int kNumEncodings =
+        sizeof(kEncodings) / sizeof(kEncodings[0]);
+
+    SandeshResponseTest *resp(new SandeshResponseTest);
+    std::vector<SandeshResponseElem> elems;
+    for (int i = 0; i < 16; i++) {
+        SandeshResponseElem elem;
+        elem.set_i32Elem(i * 1000);
+        elems.push_back(elem);
+    }
+    resp->set_listElem(elems);
+    SandeshRequestTest1 *req(CreateRequest());
+    Sandesh *sandeshes[] = { req, resp };
+
+    size_t message_bytes[kNumEncodings];
+    for (int e = 0; e < kNumEncodings; e++) {
+        uint64_t start = ClockMonotonicUsec();
+        size_t bytes = 0;
+        int built = 0;
+        for (int i = 0; i < kMessages; i++) {
+            std::string msg(Encode(sandeshes[i % 2], kEncodings[e]));
+            bytes += msg.size();
+            SandeshMessage *message(Create(msg));
+            built += (message != NULL);
+            delete message;
+        }
+        uint64_t usecs = std::max<uint64_t>(ClockMonotonicUsec() - start, 1);
+        EXPECT_EQ(kMessages, built);
+        message_bytes[e] = bytes / kMessages;
+        LOG(DEBUG, SandeshEncoding::ToString(kEncodings[e]) << ": " <<
+            kMessages * 1000000 / usecs << " messages/s, " <<
+            message_bytes[e] << " bytes/message");
+    }
+    EXPECT_LT(message_bytes[1], message_bytes[0]);
+    EXPECT_LT(message_bytes[2], message_bytes[1]);
+    req->Release();
+    resp->Release();
+}
+
+class SandeshBinaryEncodingTest : public ::testing::Test {
+protected:
+    SandeshBinaryEncodingTest() {
+        binary_msg_num_ = 0;
+        config_.sandesh_binary_encoding_enable = true;
+    }
+
+    virtual void SetUp() {
+        requestserver_done = false;
+        evm_.reset(new EventManager());
+        server_ = new SandeshServerTest(evm_.get(),
+                boost::bind(&SandeshBinaryEncodingTest::ReceiveSandeshMsg,
+                            this, _1, _2), config_);
+        thread_.reset(new ServerThread(evm_.get()));
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        Sandesh::Uninit();
+        task_util::WaitForIdle();
+        TASK_UTIL_EXPECT_FALSE(server_->HasSessions());
+        task_util::WaitForIdle();
+        server_->Shutdown();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(server_);
+        task_util::WaitForIdle();
+        evm_->Shutdown();
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+        task_util::WaitForIdle();
+    }
+
+    bool ReceiveSandeshMsg(SandeshSession *session,
+           const SandeshMessage *msg) {
+        const SandeshBinaryMessage *bmsg(
+            dynamic_cast<const SandeshBinaryMessage *>(msg));
+        if (!bmsg) {
+            return true;
+        }
+        binary_msg_num_++;
+        if (bmsg->GetMessageType() != "SandeshRequestTest1") {
+            return true;
+        }
+        // Process the request as the client would
+        SandeshRequest *request(
+            dynamic_cast<SandeshRequest *>(bmsg->Decode()));
+        EXPECT_TRUE(request != NULL);
+        if (request) {
+            request->HandleRequest();
+            request->Release();
+        }
+        return true;
+    }
+
+    SandeshConfig config_;
+    tbb::atomic<int> binary_msg_num_;
+    std::auto_ptr<ServerThread> thread_;
+    std::auto_ptr<EventManager> evm_;
+    SandeshServerTest *server_;
+};
+
+TEST_F(SandeshBinaryEncodingTest, Negotiate) {
+    server_->Initialize(0);
+    thread_->Start();       // Must be called after initialization
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+    // Connect to the server, offering the binary encodings, the server
+    // prefers the compact one
+    Sandesh::InitGenerator("SandeshBinaryEncodingTest-Client", "localhost",
+            "Test", "Test", evm_.get(), 0, NULL, DerivedStats(), config_);
+    Sandesh::ConnectToCollector("127.0.0.1", port);
+    TASK_UTIL_EXPECT_TRUE(Sandesh::client()->state() ==
+                          SandeshClientSM::ESTABLISHED);
+    TASK_UTIL_EXPECT_EQ(SandeshEncoding::COMPACT,
+                        Sandesh::client()->session()->encoding());
+    // Send the request
+    std::string context;
+    SandeshRequestTest1::Request(xmldata, test_i32, context);
+    TASK_UTIL_EXPECT_TRUE(requestserver_done);
+    EXPECT_LT(0, static_cast<int>(binary_msg_num_));
+}
+
 class SandeshHeaderTest : public ::testing::Test {
 protected:
     SandeshHeaderTest() :
@@ -23,15 +23,23 @@
 #include <base/regex.h>
 #include <base/util.h>
 #include <base/queue_task.h>
+#include <base/time_util.h>
 
+#include <sandesh/protocol/TBinaryProtocol.h>
+#include <sandesh/protocol/TCompactProtocol.h>
+#include <sandesh/protocol/TXMLProtocol.h>
+#include <sandesh/transport/TBufferTransports.h>
 #include <sandesh/sandesh_types.h>
 #include <sandesh/sandesh_constants.h>
 #include <sandesh/sandesh.h>
+#include <sandesh/sandesh_session.h>
 
 #include "sandesh_perf_test_types.h"
 
 using contrail::regex;
 using contrail::regex_replace;
+using namespace contrail::sandesh::protocol;
+using namespace contrail::sandesh::transport;
 
 // Verfiy the performance of WorkQueue enqueue and dequeue for the following cases:
 // 1. Allocating new Sandesh
@@ -395,6 +403,421 @@ TEST_F(SandeshPerfTestString, DISABLED_PerfTestSplitIter) {
     }
 }
 
+// Per message encode cost of the SandeshEncoder, which reuses the encode
+// buffer and the protocols of the thread and writes through the concrete
+// protocols, compared to allocating a buffer and a protocol for each message
+// and writing through the generic protocol.
+class SandeshPerfTestEncode : public ::testing::Test {
+protected:
+    static const int kInterfaces = 8;
+    static const int kCounters = 8;
+
+    SandeshPerfTestEncode() {
+        std::vector<PerfTestInterfaceStats> interfaces;
+        for (int i = 0; i < kInterfaces; i++) {
+            PerfTestInterfaceStats stats;
+            stats.set_name("tap" + integerToString(i));
+            stats.set_in_pkts(123456789 + i);
+            stats.set_out_pkts(987654321 + i);
+            stats.set_in_bytes(123456789012ULL + i);
+            stats.set_out_bytes(987654321098ULL + i);
+            stats.set_speed(1000);
+            interfaces.push_back(stats);
+        }
+        std::map<std::string, uint64_t> counters;
+        for (int i = 0; i < kCounters; i++) {
+            counters.insert(std::make_pair("counter" + integerToString(i),
+                                           1000 * i));
+        }
+        sandesh_.set_name("default-domain:admin:vn1");
+        sandesh_.set_interfaces(interfaces);
+        sandesh_.set_counters(counters);
+    }
+
+    // Encoding of the header and the sandesh before the SandeshEncoder,
+    // without the envelope.
+    static boost::shared_ptr<TMemoryBuffer> LegacyEncode(Sandesh *sandesh,
+            SandeshEncoding::type encoding) {
+        SandeshHeader header;
+        SandeshEncoder::PopulateHeader(sandesh, &header);
+        boost::shared_ptr<TMemoryBuffer> btrans(
+            new TMemoryBuffer(SandeshWriter::kEncodeBufferSize));
+        boost::shared_ptr<TProtocol> prot;
+        if (encoding == SandeshEncoding::BINARY) {
+            prot.reset(new TBinaryProtocol(btrans));
+        } else if (encoding == SandeshEncoding::COMPACT) {
+            prot.reset(new TCompactProtocol(btrans));
+        } else {
+            prot.reset(new TXMLProtocol(btrans));
+        }
+        EXPECT_LT(0, header.write(prot));
+        EXPECT_LT(0, sandesh->Write(prot));
+        return btrans;
+    }
+
+    void Benchmark(SandeshEncoding::type encoding, int iterations) {
+        SandeshTxDropReason::type reason;
+        boost::shared_ptr<TMemoryBuffer> legacy(
+            LegacyEncode(&sandesh_, encoding));
+        boost::shared_ptr<TMemoryBuffer> encoded(
+            SandeshWriter::Encode(&sandesh_, encoding, &reason));
+        ASSERT_TRUE(encoded);
+        std::string message(encoded->getBufferAsString());
+        size_t open_length(SandeshWriter::sandesh_open_.length());
+        size_t close_length(SandeshWriter::sandesh_close_.length());
+        EXPECT_EQ(legacy->getBufferAsString(), message.substr(open_length,
+            message.length() - open_length - close_length));
+
+        uint64_t start = ClockMonotonicUsec();
+        for (int i = 0; i < iterations; i++) {
+            LegacyEncode(&sandesh_, encoding);
+        }
+        uint64_t legacy_usecs = ClockMonotonicUsec() - start;
+
+        start = ClockMonotonicUsec();
+        for (int i = 0; i < iterations; i++) {
+            SandeshWriter::Encode(&sandesh_, encoding, &reason);
+        }
+        uint64_t encoder_usecs = ClockMonotonicUsec() - start;
+
+        LOG(DEBUG, SandeshEncoding::ToString(encoding) << " " <<
+            message.length() << " bytes: per message protocol " <<
+            legacy_usecs * 1000 / iterations << " ns, encoder " <<
+            encoder_usecs * 1000 / iterations << " ns per message");
+    }
+
+    PerfTestEncodeSandesh sandesh_;
+};
+
+TEST_F(SandeshPerfTestEncode, XML) {
+    Benchmark(SandeshEncoding::XML, 10);
+}
+
+TEST_F(SandeshPerfTestEncode, Binary) {
+    Benchmark(SandeshEncoding::BINARY, 10);
+}
+
+TEST_F(SandeshPerfTestEncode, Compact) {
+    Benchmark(SandeshEncoding::COMPACT, 10);
+}
+
+TEST_F(SandeshPerfTestEncode, DISABLED_XMLPerformance) {
+    Benchmark(SandeshEncoding::XML, 20000);
+}
+
+TEST_F(SandeshPerfTestEncode, DISABLED_BinaryPerformance) {
+    Benchmark(SandeshEncoding::BINARY, 20000);
+}
+
+TEST_F(SandeshPerfTestEncode, DISABLED_CompactPerformance) {
+    Benchmark(SandeshEncoding::COMPACT, 20000);
+}
+
+// XML encoder before the output buffer and the field tag cache of
+// TXMLProtocol, which formats the numbers with stringstream and writes each
+// piece to the transport. The pretty print is not supported.
+class LegacyXMLProtocol : public TVirtualProtocol<LegacyXMLProtocol> {
+public:
+    explicit LegacyXMLProtocol(boost::shared_ptr<TTransport> trans) :
+        TVirtualProtocol<LegacyXMLProtocol>(trans),
+        trans_(trans.get()) {
+    }
+
+    int32_t writeMessageBegin(const std::string& name,
+                              const TMessageType messageType,
+                              const int32_t seqid) {
+        return 0;
+    }
+    int32_t writeMessageEnd() {
+        return 0;
+    }
+    int32_t writeStructBegin(const char *name) {
+        xml_state_.push_back(name);
+        return writePlain("<" + xml_state_.back() + ">");
+    }
+    int32_t writeStructEnd() {
+        return writeEndTag();
+    }
+    int32_t writeSandeshBegin(const char *name) {
+        xml_state_.push_back(name);
+        return writePlain("<" + xml_state_.back() + " type=\"sandesh\">");
+    }
+    int32_t writeSandeshEnd() {
+        return writeEndTag();
+    }
+    int32_t writeContainerElementBegin() {
+        return writePlain("<element>");
+    }
+    int32_t writeContainerElementEnd() {
+        return writePlain("</element>");
+    }
+    int32_t writeFieldBegin(const char *name, const TType fieldType,
+            const int16_t fieldId,
+            const std::map<std::string, std::string> *const amap = NULL) {
+        std::string xml;
+        xml.reserve(512);
+        xml += "<";
+        xml += name;
+        xml += " type=\"" + TypeName(fieldType) + "\" identifier=\"" +
+            integerToString(fieldId) + "\"";
+        if (amap != NULL) {
+            for (std::map<std::string, std::string>::const_iterator it =
+                 amap->begin(); it != amap->end(); ++it) {
+                xml += " " + it->first + "=\"" + it->second + "\"";
+            }
+        }
+        xml += ">";
+        xml_state_.push_back(name);
+        return writePlain(xml);
+    }
+    int32_t writeFieldEnd() {
+        return writeEndTag();
+    }
+    int32_t writeFieldStop() {
+        return 0;
+    }
+    int32_t writeMapBegin(const TType keyType, const TType valType,
+                          const uint32_t size) {
+        return writePlain("<map key=\"" + TypeName(keyType) + "\" value=\"" +
+            TypeName(valType) + "\" size=\"" + integerToString(size) + "\">");
+    }
+    int32_t writeMapEnd() {
+        return writePlain("</map>");
+    }
+    int32_t writeListBegin(const TType elemType, const uint32_t size) {
+        return writePlain("<list type=\"" + TypeName(elemType) +
+            "\" size=\"" + integerToString(size) + "\">");
+    }
+    int32_t writeListEnd() {
+        return writePlain("</list>");
+    }
+    int32_t writeSetBegin(const TType elemType, const uint32_t size) {
+        return writePlain("<set type=\"" + TypeName(elemType) +
+            "\" size=\"" + integerToString(size) + "\">");
+    }
+    int32_t writeSetEnd() {
+        return writePlain("</set>");
+    }
+    int32_t writeBool(const bool value) {
+        return writePlain(value ? "true" : "false");
+    }
+    int32_t writeByte(const int8_t byte) {
+        return writePlain(integerToString(byte));
+    }
+    int32_t writeI16(const int16_t i16) {
+        return writePlain(integerToString(i16));
+    }
+    int32_t writeI32(const int32_t i32) {
+        return writePlain(integerToString(i32));
+    }
+    int32_t writeI64(const int64_t i64) {
+        return writePlain(integerToString(i64));
+    }
+    int32_t writeU16(const uint16_t u16) {
+        return writePlain(integerToString(u16));
+    }
+    int32_t writeU32(const uint32_t u32) {
+        return writePlain(integerToString(u32));
+    }
+    int32_t writeU64(const uint64_t u64) {
+        return writePlain(integerToString(u64));
+    }
+    int32_t writeIPV4(const uint32_t ip4) {
+        return writePlain(integerToString(ip4));
+    }
+    int32_t writeIPADDR(const boost::asio::ip::address& ipaddress) {
+        return writePlain(ipaddress.to_string());
+    }
+    int32_t writeDouble(const double dub) {
+        return writePlain(integerToString(dub));
+    }
+    int32_t writeString(const std::string& str) {
+        return writePlain(TXMLProtocol::escapeXMLControlChars(str));
+    }
+    int32_t writeBinary(const std::string& str) {
+        return writeString(str);
+    }
+    int32_t writeXML(const std::string& str) {
+        return writePlain("<![CDATA[" + str + "]]>");
+    }
+    int32_t writeUUID(const boost::uuids::uuid& uuid) {
+        return writeString(boost::uuids::to_string(uuid));
+    }
+
+private:
+    static std::string TypeName(TType type) {
+        switch (type) {
+        case T_BOOL:    return "bool";
+        case T_BYTE:    return "byte";
+        case T_I16:     return "i16";
+        case T_I32:     return "i32";
+        case T_I64:     return "i64";
+        case T_U16:     return "u16";
+        case T_U32:     return "u32";
+        case T_U64:     return "u64";
+        case T_IPV4:    return "ipv4";
+        case T_IPADDR:  return "ipaddr";
+        case T_DOUBLE:  return "double";
+        case T_STRING:  return "string";
+        case T_STRUCT:  return "struct";
+        case T_MAP:     return "map";
+        case T_SET:     return "set";
+        case T_LIST:    return "list";
+        case T_SANDESH: return "sandesh";
+        case T_XML:     return "xml";
+        case T_UUID:    return "uuid_t";
+        default:        return "unknown";
+        }
+    }
+
+    int32_t writePlain(const std::string& str) {
+        if (trans_->write((uint8_t *)str.data(), str.length())) {
+            return -1;
+        }
+        return str.length();
+    }
+
+    int32_t writeEndTag() {
+        std::string etag("</" + xml_state_.back() + ">");
+        xml_state_.pop_back();
+        return writePlain(etag);
+    }
+
+    TTransport *trans_;
+    std::vector<std::string> xml_state_;
+};
+
+// XML encode cost of a mix of virtual network and interface UVEs, with the
+// TXMLProtocol compared to the legacy encoder. The output is checked against
+// the expected XML in sandesh_rw_test, and against the legacy encoder here.
+class SandeshPerfTestXMLEncode : public ::testing::Test {
+protected:
+    static const int kVns = 4;
+    static const int kVmisPerVn = 8;
+
+    SandeshPerfTestXMLEncode() {
+        for (int vn = 0; vn < kVns; vn++) {
+            std::string vn_name("default-domain:admin:vn" +
+                                integerToString(vn));
+            PerfTestVnAgent vn_data;
+            vn_data.set_name(vn_name);
+            std::vector<std::string> interfaces;
+            std::vector<PerfTestInterfaceStats> interface_stats;
+            for (int vmi = 0; vmi < kVmisPerVn; vmi++) {
+                std::string vmi_name("default-domain:admin:vmi-" +
+                    integerToString(vn * kVmisPerVn + vmi));
+                interfaces.push_back(vmi_name);
+                PerfTestInterfaceStats stats;
+                stats.set_name(vmi_name);
+                stats.set_in_pkts(123456789ULL * vmi);
+                stats.set_out_pkts(987654321ULL * vmi);
+                stats.set_in_bytes(123456789012ULL * vmi);
+                stats.set_out_bytes(987654321098ULL * vmi);
+                stats.set_speed(10000);
+                interface_stats.push_back(stats);
+
+                PerfTestVmiAgent vmi_data;
+                vmi_data.set_name(vmi_name);
+                vmi_data.set_virtual_network(vn_name);
+                vmi_data.set_vm_name("vm<" + integerToString(vmi) +
+                                     "> 'R&D'");
+                vmi_data.set_ip_address("10.1." + integerToString(vn) + "." +
+                                        integerToString(vmi + 3));
+                vmi_data.set_mac_address("02:a3:5c:6e:0" +
+                                         integerToString(vmi) + ":01");
+                vmi_data.set_active(true);
+                vmi_data.set_fip_list(std::vector<std::string>(2,
+                    "default-domain:admin:public:floating-ip-pool"));
+                vmi_data.set_stats(stats);
+                PerfTestVmiAgentUve *vmi_uve = new PerfTestVmiAgentUve();
+                vmi_uve->set_data(vmi_data);
+                messages_.push_back(vmi_uve);
+            }
+            vn_data.set_interface_list(interfaces);
+            vn_data.set_vrf_list(std::vector<std::string>(1,
+                vn_name + ":" + "vn" + integerToString(vn)));
+            vn_data.set_acl_rules(12);
+            vn_data.set_in_tpkts(123456789012ULL);
+            vn_data.set_out_tpkts(98765432109ULL);
+            vn_data.set_in_bytes(12345678901234ULL);
+            vn_data.set_out_bytes(9876543210987ULL);
+            vn_data.set_interface_stats(interface_stats);
+            std::map<std::string, uint64_t> in_stats;
+            for (int i = 0; i < kVns; i++) {
+                in_stats.insert(std::make_pair("default-domain:admin:vn" +
+                    integerToString(i), 1000000ULL * i));
+            }
+            vn_data.set_in_stats(in_stats);
+            PerfTestVnAgentUve *vn_uve = new PerfTestVnAgentUve();
+            vn_uve->set_data(vn_data);
+            messages_.push_back(vn_uve);
+        }
+    }
+
+    ~SandeshPerfTestXMLEncode() {
+        for (std::vector<Sandesh *>::const_iterator it = messages_.begin();
+             it != messages_.end(); ++it) {
+            (*it)->Release();
+        }
+    }
+
+    // Returns the time taken to encode the messages iterations times
+    uint64_t Encode(boost::shared_ptr<TMemoryBuffer> btrans,
+                    boost::shared_ptr<TProtocol> prot, int iterations) {
+        uint64_t start = ClockMonotonicUsec();
+        for (int i = 0; i < iterations; i++) {
+            for (std::vector<Sandesh *>::const_iterator it = messages_.begin();
+                 it != messages_.end(); ++it) {
+                btrans->resetBuffer();
+                (*it)->Write(prot);
+            }
+        }
+        return ClockMonotonicUsec() - start;
+    }
+
+    void Encode(int iterations) {
+        boost::shared_ptr<TMemoryBuffer> legacy_btrans(
+            new TMemoryBuffer(4096));
+        boost::shared_ptr<TProtocol> legacy_prot(
+            new LegacyXMLProtocol(legacy_btrans));
+        boost::shared_ptr<TMemoryBuffer> btrans(new TMemoryBuffer(4096));
+        boost::shared_ptr<TProtocol> prot(new TXMLProtocol(btrans));
+
+        size_t bytes = 0;
+        for (std::vector<Sandesh *>::const_iterator it = messages_.begin();
+             it != messages_.end(); ++it) {
+            legacy_btrans->resetBuffer();
+            btrans->resetBuffer();
+            int32_t legacy_size = (*it)->Write(legacy_prot);
+            EXPECT_LT(0, legacy_size);
+            int32_t size = (*it)->Write(prot);
+            EXPECT_EQ(legacy_size, size);
+            EXPECT_EQ(static_cast<uint32_t>(size), btrans->available_read());
+            EXPECT_EQ(legacy_btrans->getBufferAsString(),
+                      btrans->getBufferAsString());
+            bytes += btrans->available_read();
+        }
+
+        uint64_t legacy_usecs = Encode(legacy_btrans, legacy_prot, iterations);
+        uint64_t usecs = Encode(btrans, prot, iterations);
+        int messages = iterations * messages_.size();
+        LOG(DEBUG, messages_.size() << " UVEs, " <<
+            bytes / messages_.size() << " bytes average: legacy " <<
+            legacy_usecs * 1000 / messages << " ns, TXMLProtocol " <<
+            usecs * 1000 / messages << " ns per message");
+    }
+
+    std::vector<Sandesh *> messages_;
+};
+
+TEST_F(SandeshPerfTestXMLEncode, UveMix) {
+    Encode(10);
+}
+
+TEST_F(SandeshPerfTestXMLEncode, DISABLED_UveMixPerformance) {
+    Encode(2000);
+}
+
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
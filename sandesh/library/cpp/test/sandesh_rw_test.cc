@@ -18,11 +18,13 @@
 #include "testing/gunit.h"
 
 #include "base/logging.h"
+#include "base/time_util.h"
 #include "base/util.h"
 
 #include <sandesh/protocol/TXMLProtocol.h>
 #include <sandesh/protocol/TJSONProtocol.h>
 #include <sandesh/protocol/TBinaryProtocol.h>
+#include <sandesh/protocol/TCompactProtocol.h>
 #include <sandesh/transport/TBufferTransports.h>
 
 #include <sandesh/sandesh_types.h>
@@ -215,6 +217,52 @@ protected:
         EXPECT_EQ(data_s, expected_json);
     }
 
+    // Bytes per struct and encode and decode time of the XML, binary and
+    // compact protocols.
+    void CompareProtocols(int iterations) {
+        static const char *kNames[] = { "xml", "binary", "compact" };
+        static const int kNumProtocols = sizeof(kNames) / sizeof(kNames[0]);
+
+        uint32_t struct_bytes[kNumProtocols];
+        for (int p = 0; p < kNumProtocols; p++) {
+            boost::shared_ptr<TMemoryBuffer> btrans(new TMemoryBuffer(4096));
+            boost::shared_ptr<TProtocol> prot;
+            if (p == 0) {
+                prot.reset(new TXMLProtocol(btrans));
+            } else if (p == 1) {
+                prot.reset(new TBinaryProtocol(btrans));
+            } else {
+                prot.reset(new TCompactProtocol(btrans));
+            }
+            // Populate and verify the struct
+            SandeshReadWriteProcess(btrans, prot);
+
+            uint64_t start = ClockMonotonicUsec();
+            for (int i = 0; i < iterations; i++) {
+                btrans->resetBuffer();
+                EXPECT_LT(0, wstruct_test_.write(prot));
+            }
+            uint64_t encode_usecs = ClockMonotonicUsec() - start;
+            std::string encoded(btrans->getBufferAsString());
+            struct_bytes[p] = encoded.size();
+
+            start = ClockMonotonicUsec();
+            for (int i = 0; i < iterations; i++) {
+                btrans->resetBuffer(reinterpret_cast<uint8_t *>(
+                    const_cast<char *>(encoded.data())), encoded.size());
+                EXPECT_LT(0, rstruct_test_.read(prot));
+            }
+            uint64_t decode_usecs = ClockMonotonicUsec() - start;
+            EXPECT_EQ(wstruct_test_, rstruct_test_);
+
+            LOG(DEBUG, kNames[p] << ": " << struct_bytes[p] << " bytes, encode "
+                << encode_usecs * 1000 / iterations << " ns, decode "
+                << decode_usecs * 1000 / iterations << " ns per struct");
+        }
+        EXPECT_LT(struct_bytes[1], struct_bytes[0]);
+        EXPECT_LT(struct_bytes[2], struct_bytes[1]);
+    }
+
     SandeshStructTest wstruct_test_;
     SandeshStructTest rstruct_test_;
     SandeshStructJsonTest wjson_struct_test_;
@@ -231,6 +279,81 @@ TEST_F(SandeshReadWriteUnitTest, StructXMLReadWrite) {
     SandeshReadWriteProcess(btrans, prot);
 }
 
+// The expected output was produced by the TXMLProtocol before it buffered
+// its output, XML being the wire format of the collector and the introspect.
+TEST_F(SandeshReadWriteUnitTest, StructXMLGolden) {
+    boost::shared_ptr<TMemoryBuffer> btrans =
+            boost::shared_ptr<TMemoryBuffer>(
+                    new TMemoryBuffer(4096));
+    boost::shared_ptr<TXMLProtocol> prot =
+            boost::shared_ptr<TXMLProtocol>(
+                    new TXMLProtocol(btrans));
+    SandeshXMLGoldenTest golden;
+    golden.set_stringTest("<a href='x'>R&D \"q\"</a>");
+    golden.set_i32Test(-2147483647 - 1);
+    golden.set_i64Test(-9223372036854775807LL - 1);
+    golden.set_byteTest(127);
+    golden.set_negByteTest(-128);
+    golden.set_doubleTest(-0.1);
+    golden.set_expDoubleTest(1.5e+300);
+    golden.set_u64Test(18446744073709551615ull);
+    golden.set_boolTest(false);
+    std::vector<std::string> string_list;
+    string_list.push_back("a<b");
+    string_list.push_back("");
+    string_list.push_back("c>d&e");
+    golden.set_stringListTest(string_list);
+    std::map<std::string, int32_t> string_map;
+    string_map.insert(std::make_pair("k&1", -1));
+    string_map.insert(std::make_pair("k'2", 2));
+    golden.set_mapTest(string_map);
+    std::vector<SandeshListTestElement> struct_list(2);
+    struct_list[0].set_i32Elem(-5);
+    struct_list[1].set_i32Elem(7);
+    golden.set_structListTest(struct_list);
+    golden.set_xmlTest("<x>a&b</x>");
+    boost::uuids::uuid uuid_test =
+         {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+          0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f};
+    golden.set_uuidTest(uuid_test);
+
+    std::string expected_xml =
+        "<SandeshXMLGoldenTest>"
+        "<stringTest type=\"string\" identifier=\"1\">"
+        "&lt;a href=&apos;x&apos;&gt;R&amp;D \"q\"&lt;/a&gt;</stringTest>"
+        "<i32Test type=\"i32\" identifier=\"2\">-2147483648</i32Test>"
+        "<i64Test type=\"i64\" identifier=\"3\">-9223372036854775808</i64Test>"
+        "<byteTest type=\"byte\" identifier=\"4\">127</byteTest>"
+        "<negByteTest type=\"byte\" identifier=\"5\">-128</negByteTest>"
+        "<doubleTest type=\"double\" identifier=\"6\">-0.1</doubleTest>"
+        "<expDoubleTest type=\"double\" identifier=\"7\">1.5e+300"
+        "</expDoubleTest>"
+        "<u64Test type=\"u64\" identifier=\"8\">18446744073709551615</u64Test>"
+        "<boolTest type=\"bool\" identifier=\"9\">false</boolTest>"
+        "<stringListTest type=\"list\" identifier=\"10\">"
+        "<list type=\"string\" size=\"3\"><element>a&lt;b</element>"
+        "<element></element><element>c&gt;d&amp;e</element></list>"
+        "</stringListTest>"
+        "<mapTest type=\"map\" identifier=\"11\" tags=\"\">"
+        "<map key=\"string\" value=\"i32\" size=\"2\">"
+        "<element>k&amp;1</element><element>-1</element>"
+        "<element>k&apos;2</element><element>2</element></map></mapTest>"
+        "<structListTest type=\"list\" identifier=\"12\" tags=\".i32Elem\">"
+        "<list type=\"struct\" size=\"2\"><SandeshListTestElement>"
+        "<i32Elem type=\"i32\" identifier=\"1\">-5</i32Elem>"
+        "</SandeshListTestElement><SandeshListTestElement>"
+        "<i32Elem type=\"i32\" identifier=\"1\">7</i32Elem>"
+        "</SandeshListTestElement></list></structListTest>"
+        "<xmlTest type=\"xml\" identifier=\"13\"><![CDATA[<x>a&b</x>]]>"
+        "</xmlTest>"
+        "<uuidTest type=\"uuid_t\" identifier=\"14\">"
+        "00010203-0405-0607-0809-0a0b0c0d0e0f</uuidTest>"
+        "</SandeshXMLGoldenTest>";
+    int32_t wxfer = golden.write(prot);
+    EXPECT_EQ(expected_xml, btrans->getBufferAsString());
+    EXPECT_EQ(static_cast<int32_t>(expected_xml.length()), wxfer);
+}
+
 TEST_F(SandeshReadWriteUnitTest, StructBinaryReadWrite) {
     boost::shared_ptr<TMemoryBuffer> btrans =
             boost::shared_ptr<TMemoryBuffer>(
@@ -241,6 +364,43 @@ TEST_F(SandeshReadWriteUnitTest, StructBinaryReadWrite) {
     SandeshReadWriteProcess(btrans, prot);
 }
 
+TEST_F(SandeshReadWriteUnitTest, StructCompactReadWrite) {
+    boost::shared_ptr<TMemoryBuffer> btrans =
+            boost::shared_ptr<TMemoryBuffer>(
+                    new TMemoryBuffer(4096));
+    boost::shared_ptr<TCompactProtocol> prot =
+            boost::shared_ptr<TCompactProtocol>(
+                    new TCompactProtocol(btrans));
+    SandeshReadWriteProcess(btrans, prot);
+}
+
+// Truncated compact input must fail to read instead of consuming
+// uninitialized bytes.
+TEST_F(SandeshReadWriteUnitTest, StructCompactTruncated) {
+    boost::shared_ptr<TMemoryBuffer> btrans =
+            boost::shared_ptr<TMemoryBuffer>(
+                    new TMemoryBuffer(4096));
+    boost::shared_ptr<TCompactProtocol> prot =
+            boost::shared_ptr<TCompactProtocol>(
+                    new TCompactProtocol(btrans));
+    SandeshReadWriteProcess(btrans, prot);
+    btrans->resetBuffer();
+    EXPECT_LT(0, wstruct_test_.write(prot));
+    std::string encoded(btrans->getBufferAsString());
+    for (size_t len = 0; len < encoded.size(); len++) {
+        btrans->resetBuffer(reinterpret_cast<uint8_t *>(
+            const_cast<char *>(encoded.data())), len);
+        EXPECT_GT(0, rstruct_test_.read(prot)) << "length " << len;
+    }
+}
+
+TEST_F(SandeshReadWriteUnitTest, ProtocolComparison) {
+    CompareProtocols(10);
+}
+
+TEST_F(SandeshReadWriteUnitTest, DISABLED_ProtocolComparisonPerformance) {
+    CompareProtocols(20000);
+}
 
 TEST_F(SandeshReadWriteUnitTest, StructJSONReadWrite) {
     boost::shared_ptr<TMemoryBuffer> btrans =
@@ -128,6 +128,12 @@ private:
         return ret;
     }
 
+    virtual bool SendShared(const u_int8_t *data, size_t size,
+                            const boost::shared_ptr<const void> &owner,
+                            size_t *sent) {
+        return Send(data, size, sent);
+    }
+
     vector<int> sizes;
     int release_count_;
 